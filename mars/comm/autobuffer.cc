@@ -37,6 +37,7 @@ AutoBuffer::AutoBuffer(size_t _nSize)
     , length_(0)
     , capacity_(0)
     , malloc_unitsize_(_nSize)
+    , allocator_(NULL)
 {}
 
 
@@ -45,7 +46,8 @@ AutoBuffer::AutoBuffer(void* _pbuffer, size_t _len, size_t _nSize)
     , pos_(0)
     , length_(0)
     , capacity_(0)
-    , malloc_unitsize_(_nSize) {
+    , malloc_unitsize_(_nSize)
+    , allocator_(NULL) {
     Attach(_pbuffer, _len);
 }
 
@@ -54,7 +56,8 @@ AutoBuffer::AutoBuffer(const void* _pbuffer, size_t _len, size_t _nSize)
     , pos_(0)
     , length_(0)
     , capacity_(0)
-    , malloc_unitsize_(_nSize) {
+    , malloc_unitsize_(_nSize)
+    , allocator_(NULL) {
     Write(0, _pbuffer, _len);
 }
 
@@ -255,6 +258,7 @@ size_t AutoBuffer::Capacity() const {
 
 void AutoBuffer::Attach(void* _pbuffer, size_t _len) {
     Reset();
+    allocator_ = NULL;
     parray_ = (unsigned char*)_pbuffer;
     length_ = _len;
     capacity_ = _len;
@@ -266,6 +270,7 @@ void AutoBuffer::Attach(AutoBuffer& _rhs) {
     pos_ = _rhs.pos_;
     length_ = _rhs.length_;
     capacity_ = _rhs.capacity_;
+    allocator_ = _rhs.allocator_;
 
     _rhs.parray_ = NULL;
     _rhs.Reset();
@@ -284,8 +289,12 @@ void* AutoBuffer::Detach(size_t* _plen) {
 }
 
 void AutoBuffer::Reset() {
-    if (NULL != parray_)
-        free(parray_);
+    if (NULL != parray_) {
+        if (NULL != allocator_)
+            allocator_->Free(parray_, capacity_);
+        else
+            free(parray_);
+    }
 
     parray_ = NULL;
     pos_ = 0;
@@ -293,17 +302,35 @@ void AutoBuffer::Reset() {
     capacity_ = 0;
 }
 
+void AutoBuffer::SetAllocator(AutoBufferAllocator* _allocator) {
+    ASSERT2(NULL == parray_, "capacity:%" PRIu64, (uint64_t)capacity_);
+    if (NULL != parray_) return;
+    allocator_ = _allocator;
+}
+
+AutoBufferAllocator* AutoBuffer::Allocator() const {
+    return allocator_;
+}
+
 void AutoBuffer::__FitSize(size_t _len) {
     if (_len > capacity_) {
         size_t mallocsize = ((_len + malloc_unitsize_ -1)/malloc_unitsize_)*malloc_unitsize_ ;
 
-        void* p = realloc(parray_, mallocsize);
+        size_t newcapacity = mallocsize;
+        void* p = NULL;
+        if (NULL != allocator_)
+            p = allocator_->Realloc(parray_, capacity_, mallocsize, newcapacity);
+        else
+            p = realloc(parray_, mallocsize);
 
         if (NULL == p) {
 		ASSERT2(p, "_len=%" PRIu64 ", m_nMallocUnitSize=%" PRIu64 ", nMallocSize=%" PRIu64", m_nCapacity=%" PRIu64,
 				(uint64_t)_len, (uint64_t)malloc_unitsize_, (uint64_t)mallocsize, (uint64_t)capacity_);
 
-            free(parray_);
+            if (NULL != allocator_ && NULL != parray_)
+                allocator_->Free(parray_, capacity_);
+            else
+                free(parray_);
             parray_ = NULL;
             capacity_ = 0;
             return;
@@ -314,7 +341,7 @@ void AutoBuffer::__FitSize(size_t _len) {
         ASSERT2(_len <= 50 * 1024 * 1024, "%u", (uint32_t)_len);
         ASSERT(parray_);
         
-        memset(parray_+capacity_, 0, mallocsize-capacity_);
-        capacity_ = mallocsize;
+        memset(parray_+capacity_, 0, newcapacity-capacity_);
+        capacity_ = newcapacity;
     }
 }
@@ -18,6 +18,20 @@
 #include <sys/types.h>
 #include <string.h>
 
+/*
+ * Optional allocator of an AutoBuffer. Memory it hands out must still be releasable by free(),
+ * because Detach hands the raw pointer to callers that may not know the allocator.
+ */
+class AutoBufferAllocator {
+  public:
+    virtual ~AutoBufferAllocator() {}
+
+    // grow _ptr (capacity _capacity, NULL if none) to hold at least _size bytes, keeping its content.
+    // returns NULL on failure, _new_capacity receives the usable size.
+    virtual void* Realloc(void* _ptr, size_t _capacity, size_t _size, size_t& _new_capacity) = 0;
+    virtual void  Free(void* _ptr, size_t _capacity) = 0;
+};
+
 class AutoBuffer {
   public:
     enum TSeek {
@@ -94,12 +108,18 @@ class AutoBuffer {
     size_t Length() const;
     size_t Capacity() const;
 
-    void Attach(void* _pbuffer, size_t _len);
-    void Attach(AutoBuffer& _rhs);
+    void Attach(void* _pbuffer, size_t _len);   // malloc memory, the buffer drops its allocator
+    void Attach(AutoBuffer& _rhs);              // the memory of _rhs together with its allocator
+    // the memory belongs to Allocator() if there is one: give it back by Allocator()->Free(ptr, capacity)
+    // with the Capacity() from before Detach. free() releases it as well, but the allocator never learns.
     void* Detach(size_t* _plen = NULL);
 
     void Reset();
 
+    // only while the buffer holds no memory, NULL for malloc/realloc/free
+    void SetAllocator(AutoBufferAllocator* _allocator);
+    AutoBufferAllocator* Allocator() const;
+
   private:
     void __FitSize(size_t _len);
 
@@ -113,6 +133,7 @@ class AutoBuffer {
     size_t length_;
     size_t capacity_;
     size_t malloc_unitsize_;
+    AutoBufferAllocator* allocator_;
 };
 
 extern const AutoBuffer KNullAtuoBuffer;
@@ -0,0 +1,170 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * buffer_pool.cc
+ *
+ *  Created on: 2026-10-18
+ */
+
+#include "buffer_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const size_t kClassCount = 10;   // 128B .. 64KB
+
+struct SizeClassBufferPool::ThreadCache {
+    void*  head[kClassCount];
+    size_t count[kClassCount];
+};
+
+static size_t __ClassIndex(size_t _class_size) {
+    size_t index = 0;
+    while ((SizeClassBufferPool::kMinClassSize << index) < _class_size) ++index;
+    return index;
+}
+
+SizeClassBufferPool& SizeClassBufferPool::Instance() {
+    // never destroyed, threads may release their caches after static destruction
+    static SizeClassBufferPool* pool = new SizeClassBufferPool();
+    return *pool;
+}
+
+SizeClassBufferPool::SizeClassBufferPool()
+: cache_(&SizeClassBufferPool::__ReleaseCache), hits_(0), misses_(0), bytes_in_flight_(0) {
+}
+
+SizeClassBufferPool::~SizeClassBufferPool() {
+    __ReleaseCache(cache_.get());
+    cache_.set(NULL);
+}
+
+size_t SizeClassBufferPool::ClassSize(size_t _size) {
+    if (_size > kMaxClassSize) return 0;
+
+    size_t class_size = kMinClassSize;
+    while (class_size < _size) class_size <<= 1;
+    return class_size;
+}
+
+void* SizeClassBufferPool::Alloc(size_t _size, size_t& _capacity) {
+    size_t class_size = ClassSize(_size);
+    if (0 == class_size) {
+        _capacity = _size;
+        return malloc(_size);
+    }
+
+    ThreadCache* cache = __Cache();
+    size_t index = __ClassIndex(class_size);
+    void* ptr = NULL;
+
+    if (NULL != cache && NULL != cache->head[index]) {
+        ptr = cache->head[index];
+        memcpy(&cache->head[index], ptr, sizeof(void*));
+        --cache->count[index];
+        hits_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        ptr = malloc(class_size);
+        if (NULL == ptr) return NULL;
+        misses_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bytes_in_flight_.fetch_add((int64_t)class_size, std::memory_order_relaxed);
+    _capacity = class_size;
+    return ptr;
+}
+
+void* SizeClassBufferPool::Realloc(void* _ptr, size_t _capacity, size_t _size, size_t& _new_capacity) {
+    if (NULL != _ptr && _size <= _capacity) {
+        _new_capacity = _capacity;
+        return _ptr;
+    }
+
+    if (0 == ClassSize(_size)) {
+        // leaving the size classes, realloc may still grow in place
+        if (_capacity == ClassSize(_capacity)) bytes_in_flight_.fetch_sub((int64_t)_capacity, std::memory_order_relaxed);
+        _new_capacity = _size;
+        return realloc(_ptr, _size);
+    }
+
+    void* ptr = Alloc(_size, _new_capacity);
+    if (NULL == ptr) return NULL;
+
+    if (NULL != _ptr) {
+        memcpy(ptr, _ptr, _capacity);
+        Free(_ptr, _capacity);
+    }
+    return ptr;
+}
+
+void SizeClassBufferPool::Free(void* _ptr, size_t _capacity) {
+    if (NULL == _ptr) return;
+
+    // only blocks of exactly a class size can be reused, anything else came from malloc/realloc directly
+    if (_capacity != ClassSize(_capacity)) {
+        free(_ptr);
+        return;
+    }
+
+    bytes_in_flight_.fetch_sub((int64_t)_capacity, std::memory_order_relaxed);
+
+    ThreadCache* cache = __Cache();
+    size_t index = __ClassIndex(_capacity);
+
+    if (NULL == cache || kMaxCachedPerClass <= cache->count[index]) {
+        free(_ptr);
+        return;
+    }
+
+    memcpy(_ptr, &cache->head[index], sizeof(void*));
+    cache->head[index] = _ptr;
+    ++cache->count[index];
+}
+
+SizeClassBufferPool::Stat SizeClassBufferPool::GetStat() const {
+    Stat stat;
+    stat.hits = hits_.load(std::memory_order_relaxed);
+    stat.misses = misses_.load(std::memory_order_relaxed);
+    stat.bytes_in_flight = bytes_in_flight_.load(std::memory_order_relaxed);
+    return stat;
+}
+
+void SizeClassBufferPool::ResetStat() {
+    hits_.store(0, std::memory_order_relaxed);
+    misses_.store(0, std::memory_order_relaxed);
+}
+
+SizeClassBufferPool::ThreadCache* SizeClassBufferPool::__Cache() {
+    ThreadCache* cache = (ThreadCache*)cache_.get();
+    if (NULL != cache) return cache;
+
+    cache = (ThreadCache*)calloc(1, sizeof(ThreadCache));
+    cache_.set(cache);
+    return cache;
+}
+
+void SizeClassBufferPool::__ReleaseCache(void* _cache) {
+    ThreadCache* cache = (ThreadCache*)_cache;
+    if (NULL == cache) return;
+
+    for (size_t i = 0; i < kClassCount; ++i) {
+        void* ptr = cache->head[i];
+        while (NULL != ptr) {
+            void* next = NULL;
+            memcpy(&next, ptr, sizeof(void*));
+            free(ptr);
+            ptr = next;
+        }
+    }
+    free(cache);
+}
@@ -0,0 +1,82 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * buffer_pool.h
+ *
+ *  Created on: 2026-10-18
+ */
+
+#ifndef COMM_BUFFER_POOL_H_
+#define COMM_BUFFER_POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/thread/tss.h"
+
+/*
+ * Power of 2 size classes from 128 bytes to 64KB, cached in per thread freelists.
+ * A block freed on another thread than it was allocated on simply joins that thread's list.
+ * Blocks are plain malloc memory, so a buffer detached from a pooled AutoBuffer may be released by free(),
+ * it just stops being counted in BytesInFlight. Larger sizes go straight to malloc/realloc.
+ *
+ *   AutoBuffer buffer;
+ *   buffer.SetAllocator(&SizeClassBufferPool::Instance());
+ */
+class SizeClassBufferPool : public AutoBufferAllocator {
+  public:
+    struct Stat {
+        uint64_t hits;              // served from a freelist
+        uint64_t misses;            // served by malloc
+        int64_t  bytes_in_flight;   // size class bytes handed out and not returned yet
+    };
+
+    static const size_t kMinClassSize = 128;
+    static const size_t kMaxClassSize = 64 * 1024;
+    static const size_t kMaxCachedPerClass = 32;    // per thread
+
+    static SizeClassBufferPool& Instance();
+
+  public:
+    SizeClassBufferPool();
+    virtual ~SizeClassBufferPool();
+
+    // for PtrBuffer users, the block is released by Free(_ptr, _capacity)
+    void* Alloc(size_t _size, size_t& _capacity);
+
+    virtual void* Realloc(void* _ptr, size_t _capacity, size_t _size, size_t& _new_capacity);
+    virtual void  Free(void* _ptr, size_t _capacity);
+
+    Stat GetStat() const;
+    void ResetStat();
+
+    static size_t ClassSize(size_t _size);     // 0 if above kMaxClassSize
+
+  private:
+    SizeClassBufferPool(const SizeClassBufferPool&);
+    SizeClassBufferPool& operator=(const SizeClassBufferPool&);
+
+    struct ThreadCache;
+    ThreadCache* __Cache();
+    static void __ReleaseCache(void* _cache);
+
+  private:
+    Tss cache_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<int64_t>  bytes_in_flight_;
+};
+
+#endif /* COMM_BUFFER_POOL_H_ */
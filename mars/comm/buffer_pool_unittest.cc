@@ -0,0 +1,82 @@
+#include "buffer_pool.h"
+#include "gtest/gtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace testing;
+
+TEST(buffer_pool, class_size) {
+    EXPECT_EQ(SizeClassBufferPool::ClassSize(1), 128u);
+    EXPECT_EQ(SizeClassBufferPool::ClassSize(128), 128u);
+    EXPECT_EQ(SizeClassBufferPool::ClassSize(129), 256u);
+    EXPECT_EQ(SizeClassBufferPool::ClassSize(64 * 1024), 64u * 1024);
+    EXPECT_EQ(SizeClassBufferPool::ClassSize(64 * 1024 + 1), 0u);
+}
+
+TEST(buffer_pool, grow_keeps_content_and_reuses) {
+    SizeClassBufferPool pool;
+
+    {
+        AutoBuffer buffer;
+        buffer.SetAllocator(&pool);
+        for (int i = 0; i < 100 * 1024; ++i) buffer.Write((char)(i % 251));
+        for (int i = 0; i < 100 * 1024; ++i) ASSERT_EQ(((char*)buffer.Ptr())[i], (char)(i % 251));
+    }
+    EXPECT_EQ(pool.GetStat().bytes_in_flight, 0);
+
+    {
+        AutoBuffer buffer;
+        buffer.SetAllocator(&pool);
+        buffer.Write("hello", 5);
+    }
+    pool.ResetStat();
+    {
+        AutoBuffer buffer;
+        buffer.SetAllocator(&pool);
+        buffer.Write("hello", 5);
+        EXPECT_EQ(buffer.Capacity(), 128u);
+        EXPECT_EQ(pool.GetStat().hits, 1u);
+        EXPECT_EQ(pool.GetStat().bytes_in_flight, 128);
+    }
+    EXPECT_EQ(pool.GetStat().misses, 0u);
+
+    // detached blocks stay plain malloc memory
+    AutoBuffer buffer;
+    buffer.SetAllocator(&pool);
+    buffer.Write("detach", 6);
+    free(buffer.Detach());
+}
+
+// Attach moves the allocator along with the memory, Detach leaves giving it back to the caller
+TEST(buffer_pool, attach_and_detach_keep_the_allocator) {
+    SizeClassBufferPool pool;
+
+    {
+        AutoBuffer pooled;
+        pooled.SetAllocator(&pool);
+        pooled.Write("attach", 6);
+
+        AutoBuffer plain;
+        plain.Attach(pooled);
+        EXPECT_TRUE(&pool == plain.Allocator());
+        EXPECT_EQ(pool.GetStat().bytes_in_flight, 128);
+
+        // malloc memory of a class size is not the pool's to keep
+        AutoBuffer attached;
+        attached.SetAllocator(&pool);
+        attached.Attach(malloc(128), 128);
+        EXPECT_TRUE(NULL == attached.Allocator());
+    }
+    EXPECT_EQ(pool.GetStat().bytes_in_flight, 0);
+
+    AutoBuffer buffer;
+    buffer.SetAllocator(&pool);
+    buffer.Write("detach", 6);
+    size_t capacity = buffer.Capacity();
+    void* ptr = buffer.Detach();
+    buffer.Allocator()->Free(ptr, capacity);
+    EXPECT_EQ(pool.GetStat().bytes_in_flight, 0);
+}
+
+EXPORT_GTEST_SYMBOLS(comm_export_buffer_pool_unittest)
@@ -29,6 +29,11 @@
 
 #include "network/getdnssvraddrs.h"
 #include "socket/local_ipstack.h"
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <memory>
 enum {
     kGetIPDoing,
     kGetIPTimeout,
@@ -37,145 +42,213 @@ enum {
     kGetIPFail,
 };
 
-struct dnsinfo {
-    thread_tid      threadid;
-    DNS*            dns;
-    DNS::DNSFunc    dns_func;
+// one resolution, shared by every caller of the same host through the same DNSFunc
+struct DNSQuery {
     std::string     host_name;
+    DNS::DNSFunc    dns_func;
     std::vector<std::string> result;
     int status;
+    bool resolving;         // picked by a worker
+    uint64_t deadline;      // the latest a waiter still wants the result
 };
 
-static std::string DNSInfoToString(const struct dnsinfo& _info) {
-    XMessage msg;
-    msg(TSF"info:%_, threadid:%_, dns:%_, host_name:%_, status:%_", &_info, _info.threadid, _info.dns, _info.host_name, _info.status);
-    return msg.Message();
-}
-static std::vector<dnsinfo> sg_dnsinfo_vec;
-static Condition sg_condition;
+// one caller blocked in GetHostByName, cancelling it leaves the query running
+struct DNSWaiter {
+    DNS*            dns;
+    std::string     host_name;
+    int status;
+};
+
+struct DNSCacheItem {
+    std::vector<std::string> ips;   // empty for a failed lookup
+    uint64_t expire_time;
+};
+
+static const int kMaxDNSWorkers = 4;
+static const long kDNSWorkerIdleTimeout = 30 * 1000;
+static const size_t kMaxDNSCacheSize = 256;
+
+static std::list<std::shared_ptr<DNSQuery> > sg_running_queries;    // queued or resolving
+static std::list<std::shared_ptr<DNSQuery> > sg_pending_queries;    // not picked by a worker yet
+static std::list<DNSWaiter*> sg_waiters;
+static std::map<std::string, DNSCacheItem> sg_cache;
+static uint64_t sg_cache_ttl = 60 * 1000;
+static uint64_t sg_negative_cache_ttl = 5 * 1000;
+static int sg_worker_count = 0;
+static int sg_idle_worker_count = 0;
+
+static Condition sg_condition;          // a query finished or a waiter got cancelled
+static Condition sg_worker_condition;   // a query got queued
 static Mutex sg_mutex;
 
-static void __GetIP() {
+static std::vector<std::string> __Resolve(const std::string& _host_name, DNS::DNSFunc _dnsfunc) {
     xverbose_function();
 
+    if (NULL != _dnsfunc) return _dnsfunc(_host_name);
 
-    std::string host_name;
-    DNS::DNSFunc dnsfunc = NULL;
+    //
+    xgroup2_define(log_group);
+    std::vector<socket_address> dnssvraddrs;
+    mars::comm::getdnssvraddrs(dnssvraddrs);
+    xinfo2("dns server:") >> log_group;
+    for (std::vector<socket_address>::iterator iter = dnssvraddrs.begin(); iter != dnssvraddrs.end(); ++iter) {
+        xinfo2(TSF"%_:%_ ", iter->ip(), iter->port()) >> log_group;
+    }
 
-    ScopedLock lock(sg_mutex);
-    std::vector<dnsinfo>::iterator iter = sg_dnsinfo_vec.begin();
+    //
+    struct addrinfo hints, *single, *result;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = PF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    //in iOS work fine, in Android ipv6 stack get ipv4-ip fail
+    //and in ipv6 stack AI_ADDRCONFIGd will filter ipv4-ip but we ipv4-ip can use by nat64
+//    hints.ai_flags = AI_V4MAPPED|AI_ADDRCONFIG;
+    int error = 0;
+    TLocalIPStack ipstack = local_ipstack_detect();
+    if (ELocalIPStack_IPv4 == ipstack) {
+        error = getaddrinfo(_host_name.c_str(), NULL, &hints, &result);
+    } else {
+        error = getaddrinfo(_host_name.c_str(), NULL, /*&hints*/NULL, &result);
+    }
 
-    for (; iter != sg_dnsinfo_vec.end(); ++iter) {
-        if (iter->threadid == ThreadUtil::currentthreadid()) {
-            host_name = iter->host_name;
-            dnsfunc = iter->dns_func;
-            break;
-        }
+    std::vector<std::string> ips;
+    if (error != 0) {
+        xwarn2(TSF"error, error:%_/%_, hostname:%_, ipstack:%_", error, strerror(error), _host_name.c_str(), ipstack);
+        return ips;
     }
 
-    lock.unlock();
-
-    if (NULL == dnsfunc) {
-        
-        //
-        xgroup2_define(log_group);
-        std::vector<socket_address> dnssvraddrs;
-        mars::comm::getdnssvraddrs(dnssvraddrs);
-        xinfo2("dns server:") >> log_group;
-        for (std::vector<socket_address>::iterator iter = dnssvraddrs.begin(); iter != dnssvraddrs.end(); ++iter) {
-            xinfo2(TSF"%_:%_ ", iter->ip(), iter->port()) >> log_group;
-        }
-        
-        //
-        struct addrinfo hints, *single, *result;
-        memset(&hints, 0, sizeof(hints));
-        hints.ai_family = PF_INET;
-        hints.ai_socktype = SOCK_STREAM;
-        //in iOS work fine, in Android ipv6 stack get ipv4-ip fail
-        //and in ipv6 stack AI_ADDRCONFIGd will filter ipv4-ip but we ipv4-ip can use by nat64
-    //    hints.ai_flags = AI_V4MAPPED|AI_ADDRCONFIG;
-        int error = 0;
-        TLocalIPStack ipstack = local_ipstack_detect();
-        if (ELocalIPStack_IPv4 == ipstack) {
-            error = getaddrinfo(host_name.c_str(), NULL, &hints, &result);
-        } else {
-            error = getaddrinfo(host_name.c_str(), NULL, /*&hints*/NULL, &result);
+    for (single = result; single; single = single->ai_next) {
+        // In Indonesia, if there is no ipv6's ip, operators return 0.0.0.0.
+        if (PF_INET == single->ai_family) {
+            sockaddr_in* addr_in = (sockaddr_in*)single->ai_addr;
+            if (INADDR_ANY == addr_in->sin_addr.s_addr || INADDR_NONE == addr_in->sin_addr.s_addr) {
+                xwarn2(TSF"hehe, addr_in->sin_addr.s_addr:%0", addr_in->sin_addr.s_addr);
+                continue;
+            }
         }
-           
-        lock.lock();
 
-        iter = sg_dnsinfo_vec.begin();
-        for (; iter != sg_dnsinfo_vec.end(); ++iter) {
-            if (iter->threadid == ThreadUtil::currentthreadid()) {
-                break;
-            }
+        socket_address sock_addr(single->ai_addr);
+        const char* ip = sock_addr.ip();
+
+        if (!socket_address(ip, 0).valid_server_address(false, true)) {
+            xerror2(TSF"ip is invalid, ip:%0", ip);
+            continue;
         }
 
-        if (error != 0) {
-            xwarn2(TSF"error, error:%_/%_, hostname:%_, ipstack:%_", error, strerror(error), host_name.c_str(), ipstack);
+        ips.push_back(ip);
+    }
 
-            if (iter != sg_dnsinfo_vec.end()) iter->status = kGetIPFail;
+    //
+    xgroup2_define(ip_group);
+    xinfo2(TSF"host %_ resolved iplist: ", _host_name) >> ip_group;
+    for(auto ip : ips){
+        xinfo2(TSF"%_,", ip) >> ip_group;
+    }
 
-            sg_condition.notifyAll();
-            return;
-        } else {
-            if (iter == sg_dnsinfo_vec.end()) {
-                freeaddrinfo(result);
-                return;
-            }
+    freeaddrinfo(result);
+    return ips;
+}
 
-            for (single = result; single; single = single->ai_next) {
-                // In Indonesia, if there is no ipv6's ip, operators return 0.0.0.0.
-                if (PF_INET == single->ai_family) {
-                    sockaddr_in* addr_in = (sockaddr_in*)single->ai_addr;
-//                    struct in_addr convertAddr;
-                    if (INADDR_ANY == addr_in->sin_addr.s_addr || INADDR_NONE == addr_in->sin_addr.s_addr) {
-                        xwarn2(TSF"hehe, addr_in->sin_addr.s_addr:%0", addr_in->sin_addr.s_addr);
-                        continue;
-                    }
-                }
+// sg_mutex held
+static bool __LookupCache(const std::string& _host_name, std::vector<std::string>& _ips) {
+    std::map<std::string, DNSCacheItem>::iterator it = sg_cache.find(_host_name);
+    if (sg_cache.end() == it) return false;
 
+    if (gettickcount() >= it->second.expire_time) {
+        sg_cache.erase(it);
+        return false;
+    }
 
-//                convertAddr.s_addr = addr_in->sin_addr.s_addr;
-                socket_address sock_addr(single->ai_addr);
-                const char* ip = sock_addr.ip();
+    _ips = it->second.ips;
+    return true;
+}
 
-                if (!socket_address(ip, 0).valid_server_address(false, true)) {
-                    xerror2(TSF"ip is invalid, ip:%0", ip);
-                    continue;
-                }
+// sg_mutex held
+static void __UpdateCache(const std::string& _host_name, const std::vector<std::string>& _ips) {
+    uint64_t ttl = _ips.empty() ? sg_negative_cache_ttl : sg_cache_ttl;
+    if (0 == ttl) return;
 
-                iter->result.push_back(ip);
-            }
-            
-            //
-            xgroup2_define(ip_group);
-            xinfo2(TSF"host %_ resolved iplist: ", host_name) >> ip_group;
-            for(auto ip : iter->result){
-                xinfo2(TSF"%_,", ip) >> ip_group;
-            }
-            
-            freeaddrinfo(result);
-            iter->status = kGetIPSuc;
-            sg_condition.notifyAll();
-        }
-    } else {
-        std::vector<std::string> ips = dnsfunc(host_name);
-        lock.lock();
-        
-        iter = sg_dnsinfo_vec.begin();
-        for (; iter != sg_dnsinfo_vec.end(); ++iter) {
-            if (iter->threadid == ThreadUtil::currentthreadid()) {
-                break;
-            }
+    uint64_t now = gettickcount();
+    if (kMaxDNSCacheSize <= sg_cache.size() && sg_cache.end() == sg_cache.find(_host_name)) {
+        for (std::map<std::string, DNSCacheItem>::iterator it = sg_cache.begin(); it != sg_cache.end();) {
+            if (now >= it->second.expire_time) sg_cache.erase(it++);
+            else ++it;
         }
-        
-        if (iter != sg_dnsinfo_vec.end()) {
-            iter->status = ips.empty()? kGetIPFail:kGetIPSuc;
-            iter->result = ips;
+        if (kMaxDNSCacheSize <= sg_cache.size()) sg_cache.clear();
+    }
+
+    DNSCacheItem& item = sg_cache[_host_name];
+    item.ips = _ips;
+    item.expire_time = now + ttl;
+}
+
+static void __DNSWorker() {
+    xverbose_function();
+    ScopedLock lock(sg_mutex);
+
+    while (true) {
+        if (sg_pending_queries.empty()) {
+            ++sg_idle_worker_count;
+            int ret = sg_worker_condition.wait(lock, kDNSWorkerIdleTimeout);
+            --sg_idle_worker_count;
+
+            if (ETIMEDOUT == ret && sg_pending_queries.empty()) break;
+            continue;
         }
+
+        std::shared_ptr<DNSQuery> query = sg_pending_queries.front();
+        sg_pending_queries.pop_front();
+        query->resolving = true;
+        lock.unlock();
+
+        std::vector<std::string> ips = __Resolve(query->host_name, query->dns_func);
+
+        lock.lock();
+        query->result.swap(ips);
+        query->status = query->result.empty() ? kGetIPFail : kGetIPSuc;
+        sg_running_queries.remove(query);
+        if (NULL == query->dns_func) __UpdateCache(query->host_name, query->result);
         sg_condition.notifyAll();
     }
+
+    --sg_worker_count;
+}
+
+// sg_mutex held
+// a worker stuck in a resolution nobody waits for any more does not hold a place of kMaxDNSWorkers
+static int __LiveWorkerCount() {
+    uint64_t now = gettickcount();
+    int count = sg_worker_count;
+    for (std::list<std::shared_ptr<DNSQuery> >::iterator it = sg_running_queries.begin(); it != sg_running_queries.end(); ++it) {
+        if ((*it)->resolving && now >= (*it)->deadline) --count;
+    }
+    return count;
+}
+
+// sg_mutex held
+static bool __Dispatch(const std::shared_ptr<DNSQuery>& _query, bool& _start_fail) {
+    sg_pending_queries.push_back(_query);
+
+    int live_workers = __LiveWorkerCount();
+    if ((int)sg_pending_queries.size() > sg_idle_worker_count && live_workers < kMaxDNSWorkers) {
+        // detached when the Thread object goes out of scope, the worker ends after idling a while
+        Thread thread(&__DNSWorker, "dns_worker");
+        if (0 == thread.start()) {
+            ++sg_worker_count;
+            ++live_workers;
+        } else {
+            _start_fail = true;
+            xerror2(TSF"start the thread fail, workers:%_, live:%_", sg_worker_count, live_workers);
+        }
+    }
+
+    if (0 == live_workers) {
+        sg_pending_queries.remove(_query);
+        return false;
+    }
+
+    sg_worker_condition.notifyOne();
+    return true;
 }
 
 ///////////////////////////////////////////////////////////////////
@@ -199,89 +272,67 @@ bool DNS::GetHostByName(const std::string& _host_name, std::vector<std::string>&
 
     if (_breaker && _breaker->isbreak) return false;
 
-    Thread thread(&__GetIP, _host_name.c_str());
-    int startRet = thread.start();
-
-    if (startRet != 0) {
-        xerror2(TSF"start the thread fail");
-        return false;
+    if (NULL == dnsfunc_ && __LookupCache(_host_name, ips)) {
+        xdebug2(TSF"dns cache hit, host:%_, ips:%_", _host_name, ips.size());
+        return !ips.empty();
     }
 
-    dnsinfo info;
-    info.threadid = thread.tid();
-    info.host_name = _host_name;
-    info.dns_func = dnsfunc_;
-    info.dns = this;
-    info.status = kGetIPDoing;
-    sg_dnsinfo_vec.push_back(info);
-
-    if (_breaker) _breaker->dnsstatus = &(sg_dnsinfo_vec.back().status);
-
     uint64_t time_end = gettickcount() + (uint64_t)millsec;
 
-    while (true) {
-        uint64_t time_cur = gettickcount();
-        uint64_t time_wait = time_end > time_cur ? time_end - time_cur : 0;
-
-        int wait_ret = sg_condition.wait(lock, (long)time_wait);
-
-        std::vector<dnsinfo>::iterator it = sg_dnsinfo_vec.begin();
-
-        for (; it != sg_dnsinfo_vec.end(); ++it) {
-            if (info.threadid == it->threadid)
-                break;
+    std::shared_ptr<DNSQuery> query;
+    for (std::list<std::shared_ptr<DNSQuery> >::iterator it = sg_running_queries.begin(); it != sg_running_queries.end(); ++it) {
+        if ((*it)->host_name == _host_name && (*it)->dns_func == dnsfunc_) {
+            query = *it;
+            break;
         }
+    }
 
-        xassert2(it != sg_dnsinfo_vec.end());
-        
-        if (it != sg_dnsinfo_vec.end()){
-
-            if (ETIMEDOUT == wait_ret) {
-                it->status = kGetIPTimeout;
-            }
+    if (!query) {
+        query = std::make_shared<DNSQuery>();
+        query->host_name = _host_name;
+        query->dns_func = dnsfunc_;
+        query->status = kGetIPDoing;
+        query->resolving = false;
+        query->deadline = time_end;
+
+        bool start_fail = false;
+        bool dispatched = __Dispatch(query, start_fail);
+        if (start_fail && monitor_func_) monitor_func_(kDNSThreadIDError);
+        if (!dispatched) return false;
+        sg_running_queries.push_back(query);
+    } else {
+        xinfo2(TSF"join the running dns query, host:%_", _host_name);
+        query->deadline = std::max(query->deadline, time_end);
+    }
 
-            if (kGetIPDoing == it->status) {
-                continue;
-            }
+    DNSWaiter waiter;
+    waiter.dns = this;
+    waiter.host_name = _host_name;
+    waiter.status = kGetIPDoing;
+    sg_waiters.push_back(&waiter);
 
-            if (kGetIPSuc == it->status) {
-                if (_host_name==it->host_name) {
-                    ips = it->result;
-
-                    if (_breaker) _breaker->dnsstatus = NULL;
-
-                    sg_dnsinfo_vec.erase(it);
-                    return true;
-                } else {
-                    std::vector<dnsinfo>::iterator iter = sg_dnsinfo_vec.begin();
-                    int i = 0;
-                    for (; iter != sg_dnsinfo_vec.end(); ++iter) {
-                        xerror2(TSF"sg_info_vec[%_]:%_", i++, DNSInfoToString(*iter));
-                    }
-                    if (monitor_func_)
-                        monitor_func_(kDNSThreadIDError);
-                    xassert2(false, TSF"_host_name:%_, it->host_name:%_", _host_name, it->host_name);
-                    return false;
-                }
-            }
+    if (_breaker) _breaker->dnsstatus = &waiter.status;
 
-            if (kGetIPTimeout == it->status || kGetIPCancel == it->status || kGetIPFail == it->status) {
-                if (_breaker) _breaker->dnsstatus = NULL;
+    while (kGetIPDoing == query->status && kGetIPDoing == waiter.status) {
+        uint64_t time_cur = gettickcount();
 
-                xinfo2(TSF "dns get ip status:%_ host:%_, func:%_", it->status, it->host_name, it->dns_func);
-                sg_dnsinfo_vec.erase(it);
-                return false;
-            }
+        if (time_cur >= time_end) {
+            waiter.status = kGetIPTimeout;
+            break;
+        }
 
-            xassert2(false, "%d", it->status);
+        sg_condition.wait(lock, (long)(time_end - time_cur));
+    }
 
-            if (_breaker) _breaker->dnsstatus = NULL;
+    sg_waiters.remove(&waiter);
+    if (_breaker) _breaker->dnsstatus = NULL;
 
-            sg_dnsinfo_vec.erase(it);
-        }
-        return false;
+    if (kGetIPDoing == waiter.status && kGetIPSuc == query->status) {
+        ips = query->result;
+        return true;
     }
 
+    xinfo2(TSF "dns get ip status:%_, query status:%_, host:%_, func:%_", waiter.status, query->status, _host_name, dnsfunc_);
     return false;
 }
 
@@ -289,15 +340,11 @@ void DNS::Cancel(const std::string& _host_name) {
     xverbose_function();
     ScopedLock lock(sg_mutex);
 
-    for (unsigned int i = 0; i < sg_dnsinfo_vec.size(); ++i) {
-        dnsinfo& info = sg_dnsinfo_vec.at(i);
-
-        if (_host_name.empty() && info.dns == this) {
-            info.status = kGetIPCancel;
-        }
+    for (std::list<DNSWaiter*>::iterator it = sg_waiters.begin(); it != sg_waiters.end(); ++it) {
+        if ((*it)->dns != this) continue;
 
-        if (info.host_name.compare(_host_name) == 0 && info.dns == this) {
-            info.status = kGetIPCancel;
+        if (_host_name.empty() || (*it)->host_name == _host_name) {
+            (*it)->status = kGetIPCancel;
         }
     }
 
@@ -312,3 +359,15 @@ void DNS::Cancel(DNSBreaker& _breaker) {
 
     sg_condition.notifyAll();
 }
+
+void DNS::SetCacheTTL(uint64_t _ttl_ms, uint64_t _negative_ttl_ms) {
+    ScopedLock lock(sg_mutex);
+    sg_cache_ttl = _ttl_ms;
+    sg_negative_cache_ttl = _negative_ttl_ms;
+    if (0 == sg_cache_ttl && 0 == sg_negative_cache_ttl) sg_cache.clear();
+}
+
+void DNS::ClearCache() {
+    ScopedLock lock(sg_mutex);
+    sg_cache.clear();
+}
@@ -21,6 +21,7 @@
 #ifndef COMM_COMM_DNS_H_
 #define COMM_COMM_DNS_H_
 
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -37,6 +38,13 @@ struct DNSBreaker {
     }
 };
 
+/*
+ * Lookups run on a small shared worker pool, concurrent lookups of the same host through the same
+ * DNSFunc share one query, and results of the system resolver are cached for a fixed time
+ * (getaddrinfo does not report record TTLs). Results of a DNSFunc hook are never cached, the hook
+ * owns its policy. Cancel() and DNSBreaker only release the waiting caller, the query itself runs on
+ * and still fills the cache.
+ */
 class DNS {
   public:
    typedef std::vector<std::string> (*DNSFunc)(const std::string& host);
@@ -49,6 +57,10 @@ class DNS {
     bool GetHostByName(const std::string& _host_name, std::vector<std::string>& ips, long millsec = 2 * 1000, DNSBreaker* _breaker = NULL);
     void Cancel(const std::string& _host_name = std::string());
     void Cancel(DNSBreaker& _breaker);
+
+    // 0 disables the respective cache
+    static void SetCacheTTL(uint64_t _ttl_ms, uint64_t _negative_ttl_ms);
+    static void ClearCache();
     
     void SetMonitorFunc(const boost::function<void (int _key)>& _monitor_func) {
     	monitor_func_ = _monitor_func;
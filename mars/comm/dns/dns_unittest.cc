@@ -0,0 +1,99 @@
+#include "dns/dns.h"
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <string>
+
+#include "boost/bind.hpp"
+
+#include "mars/comm/thread/thread.h"
+#include "mars/comm/time_utils.h"
+
+using namespace testing;
+
+static std::atomic<int> sg_slow_dns_calls(0);
+
+static std::vector<std::string> __SlowDNS(const std::string& _host) {
+    ++sg_slow_dns_calls;
+    ThreadUtil::sleep(1);
+    std::vector<std::string> ips;
+    ips.push_back("10.0.0.1");
+    return ips;
+}
+
+static void __Lookup(DNS* _dns, std::atomic<int>* _succeeded) {
+    std::vector<std::string> ips;
+    if (_dns->GetHostByName("coalesce.test", ips, 5 * 1000) && 1 == ips.size()) ++*_succeeded;
+}
+
+TEST(dns, concurrent_lookups_share_one_query) {
+    DNS dns(&__SlowDNS);
+    std::atomic<int> succeeded(0);
+    sg_slow_dns_calls = 0;
+
+    Thread* threads[8];
+    for (int i = 0; i < 8; ++i) {
+        threads[i] = new Thread(boost::bind(&__Lookup, &dns, &succeeded), NULL, true);
+        threads[i]->start();
+    }
+    for (int i = 0; i < 8; ++i) {
+        threads[i]->join();
+        delete threads[i];
+    }
+
+    EXPECT_EQ(succeeded.load(), 8);
+    EXPECT_EQ(sg_slow_dns_calls.load(), 1);
+}
+
+static void __Break(DNS* _dns, DNSBreaker* _breaker) {
+    ThreadUtil::usleep(100 * 1000);
+    _dns->Cancel(*_breaker);
+}
+
+TEST(dns, breaker_releases_only_its_caller) {
+    DNS dns(&__SlowDNS);
+    DNSBreaker breaker;
+
+    Thread thread(boost::bind(&__Break, &dns, &breaker), NULL, true);
+    thread.start();
+
+    uint64_t begin = gettickcount();
+    std::vector<std::string> ips;
+    EXPECT_FALSE(dns.GetHostByName("breaker.test", ips, 5 * 1000, &breaker));
+    EXPECT_LT(gettickcount() - begin, 900u);
+    thread.join();
+
+    // the query kept running for the next caller
+    EXPECT_TRUE(dns.GetHostByName("breaker.test", ips, 5 * 1000));
+    EXPECT_EQ(ips.size(), 1u);
+}
+
+static std::atomic<bool> sg_hang_released(false);
+
+static std::vector<std::string> __HangDNS(const std::string& _host) {
+    while (!sg_hang_released) ThreadUtil::usleep(10 * 1000);
+    return std::vector<std::string>();
+}
+
+static std::vector<std::string> __FastDNS(const std::string& _host) {
+    return std::vector<std::string>(1, "10.0.0.2");
+}
+
+TEST(dns, timed_out_workers_leave_room) {
+    sg_hang_released = false;
+    DNS hang(&__HangDNS);
+    std::vector<std::string> ips;
+
+    // as many lookups as there are workers, each hangs past the timeout of its caller
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_FALSE(hang.GetHostByName("hang" + std::to_string(i) + ".test", ips, 100));
+    }
+
+    DNS fast(&__FastDNS);
+    EXPECT_TRUE(fast.GetHostByName("fast.test", ips, 2 * 1000));
+    EXPECT_EQ(ips.size(), 1u);
+
+    sg_hang_released = true;
+}
+
+EXPORT_GTEST_SYMBOLS(comm_export_dns_unittest)
@@ -22,6 +22,7 @@
 #include <list>
 #include <string>
 #include <algorithm>
+#include <atomic>
 #ifndef _WIN32
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
@@ -49,7 +50,7 @@ namespace MessageQueue {
 #define MAX_MQ_SIZE 5000
 
     static unsigned int __MakeSeq() {
-        static unsigned int s_seq = 0;
+        static std::atomic<unsigned int> s_seq(0);
 
         return ++s_seq;
     }
@@ -61,10 +62,12 @@ namespace MessageQueue {
             postid.seq = _seq;
             periodstatus = kImmediately;
             record_time = 0;
+            ready_time = ::gettickcount();
 
             if (kImmediately != _timing.type) {
                 periodstatus = kAfter;
-                record_time = ::gettickcount();
+                record_time = ready_time;
+                ready_time += _timing.after;
             }
         }
 
@@ -79,6 +82,7 @@ namespace MessageQueue {
         MessageTiming timing;
         TMessageTiming periodstatus;
         uint64_t record_time;
+        uint64_t ready_time;     // tick the message becomes runnable, post tick for kImmediately
         boost::shared_ptr<Condition> wait_end_cond;
     };
 
@@ -128,89 +132,164 @@ namespace MessageQueue {
     };
 
     struct MessageQueueContent {
-        MessageQueueContent(): breakflag(false) {}
+        typedef std::multimap<uint64_t, MessageWrapper*> TimerMessageMap;
 
-#if defined(ANDROID)
-        MessageQueueContent(const MessageQueueContent&): breakflag(false) { /*ASSERT(false);*/ }
-#endif
+        MessageQueueContent(): released(false), breakflag(false) {}
+
+        size_t MessageSize() const { return lst_message.size() + timer_message.size(); }
+
+        void PushMessage(MessageWrapper* _message) {
+            if (kImmediately == _message->timing.type) {
+                lst_message.push_back(_message);
+            } else {
+                timer_message.insert(std::make_pair(_message->ready_time, _message));
+            }
+        }
+
+        template<typename Pred>
+        MessageWrapper* FindMessage(const Pred& _pred) const {
+            for (std::list<MessageWrapper*>::const_iterator it = lst_message.begin(); it != lst_message.end(); ++it) {
+                if (_pred(*it)) return *it;
+            }
+            for (TimerMessageMap::const_iterator it = timer_message.begin(); it != timer_message.end(); ++it) {
+                if (_pred(it->second)) return it->second;
+            }
+            return NULL;
+        }
+
+        template<typename Pred>
+        MessageWrapper* TakeMessage(const Pred& _pred) {
+            for (std::list<MessageWrapper*>::iterator it = lst_message.begin(); it != lst_message.end(); ++it) {
+                if (_pred(*it)) {
+                    MessageWrapper* message = *it;
+                    lst_message.erase(it);
+                    return message;
+                }
+            }
+            for (TimerMessageMap::iterator it = timer_message.begin(); it != timer_message.end(); ++it) {
+                if (_pred(it->second)) {
+                    MessageWrapper* message = it->second;
+                    timer_message.erase(it);
+                    return message;
+                }
+            }
+            return NULL;
+        }
+
+        template<typename Pred>
+        void TakeMessages(const Pred& _pred, std::list<MessageWrapper*>& _messages) {
+            for (std::list<MessageWrapper*>::iterator it = lst_message.begin(); it != lst_message.end();) {
+                if (_pred(*it)) {
+                    _messages.push_back(*it);
+                    it = lst_message.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            for (TimerMessageMap::iterator it = timer_message.begin(); it != timer_message.end();) {
+                if (_pred(it->second)) {
+                    _messages.push_back(it->second);
+                    timer_message.erase(it++);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        Mutex mutex;        // guards everything below, the queue map lock is never held while waiting on it
+        bool released;      // set under mutex once the runloop exits and the content leaves the queue map
 
         MessageHandler_t invoke_reg;
         bool breakflag;
         boost::shared_ptr<RunloopCond> breaker;
-        std::list<MessageWrapper*> lst_message;
+        std::list<MessageWrapper*> lst_message;     // kImmediately, in post order
+        TimerMessageMap timer_message;              // kAfter and kPeriod, ordered by ready_time
         std::list<HandlerWrapper*> lst_handler;
 
         std::list<RunLoopInfo> lst_runloop_info;
 
     private:
+        MessageQueueContent(const MessageQueueContent&);
         void operator=(const MessageQueueContent&);
+    };
 
-#if !defined(ANDROID)
-        MessageQueueContent(const MessageQueueContent&);
-#endif
+    typedef boost::shared_ptr<MessageQueueContent> MessageQueueContentPtr;
+
+    /*
+     * The queue map is split into shards, each with its own mutex that is only held for lookup,
+     * insert and erase. Posting, cancelling and the runloop lock the MessageQueueContent itself,
+     * so threads working on different queues never contend on a common mutex.
+     * Lock order: MessageQueueContent::mutex -> MessageQueueShard::mutex.
+     */
+    struct MessageQueueShard {
+        Mutex mutex;
+        std::map<MessageQueue_t, MessageQueueContentPtr> contents;
     };
 
-#define sg_messagequeue_map_mutex messagequeue_map_mutex()
-    static Mutex& messagequeue_map_mutex() {
-        static Mutex* mutex = new Mutex;
-        return *mutex;
+    static const size_t kMessageQueueShards = 16;
+
+    static MessageQueueShard& __Shard(const MessageQueue_t& _id) {
+        static MessageQueueShard* shards = new MessageQueueShard[kMessageQueueShards];
+        // thread ids are usually aligned pointers or sequential numbers, mix them before picking a shard
+        return shards[(size_t)(((uint64_t)_id * 0x9E3779B97F4A7C15ULL) >> 60) % kMessageQueueShards];
     }
-#define sg_messagequeue_map messagequeue_map()
-    static std::map<MessageQueue_t, MessageQueueContent>& messagequeue_map() {
-        static std::map<MessageQueue_t, MessageQueueContent>* mq_map = new std::map<MessageQueue_t, MessageQueueContent>;
-        return *mq_map;
+
+    static MessageQueueContentPtr __FindContent(const MessageQueue_t& _id) {
+        MessageQueueShard& shard = __Shard(_id);
+        ScopedLock lock(shard.mutex);
+
+        std::map<MessageQueue_t, MessageQueueContentPtr>::iterator pos = shard.contents.find(_id);
+        if (shard.contents.end() == pos) return MessageQueueContentPtr();
+        return pos->second;
     }
 
 
-    static std::string DumpMessage(const std::list<MessageWrapper*>& _message_lst) {
+    static std::string DumpMessage(const MessageQueueContent& _content) {
         XMessage xmsg;
-        xmsg(TSF"**************Dump MQ Message**************size:%_\n", _message_lst.size());
+        xmsg(TSF"**************Dump MQ Message**************size:%_\n", _content.MessageSize());
         int index = 0;
-        for (auto msg : _message_lst) {
+        _content.FindMessage([&xmsg, &index](const MessageWrapper* msg) {
             xmsg(TSF"postid:%_, timing:%_, record_time:%_, message:%_\n", msg->postid.ToString(), msg->timing.ToString(), msg->record_time, msg->message.ToString());
-            if (++index>50)
-                break;
-        }
+            return ++index > 50;
+        });
         return xmsg.String();
     }
     std::string DumpMQ(const MessageQueue_t& _msq_queue_id) {
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = _msq_queue_id;
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) {
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) {
             //ASSERT2(false, "%" PRIu64, id);
             xinfo2(TSF"message queue not found.");
             return "";
         }
 
-        MessageQueueContent& content = pos->second;
-        return DumpMessage(content.lst_message);
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return "";
+        MessageQueueContent& content = *content_ptr;
+        return DumpMessage(content);
     }
 
     MessageQueue_t CurrentThreadMessageQueue() {
-        ScopedLock lock(sg_messagequeue_map_mutex);
         MessageQueue_t id = (MessageQueue_t)ThreadUtil::currentthreadid();
 
-        if (sg_messagequeue_map.end() == sg_messagequeue_map.find(id)) id = KInvalidQueueID;
+        if (!__FindContent(id)) id = KInvalidQueueID;
 
         return id;
     }
 
     MessageQueue_t TID2MessageQueue(thread_tid _tid) {
-        ScopedLock lock(sg_messagequeue_map_mutex);
         MessageQueue_t id = (MessageQueue_t)_tid;
 
-        if (sg_messagequeue_map.end() == sg_messagequeue_map.find(id))id = KInvalidQueueID;
+        if (!__FindContent(id)) id = KInvalidQueueID;
 
         return id;
     }
 
     thread_tid  MessageQueue2TID(MessageQueue_t _id) {
-        ScopedLock lock(sg_messagequeue_map_mutex);
         MessageQueue_t& id = _id;
 
-        if (sg_messagequeue_map.end() == sg_messagequeue_map.find(id)) return 0;
+        if (!__FindContent(id)) return 0;
 
         return (thread_tid)id;
     }
@@ -218,12 +297,14 @@ namespace MessageQueue {
     void WaitForRunningLockEnd(const MessagePost_t&  _message) {
         if (Handler2Queue(Post2Handler(_message)) == CurrentThreadMessageQueue()) return;
 
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = Handler2Queue(Post2Handler(_message));
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) return;
-        MessageQueueContent& content = pos->second;
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) return;
+
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return;
+        MessageQueueContent& content = *content_ptr;
 
         if (content.lst_runloop_info.empty()) return;
 
@@ -239,12 +320,14 @@ namespace MessageQueue {
     void WaitForRunningLockEnd(const MessageQueue_t&  _messagequeueid) {
         if (_messagequeueid == CurrentThreadMessageQueue()) return;
 
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = _messagequeueid;
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) return;
-        MessageQueueContent& content = pos->second;
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) return;
+
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return;
+        MessageQueueContent& content = *content_ptr;
 
         if (content.lst_runloop_info.empty()) return;
         if (KNullPost == content.lst_runloop_info.front().runing_message_id) return;
@@ -256,12 +339,14 @@ namespace MessageQueue {
     void WaitForRunningLockEnd(const MessageHandler_t&  _handler) {
         if (Handler2Queue(_handler) == CurrentThreadMessageQueue()) return;
 
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = Handler2Queue(_handler);
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) { return; }
-        MessageQueueContent& content = pos->second;
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) { return; }
+
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return;
+        MessageQueueContent& content = *content_ptr;
         if (content.lst_runloop_info.empty()) return;
 
         for(auto& i : content.lst_runloop_info) {
@@ -278,33 +363,37 @@ namespace MessageQueue {
     void BreakMessageQueueRunloop(const MessageQueue_t&  _messagequeueid) {
         ASSERT(0 != _messagequeueid);
 
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = _messagequeueid;
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) {
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) {
             //ASSERT2(false, "%llu", (unsigned long long)id);
             return;
         }
 
-        pos->second.breakflag = true;
-        pos->second.breaker->Notify(lock);
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return;
+
+        content_ptr->breakflag = true;
+        content_ptr->breaker->Notify(lock);
     }
 
     MessageHandler_t InstallMessageHandler(const MessageHandler& _handler, bool _recvbroadcast, const MessageQueue_t& _messagequeueid) {
         ASSERT(bool(_handler));
 
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = _messagequeueid;
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) {
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) {
             ASSERT2(false, "%llu", (unsigned long long)id);
             return KNullHandler;
         }
 
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return KNullHandler;
+
         HandlerWrapper* handler = new HandlerWrapper(_handler, _recvbroadcast, _messagequeueid, __MakeSeq());
-        pos->second.lst_handler.push_back(handler);
+        content_ptr->lst_handler.push_back(handler);
         return handler->reg;
     }
 
@@ -314,13 +403,14 @@ namespace MessageQueue {
 
         if (0 == _handlerid.queue || 0 == _handlerid.seq) return;
 
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = _handlerid.queue;
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) return;
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) return;
 
-        MessageQueueContent& content = pos->second;
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return;
+        MessageQueueContent& content = *content_ptr;
 
         for (std::list<HandlerWrapper*>::iterator it = content.lst_handler.begin(); it != content.lst_handler.end(); ++it) {
             if (_handlerid == (*it)->reg) {
@@ -332,80 +422,84 @@ namespace MessageQueue {
     }
 
     MessagePost_t PostMessage(const MessageHandler_t& _handlerid, const Message& _message, const MessageTiming& _timing) {
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = _handlerid.queue;
 
-//        xinfo2(TSF"mq map size:%_", sg_messagequeue_map.size());
 //        xinfo2(TSF"mq id:%_", id);
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) {
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) {
             //ASSERT2(false, "%" PRIu64, id);
             return KNullPost;
         }
 
-        MessageQueueContent& content = pos->second;
-        if(content.lst_message.size() >= MAX_MQ_SIZE) {
-            xwarn2(TSF"%_", DumpMessage(content.lst_message));
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return KNullPost;
+        MessageQueueContent& content = *content_ptr;
+        if(content.MessageSize() >= MAX_MQ_SIZE) {
+            xwarn2(TSF"%_", DumpMessage(content));
             ASSERT2(false, "Over MAX_MQ_SIZE");
             return KNullPost;
         }
 
         MessageWrapper* messagewrapper = new MessageWrapper(_handlerid, _message, _timing, __MakeSeq());
 
-        content.lst_message.push_back(messagewrapper);
+        content.PushMessage(messagewrapper);
         content.breaker->Notify(lock);
         return messagewrapper->postid;
     }
 
     MessagePost_t SingletonMessage(bool _replace, const MessageHandler_t& _handlerid, const Message& _message, const MessageTiming& _timing) {
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = _handlerid.queue;
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) return KNullPost;
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) return KNullPost;
 
-        MessageQueueContent& content = pos->second;
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return KNullPost;
+        MessageQueueContent& content = *content_ptr;
 
         MessagePost_t post_id;
 
-        for (std::list<MessageWrapper*>::iterator it = content.lst_message.begin(); it != content.lst_message.end(); ++it) {
-            if ((*it)->postid.reg == _handlerid && (*it)->message == _message) {
-                if (_replace) {
-                    post_id = (*it)->postid;
-                    delete(*it);
-                    content.lst_message.erase(it);
-                    break;
-                } else {
-                    return (*it)->postid;
-                }
+        auto same_message = [&_handlerid, &_message](const MessageWrapper* _v) {
+            return _v->postid.reg == _handlerid && _v->message == _message;
+        };
+
+        if (_replace) {
+            MessageWrapper* old = content.TakeMessage(same_message);
+            if (NULL != old) {
+                post_id = old->postid;
+                delete old;
             }
+        } else {
+            MessageWrapper* old = content.FindMessage(same_message);
+            if (NULL != old) return old->postid;
         }
 
-        if(content.lst_message.size() >= MAX_MQ_SIZE) {
-            xwarn2(TSF"%_", DumpMessage(content.lst_message));
+        if(content.MessageSize() >= MAX_MQ_SIZE) {
+            xwarn2(TSF"%_", DumpMessage(content));
             ASSERT2(false, "Over MAX_MQ_SIZE");
             return KNullPost;
         }
 
         MessageWrapper* messagewrapper = new MessageWrapper(_handlerid, _message, _timing, 0 != post_id.seq ? post_id.seq : __MakeSeq());
-        content.lst_message.push_back(messagewrapper);
+        content.PushMessage(messagewrapper);
         content.breaker->Notify(lock);
         return messagewrapper->postid;
     }
 
     MessagePost_t BroadcastMessage(const MessageQueue_t& _messagequeueid,  const Message& _message, const MessageTiming& _timing) {
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = _messagequeueid;
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) {
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) {
             ASSERT2(false, "%" PRIu64, id);
             return KNullPost;
         }
 
-        MessageQueueContent& content = pos->second;
-        if(content.lst_message.size() >= MAX_MQ_SIZE) {
-            xwarn2(TSF"%_", DumpMessage(content.lst_message));
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return KNullPost;
+        MessageQueueContent& content = *content_ptr;
+        if(content.MessageSize() >= MAX_MQ_SIZE) {
+            xwarn2(TSF"%_", DumpMessage(content));
             ASSERT2(false, "Over MAX_MQ_SIZE");
             return KNullPost;
         }
@@ -415,7 +509,7 @@ namespace MessageQueue {
         reg.seq = 0;
         MessageWrapper* messagewrapper = new MessageWrapper(reg, _message, _timing, __MakeSeq());
 
-        content.lst_message.push_back(messagewrapper);
+        content.PushMessage(messagewrapper);
         content.breaker->Notify(lock);
         return messagewrapper->postid;
     }
@@ -442,56 +536,60 @@ namespace MessageQueue {
     }
 
     MessagePost_t FasterMessage(const MessageHandler_t& _handlerid, const Message& _message, const MessageTiming& _timing) {
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = _handlerid.queue;
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) return KNullPost;
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) return KNullPost;
 
-        MessageQueueContent& content = pos->second;
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return KNullPost;
+        MessageQueueContent& content = *content_ptr;
 
         MessageWrapper* messagewrapper = new MessageWrapper(_handlerid, _message, _timing, __MakeSeq());
 
-        for (std::list<MessageWrapper*>::iterator it = content.lst_message.begin(); it != content.lst_message.end(); ++it) {
-            if ((*it)->postid.reg == _handlerid && (*it)->message == _message) {
-                if (__ComputerWaitTime(**it) < __ComputerWaitTime(*messagewrapper)) {
-                    delete messagewrapper;
-                    return (*it)->postid;
-                }
+        auto same_message = [&_handlerid, &_message](const MessageWrapper* _v) {
+            return _v->postid.reg == _handlerid && _v->message == _message;
+        };
 
-                messagewrapper->postid = (*it)->postid;
-                delete(*it);
-                content.lst_message.erase(it);
-                break;
+        MessageWrapper* old = content.FindMessage(same_message);
+        if (NULL != old) {
+            if (__ComputerWaitTime(*old) < __ComputerWaitTime(*messagewrapper)) {
+                delete messagewrapper;
+                return old->postid;
             }
+
+            messagewrapper->postid = old->postid;
+            delete content.TakeMessage([old](const MessageWrapper* _v) { return old == _v; });
         }
 
-        if(content.lst_message.size() >= MAX_MQ_SIZE) {
-            xwarn2(TSF"%_", DumpMessage(content.lst_message));
+        if(content.MessageSize() >= MAX_MQ_SIZE) {
+            xwarn2(TSF"%_", DumpMessage(content));
             ASSERT2(false, "Over MAX_MQ_SIZE");
             delete messagewrapper;
             return KNullPost;
         }
-        content.lst_message.push_back(messagewrapper);
+        content.PushMessage(messagewrapper);
         content.breaker->Notify(lock);
         return messagewrapper->postid;
     }
 
     MessagePost_t PostMessageAtFirst(const MessageHandler_t& _handlerid, const Message& _message){
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = _handlerid.queue;
         
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) return KNullPost;
-        
-        MessageQueueContent& content = pos->second;
-        if(content.lst_message.size() >= MAX_MQ_SIZE) {
-            xwarn2(TSF"%_", DumpMessage(content.lst_message));
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) return KNullPost;
+
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return KNullPost;
+        MessageQueueContent& content = *content_ptr;
+        if(content.MessageSize() >= MAX_MQ_SIZE) {
+            xwarn2(TSF"%_", DumpMessage(content));
             ASSERT2(false, "Over MAX_MQ_SIZE");
             return KNullPost;
         }
         
         MessageWrapper* messagewrapper = new MessageWrapper(_handlerid, _message, kImmediately, __MakeSeq());
+        messagewrapper->ready_time = 0;     // ahead of every due timer as well
         content.lst_message.push_front(messagewrapper);
         content.breaker->Notify(lock);
         return messagewrapper->postid;
@@ -500,18 +598,19 @@ namespace MessageQueue {
     bool WaitMessage(const MessagePost_t& _message, long _timeoutInMs) {
         bool is_in_mq = Handler2Queue(Post2Handler(_message)) == CurrentThreadMessageQueue();
 
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = Handler2Queue(Post2Handler(_message));
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) return false;
-        MessageQueueContent& content = pos->second;
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) return false;
+
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return false;
+        MessageQueueContent& content = *content_ptr;
 
-        auto find_it = std::find_if(content.lst_message.begin(), content.lst_message.end(),
-                                    [&_message](const MessageWrapper * const &_v) {
+        MessageWrapper* wait_message = content.FindMessage([&_message](const MessageWrapper* _v) {
                                         return _message == _v->postid;
                                     });
 
-        if (find_it == content.lst_message.end()) {
+        if (NULL == wait_message) {
             auto find_it = std::find_if(content.lst_runloop_info.begin(), content.lst_runloop_info.end(),
                                         [&_message](const RunLoopInfo& _v){ return _message == _v.runing_message_id; });
 
@@ -530,18 +629,17 @@ namespace MessageQueue {
 
             if (is_in_mq) {
                 lock.unlock();
-                RunLoop( [&_message](){
-                    MessageQueueContent& content = sg_messagequeue_map[Handler2Queue(Post2Handler(_message))];
-                    return content.lst_message.end() == std::find_if(content.lst_message.begin(), content.lst_message.end(),
-                                                                     [&_message](const MessageWrapper *  const &_v) {
-                                                                         return _message == _v->postid;
-                                                                     });
+                // the breaker runs inside RunLoop::Run with content_ptr->mutex already held
+                RunLoop( [&_message, content_ptr](){
+                    return NULL == content_ptr->FindMessage([&_message](const MessageWrapper* _v) {
+                                                                return _message == _v->postid;
+                                                            });
                 }).Run();
 
             } else {
-                if (!((*find_it)->wait_end_cond))(*find_it)->wait_end_cond = boost::make_shared<Condition>();
+                if (!(wait_message->wait_end_cond)) wait_message->wait_end_cond = boost::make_shared<Condition>();
 
-                boost::shared_ptr<Condition> wait_end_cond = (*find_it)->wait_end_cond;
+                boost::shared_ptr<Condition> wait_end_cond = wait_message->wait_end_cond;
                 if(_timeoutInMs < 0) {
                     wait_end_cond->wait(lock);
                 } else {
@@ -555,12 +653,14 @@ namespace MessageQueue {
     }
 
     bool FoundMessage(const MessagePost_t& _message) {
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = Handler2Queue(Post2Handler(_message));
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) return false;
-        MessageQueueContent& content = pos->second;
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) return false;
+
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return false;
+        MessageQueueContent& content = *content_ptr;
         if (content.lst_runloop_info.empty()) return false;
 
         auto find_it = std::find_if(content.lst_runloop_info.begin(), content.lst_runloop_info.end(),
@@ -568,11 +668,7 @@ namespace MessageQueue {
 
         if (find_it != content.lst_runloop_info.end())  { return true; }
 
-        for (std::list<MessageWrapper*>::iterator it = content.lst_message.begin(); it != content.lst_message.end(); ++it) {
-            if (_message == (*it)->postid) { return true;}
-        }
-
-        return false;
+        return NULL != content.FindMessage([&_message](const MessageWrapper* _v) { return _message == _v->postid; });
     }
 
     bool CancelMessage(const MessagePost_t& _postid) {
@@ -582,24 +678,18 @@ namespace MessageQueue {
         // 0==_postid.reg.seq for BroadcastMessage
         if (0 == _postid.reg.queue || 0 == _postid.seq) return false;
 
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = _postid.reg.queue;
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) {
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) {
             ASSERT2(false, "%" PRIu64, id);
             return false;
         }
 
-        MessageQueueContent& content = pos->second;
-        MessageWrapper* tmpMessage = nullptr;
-        for (std::list<MessageWrapper*>::iterator it = content.lst_message.begin(); it != content.lst_message.end(); ++it) {
-            if (_postid == (*it)->postid) {
-                tmpMessage = *it;
-                content.lst_message.erase(it);
-                break;
-            }
-        }
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return false;
+        MessageQueueContent& content = *content_ptr;
+        MessageWrapper* tmpMessage = content.TakeMessage([&_postid](const MessageWrapper* _v) { return _postid == _v->postid; });
         lock.unlock();
 
         if(tmpMessage != nullptr) {
@@ -616,25 +706,19 @@ namespace MessageQueue {
         // 0==_handlerid.seq for BroadcastMessage
         if (0 == _handlerid.queue) return;
 
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = _handlerid.queue;
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) {
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) {
             //        ASSERT2(false, "%lu", id);
             return;
         }
 
-        MessageQueueContent& content = pos->second;
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return;
+        MessageQueueContent& content = *content_ptr;
         std::list<MessageWrapper*> lstMessages;
-        for (std::list<MessageWrapper*>::iterator it = content.lst_message.begin(); it != content.lst_message.end();) {
-            if (_handlerid == (*it)->postid.reg) {
-                lstMessages.push_back(*it);
-                it = content.lst_message.erase(it);
-            } else {
-                ++it;
-            }
-        }
+        content.TakeMessages([&_handlerid](const MessageWrapper* _v) { return _handlerid == _v->postid.reg; }, lstMessages);
         lock.unlock();
 
         for (std::list<MessageWrapper*>::iterator it = lstMessages.begin(); it != lstMessages.end();) {
@@ -649,25 +733,21 @@ namespace MessageQueue {
         // 0==_handlerid.seq for BroadcastMessage
         if (0 == _handlerid.queue) return;
 
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = _handlerid.queue;
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) {
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) {
             ASSERT2(false, "%" PRIu64, id);
             return;
         }
 
-        MessageQueueContent& content = pos->second;
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return;
+        MessageQueueContent& content = *content_ptr;
         std::list<MessageWrapper*> lstMessages;
-        for (std::list<MessageWrapper*>::iterator it = content.lst_message.begin(); it != content.lst_message.end();) {
-            if (_handlerid == (*it)->postid.reg && _title == (*it)->message.title) {
-                lstMessages.push_back(*it);
-                it = content.lst_message.erase(it);
-            } else {
-                ++it;
-            }
-        }
+        content.TakeMessages([&_handlerid, &_title](const MessageWrapper* _v) {
+            return _handlerid == _v->postid.reg && _title == _v->message.title;
+        }, lstMessages);
         lock.unlock();
 
         for (std::list<MessageWrapper*>::iterator it = lstMessages.begin(); it != lstMessages.end();) {
@@ -678,14 +758,16 @@ namespace MessageQueue {
 
     const Message& RunningMessage() {
         MessageQueue_t id = (MessageQueue_t)ThreadUtil::currentthreadid();
-        ScopedLock lock(sg_messagequeue_map_mutex);
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) {
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) {
             return KNullMessage;
         }
 
-        Message* runing_message = pos->second.lst_runloop_info.back().runing_message;
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return KNullMessage;
+
+        Message* runing_message = content_ptr->lst_runloop_info.back().runing_message;
         return runing_message? *runing_message: KNullMessage;
     }
 
@@ -695,14 +777,15 @@ namespace MessageQueue {
     }
 
     MessagePost_t RunningMessageID(const MessageQueue_t& _id) {
-        ScopedLock lock(sg_messagequeue_map_mutex);
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(_id);
-        if (sg_messagequeue_map.end() == pos) {
+        MessageQueueContentPtr content_ptr = __FindContent(_id);
+        if (!content_ptr) {
             return KNullPost;
         }
 
-        MessageQueueContent& content = pos->second;
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return KNullPost;
+        MessageQueueContent& content = *content_ptr;
         return content.lst_runloop_info.back().runing_message_id;
     }
 
@@ -723,12 +806,16 @@ namespace MessageQueue {
 
 
     static MessageQueue_t __CreateMessageQueueInfo(boost::shared_ptr<RunloopCond>& _breaker, thread_tid _tid) {
-        ScopedLock lock(sg_messagequeue_map_mutex);
-
         MessageQueue_t id = (MessageQueue_t)_tid;
 
-        if (sg_messagequeue_map.end() == sg_messagequeue_map.find(id)) {
-            MessageQueueContent& content = sg_messagequeue_map[id];
+        MessageQueueShard& shard = __Shard(id);
+        ScopedLock lock(shard.mutex);
+
+        if (shard.contents.end() == shard.contents.find(id)) {
+            MessageQueueContentPtr content_ptr = boost::make_shared<MessageQueueContent>();
+            shard.contents[id] = content_ptr;
+
+            MessageQueueContent& content = *content_ptr;
             HandlerWrapper* handler = new HandlerWrapper(&__AsyncInvokeHandler, false, id, __MakeSeq());
             content.lst_handler.push_back(handler);
             content.invoke_reg = handler->reg;
@@ -741,23 +828,35 @@ namespace MessageQueue {
         return id;
     }
 
-    static void __ReleaseMessageQueueInfo() {
+    // called by the runloop with _content.mutex held
+    static void __ReleaseMessageQueueInfo(MessageQueueContent& _content) {
 
         MessageQueue_t id = (MessageQueue_t)ThreadUtil::currentthreadid();
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() != pos) {
-            MessageQueueContent& content = pos->second;
+        MessageQueueShard& shard = __Shard(id);
+        ScopedLock lock(shard.mutex);
+
+        std::map<MessageQueue_t, MessageQueueContentPtr>::iterator pos = shard.contents.find(id);
+        if (shard.contents.end() != pos && pos->second.get() == &_content) {
+            MessageQueueContent& content = _content;
+            content.released = true;
 
             for (std::list<MessageWrapper*>::iterator it = content.lst_message.begin(); it != content.lst_message.end(); ++it) {
                 delete(*it);
             }
 
+            for (MessageQueueContent::TimerMessageMap::iterator it = content.timer_message.begin(); it != content.timer_message.end(); ++it) {
+                delete it->second;
+            }
+
             for (std::list<HandlerWrapper*>::iterator it = content.lst_handler.begin(); it != content.lst_handler.end(); ++it) {
                 delete(*it);
             }
 
-            sg_messagequeue_map.erase(id);
+            content.lst_message.clear();
+            content.timer_message.clear();
+            content.lst_handler.clear();
+            shard.contents.erase(pos);
         }
     }
 
@@ -813,16 +912,19 @@ namespace MessageQueue {
     void RunLoop::Run() {
         MessageQueue_t id = CurrentThreadMessageQueue();
         ASSERT(0 != id);
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        ASSERT(content_ptr);
+        if (!content_ptr) return;
         {
-            ScopedLock lock(sg_messagequeue_map_mutex);
-            sg_messagequeue_map[id].lst_runloop_info.push_back(RunLoopInfo());
+            ScopedLock lock(content_ptr->mutex);
+            content_ptr->lst_runloop_info.push_back(RunLoopInfo());
         }
 
         xinfo_function(TSF"messagequeue id:%_", id);
 
         while (true) {
-            ScopedLock lock(sg_messagequeue_map_mutex);
-            MessageQueueContent& content = sg_messagequeue_map[id];
+            ScopedLock lock(content_ptr->mutex);
+            MessageQueueContent& content = *content_ptr;
             content.lst_runloop_info.back().runing_message_id = KNullPost;
             content.lst_runloop_info.back().runing_message = NULL;
             content.lst_runloop_info.back().runing_handler.clear();
@@ -833,7 +935,7 @@ namespace MessageQueue {
             if ((content.breakflag || (breaker_func_ && breaker_func_()))) {
                 content.lst_runloop_info.pop_back();
                 if (content.lst_runloop_info.empty())
-                    __ReleaseMessageQueueInfo();
+                    __ReleaseMessageQueueInfo(content);
                 break;
             }
 
@@ -841,51 +943,27 @@ namespace MessageQueue {
             MessageWrapper* messagewrapper = NULL;
             bool delmessage = true;
 
-            for (std::list<MessageWrapper*>::iterator it = content.lst_message.begin(); it != content.lst_message.end(); ++it) {
-                if (kImmediately == (*it)->timing.type) {
-                    messagewrapper = *it;
-                    content.lst_message.erase(it);
-                    break;
-                } else if (kAfter == (*it)->timing.type) {
-                    int64_t time_cost = ::gettickspan((*it)->record_time);
-
-                    if ((*it)->timing.after <= time_cost) {
-                        messagewrapper = *it;
-                        content.lst_message.erase(it);
-                        break;
-                    } else {
-                        wait_time = std::min(wait_time, (*it)->timing.after - time_cost);
-                    }
-                } else if (kPeriod == (*it)->timing.type) {
-                    if (kAfter == (*it)->periodstatus) {
-                        int64_t time_cost = ::gettickspan((*it)->record_time);
-
-                        if ((*it)->timing.after <= time_cost) {
-                            messagewrapper = *it;
-                            (*it)->record_time = ::gettickcount();
-                            (*it)->periodstatus = kPeriod;
-                            delmessage = false;
-                            break;
-                        } else {
-                            wait_time = std::min(wait_time, (*it)->timing.after - time_cost);
-                        }
-                    } else if (kPeriod == (*it)->periodstatus) {
-                        int64_t time_cost = ::gettickspan((*it)->record_time);
-
-                        if ((*it)->timing.period <= time_cost) {
-                            messagewrapper = *it;
-                            (*it)->record_time = ::gettickcount();
-                            delmessage = false;
-                            break;
-                        } else {
-                            wait_time = std::min(wait_time, (*it)->timing.period - time_cost);
-                        }
-                    } else {
-                        ASSERT(false);
-                    }
-                } else {
-                    ASSERT(false);
+            // immediate messages and due timers run in the order they became ready.
+            uint64_t now = ::gettickcount();
+            MessageQueueContent::TimerMessageMap::iterator timer = content.timer_message.begin();
+            bool timer_due = content.timer_message.end() != timer && timer->first <= now;
+
+            if (timer_due && (content.lst_message.empty() || timer->first < content.lst_message.front()->ready_time)) {
+                messagewrapper = timer->second;
+                content.timer_message.erase(timer);
+
+                if (kPeriod == messagewrapper->timing.type) {
+                    messagewrapper->record_time = now;
+                    messagewrapper->periodstatus = kPeriod;
+                    messagewrapper->ready_time = now + messagewrapper->timing.period;
+                    content.timer_message.insert(std::make_pair(messagewrapper->ready_time, messagewrapper));
+                    delmessage = false;
                 }
+            } else if (!content.lst_message.empty()) {
+                messagewrapper = content.lst_message.front();
+                content.lst_message.pop_front();
+            } else if (content.timer_message.end() != timer) {
+                wait_time = std::min(wait_time, (int64_t)(timer->first - now));
             }
 
             if (NULL == messagewrapper) {
@@ -927,13 +1005,12 @@ namespace MessageQueue {
     }
 
     boost::shared_ptr<RunloopCond> RunloopCond::CurrentCond() {
-        ScopedLock lock(sg_messagequeue_map_mutex);
         MessageQueue_t id = (MessageQueue_t)ThreadUtil::currentthreadid();
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() != pos) {
-            MessageQueueContent& content = pos->second;
-            return content.breaker;
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (content_ptr) {
+            ScopedLock lock(content_ptr->mutex);
+            return content_ptr->breaker;
         } else {
             return boost::shared_ptr<RunloopCond>();
         }
@@ -1044,13 +1121,14 @@ namespace MessageQueue {
     }
 
     MessageHandler_t DefAsyncInvokeHandler(const MessageQueue_t& _messagequeue) {
-        ScopedLock lock(sg_messagequeue_map_mutex);
         const MessageQueue_t& id = _messagequeue;
 
-        std::map<MessageQueue_t, MessageQueueContent>::iterator pos = sg_messagequeue_map.find(id);
-        if (sg_messagequeue_map.end() == pos) return KNullHandler;
+        MessageQueueContentPtr content_ptr = __FindContent(id);
+        if (!content_ptr) return KNullHandler;
 
-        MessageQueueContent& content = pos->second;
+        ScopedLock lock(content_ptr->mutex);
+        if (content_ptr->released) return KNullHandler;
+        MessageQueueContent& content = *content_ptr;
         return content.invoke_reg;
     }
 
@@ -504,11 +504,12 @@ SOCKET ComplexConnect::ConnectImpatient(const std::vector<socket_address>& _veca
     int lasterror = 0;
     unsigned int index = 0;
     SOCKET retsocket = INVALID_SOCKET;
+    // kept across rounds so a large race keeps its poller (and epoll set) instead of rebuilding it
+    SocketSelect sel(_breaker);
 
     do {
         curtime = gettickcount();
         // timeout and connect
-        SocketSelect sel(_breaker);
         sel.PreSelect();
 
         int next_connect_timeout = 0;
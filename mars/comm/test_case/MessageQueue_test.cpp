@@ -2,6 +2,11 @@
 #include "../messagequeue/message_queue.h"
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
 #include "boost/bind.hpp"
 #include "thread/thread.h"
 
@@ -323,3 +328,128 @@ TEST(MessageQueue_test, WaitMessage_SingletonMessage)
 	}
 
 }
+
+
+static int64_t __NowUs() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void __PrintPercentiles(const char* _name, std::vector<int64_t>& _values) {
+	if (_values.empty()) return;
+	std::sort(_values.begin(), _values.end());
+	size_t n = _values.size();
+	printf("%s count:%zu p50:%lldus p90:%lldus p99:%lldus p999:%lldus max:%lldus\n", _name, n,
+		(long long)_values[n * 50 / 100], (long long)_values[n * 90 / 100], (long long)_values[n * 99 / 100],
+		(long long)_values[n * 999 / 1000], (long long)_values[n - 1]);
+}
+
+// posts 100k messages, 40% kImmediately and 60% kAfter 1~100ms, keeping a few thousand delayed
+// messages pending (MAX_MQ_SIZE is 5000), and reports how late each one runs.
+TEST(MessageQueue_test, MixedTimingDispatchBenchmark)
+{
+	const int kMessages = 100000;
+	const int kMaxPending = 4000;
+
+	MessageQueue::MessageQueueCreater creater(true, "mq_dispatch_bench");
+	MessageQueue::MessageHandler_t handler = MessageQueue::DefAsyncInvokeHandler(creater.GetMessageQueue());
+
+	std::vector<int64_t> immediate_latency;
+	std::vector<int64_t> after_latency;
+	immediate_latency.reserve(kMessages);
+	after_latency.reserve(kMessages);
+	std::atomic<int> pending(0);
+
+	srand(0);
+	int64_t begin = __NowUs();
+	for (int i = 0; i < kMessages; ++i) {
+		while (pending.load() >= kMaxPending) ThreadUtil::usleep(100);
+
+		int64_t after = (i % 5 < 2) ? 0 : rand() % 100 + 1;
+		int64_t ready = __NowUs() + after * 1000;
+		std::vector<int64_t>* latency = 0 == after ? &immediate_latency : &after_latency;
+		++pending;
+
+		auto func = [latency, ready, &pending]() {
+			latency->push_back(std::max<int64_t>(0, __NowUs() - ready));
+			--pending;
+		};
+
+		if (0 == after) {
+			MessageQueue::AsyncInvoke(func, handler);
+		} else {
+			MessageQueue::AsyncInvokeAfter(after, func, handler);
+		}
+	}
+
+	while (pending.load() > 0) ThreadUtil::usleep(1000);
+	int64_t cost = __NowUs() - begin;
+	creater.CancelAndWait();
+
+	EXPECT_EQ(immediate_latency.size() + after_latency.size(), (size_t)kMessages);
+	printf("messages:%d total:%lldms\n", kMessages, (long long)cost / 1000);
+	__PrintPercentiles("kImmediately", immediate_latency);
+	__PrintPercentiles("kAfter", after_latency);
+}
+
+struct QueueBenchContext {
+	MessageQueue::MessageHandler_t handler;
+	std::atomic<int> pending;
+	std::atomic<int> done;
+};
+
+static void __PostToQueue(QueueBenchContext* _context, int _count, int _max_pending) {
+	for (int i = 0; i < _count; ++i) {
+		while (_context->pending.load() >= _max_pending) ThreadUtil::yield();
+
+		++_context->pending;
+		MessageQueue::AsyncInvoke([_context]() {
+			--_context->pending;
+			++_context->done;
+		}, _context->handler);
+	}
+}
+
+TEST(MessageQueue_test, MultiQueueThroughputBenchmark)
+{
+	const int kMessagesPerQueue = 100000;
+	const int kMaxPending = 1000;
+	const int kQueues[] = {1, 2, 4, 8};
+
+	for (size_t n = 0; n < sizeof(kQueues) / sizeof(kQueues[0]); ++n) {
+		std::vector<MessageQueue::MessageQueueCreater*> creaters;
+		std::vector<QueueBenchContext*> contexts;
+		std::vector<Thread*> posters;
+
+		for (int i = 0; i < kQueues[n]; ++i) {
+			MessageQueue::MessageQueueCreater* creater = new MessageQueue::MessageQueueCreater(true, "mq_throughput_bench");
+			QueueBenchContext* context = new QueueBenchContext;
+			context->handler = MessageQueue::DefAsyncInvokeHandler(creater->GetMessageQueue());
+			context->pending = 0;
+			context->done = 0;
+
+			creaters.push_back(creater);
+			contexts.push_back(context);
+			posters.push_back(new Thread(boost::bind(&__PostToQueue, context, kMessagesPerQueue, kMaxPending)));
+		}
+
+		int64_t begin = __NowUs();
+		for (size_t i = 0; i < posters.size(); ++i) posters[i]->start();
+		for (size_t i = 0; i < posters.size(); ++i) posters[i]->join();
+		for (size_t i = 0; i < contexts.size(); ++i) {
+			while (contexts[i]->pending.load() > 0) ThreadUtil::usleep(100);
+		}
+		int64_t cost = __NowUs() - begin;
+
+		for (int i = 0; i < kQueues[n]; ++i) {
+			creaters[i]->CancelAndWait();
+			EXPECT_EQ(contexts[i]->done.load(), kMessagesPerQueue);
+			delete posters[i];
+			delete contexts[i];
+			delete creaters[i];
+		}
+
+		long long total = (long long)kQueues[n] * kMessagesPerQueue;
+		printf("queues:%d messages:%lld total:%lldms throughput:%lld msg/s\n", kQueues[n], total,
+		       (long long)cost / 1000, total * 1000000 / (cost > 0 ? cost : 1));
+	}
+}
@@ -0,0 +1,79 @@
+#include "../buffer_pool.h"
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mars/comm/tickcount.h"
+
+using namespace testing;
+
+// plain realloc/free, counting the calls that reach the allocator
+class CountingAllocator : public AutoBufferAllocator {
+  public:
+    CountingAllocator(): allocs(0) {}
+
+    virtual void* Realloc(void* _ptr, size_t _capacity, size_t _size, size_t& _new_capacity) {
+        ++allocs;
+        _new_capacity = _size;
+        return realloc(_ptr, _size);
+    }
+    virtual void Free(void* _ptr, size_t _capacity) { free(_ptr); }
+
+    uint64_t allocs;
+};
+
+// request body, extension, header, socket read buffer, response body and stream, the buffers of
+// one longlink send/recv round trip
+static void __RoundTrip(AutoBufferAllocator* _allocator, const AutoBuffer& _wire) {
+    AutoBuffer body, extension, header, recv, resp_body, stream;
+    body.SetAllocator(_allocator);
+    extension.SetAllocator(_allocator);
+    header.SetAllocator(_allocator);
+    recv.SetAllocator(_allocator);
+    resp_body.SetAllocator(_allocator);
+    stream.SetAllocator(_allocator);
+
+    char req[512];
+    memset(req, 'q', sizeof(req));
+    body.Write(req, sizeof(req));
+    extension.Write("ext", 3);
+    header.AllocWrite(20, false);
+    header.Write(req, 20);
+
+    recv.AllocWrite(16 * 1024, false);
+    memcpy(recv.PosPtr(), _wire.Ptr(), _wire.Length());
+    recv.Length(recv.Pos() + _wire.Length(), recv.Length() + _wire.Length());
+
+    resp_body.Write(recv.Ptr(20), recv.Length() - 20);
+    stream.Attach(resp_body);
+}
+
+// malloc calls and time of the buffers of a round trip, plain against SizeClassBufferPool
+TEST(buffer_pool, round_trip_allocation_benchmark) {
+    const int kRounds = 200000;
+    AutoBuffer wire;
+    char resp[2048];
+    memset(resp, 'r', sizeof(resp));
+    wire.Write(resp, sizeof(resp));
+
+    CountingAllocator counting;
+    tickcount_t begin(true);
+    for (int i = 0; i < kRounds; ++i) __RoundTrip(&counting, wire);
+    uint64_t plain_cost = (int64_t)begin.gettickspan();
+
+    SizeClassBufferPool& pool = SizeClassBufferPool::Instance();
+    __RoundTrip(&pool, wire);   // warm the freelists of this thread
+    pool.ResetStat();
+    begin.gettickcount();
+    for (int i = 0; i < kRounds; ++i) __RoundTrip(&pool, wire);
+    uint64_t pool_cost = (int64_t)begin.gettickspan();
+    SizeClassBufferPool::Stat stat = pool.GetStat();
+
+    printf("rounds:%d malloc per round trip:%.2f (%llu ms) pooled malloc per round trip:%.2f hits:%llu misses:%llu (%llu ms)\n",
+           kRounds, (double)counting.allocs / kRounds, (unsigned long long)plain_cost,
+           (double)stat.misses / kRounds, (unsigned long long)stat.hits, (unsigned long long)stat.misses,
+           (unsigned long long)pool_cost);
+    EXPECT_EQ(stat.misses, 0u);
+}
@@ -0,0 +1,93 @@
+#include "../unix/socket/socketpoll.h"
+#include "gtest/gtest.h"
+
+#include <poll.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "mars/comm/tickcount.h"
+
+using namespace testing;
+
+struct SocketPairs {
+    explicit SocketPairs(size_t _count) {
+        for (size_t i = 0; i < _count; ++i) {
+            int fds[2];
+            if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) break;
+            local.push_back(fds[0]);
+            remote.push_back(fds[1]);
+        }
+    }
+
+    ~SocketPairs() {
+        for (size_t i = 0; i < local.size(); ++i) {
+            close(local[i]);
+            close(remote[i]);
+        }
+    }
+
+    std::vector<int> local;
+    std::vector<int> remote;
+};
+
+static uint64_t __RunPollLoop(bool _rebuild, SocketPairs& _idle, SocketPairs& _active, int _rounds) {
+    SocketBreaker breaker;
+    SocketPoll poll(breaker);
+    char buf[16];
+
+    tickcount_t begin(true);
+    for (int round = 0; round < _rounds; ++round) {
+        if (_rebuild || 0 == round) {
+            poll.ClearEvent();
+            for (size_t i = 0; i < _idle.local.size(); ++i) poll.ReadEvent(_idle.local[i], true);
+            for (size_t i = 0; i < _active.local.size(); ++i) poll.ReadEvent(_active.local[i], true);
+        }
+
+        for (size_t i = 0; i < _active.remote.size(); ++i) send(_active.remote[i], "x", 1, 0);
+
+        poll.Poll(1000);
+        EXPECT_EQ(poll.TriggeredEvents().size(), _active.local.size());
+        for (size_t i = 0; i < poll.TriggeredEvents().size(); ++i) recv(poll.TriggeredEvents()[i].FD(), buf, sizeof(buf), 0);
+    }
+    return (int64_t)begin.gettickspan();
+}
+
+static uint64_t __RunRawPollLoop(SocketPairs& _idle, SocketPairs& _active, int _rounds) {
+    std::vector<pollfd> fds;
+    char buf[16];
+
+    tickcount_t begin(true);
+    for (int round = 0; round < _rounds; ++round) {
+        fds.clear();
+        for (size_t i = 0; i < _idle.local.size(); ++i) fds.push_back({_idle.local[i], POLLIN, 0});
+        for (size_t i = 0; i < _active.local.size(); ++i) fds.push_back({_active.local[i], POLLIN, 0});
+
+        for (size_t i = 0; i < _active.remote.size(); ++i) send(_active.remote[i], "x", 1, 0);
+
+        poll(&fds[0], (nfds_t)fds.size(), 1000);
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if (fds[i].revents & POLLIN) recv(fds[i].fd, buf, sizeof(buf), 0);
+        }
+    }
+    return (int64_t)begin.gettickspan();
+}
+
+// a few active sockets among 1000 idle ones: poll() of a rebuilt pollfd array every round, SocketPoll
+// filled anew every round, and SocketPoll keeping its registrations from round to round
+TEST(socketpoll, idle_active_benchmark) {
+    const int kRounds = 2000;
+    const size_t kActive[] = {1, 8, 64};
+    SocketPairs idle(1000);
+    ASSERT_EQ(idle.local.size(), 1000u);
+
+    for (size_t i = 0; i < sizeof(kActive) / sizeof(kActive[0]); ++i) {
+        SocketPairs active(kActive[i]);
+        uint64_t raw = __RunRawPollLoop(idle, active, kRounds);
+        uint64_t rebuild = __RunPollLoop(true, idle, active, kRounds);
+        uint64_t persistent = __RunPollLoop(false, idle, active, kRounds);
+        printf("idle:1000 active:%zu rounds:%d poll():%llu ms rebuild:%llu ms persistent:%llu ms\n",
+               kActive[i], kRounds, (unsigned long long)raw, (unsigned long long)rebuild, (unsigned long long)persistent);
+    }
+}
@@ -19,6 +19,10 @@
 
 #include "socketpoll.h"
 
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
 #include <algorithm>
 
 #include "comm/xlogger/xlogger.h"
@@ -35,13 +39,43 @@ SOCKET PollEvent::FD() const { return poll_event_.fd; }
     
 //////////////////////////////////////////////
 
+#if defined(__linux__)
+static const size_t kEpollThreshold = 16;
+
+static uint32_t __ToEpoll(short _events) {
+    uint32_t events = 0;
+    if (_events & POLLIN)  events |= EPOLLIN;
+    if (_events & POLLPRI) events |= EPOLLPRI;
+    if (_events & POLLOUT) events |= EPOLLOUT;
+    return events;
+}
+
+static short __FromEpoll(uint32_t _events) {
+    short events = 0;
+    if (_events & EPOLLIN)  events |= POLLIN;
+    if (_events & EPOLLPRI) events |= POLLPRI;
+    if (_events & EPOLLOUT) events |= POLLOUT;
+    if (_events & EPOLLERR) events |= POLLERR;
+    if (_events & EPOLLHUP) events |= POLLHUP;
+    return events;
+}
+#endif
+
 SocketPoll::SocketPoll(SocketBreaker& _breaker, bool _autoclear)
 : breaker_(_breaker), autoclear_(_autoclear), ret_(0), errno_(0)
+#if defined(__linux__)
+, epoll_fd_(-1), epoll_disabled_(false), epoll_resync_(false)
+#endif
 {
     events_.push_back({breaker_.BreakerFD(), POLLIN, 0});
+    events_index_[breaker_.BreakerFD()] = 0;
 }
 
-SocketPoll::~SocketPoll() {}
+SocketPoll::~SocketPoll() {
+#if defined(__linux__)
+    __EpollClose();
+#endif
+}
 
 bool SocketPoll::Consign(SocketPoll& _consignor, bool _recover) {
     auto it = std::find_if(events_.begin(), events_.end(), [&_consignor](const pollfd& _v){ return _v.fd == _consignor.events_[0].fd;});
@@ -56,65 +90,87 @@ bool SocketPoll::Consign(SocketPoll& _consignor, bool _recover) {
         events_.insert(events_.end(), _consignor.events_.begin(), _consignor.events_.end());
     }
     
+    __RebuildIndex();
+#if defined(__linux__)
+    epoll_resync_ = true;
+#endif
     return true;
 }
 
 void SocketPoll::AddEvent(SOCKET _fd, bool _read, bool _write, void* _user_data) {
     
-    auto it = std::find_if(events_.begin(), events_.end(), [&_fd](const pollfd& _v){ return _v.fd == _fd;});
+    pollfd* event = __FindEvent(_fd);
     pollfd add_event = {_fd, static_cast<short>((_read? POLLIN:0) | (_write? POLLOUT:0)), 0};
-    if (it == events_.end()) {
+    if (NULL == event) {
+        events_index_[_fd] = events_.size();
         events_.push_back(add_event);
     } else {
-        *it = add_event;
+        *event = add_event;
     }
     events_user_data_[_fd] = _user_data;
+    __ChangeEvent(_fd);
 }
 
 void SocketPoll::ReadEvent(SOCKET _fd, bool _active) {
     
-    auto find_it = std::find_if(events_.begin(), events_.end(), [&_fd](const pollfd& _v){ return _v.fd == _fd;});
-    if (find_it == events_.end()) {
+    pollfd* event = __FindEvent(_fd);
+    if (NULL == event) {
         AddEvent(_fd, _active?true:false, false, NULL);
         return;
     }
     
-    if (_active)
-        find_it->events |= POLLIN;
-    else
-        find_it->events &= ~POLLIN;
+    short events = _active ? (event->events | POLLIN) : (event->events & ~POLLIN);
+    if (events == event->events) return;
+    
+    event->events = events;
+    __ChangeEvent(_fd);
 }
 
 void SocketPoll::WriteEvent(SOCKET _fd, bool _active) {
     
-    auto find_it = std::find_if(events_.begin(), events_.end(), [&_fd](const pollfd& _v){ return _v.fd == _fd;});
-    if (find_it == events_.end()) {
+    pollfd* event = __FindEvent(_fd);
+    if (NULL == event) {
         AddEvent(_fd, false, _active?true:false, NULL);
         return;
     } 
     
-    if (_active)
-        find_it->events |= POLLOUT;
-    else
-        find_it->events &= ~POLLOUT;
+    short events = _active ? (event->events | POLLOUT) : (event->events & ~POLLOUT);
+    if (events == event->events) return;
+    
+    event->events = events;
+    __ChangeEvent(_fd);
 }
 
 void SocketPoll::NullEvent(SOCKET _fd) {
-    auto find_it = std::find_if(events_.begin(), events_.end(), [&_fd](const pollfd& _v){ return _v.fd == _fd;});
-    if (find_it == events_.end()) {
+    if (NULL == __FindEvent(_fd)) {
         AddEvent(_fd, false, false, NULL);
     }
 }
 
 void SocketPoll::DelEvent(SOCKET _fd) {
-    auto find_it = std::find_if(events_.begin(), events_.end(), [&_fd](const pollfd& _v){ return _v.fd == _fd;});
-    if (find_it != events_.end()) events_.erase(find_it);
+    auto find_it = events_index_.find(_fd);
+    if (find_it != events_index_.end() && 0 != find_it->second) {
+        // move the last event into the hole, the breaker always stays at 0
+        size_t pos = find_it->second;
+        events_index_.erase(find_it);
+        if (pos != events_.size() - 1) {
+            events_[pos] = events_.back();
+            events_index_[events_[pos].fd] = pos;
+        }
+        events_.pop_back();
+    }
     events_user_data_.erase(_fd);
+    __ChangeEvent(_fd);
 }
 
 void SocketPoll::ClearEvent() {
     events_.erase(events_.begin()+1, events_.end());
     events_user_data_.clear();
+    __RebuildIndex();
+#if defined(__linux__)
+    epoll_resync_ = true;
+    epoll_changed_.clear();
+#endif
 }
 
 int SocketPoll::Poll() { return Poll(-1); }
@@ -126,6 +182,24 @@ int SocketPoll::Poll(int _msec) {
     triggered_events_.clear();
     errno_ = 0;
     ret_   = 0;
+
+#if defined(__linux__)
+    if (-1 == epoll_fd_ && !epoll_disabled_ && events_.size() > kEpollThreshold) {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (0 > epoll_fd_) {
+            xwarn2(TSF"epoll_create1 fail:(%_, %_), use poll", errno, strerror(errno));
+            epoll_disabled_ = true;
+        }
+        epoll_resync_ = true;
+    }
+
+    if (-1 != epoll_fd_ && __EpollSync()) {
+        __EpollPoll(_msec);
+        if (autoclear_) Breaker().Clear();
+        return ret_;
+    }
+#endif
+
     for (auto &i : events_) { i.revents = 0; }
     
     ret_ = poll(&events_[0], (nfds_t)events_.size(), _msec);
@@ -156,6 +230,142 @@ int SocketPoll::Poll(int _msec) {
     return ret_;
 }
 
+pollfd* SocketPoll::__FindEvent(SOCKET _fd) {
+    auto find_it = events_index_.find(_fd);
+    if (find_it == events_index_.end()) return NULL;
+    return &events_[find_it->second];
+}
+
+void SocketPoll::__ChangeEvent(SOCKET _fd) {
+#if defined(__linux__)
+    if (-1 != epoll_fd_ && !epoll_resync_) epoll_changed_.push_back(_fd);
+#endif
+}
+
+void SocketPoll::__RebuildIndex() {
+    events_index_.clear();
+    // the first entry wins, as find_if did when an fd was consigned twice
+    for (size_t i = events_.size(); i > 0; --i) {
+        events_index_[events_[i - 1].fd] = i - 1;
+    }
+}
+
+#if defined(__linux__)
+bool SocketPoll::__EpollCtl(int _op, SOCKET _fd, short _events) {
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = __ToEpoll(_events);
+    event.data.fd = _fd;
+
+    if (0 == epoll_ctl(epoll_fd_, _op, _fd, &event)) return true;
+
+    // the kernel drops closed fds by itself, and a reused fd number may still be registered
+    if (EPOLL_CTL_MOD == _op && ENOENT == errno) return 0 == epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, _fd, &event);
+    if (EPOLL_CTL_ADD == _op && EEXIST == errno) return 0 == epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, _fd, &event);
+    if (EPOLL_CTL_DEL == _op && (ENOENT == errno || EBADF == errno)) return true;
+
+    xwarn2(TSF"epoll_ctl op:%_ fd:%_ fail:(%_, %_)", _op, _fd, errno, strerror(errno));
+    return false;
+}
+
+bool SocketPoll::__EpollSync() {
+    bool ok = true;
+
+    if (epoll_resync_) {
+        for (auto it = epoll_registered_.begin(); it != epoll_registered_.end();) {
+            if (events_index_.end() == events_index_.find(it->first)) {
+                __EpollCtl(EPOLL_CTL_DEL, it->first, 0);
+                it = epoll_registered_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        for (auto& i : events_) {
+            if (!__EpollCtl(epoll_registered_.count(i.fd) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, i.fd, i.events)) { ok = false; break; }
+            epoll_registered_[i.fd] = i.events;
+        }
+    } else {
+        for (auto fd : epoll_changed_) {
+            pollfd* event = __FindEvent(fd);
+            auto registered = epoll_registered_.find(fd);
+
+            if (NULL == event) {
+                if (registered == epoll_registered_.end()) continue;
+                __EpollCtl(EPOLL_CTL_DEL, fd, 0);
+                epoll_registered_.erase(registered);
+                continue;
+            }
+
+            if (registered == epoll_registered_.end()) {
+                if (!__EpollCtl(EPOLL_CTL_ADD, fd, event->events)) { ok = false; break; }
+            } else {
+                // always re-arm, AddEvent may be registering a new socket with a reused fd number
+                if (!__EpollCtl(EPOLL_CTL_MOD, fd, event->events)) { ok = false; break; }
+            }
+            epoll_registered_[fd] = event->events;
+        }
+    }
+
+    epoll_resync_ = false;
+    epoll_changed_.clear();
+
+    if (!ok) {
+        // e.g. regular files can not be added to epoll, fall back to poll() for good
+        epoll_disabled_ = true;
+        __EpollClose();
+    }
+    return ok;
+}
+
+int SocketPoll::__EpollPoll(int _msec) {
+    for (auto fd : epoll_triggered_) {
+        pollfd* event = __FindEvent(fd);
+        if (NULL != event) event->revents = 0;
+    }
+    epoll_triggered_.clear();
+    events_[0].revents = 0;
+
+    epoll_ready_.resize(epoll_registered_.size());
+    int ret = epoll_wait(epoll_fd_, &epoll_ready_[0], (int)epoll_ready_.size(), _msec);
+
+    if (0 > ret) {
+        ret_ = ret;
+        errno_ = errno;
+        return ret_;
+    }
+
+    for (int i = 0; i < ret; ++i) {
+        auto find_it = events_index_.find(epoll_ready_[i].data.fd);
+        if (find_it == events_index_.end()) continue;
+
+        pollfd& event = events_[find_it->second];
+        event.revents = __FromEpoll(epoll_ready_[i].events) & (event.events | POLLERR | POLLHUP);
+        if (0 == event.revents) continue;
+
+        epoll_triggered_.push_back(event.fd);
+        ++ret_;
+        if (0 == find_it->second) continue;
+
+        PollEvent traggered_event;
+        traggered_event.poll_event_ = event;
+        traggered_event.user_data_  = events_user_data_[event.fd];
+
+        triggered_events_.push_back(traggered_event);
+    }
+
+    return ret_;
+}
+
+void SocketPoll::__EpollClose() {
+    if (-1 != epoll_fd_) close(epoll_fd_);
+    epoll_fd_ = -1;
+    epoll_registered_.clear();
+    epoll_changed_.clear();
+    epoll_triggered_.clear();
+}
+#endif
+
 int SocketPoll::Ret() const { return ret_; }
 int SocketPoll::Errno() const { return errno_; }
 
@@ -22,9 +22,13 @@
 #define _SOCKSTPOLL_ 
 
 #include <poll.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
 
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 #include "comm/socket/unix_socket.h"
 #include "comm/socket/socketbreaker.h"
@@ -48,6 +52,14 @@ private:
     void*     user_data_;
 };
 
+/*
+ * On Linux a SocketPoll which holds more than kEpollThreshold fds switches to a private epoll set.
+ * Registrations then stay in the kernel across Poll() calls and only fds changed by
+ * AddEvent/ReadEvent/WriteEvent/NullEvent/DelEvent are synced, so a poll costs O(ready fds).
+ * ClearEvent (SocketSelect::PreSelect) re-arms every fd added afterwards, which keeps callers that
+ * rebuild the set each loop correct even if they closed a socket and got its fd number back.
+ * Callers keeping registrations across polls must DelEvent a socket before closing it.
+ */
 class SocketPoll {
 public:
     SocketPoll(SocketBreaker& _breaker, bool _autoclear = false);
@@ -78,6 +90,17 @@ private:
     SocketPoll(const SocketPoll&);
     SocketPoll& operator=(const SocketPoll&);
     
+    pollfd* __FindEvent(SOCKET _fd);
+    void __ChangeEvent(SOCKET _fd);
+    void __RebuildIndex();
+
+#if defined(__linux__)
+    int  __EpollPoll(int _msec);
+    bool __EpollSync();
+    bool __EpollCtl(int _op, SOCKET _fd, short _events);
+    void __EpollClose();
+#endif
+
 protected:
     SocketBreaker&       breaker_;
     const bool           autoclear_;
@@ -85,9 +108,20 @@ protected:
     std::vector<pollfd>         events_;
     std::map<SOCKET, void*>     events_user_data_;
     std::vector<PollEvent>      triggered_events_;
+    std::unordered_map<SOCKET, size_t>  events_index_;  // fd -> position in events_
     
     int                    ret_;
     int                    errno_;
+
+#if defined(__linux__)
+    int                    epoll_fd_;
+    bool                   epoll_disabled_;     // epoll_create or epoll_ctl failed, stay on poll()
+    bool                   epoll_resync_;       // set by ClearEvent/Consign, re-arm every fd on next Poll
+    std::unordered_map<SOCKET, short>  epoll_registered_;   // fd -> events currently in the kernel
+    std::vector<SOCKET>    epoll_changed_;
+    std::vector<SOCKET>    epoll_triggered_;    // fds whose revents were set by the last Poll
+    std::vector<epoll_event>    epoll_ready_;
+#endif
 };
 
 #endif
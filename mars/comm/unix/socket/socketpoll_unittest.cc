@@ -0,0 +1,108 @@
+#include "socketpoll.h"
+#include "gtest/gtest.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace testing;
+
+struct SocketPairs {
+    explicit SocketPairs(size_t _count) {
+        for (size_t i = 0; i < _count; ++i) {
+            int fds[2];
+            if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) break;
+            local.push_back(fds[0]);
+            remote.push_back(fds[1]);
+        }
+    }
+
+    ~SocketPairs() {
+        for (size_t i = 0; i < local.size(); ++i) {
+            close(local[i]);
+            close(remote[i]);
+        }
+    }
+
+    std::vector<int> local;
+    std::vector<int> remote;
+};
+
+static void __Drain(int _fd) {
+    char buf[64];
+    while (0 < recv(_fd, buf, sizeof(buf), MSG_DONTWAIT)) {}
+}
+
+TEST(socketpoll, readable_and_write_toggle) {
+    const size_t kSockets = 64;     // well above the epoll threshold
+    SocketPairs pairs(kSockets);
+    ASSERT_EQ(pairs.local.size(), kSockets);
+
+    SocketBreaker breaker;
+    SocketPoll poll(breaker);
+    for (size_t i = 0; i < kSockets; ++i) poll.AddEvent(pairs.local[i], true, false, &pairs.local[i]);
+
+    EXPECT_EQ(poll.Poll(0), 0);
+
+    ASSERT_EQ(send(pairs.remote[7], "x", 1, 0), 1);
+    ASSERT_EQ(send(pairs.remote[42], "x", 1, 0), 1);
+    EXPECT_EQ(poll.Poll(100), 2);
+    ASSERT_EQ(poll.TriggeredEvents().size(), 2u);
+    for (auto event : poll.TriggeredEvents()) {
+        EXPECT_TRUE(event.Readable());
+        EXPECT_EQ(*(int*)event.UserData(), event.FD());
+    }
+
+    // level triggered: still readable until drained
+    EXPECT_EQ(poll.Poll(0), 2);
+    __Drain(pairs.local[7]);
+    __Drain(pairs.local[42]);
+    EXPECT_EQ(poll.Poll(0), 0);
+
+    poll.WriteEvent(pairs.local[3], true);
+    EXPECT_EQ(poll.Poll(0), 1);
+    EXPECT_TRUE(poll.TriggeredEvents()[0].Writealbe());
+    poll.WriteEvent(pairs.local[3], false);
+    EXPECT_EQ(poll.Poll(0), 0);
+
+    breaker.Break();
+    EXPECT_EQ(poll.Poll(0), 1);
+    EXPECT_TRUE(poll.BreakerIsBreak());
+    EXPECT_TRUE(poll.TriggeredEvents().empty());
+    breaker.Clear();
+
+    poll.DelEvent(pairs.local[0]);
+    ASSERT_EQ(send(pairs.remote[0], "x", 1, 0), 1);
+    EXPECT_EQ(poll.Poll(0), 0);
+}
+
+TEST(socketpoll, clear_event_rearms_reused_fd) {
+    const size_t kSockets = 32;
+    SocketPairs pairs(kSockets);
+    ASSERT_EQ(pairs.local.size(), kSockets);
+
+    SocketBreaker breaker;
+    SocketPoll poll(breaker);
+    for (size_t i = 0; i < kSockets; ++i) poll.ReadEvent(pairs.local[i], true);
+    EXPECT_EQ(poll.Poll(0), 0);
+
+    // close a registered socket and get its fd number back for a new one
+    int fd = pairs.local[5];
+    close(pairs.local[5]);
+    close(pairs.remote[5]);
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ASSERT_EQ(fds[0], fd);
+    pairs.local[5] = fds[0];
+    pairs.remote[5] = fds[1];
+
+    poll.ClearEvent();
+    for (size_t i = 0; i < kSockets; ++i) poll.ReadEvent(pairs.local[i], true);
+
+    ASSERT_EQ(send(pairs.remote[5], "x", 1, 0), 1);
+    EXPECT_EQ(poll.Poll(100), 1);
+    ASSERT_EQ(poll.TriggeredEvents().size(), 1u);
+    EXPECT_EQ(poll.TriggeredEvents()[0].FD(), fd);
+}
+
+EXPORT_GTEST_SYMBOLS(comm_export_socketpoll_unittest)
@@ -184,7 +184,7 @@ void XLogger::DoTypeSafeFormat(const char* _format, const string_cast** _args) {
 }
 
 XScopeTracer::XScopeTracer(TLogLevel _level, const char* _tag, const char* _name, const char* _file, const char* _func, int _line, const char* _log)
-:m_enable(xlogger_IsEnabledFor(_level)), m_info(), m_tv() {
+:m_enable(xlogger_IsEnabledForTag(_level, _tag, _file)), m_info(), m_tv() {
 	m_info.level = _level;
 
 	if (m_enable) {
@@ -30,6 +30,7 @@
 
 #ifdef XLOGGER_DISABLE
 #define  xlogger_IsEnabledFor(_level)	(false)
+#define  xlogger_IsEnabledForTag(_level, _tag, _file)	(false)
 #define  xlogger_AssertP(...)			((void)0)
 #define  xlogger_Assert(...)			((void)0)
 #define  xlogger_VPrint(...)			((void)0)
@@ -37,6 +38,11 @@
 #define  xlogger_Write(...)				((void)0)
 #endif
 
+// lines below it are compiled out, e.g. -DXLOGGER_MIN_LEVEL=kLevelInfo for release builds
+#ifndef XLOGGER_MIN_LEVEL
+#define XLOGGER_MIN_LEVEL kLevelAll
+#endif
+
 #ifdef __cplusplus
 #include <string>
 
@@ -50,6 +56,8 @@ template<int x> struct xlogger_static_assert_test{};
                                         PP_CAT(boost_static_assert_typedef_, __LINE__)
 
 
+constexpr TLogLevel kXLoggerMinLevel = XLOGGER_MIN_LEVEL;
+
 // const struct TypeSafeFormat {TypeSafeFormat(){}} __tsf__;
 using TypeSafeFormat = void*;
 const struct XLoggerTag {XLoggerTag(){}} __xlogger_tag__;
@@ -338,12 +346,14 @@ __attribute__((__format__ (printf, 2, 3)))
 #endif
 __inline void  __xlogger_c_write(const XLoggerInfo* _info, const char* _log, ...) { xlogger_Write(_info, _log); }
 
-#define xlogger2(level, tag, file, func, line, ...)		 if ((!xlogger_IsEnabledFor(level)));\
+#define __xlogger_is_enabled(level, tag, file)  ((level) >= XLOGGER_MIN_LEVEL && xlogger_IsEnabledForTag(level, tag, file))
+
+#define xlogger2(level, tag, file, func, line, ...)		 if ((!__xlogger_is_enabled(level, tag, file)));\
                                                               else { XLoggerInfo info= {level, tag, file, func, line,\
                                                                      {0, 0}, -1, -1, -1, false};\ gettimeofday(&info.m_tv, NULL);\
                                                                      XLOGGER_ROUTER_OUTPUT(__xlogger_c_write(&info, __VA_ARGS__),xlogger_Print(&info, __VA_ARGS__), __VA_ARGS__);}
 
-#define xlogger2_if(exp, level, tag, file, func, line, ...)    if (!(exp) || !xlogger_IsEnabledFor(level));\
+#define xlogger2_if(exp, level, tag, file, func, line, ...)    if (!(exp) || !__xlogger_is_enabled(level, tag, file));\
                                                                     else { XLoggerInfo info= {level, tag, file, func, line,\
                                                                            {0, 0}, -1, -1, -1, false}; gettimeofday(&info.timeval, NULL);\
                                                                            XLOGGER_ROUTER_OUTPUT(__xlogger_c_write(&info, __VA_ARGS__),xlogger_Print(&info, __VA_ARGS__), __VA_ARGS__);}
@@ -365,7 +375,7 @@ __inline void  __xlogger_c_write(const XLoggerInfo* _info, const char* _log, ...
 #define xerror2_if(exp, ...)	   __xlogger_c_impl_if(kLevelError, exp, __VA_ARGS__)
 #define xfatal2_if(exp, ...)	   __xlogger_c_impl_if(kLevelFatal, exp, __VA_ARGS__)
 
-#define xassert2(exp, ...)	  if (((exp) || !xlogger_IsEnabledFor(kLevelFatal)));else {\
+#define xassert2(exp, ...)	  if (((exp) || !__xlogger_is_enabled(kLevelFatal, XLOGGER_TAG, __XFILE__)));else {\
                                     XLoggerInfo info= {kLevelFatal, XLOGGER_TAG, __XFILE__, __XFUNCTION__, __LINE__,\
                                     {0, 0}, -1, -1, -1, false};\
                                     gettimeofday(&info.m_tv, NULL);\
@@ -377,19 +387,22 @@ __inline void  __xlogger_c_write(const XLoggerInfo* _info, const char* _log, ...
 #define XLOGGER_HOOK NULL
 #endif
 
-#define xlogger(level, tag, file, func, line, ...)	   if ((!xlogger_IsEnabledFor(level)));\
+// a constant level below kXLoggerMinLevel folds the whole line away
+#define __xlogger_is_enabled(level, tag, file)  ((level) >= kXLoggerMinLevel && xlogger_IsEnabledForTag(level, tag, file))
+
+#define xlogger(level, tag, file, func, line, ...)	   if ((!__xlogger_is_enabled(level, tag, file)));\
                                                        else XLogger(level, tag, file, func, line, false, XLOGGER_HOOK)\
                                                              XLOGGER_ROUTER_OUTPUT(.WriteNoFormat(TSF __VA_ARGS__),(TSF __VA_ARGS__), __VA_ARGS__)
 
-#define xlogger2(level, tag, file, func, line, ...)		if ((!xlogger_IsEnabledFor(level)));\
+#define xlogger2(level, tag, file, func, line, ...)		if ((!__xlogger_is_enabled(level, tag, file)));\
                                                         else XLogger(level, tag, file, func, line, false, XLOGGER_HOOK)\
                                                              XLOGGER_ROUTER_OUTPUT(.WriteNoFormat(__VA_ARGS__),(__VA_ARGS__), __VA_ARGS__)
 
-#define xlogger2_if(exp, level, tag, file, func, line, ...)		if ((!(exp) || !xlogger_IsEnabledFor(level)));\
+#define xlogger2_if(exp, level, tag, file, func, line, ...)		if ((!(exp) || !__xlogger_is_enabled(level, tag, file)));\
                                                                 else XLogger(level, tag, file, func, line, false, XLOGGER_HOOK)\
                                                                      XLOGGER_ROUTER_OUTPUT(.WriteNoFormat(__VA_ARGS__),(__VA_ARGS__), __VA_ARGS__)
 
-#define xlogger_trace(level, tag, file, func, line, ...)		if ((!xlogger_IsEnabledFor(level)));\
+#define xlogger_trace(level, tag, file, func, line, ...)		if ((!__xlogger_is_enabled(level, tag, file)));\
                                                         else XLogger(level, tag, file, func, line, true, XLOGGER_HOOK)\
                                                              XLOGGER_ROUTER_OUTPUT(.WriteNoFormat(__VA_ARGS__),(__VA_ARGS__), __VA_ARGS__)
 
@@ -424,7 +437,7 @@ __inline void  __xlogger_c_write(const XLoggerInfo* _info, const char* _log, ...
 #define xgroup2(...)			   XLogger(kLevelAll, XLOGGER_TAG, __XFILE__, __XFUNCTION__, __LINE__, false, XLOGGER_HOOK)(__VA_ARGS__)
 #define xgroup2_if(exp, ...)	   if ((!(exp))); else XLogger(kLevelAll, XLOGGER_TAG, __XFILE__, __XFUNCTION__, __LINE__, false, XLOGGER_HOOK)(__VA_ARGS__)
 
-#define xassert2(exp, ...)	  if (((exp) || !xlogger_IsEnabledFor(kLevelFatal)));\
+#define xassert2(exp, ...)	  if (((exp) || !__xlogger_is_enabled(kLevelFatal, XLOGGER_TAG, __XFILE__)));\
                              else XLogger(kLevelFatal, XLOGGER_TAG, __XFILE__, __XFUNCTION__, __LINE__, false, XLOGGER_HOOK).Assert(#exp)\
                                   XLOGGER_ROUTER_OUTPUT(.WriteNoFormat(__VA_ARGS__),(__VA_ARGS__), __VA_ARGS__)
 
@@ -0,0 +1,132 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * xlogger_level_filter.cc
+ *
+ *  Created on: 2026-10-18
+ */
+
+#include "mars/comm/xlogger/xloggerbase.h"
+
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mars/comm/compiler_util.h"
+#include "mars/comm/thread/lock.h"
+#include "mars/comm/xlogger/loginfo_extract.h"
+
+// as in xloggerbase.c, libraries built with USING_XLOG_WEAK_FUNC share the levels of the xlog library
+extern "C" {
+WEAK_FUNC int  __xlogger_IsEnabledForTag_impl(TLogLevel _level, const char* _tag, const char* _file);
+WEAK_FUNC void __xlogger_SetLevelOverride_impl(int _is_file, const char* _name, const TLogLevel* _level);
+WEAK_FUNC void __xlogger_ClearLevelOverrides_impl();
+}
+
+int xlogger_IsEnabledForTag(TLogLevel _level, const char* _tag, const char* _file) {
+    if (NULL == &__xlogger_IsEnabledForTag_impl) return xlogger_IsEnabledFor(_level);
+    return __xlogger_IsEnabledForTag_impl(_level, _tag, _file);
+}
+
+void xlogger_SetTagLevel(const char* _tag, TLogLevel _level) {
+    if (NULL != &__xlogger_SetLevelOverride_impl) __xlogger_SetLevelOverride_impl(0, _tag, &_level);
+}
+
+void xlogger_ClearTagLevel(const char* _tag) {
+    if (NULL != &__xlogger_SetLevelOverride_impl) __xlogger_SetLevelOverride_impl(0, _tag, NULL);
+}
+
+void xlogger_SetFileLevel(const char* _file, TLogLevel _level) {
+    if (NULL != &__xlogger_SetLevelOverride_impl) __xlogger_SetLevelOverride_impl(1, _file, &_level);
+}
+
+void xlogger_ClearFileLevel(const char* _file) {
+    if (NULL != &__xlogger_SetLevelOverride_impl) __xlogger_SetLevelOverride_impl(1, _file, NULL);
+}
+
+void xlogger_ClearLevelOverrides() {
+    if (NULL != &__xlogger_ClearLevelOverrides_impl) __xlogger_ClearLevelOverrides_impl();
+}
+
+#ifndef USING_XLOG_WEAK_FUNC
+
+namespace {
+typedef std::vector<std::pair<std::string, TLogLevel> > LevelList;
+
+// never changed once published, a change publishes a changed copy
+struct LevelTable {
+    LevelList tags;
+    LevelList files;
+};
+}
+
+// the logging threads only load the pointer, so a level check takes no lock even while levels change
+static std::atomic<const LevelTable*> sg_level_table(nullptr);
+static Mutex sg_mutex_level_table;
+// a reader may still be looking at a replaced table and there is no telling when it is done;
+// levels are changed by hand a few times a process, so replaced tables are simply kept.
+static std::vector<const LevelTable*> sg_replaced_tables;
+
+static const TLogLevel* __Find(const LevelList& _list, const char* _name) {
+    for (LevelList::const_iterator iter = _list.begin(); iter != _list.end(); ++iter) {
+        if (0 == strcmp(iter->first.c_str(), _name)) return &iter->second;
+    }
+    return NULL;
+}
+
+int __xlogger_IsEnabledForTag_impl(TLogLevel _level, const char* _tag, const char* _file) {
+    const LevelTable* table = sg_level_table.load(std::memory_order_acquire);
+    if (nullptr == table) return xlogger_IsEnabledFor(_level);
+
+    const TLogLevel* level = NULL;
+    if (!table->files.empty() && NULL != _file) level = __Find(table->files, ExtractFileName(_file));
+    if (NULL == level && !table->tags.empty() && NULL != _tag && '\0' != *_tag) level = __Find(table->tags, _tag);
+
+    return NULL == level ? xlogger_IsEnabledFor(_level) : (*level <= _level);
+}
+
+// _level NULL removes the level of _name
+void __xlogger_SetLevelOverride_impl(int _is_file, const char* _name, const TLogLevel* _level) {
+    if (NULL == _name || '\0' == *_name) return;
+
+    ScopedLock lock(sg_mutex_level_table);
+    const LevelTable* current = sg_level_table.load(std::memory_order_relaxed);
+    LevelTable* table = nullptr == current ? new LevelTable() : new LevelTable(*current);
+
+    LevelList& list = _is_file ? table->files : table->tags;
+    for (LevelList::iterator iter = list.begin(); iter != list.end(); ++iter) {
+        if (iter->first == _name) {
+            list.erase(iter);
+            break;
+        }
+    }
+    if (NULL != _level) list.push_back(std::make_pair(std::string(_name), *_level));
+
+    if (table->tags.empty() && table->files.empty()) {
+        delete table;
+        table = nullptr;
+    }
+
+    sg_level_table.store(table, std::memory_order_release);
+    if (nullptr != current) sg_replaced_tables.push_back(current);
+}
+
+void __xlogger_ClearLevelOverrides_impl() {
+    ScopedLock lock(sg_mutex_level_table);
+    const LevelTable* current = sg_level_table.exchange(nullptr, std::memory_order_acq_rel);
+    if (nullptr != current) sg_replaced_tables.push_back(current);
+}
+
+#endif
@@ -0,0 +1,124 @@
+// lines below info are compiled out of this file
+#define XLOGGER_MIN_LEVEL kLevelInfo
+#undef XLOGGER_TAG
+#define XLOGGER_TAG "filter_ut"
+
+#include "mars/comm/xlogger/xlogger.h"
+#include "gtest/gtest.h"
+
+#include <atomic>
+
+#include "boost/bind.hpp"
+
+#include "mars/comm/thread/thread.h"
+
+using namespace testing;
+
+static int sg_lines = 0;
+static int sg_args = 0;
+
+static void __CountAppender(const XLoggerInfo* _info, const char* _log) {
+    ++sg_lines;
+}
+
+static int __Arg() {
+    ++sg_args;
+    return 1;
+}
+
+class XloggerLevelFilterTest : public Test {
+  protected:
+    virtual void SetUp() {
+        old_level_ = xlogger_Level();
+        old_appender_ = xlogger_SetAppender(&__CountAppender);
+        xlogger_SetLevel(kLevelInfo);
+        sg_lines = 0;
+        sg_args = 0;
+    }
+
+    virtual void TearDown() {
+        xlogger_ClearLevelOverrides();
+        xlogger_SetAppender(old_appender_);
+        xlogger_SetLevel(old_level_);
+    }
+
+    TLogLevel old_level_;
+    xlogger_appender_t old_appender_;
+};
+
+TEST_F(XloggerLevelFilterTest, tag_and_file_levels) {
+    EXPECT_FALSE(xlogger_IsEnabledForTag(kLevelDebug, "stn", "/src/stn/longlink.cc"));
+    EXPECT_TRUE(xlogger_IsEnabledForTag(kLevelInfo, "stn", "/src/stn/longlink.cc"));
+
+    xlogger_SetTagLevel("stn", kLevelDebug);
+    xlogger_SetTagLevel("noisy", kLevelNone);
+    EXPECT_TRUE(xlogger_IsEnabledForTag(kLevelDebug, "stn", "/src/stn/longlink.cc"));
+    EXPECT_FALSE(xlogger_IsEnabledForTag(kLevelVerbose, "stn", "/src/stn/longlink.cc"));
+    EXPECT_FALSE(xlogger_IsEnabledForTag(kLevelDebug, "sdt", "/src/sdt/sdt.cc"));
+    EXPECT_FALSE(xlogger_IsEnabledForTag(kLevelFatal, "noisy", "/src/noisy.cc"));
+    EXPECT_TRUE(xlogger_IsEnabledForTag(kLevelInfo, NULL, NULL));
+
+    // the file level wins, directories do not matter
+    xlogger_SetFileLevel("noisy.cc", kLevelWarn);
+    EXPECT_TRUE(xlogger_IsEnabledForTag(kLevelWarn, "noisy", "/src/noisy.cc"));
+    EXPECT_FALSE(xlogger_IsEnabledForTag(kLevelInfo, "noisy", "noisy.cc"));
+    EXPECT_FALSE(xlogger_IsEnabledForTag(kLevelError, "noisy", "/src/other.cc"));
+
+    xlogger_ClearFileLevel("noisy.cc");
+    xlogger_ClearTagLevel("noisy");
+    EXPECT_TRUE(xlogger_IsEnabledForTag(kLevelError, "noisy", "/src/noisy.cc"));
+    EXPECT_TRUE(xlogger_IsEnabledForTag(kLevelDebug, "stn", "/src/stn/longlink.cc"));
+
+    // the global level is still read on every check
+    xlogger_SetLevel(kLevelError);
+    EXPECT_FALSE(xlogger_IsEnabledForTag(kLevelInfo, "sdt", "/src/sdt/sdt.cc"));
+    EXPECT_TRUE(xlogger_IsEnabledForTag(kLevelDebug, "stn", "/src/stn/longlink.cc"));
+
+    xlogger_ClearLevelOverrides();
+    EXPECT_FALSE(xlogger_IsEnabledForTag(kLevelDebug, "stn", "/src/stn/longlink.cc"));
+}
+
+TEST_F(XloggerLevelFilterTest, checked_before_formatting) {
+    xlogger_SetTagLevel(XLOGGER_TAG, kLevelWarn);
+    xinfo2(TSF"%_", __Arg());
+    EXPECT_EQ(0, sg_args);
+    EXPECT_EQ(0, sg_lines);
+
+    xwarn2(TSF"%_", __Arg());
+    EXPECT_EQ(1, sg_args);
+    EXPECT_EQ(1, sg_lines);
+
+    // below XLOGGER_MIN_LEVEL, whatever the levels at runtime
+    xlogger_SetTagLevel(XLOGGER_TAG, kLevelVerbose);
+    xdebug2(TSF"%_", __Arg());
+    xverbose2(TSF"%_", __Arg());
+    EXPECT_EQ(1, sg_args);
+    xinfo2(TSF"%_", __Arg());
+    EXPECT_EQ(2, sg_args);
+    EXPECT_EQ(2, sg_lines);
+}
+
+static void __ToggleLevels(std::atomic<bool>* _stop) {
+    while (!*_stop) {
+        xlogger_SetTagLevel("stn", kLevelDebug);
+        xlogger_SetFileLevel("longlink.cc", kLevelError);
+        xlogger_ClearLevelOverrides();
+    }
+}
+
+TEST_F(XloggerLevelFilterTest, changed_while_checked) {
+    std::atomic<bool> stop(false);
+    Thread thread(boost::bind(&__ToggleLevels, &stop));
+    thread.start();
+
+    int enabled = 0;
+    for (int i = 0; i < 200000; ++i) {
+        enabled += xlogger_IsEnabledForTag(kLevelInfo, "stn", "/src/stn/longlink.cc");
+    }
+    stop = true;
+    thread.join();
+
+    EXPECT_LT(0, enabled);
+}
+
+EXPORT_GTEST_SYMBOLS(comm_export_xlogger_level_filter_unittest)
@@ -65,6 +65,18 @@ void xlogger_SetLevel(TLogLevel _level);
 int  xlogger_IsEnabledFor(TLogLevel _level);
 xlogger_appender_t xlogger_SetAppender(xlogger_appender_t _appender);
 
+/*
+ * Levels of single tags and source files over xlogger_Level(), e.g. the debug lines of one module in a
+ * release build, or kLevelNone for a noisy one. The xlogger macros check them before a line is formatted.
+ * _file is a file name without directories, "longlink.cc"; a file level wins over a tag level.
+ */
+int  xlogger_IsEnabledForTag(TLogLevel _level, const char* _tag, const char* _file);
+void xlogger_SetTagLevel(const char* _tag, TLogLevel _level);
+void xlogger_ClearTagLevel(const char* _tag);
+void xlogger_SetFileLevel(const char* _file, TLogLevel _level);
+void xlogger_ClearFileLevel(const char* _file);
+void xlogger_ClearLevelOverrides();
+
 typedef int (*xlogger_filter_t)(XLoggerInfo* _info, const char* _log);
 void xlogger_SetFilter(xlogger_filter_t _filter);
 xlogger_filter_t xlogger_GetFilter();
@@ -63,6 +63,17 @@ class LongLinkEncoder {
      */
     std::function<void (uint32_t _cmdid, uint32_t _seq, const AutoBuffer& _body, const AutoBuffer& _extension, AutoBuffer& _packed, longlink_tracker* _tracker)> longlink_pack;
 
+    /**
+     * optional and empty by default, write only the request header into _header when the package is the header
+     * followed by _body unchanged, so the body is sent without being copied. return false to fall back to longlink_pack.
+     * LongLink tries it before longlink_pack for every request, so it is only valid while longlink_pack
+     * just puts a header in front of the body.
+     */
+    std::function<bool (uint32_t _cmdid, uint32_t _seq, const AutoBuffer& _body, const AutoBuffer& _extension, AutoBuffer& _header, longlink_tracker* _tracker)> longlink_pack_header;
+
+    // sets longlink_pack_header to the one of the default longlink_pack
+    void EnableDefaultPackHeader();
+
     /**
      * unpackage the response data
      * _packed: data received from server
@@ -74,6 +85,20 @@ class LongLinkEncoder {
      */
     std::function<int (const AutoBuffer& _packed, uint32_t& _cmdid, uint32_t& _seq, size_t& _package_len, AutoBuffer& _body, AutoBuffer& _extension, longlink_tracker* _tracker)> longlink_unpack;
 
+    /**
+     * optional and empty by default, locate the body inside the response data instead of copying it out
+     * _body_offset, _body_len: position of the body in the package
+     * return: as longlink_unpack, LONGLINK_UNPACK_CONTINUE with _package_len set once the header is complete,
+     *         so that LongLink can receive a large body straight into its own buffer.
+     * LongLink takes packages with a body of 16KB and more through it instead of longlink_unpack, so it is only
+     * valid while longlink_unpack just strips a header: nothing else longlink_unpack does happens to them,
+     * and their _extension stays empty.
+     */
+    std::function<int (const AutoBuffer& _packed, uint32_t& _cmdid, uint32_t& _seq, size_t& _package_len, size_t& _body_offset, size_t& _body_len, longlink_tracker* _tracker)> longlink_unpack_view;
+
+    // sets longlink_unpack_view to the one of the default longlink_unpack
+    void EnableDefaultUnpackView();
+
     //heartbeat signal to keep longlink network alive
     std::function<uint32_t ()> longlink_noop_cmdid;
     std::function<bool (uint32_t _taskid, uint32_t _cmdid, uint32_t _recv_seq, const AutoBuffer& _body, const AutoBuffer& _extend)> longlink_noop_isresp;
@@ -36,6 +36,7 @@ enum TAppenderMode
 enum TCompressMode{
     kZlib,
     kZstd,
+    kZstdDict,  // kZstd primed with XLogConfig::zstd_dict_, see tools/xlog_zstd_train.cc
 };
 
 struct XLogConfig{
@@ -47,6 +48,26 @@ struct XLogConfig{
     int compress_level_ = 6;
     std::string cachedir_;
     int cache_days_ = 0;
+    // kAppenderAsync only: every logging thread formats into its own lock-free ring and the
+    // async thread drains all rings into the mmap buffer, so producers never share a mutex.
+    // The price is crash safety: a line waits in its thread's ring, which is plain memory, until the async
+    // thread drains it, which is woken for that only once a ring is a third full (of 64KB), by a flush or a fatal line.
+    // A crash loses what is in the rings, the mmap buffer alone would have kept it. Off by default for that.
+    bool async_ring_ = false;
+    // keep a "<file>.xlog.idx" sidecar with the time range, levels and tags of every block,
+    // so LogBlockIndex::Query can pick the blocks of an incident without decoding the whole file.
+    bool block_index_ = false;
+    // kZstdDict only: a dictionary trained by xlog_zstd_train. Decoders need the same dictionary,
+    // blocks name it by its dictionary id. Without a usable one the appender falls back to kZstd.
+    std::string zstd_dict_;
+    // write lines as LogBinaryRecord, the raw fields of XLoggerInfo and the body, and leave the text of
+    // the time, ids and brackets to the decoders. Saves the logging thread most of log_formater's work.
+    bool binary_record_ = false;
+    // the mmap cache of the async mode, buffer_size_ bytes cut in buffer_segments_ (2 at least) segments.
+    // Writers fill one and go on with the next while the async thread writes the full ones to file,
+    // lines are only dropped, and counted by appender_get_overflow_count, if all of them wait for the file.
+    size_t buffer_size_ = 512 * 1024;
+    int buffer_segments_ = 4;
 };
 
 void appender_open(const XLogConfig& _config);
@@ -60,6 +81,8 @@ bool appender_make_logfile_name(int _timespan, const char* _prefix, std::vector<
 bool appender_get_current_log_path(char* _log_path, unsigned int _len);
 bool appender_get_current_log_cache_path(char* _logPath, unsigned int _len);
 void appender_set_console_log(bool _is_open);
+// lines the async mode dropped since appender_open because no segment of the mmap cache was free
+uint64_t appender_get_overflow_count();
 
 /*
  * By default, all logs will write to one file everyday. You can split logs to multi-file by changing max_file_size.
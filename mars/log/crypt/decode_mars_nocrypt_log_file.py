@@ -5,6 +5,7 @@ import os
 import glob
 import zlib
 import struct
+import time
 import binascii
 import traceback
 import zstandard as zstd
@@ -22,9 +23,68 @@ MAGIC_SYNC_ZSTD_START = 0x0A;
 MAGIC_SYNC_NO_CRYPT_ZSTD_START = 0x0B;
 MAGIC_ASYNC_ZSTD_START = 0x0C;
 MAGIC_ASYNC_NO_CRYPT_ZSTD_START = 0x0D;
+MAGIC_ASYNC_ZSTD_DICT_START = 0x0E;
+MAGIC_ASYNC_NO_CRYPT_ZSTD_DICT_START = 0x0F;
+# lines a crash left in the mmap buffer, tea crypted and not compressed
+MAGIC_ASYNC_RAW_CRYPT_START = 0x11;
 
 MAGIC_END = 0x00
 
+# the dictionary of kZstdDict logs, trained by xlog_zstd_train
+ZSTD_DICT = None
+if os.environ.get("XLOG_ZSTD_DICT"):
+    ZSTD_DICT = zstd.ZstdCompressionDict(open(os.environ["XLOG_ZSTD_DICT"], "rb").read())
+
+# lines of XLogConfig::binary_record_, rendered to the text log_formater writes, see log_binary_record.h
+BINARY_RECORD_MAGIC = '\x1e'
+BINARY_RECORD_HEADER = struct.Struct('=cBBBBBHhHIiii')
+LEVEL_STRINGS = ['V', 'D', 'I', 'W', 'E', 'F']
+
+def RenderBinaryRecords(_buffer):
+    _buffer = str(_buffer)
+    if -1 == _buffer.find(BINARY_RECORD_MAGIC): return _buffer
+
+    out = []
+    pos = 0
+    while pos < len(_buffer):
+        record = _buffer.find(BINARY_RECORD_MAGIC, pos)
+        if -1 == record:
+            out.append(_buffer[pos:])
+            break
+        out.append(_buffer[pos:record])
+
+        record_len = 0
+        if record + BINARY_RECORD_HEADER.size <= len(_buffer):
+            magic, level, flags, tag_len, filename_len, func_len, body_len, gmtoff, msec, sec, pid, tid, line = BINARY_RECORD_HEADER.unpack_from(_buffer, record)
+            record_len = BINARY_RECORD_HEADER.size + tag_len + filename_len + func_len + body_len
+
+        # a stray byte of a text line, or a record torn by a crash
+        if 0 == record_len or len(_buffer) < record + record_len or len(LEVEL_STRINGS) <= level:
+            out.append(BINARY_RECORD_MAGIC)
+            pos = record + 1
+            continue
+
+        strings = record + BINARY_RECORD_HEADER.size
+        tag = _buffer[strings:strings+tag_len]
+        strings += tag_len
+        filename = _buffer[strings:strings+filename_len]
+        strings += filename_len
+        func_name = _buffer[strings:strings+func_len]
+        strings += func_len
+        body = _buffer[strings:strings+body_len]
+
+        timestr = ''
+        if 0 != sec:
+            tm = time.gmtime(sec + gmtoff * 60)
+            timestr = '%04d-%02d-%02d %s%d %02d:%02d:%02d.%03d' % (tm.tm_year, tm.tm_mon, tm.tm_mday, '+' if 0 < gmtoff else '',
+                                                                   int(gmtoff * 60 / 360.0), tm.tm_hour, tm.tm_min, tm.tm_sec, msec)
+        out.append('[%s][%s][%d, %d%s][%s][%s, %s, %d][%s' % (LEVEL_STRINGS[level], timestr, pid, tid, '*' if flags & 0x01 else '',
+                                                              tag, filename, func_name, line, body))
+        if 0 == body_len or '\n' != body[-1]: out.append('\n')
+        pos = record + record_len
+
+    return ''.join(out)
+
 lastseq = 0
 
 class ZstdDecompressReader:
@@ -42,7 +102,7 @@ def IsGoodLogBuffer(_buffer, _offset, count):
     if MAGIC_NO_COMPRESS_START==magic_start or MAGIC_COMPRESS_START==magic_start or MAGIC_COMPRESS_START1==magic_start:
         crypt_key_len = 4
     elif MAGIC_COMPRESS_START2==magic_start or MAGIC_NO_COMPRESS_START1==magic_start or MAGIC_NO_COMPRESS_NO_CRYPT_START==magic_start or MAGIC_COMPRESS_NO_CRYPT_START==magic_start\
-            or MAGIC_SYNC_ZSTD_START==magic_start or MAGIC_SYNC_NO_CRYPT_ZSTD_START==magic_start or MAGIC_ASYNC_ZSTD_START==magic_start or MAGIC_ASYNC_NO_CRYPT_ZSTD_START==magic_start:
+            or MAGIC_SYNC_ZSTD_START==magic_start or MAGIC_SYNC_NO_CRYPT_ZSTD_START==magic_start or MAGIC_ASYNC_ZSTD_START==magic_start or MAGIC_ASYNC_NO_CRYPT_ZSTD_START==magic_start or MAGIC_ASYNC_ZSTD_DICT_START==magic_start or MAGIC_ASYNC_NO_CRYPT_ZSTD_DICT_START==magic_start or MAGIC_ASYNC_RAW_CRYPT_START==magic_start:
         crypt_key_len = 64
     else:
         return (False, '_buffer[%d]:%d != MAGIC_NUM_START'%(_offset, _buffer[_offset]))
@@ -65,7 +125,7 @@ def GetLogStartPos(_buffer, _count):
         if offset >= len(_buffer): break
         
         if MAGIC_NO_COMPRESS_START==_buffer[offset] or MAGIC_NO_COMPRESS_START1==_buffer[offset] or MAGIC_COMPRESS_START==_buffer[offset] or MAGIC_COMPRESS_START1==_buffer[offset] or MAGIC_COMPRESS_START2==_buffer[offset] or MAGIC_COMPRESS_NO_CRYPT_START==_buffer[offset] or MAGIC_NO_COMPRESS_NO_CRYPT_START==_buffer[offset]\
-                or MAGIC_SYNC_ZSTD_START==_buffer[offset] or MAGIC_SYNC_NO_CRYPT_ZSTD_START==_buffer[offset] or MAGIC_ASYNC_ZSTD_START==_buffer[offset] or MAGIC_ASYNC_NO_CRYPT_ZSTD_START==_buffer[offset]:
+                or MAGIC_SYNC_ZSTD_START==_buffer[offset] or MAGIC_SYNC_NO_CRYPT_ZSTD_START==_buffer[offset] or MAGIC_ASYNC_ZSTD_START==_buffer[offset] or MAGIC_ASYNC_NO_CRYPT_ZSTD_START==_buffer[offset] or MAGIC_ASYNC_ZSTD_DICT_START==_buffer[offset] or MAGIC_ASYNC_NO_CRYPT_ZSTD_DICT_START==_buffer[offset] or MAGIC_ASYNC_RAW_CRYPT_START==_buffer[offset]:
             if IsGoodLogBuffer(_buffer, offset, _count)[0]: return offset
         offset+=1
         
@@ -88,7 +148,7 @@ def DecodeBuffer(_buffer, _offset, _outbuffer):
     if MAGIC_NO_COMPRESS_START==magic_start or MAGIC_COMPRESS_START==magic_start or MAGIC_COMPRESS_START1==magic_start:
         crypt_key_len = 4
     elif MAGIC_COMPRESS_START2==magic_start or MAGIC_NO_COMPRESS_START1==magic_start or MAGIC_NO_COMPRESS_NO_CRYPT_START==magic_start or MAGIC_COMPRESS_NO_CRYPT_START==magic_start\
-            or MAGIC_SYNC_ZSTD_START==magic_start or MAGIC_SYNC_NO_CRYPT_ZSTD_START==magic_start or MAGIC_ASYNC_ZSTD_START==magic_start or MAGIC_ASYNC_NO_CRYPT_ZSTD_START==magic_start:
+            or MAGIC_SYNC_ZSTD_START==magic_start or MAGIC_SYNC_NO_CRYPT_ZSTD_START==magic_start or MAGIC_ASYNC_ZSTD_START==magic_start or MAGIC_ASYNC_NO_CRYPT_ZSTD_START==magic_start or MAGIC_ASYNC_ZSTD_DICT_START==magic_start or MAGIC_ASYNC_NO_CRYPT_ZSTD_DICT_START==magic_start or MAGIC_ASYNC_RAW_CRYPT_START==magic_start:
         crypt_key_len = 64
     else:
         _outbuffer.extend('in DecodeBuffer _buffer[%d]:%d != MAGIC_NUM_START'%(_offset, magic_start))
@@ -114,11 +174,14 @@ def DecodeBuffer(_buffer, _offset, _outbuffer):
     try:
 
 
-        if MAGIC_NO_COMPRESS_START1==_buffer[_offset] or MAGIC_COMPRESS_START2==_buffer[_offset] or MAGIC_SYNC_ZSTD_START==_buffer[_offset] or MAGIC_ASYNC_ZSTD_START==_buffer[_offset]:
+        if MAGIC_NO_COMPRESS_START1==_buffer[_offset] or MAGIC_COMPRESS_START2==_buffer[_offset] or MAGIC_SYNC_ZSTD_START==_buffer[_offset] or MAGIC_ASYNC_ZSTD_START==_buffer[_offset] or MAGIC_ASYNC_ZSTD_DICT_START==_buffer[_offset] or MAGIC_ASYNC_RAW_CRYPT_START==_buffer[_offset]:
             print("use wrong decode script")
         elif MAGIC_ASYNC_NO_CRYPT_ZSTD_START == _buffer[_offset]:
             decompressor = zstd.ZstdDecompressor()
             tmpbuffer = next(decompressor.read_from(ZstdDecompressReader(str(tmpbuffer)), 100000, 1000000))
+        elif MAGIC_ASYNC_NO_CRYPT_ZSTD_DICT_START==_buffer[_offset]:
+            decompressor = zstd.ZstdDecompressor(dict_data=ZSTD_DICT)
+            tmpbuffer = next(decompressor.read_from(ZstdDecompressReader(str(tmpbuffer)), 100000, 1000000))
         elif MAGIC_COMPRESS_START==_buffer[_offset] or MAGIC_COMPRESS_NO_CRYPT_START==_buffer[_offset]:
             decompressor = zlib.decompressobj(-zlib.MAX_WBITS)
             tmpbuffer = decompressor.decompress(str(tmpbuffer))
@@ -141,7 +204,7 @@ def DecodeBuffer(_buffer, _offset, _outbuffer):
         _outbuffer.extend("[F]decode_log_file.py decompress err, " + str(e) + "\n")
         return _offset+headerLen+length+1
 
-    _outbuffer.extend(tmpbuffer)
+    _outbuffer.extend(RenderBinaryRecords(tmpbuffer))
     
     return _offset+headerLen+length+1
 
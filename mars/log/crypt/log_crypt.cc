@@ -27,6 +27,7 @@
 #include <stdlib.h>
 
 #include "log_magic_num.h"
+#include "log_tea.h"
 
 #ifdef WIN32
 #include <algorithm>
@@ -38,16 +39,9 @@
 
 const static int TEA_BLOCK_LEN = 8;
 
-static void __TeaEncrypt (uint32_t* v, uint32_t* k) {
-    uint32_t v0=v[0], v1=v[1], sum=0, i;
-    const static uint32_t delta=0x9e3779b9;
-    uint32_t k0=k[0], k1=k[1], k2=k[2], k3=k[3];
-    for (i=0; i < 16; i++) {
-        sum += delta;
-        v0 += ((v1<<4) + k0) ^ (v1 + sum) ^ ((v1>>5) + k1);
-        v1 += ((v0<<4) + k2) ^ (v0 + sum) ^ ((v0>>5) + k3);
-    }
-    v[0]=v0; v[1]=v1;
+// the staged block of the mmap buffer has the header of a log block as well
+static bool __IsHeaderStart(char _magic) {
+    return LogMagicNum::MagicStartIsValid(_magic) || LogMagicNum::kMagicAsyncRawStart == _magic;
 }
 
 static uint16_t __GetSeq(bool _is_async) {
@@ -168,7 +162,7 @@ uint32_t LogCrypt::GetLogLen(const char*  const _data, size_t _len) {
     if (_len < GetHeaderLen()) return 0;
     
     char start = _data[0];
-    if (!LogMagicNum::MagicStartIsValid(start)) {
+    if (!__IsHeaderStart(start)) {
         return 0;
     }
     
@@ -180,7 +174,11 @@ uint32_t LogCrypt::GetLogLen(const char*  const _data, size_t _len) {
 void LogCrypt::UpdateLogLen(char* _data, uint32_t _add_len) {
     
     uint32_t currentlen = (uint32_t)(GetLogLen(_data, GetHeaderLen()) + _add_len);
-    memcpy(_data + GetHeaderLen() - sizeof(uint32_t) - sizeof(char) * 64, &currentlen, sizeof(currentlen));
+    SetLogLen(_data, currentlen);
+}
+
+void LogCrypt::SetLogLen(char* _data, uint32_t _len) {
+    memcpy(_data + GetHeaderLen() - sizeof(uint32_t) - sizeof(char) * 64, &_len, sizeof(_len));
 }
 
 void LogCrypt::SetHeaderInfo(char* _data, bool _is_async, char _magic_start) {
@@ -204,6 +202,10 @@ void LogCrypt::SetHeaderInfo(char* _data, bool _is_async, char _magic_start) {
     memcpy(_data + sizeof(_magic_start) + sizeof(seq_) + sizeof(hour) * 2 + sizeof(len), client_pubkey_, sizeof(client_pubkey_));
 }
 
+void LogCrypt::SetClientPubKey(char* _data) {
+    memcpy(_data + GetHeaderLen() - sizeof(client_pubkey_), client_pubkey_, sizeof(client_pubkey_));
+}
+
 void LogCrypt::SetTailerInfo(char* _data, char _magic_end) {
     memcpy(_data, &_magic_end, sizeof(_magic_end));
 }
@@ -230,17 +232,8 @@ void LogCrypt::CryptSyncLog(const char* const _log_data,
     //}
 
 #ifndef XLOG_NO_CRYPT
- /*   uint32_t tmp[2] = {0};
-    size_t cnt = _input_len / TEA_BLOCK_LEN;
-    size_t remain_len = _input_len % TEA_BLOCK_LEN;
-    
-    for (size_t i = 0; i < cnt; ++i) {
-        memcpy(tmp, _log_data + i * TEA_BLOCK_LEN, TEA_BLOCK_LEN);
-        __TeaEncrypt(tmp, tea_key_);
-        memcpy((char*)_out_buff.Ptr() + header_len + i * TEA_BLOCK_LEN, tmp, TEA_BLOCK_LEN);
-    }
-
-    memcpy((char*)_out_buff.Ptr() + header_len + _input_len - remain_len, _log_data + _input_len - remain_len, remain_len);*/
+ /*   size_t cnt = _input_len / TEA_BLOCK_LEN;
+    TeaEncryptBlocks(_log_data, (char*)_out_buff.Ptr() + header_len, cnt, tea_key_);*/
 #endif
 
 }
@@ -255,27 +248,44 @@ void LogCrypt::CryptAsyncLog(const char* const _log_data, size_t _input_len, Aut
         return;
     }
 #ifndef XLOG_NO_CRYPT
-    uint32_t tmp[2] = {0};
     size_t cnt = _input_len / TEA_BLOCK_LEN;
 	_remain_nocrypt_len = _input_len % TEA_BLOCK_LEN;
-    
-    for (size_t i = 0; i < cnt; ++i) {
-        memcpy(tmp, _log_data + i * TEA_BLOCK_LEN, TEA_BLOCK_LEN);
-        __TeaEncrypt(tmp, tea_key_);
-        memcpy((char*)_out_buff.Ptr() + i * TEA_BLOCK_LEN, tmp, TEA_BLOCK_LEN);
-    }
+
+    TeaEncryptBlocks(_log_data, _out_buff.Ptr(), cnt, tea_key_);
     
     memcpy((char*)_out_buff.Ptr() + _input_len - _remain_nocrypt_len, _log_data + _input_len - _remain_nocrypt_len, _remain_nocrypt_len);
 #endif
 }
 
+void LogCrypt::CryptStagedLog(char* _body, size_t _old_len, size_t _new_len) {
+    if (!is_crypt_) return;
+#ifndef XLOG_NO_CRYPT
+    size_t begin = _old_len / TEA_BLOCK_LEN * TEA_BLOCK_LEN;
+    size_t cnt = _new_len / TEA_BLOCK_LEN - _old_len / TEA_BLOCK_LEN;
+    TeaEncryptBlocks(_body + begin, _body + begin, cnt, tea_key_);
+#endif
+}
+
+bool LogCrypt::DecryptStagedLog(const char* _header, const char* _body, size_t _len, AutoBuffer& _out_buff) {
+    if (!is_crypt_ || 0 != memcmp(_header + GetHeaderLen() - sizeof(client_pubkey_), client_pubkey_, sizeof(client_pubkey_))) {
+        return false;
+    }
+#ifndef XLOG_NO_CRYPT
+    _out_buff.AllocWrite(_len);
+    size_t cnt = _len / TEA_BLOCK_LEN;
+    TeaDecryptBlocks(_body, _out_buff.Ptr(), cnt, tea_key_);
+    memcpy((char*)_out_buff.Ptr() + cnt * TEA_BLOCK_LEN, _body + cnt * TEA_BLOCK_LEN, _len - cnt * TEA_BLOCK_LEN);
+#endif
+    return true;
+}
+
 bool LogCrypt::Fix(char* _data, size_t _data_len, uint32_t& _raw_log_len) {
     if (_data_len < GetHeaderLen()) {
         return false;
     }
     
     char start = _data[0];
-    if (!LogMagicNum::MagicStartIsValid(start)) {
+    if (!__IsHeaderStart(start)) {
         return false;
     }
     
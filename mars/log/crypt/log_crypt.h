@@ -45,10 +45,12 @@ public:
     
     static uint32_t GetLogLen(const char* const _data, size_t _len);
     static void UpdateLogLen(char* _data, uint32_t _add_len);
+    static void SetLogLen(char* _data, uint32_t _len);
 
 public:
     
     void SetHeaderInfo(char* _data, bool _is_async, char _magic_start);
+    void SetClientPubKey(char* _data);
     void SetTailerInfo(char* _data, char _magic_end);
 
     void CryptSyncLog(const char* const _log_data,
@@ -57,6 +59,10 @@ public:
                       char _magic_start,
                       char _magic_end);
     void CryptAsyncLog(const char* const _log_data, size_t _input_len, AutoBuffer& _out_buff, size_t& _remain_nocrypt_len);
+    // in place, the tea blocks of a staged body that growing it from _old_len to _new_len bytes completed
+    void CryptStagedLog(char* _body, size_t _old_len, size_t _new_len);
+    // false if the staged block of _header was crypted under the key of another process
+    bool DecryptStagedLog(const char* _header, const char* _body, size_t _len, AutoBuffer& _out_buff);
     
     bool Fix(char* _data, size_t _data_len, uint32_t& _raw_log_len);
     bool IsCrypt();
@@ -28,13 +28,25 @@ public:
     static const char kMagicAsyncZstdStart ='\x0C';
     static const char kMagicAsyncNoCryptZstdStart ='\x0D';
 
+    // zstd with a trained dictionary, the dictionary id is in the zstd frame header at the start of the body
+    static const char kMagicAsyncZstdDictStart = '\x0E';
+    static const char kMagicAsyncNoCryptZstdDictStart = '\x0F';
+
+    // raw lines staged in the mmap buffer, packed into one of the async blocks above before they reach a file
+    static const char kMagicAsyncRawStart = '\x10';
+    // the same lines tea crypted under the key in the header, the last partial tea block left plain as LogCrypt
+    // does. Packed like the above by the process that wrote them, a crash leaves them to a file as they are.
+    static const char kMagicAsyncRawCryptStart = '\x11';
+
     static const char kMagicEnd  = '\0';
 
     static bool MagicStartIsValid(char _magic) {
         return kMagicSyncZlibStart == _magic || kMagicSyncNoCryptZlibStart == _magic
                 || kMagicAsyncZlibStart == _magic || kMagicAsyncNoCryptZlibStart == _magic
                 || kMagicSyncZstdStart == _magic || kMagicSyncNoCryptZstdStart == _magic
-                || kMagicAsyncZstdStart == _magic || kMagicAsyncNoCryptZstdStart == _magic;
+                || kMagicAsyncZstdStart == _magic || kMagicAsyncNoCryptZstdStart == _magic
+                || kMagicAsyncZstdDictStart == _magic || kMagicAsyncNoCryptZstdDictStart == _magic
+                || kMagicAsyncRawCryptStart == _magic;
     }
 
 };
@@ -0,0 +1,245 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * log_tea.cc
+ *
+ *  Created on: 2026-10-18
+ */
+
+#include "log_tea.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEA_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+// avx2 is built with a target attribute and only run if the cpu has it
+#if defined(TEA_HAS_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TEA_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TEA_HAS_NEON
+#include <arm_neon.h>
+#endif
+
+static const uint32_t kTeaDelta = 0x9e3779b9;
+static const int kTeaRounds = 16;
+
+// every kernel returns the number of blocks it did, the rest is left to the scalar one
+typedef size_t (*TeaKernelFunc)(const char* _in, char* _out, size_t _count, const uint32_t* _key);
+
+static size_t __EncryptScalar(const char* _in, char* _out, size_t _count, const uint32_t* _key) {
+    uint32_t k0 = _key[0], k1 = _key[1], k2 = _key[2], k3 = _key[3];
+
+    for (size_t i = 0; i < _count; ++i) {
+        uint32_t v[2];
+        memcpy(v, _in + i * kTeaBlockLen, kTeaBlockLen);
+
+        uint32_t v0 = v[0], v1 = v[1], sum = 0;
+        for (int round = 0; round < kTeaRounds; ++round) {
+            sum += kTeaDelta;
+            v0 += ((v1 << 4) + k0) ^ (v1 + sum) ^ ((v1 >> 5) + k1);
+            v1 += ((v0 << 4) + k2) ^ (v0 + sum) ^ ((v0 >> 5) + k3);
+        }
+
+        v[0] = v0;
+        v[1] = v1;
+        memcpy(_out + i * kTeaBlockLen, v, kTeaBlockLen);
+    }
+    return _count;
+}
+
+#ifdef TEA_HAS_SSE2
+// 4 blocks, v0 of all of them in one register and v1 in another
+static size_t __EncryptSSE2(const char* _in, char* _out, size_t _count, const uint32_t* _key) {
+    const __m128i k0 = _mm_set1_epi32((int)_key[0]);
+    const __m128i k1 = _mm_set1_epi32((int)_key[1]);
+    const __m128i k2 = _mm_set1_epi32((int)_key[2]);
+    const __m128i k3 = _mm_set1_epi32((int)_key[3]);
+
+    size_t done = 0;
+    for (; done + 4 <= _count; done += 4) {
+        const char* in = _in + done * kTeaBlockLen;
+        __m128i a = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)in), _MM_SHUFFLE(3, 1, 2, 0));
+        __m128i b = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(in + 16)), _MM_SHUFFLE(3, 1, 2, 0));
+        __m128i v0 = _mm_unpacklo_epi64(a, b);
+        __m128i v1 = _mm_unpackhi_epi64(a, b);
+
+        uint32_t sum = 0;
+        for (int round = 0; round < kTeaRounds; ++round) {
+            sum += kTeaDelta;
+            __m128i s = _mm_set1_epi32((int)sum);
+            v0 = _mm_add_epi32(v0, _mm_xor_si128(_mm_xor_si128(_mm_add_epi32(_mm_slli_epi32(v1, 4), k0), _mm_add_epi32(v1, s)),
+                                                 _mm_add_epi32(_mm_srli_epi32(v1, 5), k1)));
+            v1 = _mm_add_epi32(v1, _mm_xor_si128(_mm_xor_si128(_mm_add_epi32(_mm_slli_epi32(v0, 4), k2), _mm_add_epi32(v0, s)),
+                                                 _mm_add_epi32(_mm_srli_epi32(v0, 5), k3)));
+        }
+
+        char* out = _out + done * kTeaBlockLen;
+        _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi32(v0, v1));
+        _mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi32(v0, v1));
+    }
+    return done;
+}
+#endif
+
+#ifdef TEA_HAS_AVX2
+// 8 blocks; the shuffles work per 128 bits lane, the unpacks below undo exactly what the ones above did
+__attribute__((target("avx2")))
+static size_t __EncryptAVX2(const char* _in, char* _out, size_t _count, const uint32_t* _key) {
+    const __m256i k0 = _mm256_set1_epi32((int)_key[0]);
+    const __m256i k1 = _mm256_set1_epi32((int)_key[1]);
+    const __m256i k2 = _mm256_set1_epi32((int)_key[2]);
+    const __m256i k3 = _mm256_set1_epi32((int)_key[3]);
+
+    size_t done = 0;
+    for (; done + 8 <= _count; done += 8) {
+        const char* in = _in + done * kTeaBlockLen;
+        __m256i a = _mm256_shuffle_epi32(_mm256_loadu_si256((const __m256i*)in), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i b = _mm256_shuffle_epi32(_mm256_loadu_si256((const __m256i*)(in + 32)), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i v0 = _mm256_unpacklo_epi64(a, b);
+        __m256i v1 = _mm256_unpackhi_epi64(a, b);
+
+        uint32_t sum = 0;
+        for (int round = 0; round < kTeaRounds; ++round) {
+            sum += kTeaDelta;
+            __m256i s = _mm256_set1_epi32((int)sum);
+            v0 = _mm256_add_epi32(v0, _mm256_xor_si256(_mm256_xor_si256(_mm256_add_epi32(_mm256_slli_epi32(v1, 4), k0), _mm256_add_epi32(v1, s)),
+                                                       _mm256_add_epi32(_mm256_srli_epi32(v1, 5), k1)));
+            v1 = _mm256_add_epi32(v1, _mm256_xor_si256(_mm256_xor_si256(_mm256_add_epi32(_mm256_slli_epi32(v0, 4), k2), _mm256_add_epi32(v0, s)),
+                                                       _mm256_add_epi32(_mm256_srli_epi32(v0, 5), k3)));
+        }
+
+        char* out = _out + done * kTeaBlockLen;
+        _mm256_storeu_si256((__m256i*)out, _mm256_unpacklo_epi32(v0, v1));
+        _mm256_storeu_si256((__m256i*)(out + 32), _mm256_unpackhi_epi32(v0, v1));
+    }
+    return done;
+}
+#endif
+
+#ifdef TEA_HAS_NEON
+// 4 blocks, byte loads so the buffers need no alignment
+static size_t __EncryptNEON(const char* _in, char* _out, size_t _count, const uint32_t* _key) {
+    const uint32x4_t k0 = vdupq_n_u32(_key[0]);
+    const uint32x4_t k1 = vdupq_n_u32(_key[1]);
+    const uint32x4_t k2 = vdupq_n_u32(_key[2]);
+    const uint32x4_t k3 = vdupq_n_u32(_key[3]);
+
+    size_t done = 0;
+    for (; done + 4 <= _count; done += 4) {
+        const uint8_t* in = (const uint8_t*)_in + done * kTeaBlockLen;
+        uint32x4x2_t v = vuzpq_u32(vreinterpretq_u32_u8(vld1q_u8(in)), vreinterpretq_u32_u8(vld1q_u8(in + 16)));
+        uint32x4_t v0 = v.val[0];
+        uint32x4_t v1 = v.val[1];
+
+        uint32_t sum = 0;
+        for (int round = 0; round < kTeaRounds; ++round) {
+            sum += kTeaDelta;
+            uint32x4_t s = vdupq_n_u32(sum);
+            v0 = vaddq_u32(v0, veorq_u32(veorq_u32(vaddq_u32(vshlq_n_u32(v1, 4), k0), vaddq_u32(v1, s)), vaddq_u32(vshrq_n_u32(v1, 5), k1)));
+            v1 = vaddq_u32(v1, veorq_u32(veorq_u32(vaddq_u32(vshlq_n_u32(v0, 4), k2), vaddq_u32(v0, s)), vaddq_u32(vshrq_n_u32(v0, 5), k3)));
+        }
+
+        uint8_t* out = (uint8_t*)_out + done * kTeaBlockLen;
+        v = vzipq_u32(v0, v1);
+        vst1q_u8(out, vreinterpretq_u8_u32(v.val[0]));
+        vst1q_u8(out + 16, vreinterpretq_u8_u32(v.val[1]));
+    }
+    return done;
+}
+#endif
+
+static TeaKernelFunc __KernelFunc(TTeaKernel _kernel) {
+    switch (_kernel) {
+#ifdef TEA_HAS_SSE2
+    case kTeaSSE2: return &__EncryptSSE2;
+#endif
+#ifdef TEA_HAS_AVX2
+    case kTeaAVX2:
+        __builtin_cpu_init();   // may run before the constructors of libgcc
+        return __builtin_cpu_supports("avx2") ? &__EncryptAVX2 : NULL;
+#endif
+#ifdef TEA_HAS_NEON
+    case kTeaNEON: return &__EncryptNEON;
+#endif
+    case kTeaScalar: return &__EncryptScalar;
+    default: return NULL;
+    }
+}
+
+static TTeaKernel __DetectKernel() {
+    static const TTeaKernel kPreferred[] = {kTeaAVX2, kTeaSSE2, kTeaNEON};
+    for (size_t i = 0; i < sizeof(kPreferred) / sizeof(kPreferred[0]); ++i) {
+        if (NULL != __KernelFunc(kPreferred[i])) return kPreferred[i];
+    }
+    return kTeaScalar;
+}
+
+TTeaKernel TeaBestKernel() {
+    static const TTeaKernel kBest = __DetectKernel();
+    return kBest;
+}
+
+bool TeaKernelSupported(TTeaKernel _kernel) {
+    return NULL != __KernelFunc(_kernel);
+}
+
+const char* TeaKernelName(TTeaKernel _kernel) {
+    switch (_kernel) {
+    case kTeaScalar: return "scalar";
+    case kTeaSSE2: return "sse2";
+    case kTeaAVX2: return "avx2";
+    case kTeaNEON: return "neon";
+    default: return "unknown";
+    }
+}
+
+void TeaEncryptBlocks(const void* _in, void* _out, size_t _count, const uint32_t _key[4], TTeaKernel _kernel) {
+    TeaKernelFunc func = __KernelFunc(_kernel);
+    if (NULL == func) func = &__EncryptScalar;
+
+    size_t done = func((const char*)_in, (char*)_out, _count, _key);
+    __EncryptScalar((const char*)_in + done * kTeaBlockLen, (char*)_out + done * kTeaBlockLen, _count - done, _key);
+}
+
+void TeaEncryptBlocks(const void* _in, void* _out, size_t _count, const uint32_t _key[4]) {
+    static const TeaKernelFunc kBestFunc = __KernelFunc(TeaBestKernel());
+
+    size_t done = kBestFunc((const char*)_in, (char*)_out, _count, _key);
+    __EncryptScalar((const char*)_in + done * kTeaBlockLen, (char*)_out + done * kTeaBlockLen, _count - done, _key);
+}
+
+void TeaDecryptBlocks(const void* _in, void* _out, size_t _count, const uint32_t _key[4]) {
+    uint32_t k0 = _key[0], k1 = _key[1], k2 = _key[2], k3 = _key[3];
+
+    for (size_t i = 0; i < _count; ++i) {
+        uint32_t v[2];
+        memcpy(v, (const char*)_in + i * kTeaBlockLen, kTeaBlockLen);
+
+        uint32_t v0 = v[0], v1 = v[1], sum = kTeaDelta * kTeaRounds;
+        for (int round = 0; round < kTeaRounds; ++round) {
+            v1 -= ((v0 << 4) + k2) ^ (v0 + sum) ^ ((v0 >> 5) + k3);
+            v0 -= ((v1 << 4) + k0) ^ (v1 + sum) ^ ((v1 >> 5) + k1);
+            sum -= kTeaDelta;
+        }
+
+        v[0] = v0;
+        v[1] = v1;
+        memcpy((char*)_out + i * kTeaBlockLen, v, kTeaBlockLen);
+    }
+}
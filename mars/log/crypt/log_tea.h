@@ -0,0 +1,51 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * log_tea.h
+ *
+ *  Created on: 2026-10-18
+ */
+
+#ifndef LOG_TEA_H_
+#define LOG_TEA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 16 rounds TEA over independent 8 bytes blocks (ECB, as the log format has always been).
+ * Blocks do not depend on each other, so the simd kernels run 4 (sse2, neon) or 8 (avx2) of them in
+ * the lanes of one register. Every kernel produces the bytes of the scalar one.
+ */
+enum TTeaKernel {
+    kTeaScalar,
+    kTeaSSE2,
+    kTeaAVX2,
+    kTeaNEON,
+};
+
+static const size_t kTeaBlockLen = 8;
+
+// the fastest kernel of this cpu, picked once
+TTeaKernel TeaBestKernel();
+bool TeaKernelSupported(TTeaKernel _kernel);
+const char* TeaKernelName(TTeaKernel _kernel);
+
+// _count blocks of _in to _out, which may be the same buffer; no alignment needed
+void TeaEncryptBlocks(const void* _in, void* _out, size_t _count, const uint32_t _key[4]);
+void TeaEncryptBlocks(const void* _in, void* _out, size_t _count, const uint32_t _key[4], TTeaKernel _kernel);
+
+// scalar only, the appender decrypts no more than the staged block of a flush
+void TeaDecryptBlocks(const void* _in, void* _out, size_t _count, const uint32_t _key[4]);
+
+#endif /* LOG_TEA_H_ */
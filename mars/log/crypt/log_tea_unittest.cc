@@ -0,0 +1,83 @@
+#include "log_tea.h"
+#include "gtest/gtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+using namespace testing;
+
+static const uint32_t kKey[4] = {0x01234567, 0x89abcdef, 0xfedcba98, 0x76543210};
+static const TTeaKernel kKernels[] = {kTeaScalar, kTeaSSE2, kTeaAVX2, kTeaNEON};
+
+static std::string __RandomBytes(size_t _len) {
+    std::string bytes(_len, '\0');
+    for (size_t i = 0; i < _len; ++i) bytes[i] = (char)(rand() & 0xff);
+    return bytes;
+}
+
+TEST(log_tea, known_answer) {
+    // the block loop log_crypt.cc had before the kernels, for a block of zeros
+    uint32_t v0 = 0, v1 = 0, sum = 0;
+    for (int i = 0; i < 16; ++i) {
+        sum += 0x9e3779b9;
+        v0 += ((v1 << 4) + kKey[0]) ^ (v1 + sum) ^ ((v1 >> 5) + kKey[1]);
+        v1 += ((v0 << 4) + kKey[2]) ^ (v0 + sum) ^ ((v0 >> 5) + kKey[3]);
+    }
+
+    char zeros[kTeaBlockLen] = {0};
+    uint32_t out[2];
+    TeaEncryptBlocks(zeros, out, 1, kKey, kTeaScalar);
+    EXPECT_EQ(v0, out[0]);
+    EXPECT_EQ(v1, out[1]);
+}
+
+TEST(log_tea, kernels_match_scalar) {
+    srand(20261018);
+    EXPECT_TRUE(TeaKernelSupported(kTeaScalar));
+    EXPECT_TRUE(TeaKernelSupported(TeaBestKernel()));
+
+    for (size_t k = 0; k < sizeof(kKernels) / sizeof(kKernels[0]); ++k) {
+        if (!TeaKernelSupported(kKernels[k])) continue;
+
+        // every tail length of the 4 and 8 lanes kernels, at every misalignment
+        for (size_t count = 0; count < 40; ++count) {
+            for (size_t shift = 0; shift < 8; ++shift) {
+                std::string in = __RandomBytes(count * kTeaBlockLen + shift);
+                std::string expect(in.size(), '\0'), out(in.size(), '\0');
+                TeaEncryptBlocks(&in[shift], &expect[shift], count, kKey, kTeaScalar);
+                TeaEncryptBlocks(&in[shift], &out[shift], count, kKey, kKernels[k]);
+                ASSERT_EQ(expect, out) << TeaKernelName(kKernels[k]) << " count:" << count << " shift:" << shift;
+
+                // in place, as CryptAsyncLog may be handed
+                TeaEncryptBlocks(&in[shift], &in[shift], count, kKey, kKernels[k]);
+                EXPECT_EQ(0, memcmp(&in[shift], &expect[shift], count * kTeaBlockLen));
+            }
+        }
+    }
+
+    // the dispatching entry
+    std::string in = __RandomBytes(1001 * kTeaBlockLen);
+    std::string expect(in.size(), '\0'), out(in.size(), '\0');
+    TeaEncryptBlocks(in.data(), &expect[0], 1001, kKey, kTeaScalar);
+    TeaEncryptBlocks(in.data(), &out[0], 1001, kKey);
+    EXPECT_EQ(expect, out);
+}
+
+TEST(log_tea, decrypt_reverses_encrypt) {
+    srand(20261019);
+    for (size_t shift = 0; shift < 8; ++shift) {
+        std::string in = __RandomBytes(33 * kTeaBlockLen + shift);
+        std::string crypted(in.size(), '\0'), out(in.size(), '\0');
+        TeaEncryptBlocks(&in[shift], &crypted[shift], 33, kKey);
+        EXPECT_NE(0, memcmp(&in[shift], &crypted[shift], 33 * kTeaBlockLen));
+        TeaDecryptBlocks(&crypted[shift], &out[shift], 33, kKey);
+        EXPECT_EQ(0, memcmp(&in[shift], &out[shift], 33 * kTeaBlockLen)) << "shift:" << shift;
+
+        // in place
+        TeaDecryptBlocks(&crypted[shift], &crypted[shift], 33, kKey);
+        EXPECT_EQ(0, memcmp(&in[shift], &crypted[shift], 33 * kTeaBlockLen));
+    }
+}
+
+EXPORT_GTEST_SYMBOLS(log_export_log_tea_unittest)
@@ -37,10 +37,14 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <sys/mount.h>
+#include <sys/uio.h>
 #endif
 
 #include <ctype.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
 
 #include <unistd.h>
 #include <zlib.h>
@@ -71,9 +75,12 @@
 #include "mars/comm/objc/data_protect_attr.h"
 #endif
 
+#include "log/crypt/log_crypt.h"
 #include "log_zlib_buffer.h"
 #include "log_base_buffer.h"
 #include "log_zstd_buffer.h"
+#include "log_binary_record.h"
+#include "log_ring_buffer.h"
 #include "xlogger_appender.h"
 
 #define LOG_EXT "xlog"
@@ -83,12 +90,49 @@ extern void ConsoleLog(const XLoggerInfo* _info, const char* _log);
 
 static Tss sg_tss_dumpfile(&free);
 
-static const unsigned int kBufferBlockLength = 150 * 1024;
+static const size_t kMinSegmentLength = 32 * 1024;        // two lines of 16k at least
+static const int kMaxSegments = 64;
+static const tickcountdiff_t kSegmentWaitTime = 50;       // ms a writer waits for a free segment before it drops lines
+static const unsigned int kRingBufferLength = 64 * 1024;     // per logging thread, XLogConfig::async_ring_
 static const long kMinLogAliveTime = 24 * 60 * 60;    // 1 days in second
+static const uint64_t kFileStateInterval = 10 * 1000;   // ms the file system results of __Log2File are taken as they are
 
 static Mutex sg_mutex_dir_attr;
 
 namespace {
+// the head of the mmap cache, so the next Open finds the segments a crash left and the order they were filled in
+struct MmapHead {
+    uint32_t magic;
+    uint32_t segments;
+    uint32_t segment_len;
+    uint32_t current;
+};
+
+static const uint32_t kMmapMagic = 0x33534d58;  // "XMS3", the caches of older versions start with a block
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+static bool __IsSameDay(time_t _time1, time_t _time2) {
+    tm tm1 = *localtime(&_time1);
+    tm tm2 = *localtime(&_time2);
+    return tm1.tm_year == tm2.tm_year && tm1.tm_mon == tm2.tm_mon && tm1.tm_mday == tm2.tm_mday;
+}
+
+// O_APPEND, blocks go to the end whatever else writes to the file
+static int __OpenAppend(const char* _path, uint64_t& _size) {
+    int fd = open(_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | O_BINARY, 0666);
+    if (-1 == fd) return -1;
+
+    struct stat st;
+    _size = (0 == fstat(fd, &st)) ? (uint64_t)st.st_size : 0;
+    return fd;
+}
+
 class ScopeErrno {
   public:
     ScopeErrno() {m_errno = errno;}
@@ -126,8 +170,28 @@ void XloggerAppender::Release(XloggerAppender*& _appender) {
     _appender = nullptr;
 }
 
+namespace {
+// what tss_ring_ keeps for a logging thread. Close lets go of the rings, but not of the Tss entries of the
+// threads, so a ring only counts for the Open it was made for.
+struct ThreadRing {
+    LogRingBuffer* ring;
+    unsigned int generation;
+};
+}
+
+static void __ReleaseThreadRing(void* _thread_ring) {
+    ThreadRing* thread_ring = (ThreadRing*)_thread_ring;
+    thread_ring->ring->MarkProducerExited();
+    thread_ring->ring->Release();
+    delete thread_ring;
+}
+
 XloggerAppender::XloggerAppender(const XLogConfig& _config)
-                        : thread_async_(boost::bind(&XloggerAppender::__AsyncLogThread, this)) {
+                        : overflow_count_(0)
+                        , thread_async_(boost::bind(&XloggerAppender::__AsyncLogThread, this))
+                        , flush_requested_(false)
+                        , tss_ring_(&__ReleaseThreadRing) {
+    LogBlockIndex::ResetMeta(block_meta_);
     Open(_config);
 }
 
@@ -173,6 +237,8 @@ void XloggerAppender::Write(const XLoggerInfo* _info, const char* _log) {
 
         if (kAppenderSync == config_.mode_)
             __WriteSync(_info, _log);
+        else if (config_.async_ring_)
+            __WriteAsyncRing(_info, _log);
         else
             __WriteAsync(_info, _log);
     }
@@ -189,6 +255,7 @@ void XloggerAppender::SetMode(TAppenderMode _mode) {
 }
 
 void XloggerAppender::Flush() {
+    flush_requested_ = true;
     cond_buffer_async_.notifyAll();
 }
 
@@ -197,16 +264,21 @@ void XloggerAppender::FlushSync() {
         return;
     }
 
+    ScopedLock flush_lock(mutex_flush_);
     ScopedLock lock_buffer(mutex_buffer_async_);
     
     if (nullptr == log_buff_) return;
 
-    AutoBuffer tmp;
-    log_buff_->Flush(tmp);
+    // the segment writers are on goes as well, once the rings are in and there is a free one to go on with
+    while (true) {
+        bool switched = (!config_.async_ring_ || __DrainRings()) && __SwitchSegment();
+        lock_buffer.unlock();
 
-    lock_buffer.unlock();
+        __FlushSegments(false);
+        if (switched) break;
 
-    if (tmp.Ptr())  __Log2File(tmp.Ptr(), tmp.Length(), false);
+        lock_buffer.lock();
+    }
 }
 
 void XloggerAppender::Close() {
@@ -225,19 +297,21 @@ void XloggerAppender::Close() {
     if (thread_async_.isruning())
         thread_async_.join();
     
+    ScopedLock flush_lock(mutex_flush_);
     ScopedLock buffer_lock(mutex_buffer_async_);
     if (mmap_file_.is_open()) {
-        if (!mmap_file_.operator !()) memset(mmap_file_.data(), 0, kBufferBlockLength);
+        if (!mmap_file_.operator !()) memset(mmap_file_.data(), 0, mmap_file_.size());
 
         CloseMmapFile(mmap_file_);
     } else {
-        if (nullptr != log_buff_) {
-            delete[] (char*)((log_buff_->GetData()).Ptr());
-        }
+        delete[] buffer_data_;
     }
 
     delete log_buff_;
     log_buff_ = nullptr;
+    buffer_data_ = nullptr;
+    segments_.clear();
+    __ReleaseRings();
     buffer_lock.unlock();
 
     ScopedLock lock(mutex_log_file_);
@@ -271,31 +345,30 @@ void XloggerAppender::Open(const XLogConfig& _config) {
     char mmap_file_path[512] = {0};
     snprintf(mmap_file_path, sizeof(mmap_file_path), "%s/%s.mmap3",
              config_.cachedir_.empty()?config_.logdir_.c_str():config_.cachedir_.c_str(), config_.nameprefix_.c_str());
-    bool use_mmap = false;
-    if (OpenMmapFile(mmap_file_path, kBufferBlockLength, mmap_file_))  {
-	    if (_config.compress_mode_ == kZstd){
-		    log_buff_ = new LogZstdBuffer(mmap_file_.data(), kBufferBlockLength, true, _config.pub_key_.c_str(), _config.compress_level_);
-	    }else {
-		    log_buff_ = new LogZlibBuffer(mmap_file_.data(), kBufferBlockLength, true, _config.pub_key_.c_str());
-	    }
-        use_mmap = true;
+    int segments = std::min(std::max(config_.buffer_segments_, 2), kMaxSegments);
+    segment_len_ = std::max(config_.buffer_size_ / segments, kMinSegmentLength);
+    buffer_len_ = sizeof(MmapHead) + segments * segment_len_;
+
+    AutoBuffer buffer;
+    bool use_mmap = __OpenMmap(mmap_file_path, buffer_len_, buffer);
+    if (use_mmap) {
+        buffer_data_ = mmap_file_.data();
     } else {
-        char* buffer = new char[kBufferBlockLength];
-	    if (_config.compress_mode_ == kZstd){
-		    log_buff_ = new LogZstdBuffer(buffer, kBufferBlockLength, true, _config.pub_key_.c_str(), _config.compress_level_);
-	    } else {
-		    log_buff_ = new LogZlibBuffer(buffer, kBufferBlockLength, true, _config.pub_key_.c_str());
-	    }
-        use_mmap = false;
+        buffer_data_ = new char[buffer_len_];
+        memset(buffer_data_, 0, buffer_len_);
     }
 
-    if (nullptr == log_buff_->GetData().Ptr()) {
-        if (use_mmap && mmap_file_.is_open())  CloseMmapFile(mmap_file_);
-        return;
-    }
+    MmapHead head = {kMmapMagic, (uint32_t)segments, (uint32_t)segment_len_, 0};
+    memcpy(buffer_data_, &head, sizeof(head));
 
-    AutoBuffer buffer;
-    log_buff_->Flush(buffer);
+    segments_.resize(segments);
+    for (int i = 0; i < segments; ++i) {
+        segments_[i].data = buffer_data_ + sizeof(MmapHead) + i * segment_len_;
+        segments_[i].full = false;
+        LogBlockIndex::ResetMeta(segments_[i].meta);
+    }
+    current_segment_ = 0;
+    log_buff_ = __NewBuffer(segments_[0].data, segment_len_);
 
     ScopedLock lock(mutex_log_file_);
     log_close_ = false;
@@ -327,7 +400,8 @@ void XloggerAppender::Open(const XLogConfig& _config) {
     Write(nullptr, "MARS_BUILD_TIME: " MARS_BUILD_TIME);
     Write(nullptr, "MARS_BUILD_JOB: " MARS_TAG);
 
-    snprintf(logmsg, sizeof(logmsg), "log appender mode:%d, use mmap:%d", (int)config_.mode_, use_mmap);
+    snprintf(logmsg, sizeof(logmsg), "log appender mode:%d, use mmap:%d, segments:%d*%d", (int)config_.mode_, use_mmap,
+             (int)segments_.size(), (int)segment_len_);
     Write(nullptr, logmsg);
     
     if (!config_.cachedir_.empty()) {
@@ -477,7 +551,7 @@ void XloggerAppender::__DelTimeoutFile(const std::string& _log_path) {
             
             if (now_time > file_modify_time && now_time - file_modify_time > max_alive_time_) {
                 if(boost::filesystem::is_regular_file(iter->status())
-                && iter->path().extension() == (std::string(".") + LOG_EXT)) {
+                && (iter->path().extension() == (std::string(".") + LOG_EXT) || iter->path().extension() == ".idx")) {
                     boost::filesystem::remove(iter->path());
                 } 
                 if (boost::filesystem::is_directory(iter->status())) {
@@ -564,6 +638,8 @@ void XloggerAppender::__MoveOldFiles(const std::string& _src_path, const std::st
     }
     
     ScopedLock lock_file(mutex_log_file_);
+    // the open file may be one of those appended and removed
+    __CloseLogFile();
     time_t now_time = time(nullptr);
     
     boost::filesystem::directory_iterator end_iter;
@@ -585,6 +661,7 @@ void XloggerAppender::__MoveOldFiles(const std::string& _src_path, const std::st
         }
         
         boost::filesystem::remove(iter->path());
+        boost::filesystem::remove(LogBlockIndex::IndexPath(iter->path().string()));
     }
 }
 
@@ -616,34 +693,80 @@ void XloggerAppender::__WriteTips2Console(const char* _tips_format, ...) {
     ConsoleLog(&info, tips_info);
 }
 
-bool XloggerAppender::__WriteFile(const void* _data, size_t _len, FILE* _file) {
-    if (nullptr == _file) {
+// the blocks go in with one writev, a write cut short by a full disk is taken back so no block is left half in the file.
+bool XloggerAppender::__WriteFile(const LogBlock* _blocks, size_t _count) {
+    if (-1 == logfile_fd_) {
         assert(false);
         return false;
     }
 
-    long before_len = ftell(_file);
-    if (before_len < 0) return false;
+    size_t len = 0;
+    size_t written = 0;
+#ifdef _WIN32
+    for (size_t i = 0; i < _count; ++i) {
+        len += _blocks[i].len;
+        int ret = write(logfile_fd_, _blocks[i].data, (unsigned int)_blocks[i].len);
+        if (0 < ret)  written += ret;
+        if (ret != (int)_blocks[i].len) break;
+    }
+#else
+    std::vector<struct iovec> iov(_count);
+    for (size_t i = 0; i < _count; ++i) {
+        iov[i].iov_base = const_cast<void*>(_blocks[i].data);
+        iov[i].iov_len = _blocks[i].len;
+        len += _blocks[i].len;
+    }
+
+    for (size_t i = 0; i < _count;) {
+        size_t count = std::min(_count - i, (size_t)IOV_MAX);
+        size_t chunk_len = 0;
+        for (size_t j = i; j < i + count; ++j)  chunk_len += iov[j].iov_len;
 
-    if (1 != fwrite(_data, _len, 1, _file)) {
-        int err = ferror(_file);
+        ssize_t ret = -1;
+        do {
+            ret = writev(logfile_fd_, &iov[i], (int)count);
+        } while (-1 == ret && EINTR == errno);
 
-        __WriteTips2Console("write file error:%d", err);
+        if (0 < ret)  written += ret;
+        if (ret != (ssize_t)chunk_len) break;
+        i += count;
+    }
+#endif
 
-        ftruncate(fileno(_file), before_len);
-        fseek(_file, 0, SEEK_END);
+    if (written == len) {
+        logfile_size_ += len;
+        return true;
+    }
 
-        char err_log[256] = {0};
-        snprintf(err_log, sizeof(err_log), "\nwrite file error:%d\n", err);
+    int err = errno;
+    __WriteTips2Console("write file error:%d", err);
 
-        AutoBuffer tmp_buff;
-        log_buff_->Write(err_log, strnlen(err_log, sizeof(err_log)), tmp_buff);
+    ftruncate(logfile_fd_, (off_t)logfile_size_);
 
-        fwrite(tmp_buff.Ptr(), tmp_buff.Length(), 1, _file);
+    char err_log[256] = {0};
+    snprintf(err_log, sizeof(err_log), "\nwrite file error:%d\n", err);
 
-        return false;
-    }
+    AutoBuffer tmp_buff;
+    log_buff_->Write(err_log, strnlen(err_log, sizeof(err_log)), tmp_buff);
+
+    if ((int)tmp_buff.Length() == (int)write(logfile_fd_, tmp_buff.Ptr(), (unsigned int)tmp_buff.Length()))  logfile_size_ += tmp_buff.Length();
+
+    return false;
+}
 
+// __WriteFile plus the index entries of the blocks when config_.block_index_ is on.
+bool XloggerAppender::__WriteBlocks(const LogBlock* _blocks, size_t _count) {
+    uint64_t offset = logfile_size_;
+    if (!__WriteFile(_blocks, _count)) return false;
+    if (!config_.block_index_) return true;
+
+    if (!block_index_.IsOpen() || block_index_.LogPath() != logfile_path_)  block_index_.Open(logfile_path_);
+
+    // nothing is buffered on the way to the file, whatever the index does not know yet is read back from there
+    for (size_t i = 0; i < _count; ++i) {
+        block_index_.Append(offset, (uint32_t)_blocks[i].len, _blocks[i].meta);
+        offset += _blocks[i].len;
+    }
     return true;
 }
 
@@ -652,24 +775,17 @@ bool XloggerAppender::__OpenLogFile(const std::string& _log_dir) {
 
     struct timeval tv;
     gettimeofday(&tv, nullptr);
+    uint64_t now_tick = gettickcount();
 
-    if (nullptr != logfile_) {
-        time_t sec = tv.tv_sec;
-        tm tcur = *localtime((const time_t*)&sec);
-        tm filetm = *localtime(&openfiletime_);
-
-        if (filetm.tm_year == tcur.tm_year 
-            && filetm.tm_mon == tcur.tm_mon
-            && filetm.tm_mday == tcur.tm_mday) {
+    if (-1 != logfile_fd_) {
+        if (__IsSameDay(openfiletime_, tv.tv_sec) && (0 == max_file_size_ || logfile_size_ <= max_file_size_)
+                && !__LogFileChanged(now_tick)) {
             return true;
         }
 
-        fclose(logfile_);
-        logfile_ = nullptr;
+        __CloseLogFile();
     }
 
-
-    uint64_t now_tick = gettickcount();
     time_t now_time = tv.tv_sec;
 
     openfiletime_ = tv.tv_sec;
@@ -677,22 +793,26 @@ bool XloggerAppender::__OpenLogFile(const std::string& _log_dir) {
     char logfilepath[1024] = {0};
     __MakeLogFileName(tv, _log_dir, config_.nameprefix_.c_str(), LOG_EXT, logfilepath , 1024);
 
+    logfile_check_tick_ = now_tick;
+
     if (now_time < last_time_) {
-        logfile_ = fopen(last_file_path_, "ab");
+        logfile_fd_ = __OpenAppend(last_file_path_, logfile_size_);
+        logfile_path_ = last_file_path_;
 
-        if (nullptr == logfile_) {
+        if (-1 == logfile_fd_) {
             __WriteTips2Console("open file error:%d %s, path:%s", errno, strerror(errno), last_file_path_);
         }
 
 #ifdef __APPLE__
-        assert(logfile_);
+        assert(-1 != logfile_fd_);
 #endif
-        return nullptr != logfile_;
+        return -1 != logfile_fd_;
     }
 
-    logfile_ = fopen(logfilepath, "ab");
+    logfile_fd_ = __OpenAppend(logfilepath, logfile_size_);
+    logfile_path_ = logfilepath;
 
-    if (nullptr == logfile_) {
+    if (-1 == logfile_fd_) {
         __WriteTips2Console("open file error:%d %s, path:%s", errno, strerror(errno), logfilepath);
     }
 
@@ -712,7 +832,11 @@ bool XloggerAppender::__OpenLogFile(const std::string& _log_dir) {
 
         AutoBuffer tmp_buff;
         log_buff_->Write(log, strnlen(log, sizeof(log)), tmp_buff);
-        __WriteFile(tmp_buff.Ptr(), tmp_buff.Length(), logfile_);
+        LogIndexEntry meta;
+        LogBlockIndex::ResetMeta(meta);
+        LogBlockIndex::AddLine(meta, LogBlockIndex::LineAttr(nullptr));
+        LogBlock block = {tmp_buff.Ptr(), tmp_buff.Length(), &meta};
+        if (-1 != logfile_fd_)  __WriteBlocks(&block, 1);
     }
 
     memcpy(last_file_path_, logfilepath, sizeof(last_file_path_));
@@ -720,17 +844,170 @@ bool XloggerAppender::__OpenLogFile(const std::string& _log_dir) {
     last_time_ = now_time;
 
 #ifdef __APPLE__
-    assert(logfile_);
+    assert(-1 != logfile_fd_);
 #endif
-    return nullptr != logfile_;
+    return -1 != logfile_fd_;
+}
+
+// an upload or a clean up of the log dir may move or remove the file under the open descriptor
+bool XloggerAppender::__LogFileChanged(uint64_t _now_tick) {
+    if (_now_tick - logfile_check_tick_ < kFileStateInterval) return false;
+    logfile_check_tick_ = _now_tick;
+
+    struct stat opened, named;
+    if (0 != fstat(logfile_fd_, &opened) || 0 != stat(logfile_path_.c_str(), &named)) return true;
+    return opened.st_dev != named.st_dev || opened.st_ino != named.st_ino;
 }
 
 void XloggerAppender::__CloseLogFile() {
-    if (nullptr == logfile_) return;
+    // the next file may be of another day or index
+    file_state_.tick = 0;
+    if (-1 == logfile_fd_) return;
 
     openfiletime_ = 0;
-    fclose(logfile_);
-    logfile_ = nullptr;
+    close(logfile_fd_);
+    logfile_fd_ = -1;
+    block_index_.Close();
+}
+
+// must be called with mutex_buffer_async_ held, when the lines of log_buff_ leave for a segment of their own.
+LogIndexEntry XloggerAppender::__TakeBlockMeta() {
+    LogIndexEntry meta = block_meta_;
+    LogBlockIndex::ResetMeta(block_meta_);
+    return meta;
+}
+
+LogBaseBuffer* XloggerAppender::__NewBuffer(void* _pbuffer, size_t _len) {
+    if (config_.compress_mode_ == kZstd || config_.compress_mode_ == kZstdDict) {
+        return new LogZstdBuffer(_pbuffer, _len, true, config_.pub_key_.c_str(), config_.compress_level_,
+                                 kZstdDict == config_.compress_mode_ ? config_.zstd_dict_.data() : nullptr, config_.zstd_dict_.size());
+    }
+    return new LogZlibBuffer(_pbuffer, _len, true, config_.pub_key_.c_str());
+}
+
+// maps the cache file and packs what the last process left in it into _recovered, the segments in the
+// order they were filled. A file of another size, or of a version before the segments, is created anew.
+bool XloggerAppender::__OpenMmap(const char* _path, size_t _len, AutoBuffer& _recovered) {
+    if (!OpenMmapFile(_path, (unsigned int)_len, mmap_file_)) return false;
+
+    char* data = mmap_file_.data();
+    size_t size = mmap_file_.size();
+    MmapHead head;
+    memset(&head, 0, sizeof(head));
+    if (size >= sizeof(head)) memcpy(&head, data, sizeof(head));
+
+    std::vector<std::pair<char*, size_t> > staged;
+    if (kMmapMagic == head.magic && 0 < head.segments && head.current < head.segments
+            && size == sizeof(head) + (size_t)head.segments * head.segment_len) {
+        for (uint32_t i = 1; i <= head.segments; ++i) {
+            uint32_t index = (head.current + i) % head.segments;
+            staged.push_back(std::make_pair(data + sizeof(head) + (size_t)index * head.segment_len, (size_t)head.segment_len));
+        }
+    } else {
+        staged.push_back(std::make_pair(data, size));
+    }
+
+    for (size_t i = 0; i < staged.size(); ++i) {
+        LogBaseBuffer* buffer = __NewBuffer(staged[i].first, staged[i].second);
+        buffer->Flush(_recovered);
+        delete buffer;
+    }
+
+    if (size == _len) return true;
+
+    CloseMmapFile(mmap_file_);
+    boost::filesystem::remove(_path);
+    return OpenMmapFile(_path, (unsigned int)_len, mmap_file_);
+}
+
+// must be called with mutex_buffer_async_ held. Goes on with the next segment if the line does not fit,
+// the line is dropped and counted if none gets free in time.
+bool XloggerAppender::__WriteBuffer(ScopedLock& _lock, const void* _data, size_t _len) {
+    tickcount_t begin(true);
+    while (!log_buff_->Write(_data, _len)) {
+        if (0 == log_buff_->GetData().Length()) return false;
+        if (__SwitchSegment()) continue;
+
+        if (!__WaitSegment(_lock, begin)) {
+            ++dropped_lines_;
+            ++overflow_count_;
+            return false;
+        }
+    }
+    return true;
+}
+
+// must be called with mutex_buffer_async_ held. A burst that fills all segments waits a little for the async
+// thread, once a writer waited in vain lines are dropped at once until a segment gets free again.
+bool XloggerAppender::__WaitSegment(ScopedLock& _lock, const tickcount_t& _begin) {
+    if (0 < dropped_lines_) return false;
+
+    tickcountdiff_t left = kSegmentWaitTime - _begin.gettickspan();
+    if (left <= 0) return false;
+
+    cond_segment_free_.wait(_lock, (long)left);
+    // Close may have run meanwhile
+    return nullptr != log_buff_;
+}
+
+// must be called with mutex_buffer_async_ held. Leaves the current segment to the async thread and
+// moves the writers to the next one, false if that one still waits for the file.
+bool XloggerAppender::__SwitchSegment() {
+    if (0 == log_buff_->GetData().Length()) return true;
+
+    size_t next = (current_segment_ + 1) % segments_.size();
+    if (segments_[next].full) return false;
+
+    segments_[current_segment_].full = true;
+    segments_[current_segment_].meta = __TakeBlockMeta();
+    current_segment_ = next;
+    log_buff_->Attach(segments_[next].data, segment_len_);
+    ((MmapHead*)buffer_data_)->current = (uint32_t)next;
+
+    if (0 < dropped_lines_) {
+        char tips[128] = {0};
+        int len = snprintf(tips, sizeof(tips), "[F][ log buffer overflow, %" PRIu64 " lines dropped\n", dropped_lines_);
+        if (log_buff_->Write(tips, len) && config_.block_index_)  LogBlockIndex::AddLine(block_meta_, LogBlockIndex::LineAttr(nullptr));
+        dropped_lines_ = 0;
+    }
+
+    cond_buffer_async_.notifyAll(true);
+    return true;
+}
+
+// must be called with mutex_flush_ held. Writes the full segments to file, oldest first and in one go, and
+// only then frees them, so a crash before the write leaves them to the next Open.
+void XloggerAppender::__FlushSegments(bool _move_file) {
+    ScopedLock lock_buffer(mutex_buffer_async_);
+
+    while (nullptr != log_buff_) {
+        std::vector<BufferSegment*> full;
+        for (size_t i = 1; i <= segments_.size(); ++i) {
+            BufferSegment& segment = segments_[(current_segment_ + i) % segments_.size()];
+            if (segment.full) full.push_back(&segment);
+        }
+        if (full.empty()) break;
+
+        std::vector<LogIndexEntry> metas(full.size());
+        for (size_t i = 0; i < full.size(); ++i)  metas[i] = full[i]->meta;
+        lock_buffer.unlock();
+
+        std::vector<AutoBuffer> packed(full.size());
+        std::vector<LogBlock> blocks;
+        for (size_t i = 0; i < full.size(); ++i) {
+            log_buff_->Pack(full[i]->data, segment_len_, packed[i]);
+            if (nullptr == packed[i].Ptr()) continue;
+
+            LogBlock block = {packed[i].Ptr(), packed[i].Length(), &metas[i]};
+            blocks.push_back(block);
+        }
+        if (!blocks.empty())  __Log2File(&blocks[0], blocks.size(), _move_file);
+        for (size_t i = 0; i < full.size(); ++i)  memset(full[i]->data, 0, segment_len_);
+
+        lock_buffer.lock();
+        for (size_t i = 0; i < full.size(); ++i)  full[i]->full = false;
+        cond_segment_free_.notifyAll(lock_buffer);
+    }
 }
 
 bool XloggerAppender::__CacheLogs() {
@@ -755,8 +1032,34 @@ bool XloggerAppender::__CacheLogs() {
     return true;
 }
 
-void XloggerAppender::__Log2File(const void* _data, size_t _len, bool _move_file) {
-    if (nullptr == _data || 0 == _len || config_.logdir_.empty()) {
+// must be called with mutex_log_file_ held.
+void XloggerAppender::__UpdateFileState(const timeval& _tv) {
+    uint64_t now_tick = gettickcount();
+    if (0 != file_state_.tick && now_tick - file_state_.tick < kFileStateInterval && __IsSameDay(file_state_.time, _tv.tv_sec)) {
+        return;
+    }
+
+    char logcachefilepath[1024] = {0};
+    __MakeLogFileName(_tv, config_.cachedir_, config_.nameprefix_.c_str(), LOG_EXT, logcachefilepath , 1024);
+
+    file_state_.tick = now_tick;
+    file_state_.time = _tv.tv_sec;
+    file_state_.cache_logs = __CacheLogs();
+    file_state_.cache_exists = boost::filesystem::exists(logcachefilepath);
+}
+
+void XloggerAppender::__Log2File(const void* _data, size_t _len, bool _move_file, const LogIndexEntry* _meta) {
+    if (nullptr == _data || 0 == _len) {
+        return;
+    }
+
+    LogBlock block = {_data, _len, _meta};
+    __Log2File(&block, 1, _move_file);
+}
+
+// the file stays open from one call to the next, until the day or max_file_size_ asks for another one.
+void XloggerAppender::__Log2File(const LogBlock* _blocks, size_t _count, bool _move_file) {
+    if (0 == _count || config_.logdir_.empty()) {
         return;
     }
 
@@ -764,38 +1067,32 @@ void XloggerAppender::__Log2File(const void* _data, size_t _len, bool _move_file
 
     if (config_.cachedir_.empty()) {
         if (__OpenLogFile(config_.logdir_)) {
-            __WriteFile(_data, _len, logfile_);
-            if (kAppenderAsync == config_.mode_) {
-                __CloseLogFile();
-            }
+            __WriteBlocks(_blocks, _count);
         }
         return;
     }
 
     struct timeval tv;
     gettimeofday(&tv, nullptr);
-    char logcachefilepath[1024] = {0};
+    __UpdateFileState(tv);
 
-    __MakeLogFileName(tv, config_.cachedir_, config_.nameprefix_.c_str(), LOG_EXT, logcachefilepath , 1024);
-    
-    bool cache_logs = __CacheLogs();
-    if ((cache_logs || boost::filesystem::exists(logcachefilepath)) && __OpenLogFile(config_.cachedir_)) {
-        __WriteFile(_data, _len, logfile_);
-        if (kAppenderAsync == config_.mode_) {
-            __CloseLogFile();
-        }
+    if ((file_state_.cache_logs || file_state_.cache_exists) && __OpenLogFile(config_.cachedir_)) {
+        __WriteBlocks(_blocks, _count);
         
-        if (cache_logs || !_move_file) {
+        if (file_state_.cache_logs || !_move_file) {
             return;
         }
 
+        // the cache file is appended to the log file and removed, nothing may stay open on either
+        __CloseLogFile();
+
+        char logcachefilepath[1024] = {0};
         char logfilepath[1024] = {0};
+        __MakeLogFileName(tv, config_.cachedir_, config_.nameprefix_.c_str(), LOG_EXT, logcachefilepath , 1024);
         __MakeLogFileName(tv, config_.logdir_, config_.nameprefix_.c_str(), LOG_EXT, logfilepath , 1024);
         if (__AppendFile(logcachefilepath, logfilepath)) {
-            if (kAppenderSync == config_.mode_) {
-                __CloseLogFile();
-            }
             boost::filesystem::remove(logcachefilepath);
+            boost::filesystem::remove(LogBlockIndex::IndexPath(logcachefilepath));
         }
         return;
     }
@@ -803,22 +1100,16 @@ void XloggerAppender::__Log2File(const void* _data, size_t _len, bool _move_file
     bool write_success = false;
     bool open_success = __OpenLogFile(config_.logdir_);
     if (open_success) {
-        write_success = __WriteFile(_data, _len, logfile_);
-        if (kAppenderAsync == config_.mode_) {
-            __CloseLogFile();
-        }
+        write_success = __WriteBlocks(_blocks, _count);
     }
 
     if (!write_success) {
-        if (open_success && kAppenderSync == config_.mode_) {
+        if (open_success) {
             __CloseLogFile();
         }
 
         if (__OpenLogFile(config_.cachedir_)) {
-            __WriteFile(_data, _len, logfile_);
-            if (kAppenderAsync == config_.mode_) {
-                __CloseLogFile();
-            }
+            __WriteBlocks(_blocks, _count);
         }
     }
 }
@@ -836,63 +1127,197 @@ void XloggerAppender::WriteTips2File(const char* _tips_format, ...) {
 
     AutoBuffer tmp_buff;
     log_buff_->Write(tips_info, strnlen(tips_info, sizeof(tips_info)), tmp_buff);
-    
-    __Log2File(tmp_buff.Ptr(), tmp_buff.Length(), false);
+
+    LogIndexEntry meta;
+    LogBlockIndex::ResetMeta(meta);
+    LogBlockIndex::AddLine(meta, LogBlockIndex::LineAttr(nullptr));
+    __Log2File(tmp_buff.Ptr(), tmp_buff.Length(), false, &meta);
 }
 
 
 void XloggerAppender::__AsyncLogThread() {
+    bool timeout = false;
+    bool flush_pending = false;
     while (true) {
 
         ScopedLock lock_buffer(mutex_buffer_async_);
 
         if (nullptr == log_buff_) break;
 
-        AutoBuffer tmp;
-        log_buff_->Flush(tmp);
+        bool drained = !config_.async_ring_ || __DrainRings();
+
+        // writers hand over the segments they fill, the one they are on goes as well on a timeout, a flush or a close
+        flush_pending = flush_pending || timeout || log_close_ || flush_requested_.exchange(false)
+                            || kAppenderSync == config_.mode_;
+        bool switched = !flush_pending || __SwitchSegment();
+        if (switched) flush_pending = false;
         lock_buffer.unlock();
 
-        if (nullptr != tmp.Ptr())  __Log2File(tmp.Ptr(), tmp.Length(), true);
+        ScopedLock flush_lock(mutex_flush_);
+        __FlushSegments(true);
+        flush_lock.unlock();
+
+        if (!drained || !switched) continue;
 
         if (log_close_) break;
 
-        cond_buffer_async_.wait(15 * 60 * 1000);
+        timeout = (ETIMEDOUT == cond_buffer_async_.wait(15 * 60 * 1000));
     }
 }
 
 
+void XloggerAppender::__FormatLine(const XLoggerInfo* _info, const char* _log, PtrBuffer& _line) {
+    if (config_.binary_record_)
+        LogBinaryRecord::Format(_info, _log, _line);
+    else
+        log_formater(_info, _log, _line);
+}
+
 void XloggerAppender::__WriteSync(const XLoggerInfo* _info, const char* _log) {
     char temp[16 * 1024] = {0};     // tell perry,ray if you want modify size.
     PtrBuffer log(temp, 0, sizeof(temp));
-    log_formater(_info, _log, log);
+    __FormatLine(_info, _log, log);
 
     AutoBuffer tmp_buff;
     if (!log_buff_->Write(log.Ptr(), log.Length(), tmp_buff))   return;
 
-    __Log2File(tmp_buff.Ptr(), tmp_buff.Length(), false);
+    LogIndexEntry meta;
+    LogBlockIndex::ResetMeta(meta);
+    if (config_.block_index_)  LogBlockIndex::AddLine(meta, LogBlockIndex::LineAttr(_info));
+    __Log2File(tmp_buff.Ptr(), tmp_buff.Length(), false, &meta);
 }
 
 
 void XloggerAppender::__WriteAsync(const XLoggerInfo* _info, const char* _log) {
+    char temp[16*1024] = {0};       //tell perry,ray if you want modify size.
+    PtrBuffer log_buff(temp, 0, sizeof(temp));
+    __FormatLine(_info, _log, log_buff);
+
     ScopedLock lock(mutex_buffer_async_);
     if (nullptr == log_buff_) return;
 
-    char temp[16*1024] = {0};       //tell perry,ray if you want modify size.
+    if (!__WriteBuffer(lock, log_buff.Ptr(), log_buff.Length())) return;
+    if (config_.block_index_)  LogBlockIndex::AddLine(block_meta_, LogBlockIndex::LineAttr(_info));
+
+    if (nullptr != _info && kLevelFatal == _info->level) {
+       flush_requested_ = true;
+       cond_buffer_async_.notifyAll();
+    }
+}
+
+void XloggerAppender::__WriteAsyncRing(const XLoggerInfo* _info, const char* _log) {
+    char temp[16*1024];       // formatted by __FormatLine, no need to zero it on every line.
     PtrBuffer log_buff(temp, 0, sizeof(temp));
-    log_formater(_info, _log, log_buff);
+    __FormatLine(_info, _log, log_buff);
+
+    bool fatal = (nullptr != _info && kLevelFatal == _info->level);
+    uint64_t attr = config_.block_index_ ? LogBlockIndex::LineAttr(_info) : 0;
+
+    LogRingBuffer* ring = __GetThreadRing();
+    if (nullptr != ring) {
+        size_t before_len = ring->Length();
+        if (ring->Push(log_buff.Ptr(), log_buff.Length(), attr)) {
+            if (fatal) {
+                flush_requested_ = true;
+                cond_buffer_async_.notifyAll();
+            } else if (before_len < kRingBufferLength*1/3 && ring->Length() >= kRingBufferLength*1/3) {
+                cond_buffer_async_.notifyAll();
+            }
+            return;
+        }
+    }
+
+    // ring is full, drain it ourselves so earlier lines of this thread stay ahead of this one.
+    ScopedLock lock(mutex_buffer_async_);
+    if (nullptr == log_buff_) return;
 
-    if (log_buff_->GetData().Length() >= kBufferBlockLength*4/5) {
-       int ret = snprintf(temp, sizeof(temp), "[F][ sg_buffer_async.Length() >= BUFFER_BLOCK_LENTH*4/5, len: %d\n", (int)log_buff_->GetData().Length());
-       log_buff.Length(ret, ret);
+    tickcount_t begin(true);
+    while (!__DrainRings()) {
+        if (!__WaitSegment(lock, begin)) {
+            ++dropped_lines_;
+            ++overflow_count_;
+            return;
+        }
     }
 
-    if (!log_buff_->Write(log_buff.Ptr(), (unsigned int)log_buff.Length())) return;
+    if (!__WriteBuffer(lock, log_buff.Ptr(), log_buff.Length())) return;
+    if (config_.block_index_)  LogBlockIndex::AddLine(block_meta_, attr);
 
-    if (log_buff_->GetData().Length() >= kBufferBlockLength*1/3 || (nullptr!=_info && kLevelFatal == _info->level)) {
+    if (fatal) {
+       flush_requested_ = true;
        cond_buffer_async_.notifyAll();
     }
 }
 
+LogRingBuffer* XloggerAppender::__GetThreadRing() {
+    ThreadRing* thread_ring = (ThreadRing*)tss_ring_.get();
+    if (nullptr != thread_ring && thread_ring->generation == rings_generation_) return thread_ring->ring;
+
+    LogRingBuffer* ring = new LogRingBuffer(kRingBufferLength);
+    ScopedLock lock(mutex_rings_);
+    if (log_close_) {
+        lock.unlock();
+        ring->Release();
+        ring->Release();
+        return nullptr;
+    }
+    rings_.push_back(ring);
+    unsigned int generation = rings_generation_;
+    lock.unlock();
+
+    // the ring of an earlier Open, nobody drains it any more
+    if (nullptr != thread_ring) {
+        thread_ring->ring->Release();
+    } else {
+        thread_ring = new ThreadRing;
+        tss_ring_.set(thread_ring);
+    }
+    thread_ring->ring = ring;
+    thread_ring->generation = generation;
+    return ring;
+}
+
+// must be called with mutex_buffer_async_ held, returns false if all segments filled up before the rings are empty.
+bool XloggerAppender::__DrainRings() {
+    AutoBuffer batch(16 * 1024);
+    bool drained = true;
+
+    ScopedLock lock(mutex_rings_);
+    for (std::vector<LogRingBuffer*>::iterator iter = rings_.begin(); iter != rings_.end();) {
+        // what is left of the segment, the header goes in with the first write
+        size_t buff_len = std::max(log_buff_->GetData().Length(), (size_t)LogCrypt::GetHeaderLen());
+
+        // one copy per ring instead of one per line.
+        batch.Length(0, 0);
+        bool all_popped = (*iter)->Pop(batch, segment_len_ - buff_len, config_.block_index_ ? &block_meta_ : nullptr);
+        if (batch.Length() > 0)  log_buff_->Write(batch.Ptr(), batch.Length());
+
+        if (!all_popped) {
+            if (__SwitchSegment()) continue;
+            drained = false;
+            break;
+        }
+
+        if ((*iter)->ProducerExited() && (*iter)->Empty()) {
+            (*iter)->Release();
+            iter = rings_.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    return drained;
+}
+
+void XloggerAppender::__ReleaseRings() {
+    ScopedLock lock(mutex_rings_);
+    for (std::vector<LogRingBuffer*>::iterator iter = rings_.begin(); iter != rings_.end(); ++iter) {
+        (*iter)->Release();
+    }
+    rings_.clear();
+    ++rings_generation_;
+}
+
 #define HEX_STRING  "0123456789abcdef"
 static unsigned int to_string(const void* signature, int len, char* str) {
     char* str_p = str;
@@ -1060,6 +1485,10 @@ void XloggerAppender::SetConsoleLog(bool _is_open) {
     consolelog_open_ = _is_open;
 }
 
+uint64_t XloggerAppender::GetOverflowCount() const {
+    return overflow_count_;
+}
+
 void XloggerAppender::SetMaxFileSize(uint64_t _max_byte_size) {
     max_file_size_ = _max_byte_size;
 }
@@ -1216,6 +1645,13 @@ void appender_set_console_log(bool _is_open) {
     sg_default_appender->SetConsoleLog(_is_open);
 }
 
+uint64_t appender_get_overflow_count() {
+    if (sg_release_guard) {
+        return 0;
+    }
+    return sg_default_appender->GetOverflowCount();
+}
+
 void appender_set_max_file_size(uint64_t _max_byte_size) {
     if (sg_release_guard) {
         return;
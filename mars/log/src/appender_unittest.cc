@@ -1,11 +1,78 @@
 #include "mars/comm/xlogger/xloggerbase.h"
 #include "gtest/gtest.h"
 
+#include <stdio.h>
 #include <cstring>
 #include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "log_zstd_buffer.h"
+#include "xlog_decoder.h"
+#include "xlogger_appender.h"
 
 using namespace testing;
 
+static std::string __Dir(const char* _name) {
+    std::string dir = boost::filesystem::temp_directory_path().string() + "/" + _name;
+    boost::filesystem::remove_all(dir);
+    boost::filesystem::create_directories(dir);
+    return dir;
+}
+
+static std::string __ReadFile(const std::string& _path) {
+    std::string data;
+    FILE* file = fopen(_path.c_str(), "rb");
+    if (NULL == file) return data;
+    char buffer[4096];
+    size_t len = 0;
+    while (0 < (len = fread(buffer, 1, sizeof(buffer), file)))  data.append(buffer, len);
+    fclose(file);
+    return data;
+}
+
+static void __WriteFile(const std::string& _path, const std::string& _data) {
+    FILE* file = fopen(_path.c_str(), "wb");
+    ASSERT_TRUE(NULL != file);
+    ASSERT_EQ(_data.size(), fwrite(_data.data(), 1, _data.size(), file));
+    fclose(file);
+}
+
+// the text of all log files of _prefix in _dir
+static std::string __Decode(const std::string& _dir, const char* _prefix) {
+    std::string text;
+    boost::filesystem::directory_iterator end;
+    for (boost::filesystem::directory_iterator iter(_dir); iter != end; ++iter) {
+        std::string name = iter->path().filename().string();
+        if (0 != name.find(_prefix) || name.size() < 5 || 0 != name.compare(name.size() - 5, 5, ".xlog")) continue;
+
+        XlogDecoder decoder;
+        std::string err;
+        EXPECT_TRUE(decoder.Open(iter->path().string().c_str(), err)) << err;
+        for (size_t i = 0; i < decoder.Blocks().size(); ++i) {
+            AutoBuffer block;
+            EXPECT_TRUE(decoder.DecodeBlock(i, block, err)) << err;
+            text.append((const char*)block.Ptr(), block.Length());
+        }
+    }
+    return text;
+}
+
+static std::string __Line(int _i) {
+    char line[128];
+    snprintf(line, sizeof(line), "segment line %d, some payload to fill the segments of the mmap cache\n", _i);
+    return line;
+}
+
+static XLogConfig __Config(const std::string& _dir, const char* _prefix) {
+    XLogConfig config;
+    config.mode_ = kAppenderAsync;
+    config.logdir_ = _dir;
+    config.nameprefix_ = _prefix;
+    config.compress_mode_ = kZstd;
+    return config;
+}
+
 static int calc_dump_required_length(int srcbytes){
     //MUST CHANGE THIS IF YOU CHANGE `to_string` function.
     return srcbytes * 6 + 1;
@@ -39,5 +106,122 @@ TEST(appender, memorydump){
     EXPECT_EQ(sdump1.length(), strlen(dump2) + 1);
 }
 
+TEST(appender, segments_recovered_after_crash) {
+    static const int kLines = 3000;
+    std::string dir = __Dir("appender_segments_unittest");
+    XLogConfig config = __Config(dir, "segments");
+    config.buffer_size_ = 64 * 1024;
+    config.buffer_segments_ = 2;
+    std::string mmap_path = dir + "/segments.mmap3";
+
+    // fills the segments a few times over, the full ones are written behind
+    XloggerAppender* appender = XloggerAppender::NewInstance(config);
+    for (int i = 0; i < kLines; ++i)  appender->Write(nullptr, __Line(i).c_str());
+    std::string crashed = __ReadFile(mmap_path);
+    EXPECT_EQ(0u, appender->GetOverflowCount());
+    XloggerAppender::Release(appender);
+    EXPECT_EQ(16 + 2 * 32 * 1024u, crashed.size());
+
+    // what the mmap cache held at the crash comes back with the next open, the lines of the last segment included
+    boost::filesystem::remove_all(dir);
+    boost::filesystem::create_directories(dir);
+    __WriteFile(mmap_path, crashed);
+    appender = XloggerAppender::NewInstance(config);
+    appender->FlushSync();
+    XloggerAppender::Release(appender);
+
+    std::string text = __Decode(dir, "segments");
+    std::string::size_type begin = text.find("~~~~~ begin of mmap ~~~~~");
+    std::string::size_type end = text.find("~~~~~ end of mmap ~~~~~");
+    ASSERT_NE(std::string::npos, begin);
+    ASSERT_NE(std::string::npos, end);
+    std::string recovered = text.substr(begin, end - begin);
+
+    int first = kLines - 1;
+    while (0 < first && std::string::npos != recovered.find(__Line(first - 1)))  --first;
+    EXPECT_LT(first, kLines - 10);
+    std::string::size_type pos = 0;
+    for (int i = first; i < kLines; ++i) {
+        pos = recovered.find(__Line(i), pos);
+        ASSERT_NE(std::string::npos, pos) << i;
+    }
+    boost::filesystem::remove_all(dir);
+}
+
+// the single block cache of older versions
+TEST(appender, legacy_mmap_recovered) {
+    std::string dir = __Dir("appender_legacy_unittest");
+    std::string lines;
+    {
+        std::vector<char> mem(150 * 1024);
+        LogZstdBuffer buffer(&mem[0], mem.size(), true, "", 3);
+        for (int i = 0; i < 500; ++i) {
+            std::string line = __Line(i);
+            ASSERT_TRUE(buffer.Write(line.data(), line.size()));
+            lines += line;
+        }
+        __WriteFile(dir + "/legacy.mmap3", std::string(&mem[0], mem.size()));
+    }
+
+    XLogConfig config = __Config(dir, "legacy");
+    XloggerAppender* appender = XloggerAppender::NewInstance(config);
+    appender->FlushSync();
+    XloggerAppender::Release(appender);
+
+    EXPECT_EQ(16 + config.buffer_size_, boost::filesystem::file_size(dir + "/legacy.mmap3"));
+    EXPECT_NE(std::string::npos, __Decode(dir, "legacy").find(lines));
+    boost::filesystem::remove_all(dir);
+}
+
+static size_t __CountFiles(const std::string& _dir, const char* _ext) {
+    size_t count = 0;
+    boost::filesystem::directory_iterator end;
+    for (boost::filesystem::directory_iterator iter(_dir); iter != end; ++iter) {
+        count += iter->path().extension() == _ext;
+    }
+    return count;
+}
+
+// one file descriptor from flush to flush, a new file once max_file_size_ is passed
+TEST(appender, file_kept_open_until_rotation) {
+    static const int kLines = 4000;
+    std::string dir = __Dir("appender_rotation_unittest");
+    XLogConfig config = __Config(dir, "rotation");
+    XloggerAppender* appender = XloggerAppender::NewInstance(config);
+    appender->SetMaxFileSize(2 * 1024);
+
+    for (int i = 0; i < kLines; ++i) {
+        appender->Write(nullptr, __Line(i).c_str());
+        if (0 == i % 200)  appender->FlushSync();
+    }
+    XloggerAppender::Release(appender);
+
+    EXPECT_LT(1u, __CountFiles(dir, ".xlog"));
+    std::string text = __Decode(dir, "rotation");
+    for (int i = 0; i < kLines; ++i) {
+        ASSERT_NE(std::string::npos, text.find(__Line(i))) << i;
+    }
+    boost::filesystem::remove_all(dir);
+}
+
+// a thread that logged before a Close gets a new ring after the next Open, its lines are not left in the old one
+TEST(appender, ring_after_reopen) {
+    std::string dir = __Dir("appender_reopen_unittest");
+    XLogConfig config = __Config(dir, "reopen");
+    config.async_ring_ = true;
+    XloggerAppender* appender = XloggerAppender::NewInstance(config);
+
+    appender->Write(nullptr, __Line(0).c_str());
+    appender->Close();
+    appender->Open(config);
+    appender->Write(nullptr, __Line(1).c_str());
+    XloggerAppender::Release(appender);
+
+    std::string text = __Decode(dir, "reopen");
+    EXPECT_NE(std::string::npos, text.find(__Line(0)));
+    EXPECT_NE(std::string::npos, text.find(__Line(1)));
+    boost::filesystem::remove_all(dir);
+}
+
 EXPORT_GTEST_SYMBOLS(log_export_appender_unittest)
 
@@ -22,12 +22,15 @@
 #include <assert.h>
 #include <stdio.h>
 #include <limits.h>
+#include <stdlib.h>
+#include <string.h>
 #include <algorithm>
 #include <string>
 
 #include "mars/comm/xlogger/xloggerbase.h"
 #include "mars/comm/xlogger/loginfo_extract.h"
 #include "mars/comm/ptrbuffer.h"
+#include "mars/comm/thread/tss.h"
 
 #ifdef _WIN32
 #define PRIdMAX "lld"
@@ -81,6 +84,108 @@ static int logger_itoa(int num, char* str, int len, int min) {
 }
 #endif
 
+namespace {
+// the time text of the last second a thread logged, lines of the same second only patch in the milliseconds
+struct TimeCache {
+    time_t sec;
+    size_t len;
+    char text[64];
+};
+}
+
+static Tss sg_tss_time_cache(&free);
+
+// "YYYY-MM-DD +TZ HH:MM:SS", the milliseconds are left to __FormatTime
+static size_t __FormatSecond(time_t _sec, char* _text, size_t _len) {
+    _text[0] = '\0';
+#if !_WIN32
+    struct tm tm = {0};
+    localtime_r((const time_t*)&_sec, &tm);
+#else
+    tm tm = *localtime((const time_t*)&_sec);
+#endif
+    std::string gmt = std::to_string(tm.tm_gmtoff / 360);
+
+#ifdef ANDROID
+    snprintf(_text, _len, "%d-%02d-%02d +%.3s %02d:%02d:%02d", 1900 + tm.tm_year, 1 + tm.tm_mon, tm.tm_mday,
+             gmt.c_str(), tm.tm_hour, tm.tm_min, tm.tm_sec);
+#elif _WIN32
+    snprintf(_text, _len, "%d-%02d-%02d +%.3s %02d:%02d:%02d", 1900 + tm.tm_year, 1 + tm.tm_mon, tm.tm_mday,
+             (-_timezone) / 3600.0, tm.tm_hour, tm.tm_min, tm.tm_sec);
+#else
+    do {
+        int len = 0;
+        int total_len = (int)_len;
+        len += logger_itoa(1900 + tm.tm_year, _text + len, total_len - len, 4);
+        if (len >= total_len - 1) {
+            break;
+        }
+        _text[len++] = '-';
+        len += logger_itoa(1 + tm.tm_mon, _text + len, total_len - len, 2);
+        if (len >= total_len - 1) {
+            break;
+        }
+        _text[len++] = '-';
+        len += logger_itoa(tm.tm_mday, _text + len, total_len - len, 2);
+        if (len >= total_len - 2) {
+            break;
+        }
+        _text[len++] = ' ';
+        if (tm.tm_gmtoff > 0) {
+            _text[len++] = '+';
+        }
+        len += logger_itoa(tm.tm_gmtoff / 360, _text + len, total_len - len, 0);
+        if (len >= total_len - 1) {
+            break;
+        }
+        _text[len++] = ' ';
+        len += logger_itoa(tm.tm_hour, _text + len, total_len - len, 2);
+        if (len >= total_len - 1) {
+            break;
+        }
+        _text[len++] = ':';
+        len += logger_itoa(tm.tm_min, _text + len, total_len - len, 2);
+        if (len >= total_len - 1) {
+            break;
+        }
+        _text[len++] = ':';
+        len += logger_itoa(tm.tm_sec, _text + len, total_len - len, 2);
+    } while (false);
+#endif
+    return strnlen(_text, _len);
+}
+
+// localtime_r and the text of the second run once a second per thread instead of once a line
+static void __FormatTime(const timeval& _tv, char* _text, size_t _len) {
+    TimeCache uncached;
+    TimeCache* cache = (TimeCache*)sg_tss_time_cache.get();
+    if (NULL == cache) {
+        cache = (TimeCache*)calloc(1, sizeof(TimeCache));
+        if (NULL != cache) {
+            sg_tss_time_cache.set(cache);
+        } else {
+            cache = &uncached;
+            cache->len = 0;
+        }
+    }
+
+    if (0 == cache->len || cache->sec != _tv.tv_sec) {
+        cache->len = __FormatSecond(_tv.tv_sec, cache->text, sizeof(cache->text));
+        cache->sec = _tv.tv_sec;
+    }
+
+    if (cache->len + 5 > _len) return;
+
+    int msec = (int)(_tv.tv_usec / 1000 % 1000);
+    memcpy(_text, cache->text, cache->len);
+    char* ms = _text + cache->len;
+    ms[0] = '.';
+    ms[1] = (char)('0' + msec / 100);
+    ms[2] = (char)('0' + msec / 10 % 10);
+    ms[3] = (char)('0' + msec % 10);
+    ms[4] = '\0';
+}
+
 void log_formater(const XLoggerInfo* _info, const char* _logbody, PtrBuffer& _log) {
     static const char* levelStrings[] = {
         "V",
@@ -126,66 +231,7 @@ void log_formater(const XLoggerInfo* _info, const char* _logbody, PtrBuffer& _lo
         char temp_time[64] = {0};
 
         if (0 != _info->timeval.tv_sec) {
-            time_t sec = _info->timeval.tv_sec;
-#if !_WIN32
-            struct tm tm = {0};
-            localtime_r((const time_t*)&sec, &tm);
-#else
-            tm tm = *localtime((const time_t*)&sec);
-#endif
-            std::string gmt = std::to_string(tm.tm_gmtoff / 360);
-            
-#ifdef ANDROID
-            snprintf(temp_time, sizeof(temp_time), "%d-%02d-%02d +%.3s %02d:%02d:%02d.%.3ld", 1900 + tm.tm_year, 1 + tm.tm_mon, tm.tm_mday,
-                     gmt.c_str(), tm.tm_hour, tm.tm_min, tm.tm_sec, _info->timeval.tv_usec / 1000);
-#elif _WIN32
-            snprintf(temp_time, sizeof(temp_time), "%d-%02d-%02d +%.3s %02d:%02d:%02d.%.3d", 1900 + tm.tm_year, 1 + tm.tm_mon, tm.tm_mday,
-                     (-_timezone) / 3600.0, tm.tm_hour, tm.tm_min, tm.tm_sec, _info->timeval.tv_usec / 1000);
-#else
-            do {
-                int len = 0;
-                int total_len = sizeof(temp_time);
-                len += logger_itoa(1900 + tm.tm_year, temp_time + len, total_len - len, 4);
-                if (len >= total_len - 1) {
-                    break;
-                }
-                temp_time[len++] = '-';
-                len += logger_itoa(1 + tm.tm_mon, temp_time + len, total_len - len, 2);
-                if (len >= total_len - 1) {
-                    break;
-                }
-                temp_time[len++] = '-';
-                len += logger_itoa(tm.tm_mday, temp_time + len, total_len - len, 2);
-                if (len >= total_len - 2) {
-                    break;
-                }
-                temp_time[len++] = ' ';
-                if (tm.tm_gmtoff > 0) {
-                    temp_time[len++] = '+';
-                }
-                len += logger_itoa(tm.tm_gmtoff / 360, temp_time + len, total_len - len, 0);
-                if (len >= total_len - 1) {
-                    break;
-                }
-                temp_time[len++] = ' ';
-                len += logger_itoa(tm.tm_hour, temp_time + len, total_len - len, 2);
-                if (len >= total_len - 1) {
-                    break;
-                }
-                temp_time[len++] = ':';
-                len += logger_itoa(tm.tm_min, temp_time + len, total_len - len, 2);
-                if (len >= total_len - 1) {
-                    break;
-                }
-                temp_time[len++] = ':';
-                len += logger_itoa(tm.tm_sec, temp_time + len, total_len - len, 2);
-                if (len >= total_len - 1) {
-                    break;
-                }
-                temp_time[len++] = '.';
-                len += logger_itoa(_info->timeval.tv_usec / 1000, temp_time + len, total_len - len, 3);
-            } while (false);
-#endif
+            __FormatTime(_info->timeval, temp_time, sizeof(temp_time));
         }
 
         // _log.AllocWrite(30*1024, false);
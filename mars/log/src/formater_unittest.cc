@@ -0,0 +1,66 @@
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <string>
+
+#include "mars/comm/ptrbuffer.h"
+#include "mars/comm/xlogger/xloggerbase.h"
+
+using namespace testing;
+
+extern void log_formater(const XLoggerInfo* _info, const char* _logbody, PtrBuffer& _log);
+
+static std::string __Line(const timeval& _tv) {
+    XLoggerInfo info;
+    memset(&info, 0, sizeof(info));
+    info.level = kLevelInfo;
+    info.tag = "stn";
+    info.filename = "longlink.cc";
+    info.func_name = "__RunReadWrite";
+    info.line = 100;
+    info.timeval = _tv;
+
+    char temp[16 * 1024];
+    PtrBuffer line(temp, 0, sizeof(temp));
+    log_formater(&info, "connect 10.0.0.1:443 cost 13ms", line);
+    return std::string(temp, line.Length());
+}
+
+// the time field of a line, "[I][<time>][..."
+static std::string __Time(const std::string& _line) {
+    size_t begin = _line.find("][") + 2;
+    return _line.substr(begin, _line.find(']', begin) - begin);
+}
+
+static std::string __Expect(const timeval& _tv) {
+    time_t sec = _tv.tv_sec;
+    struct tm tm;
+    localtime_r(&sec, &tm);
+    char text[64];
+    snprintf(text, sizeof(text), "%d-%02d-%02d %s%ld %02d:%02d:%02d.%03d", 1900 + tm.tm_year, 1 + tm.tm_mon, tm.tm_mday,
+             0 < tm.tm_gmtoff ? "+" : "", (long)(tm.tm_gmtoff / 360), tm.tm_hour, tm.tm_min, tm.tm_sec, (int)(_tv.tv_usec / 1000));
+    return text;
+}
+
+TEST(formater, cached_time_unchanged) {
+    timeval now;
+    gettimeofday(&now, NULL);
+
+    // same second, the next ones, one back in time and one across a dst change if the zone has any
+    time_t secs[] = {now.tv_sec, now.tv_sec, now.tv_sec + 1, now.tv_sec + 61, now.tv_sec - 1, now.tv_sec - 180 * 24 * 3600, now.tv_sec};
+    long usecs[] = {0, 999999, 1000, 5000, 123456, 42000, 7000};
+    for (size_t i = 0; i < sizeof(secs) / sizeof(secs[0]); ++i) {
+        timeval tv;
+        tv.tv_sec = secs[i];
+        tv.tv_usec = usecs[i];
+        EXPECT_EQ(__Expect(tv), __Time(__Line(tv))) << i;
+    }
+
+    timeval zero = {0, 0};
+    EXPECT_EQ("", __Time(__Line(zero)));
+}
+
+EXPORT_GTEST_SYMBOLS(log_export_formater_unittest)
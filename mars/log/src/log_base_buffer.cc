@@ -201,17 +201,70 @@ PtrBuffer& LogBaseBuffer::GetData() {
 }
 
 void LogBaseBuffer::Flush(AutoBuffer& _buff) {
-    if (log_crypt_->GetLogLen((char*)buff_.Ptr(), buff_.Length()) == 0) {
-        __Clear();
-        return;
-    }
-    
-    __Flush();
-    _buff.Write(buff_.Ptr(), buff_.Length());
-    
+    Pack(buff_.Ptr(), buff_.Length(), _buff);
     __Clear();
 }
 
+void LogBaseBuffer::Attach(void* _pbuffer, size_t _len) {
+    buff_.Attach(_pbuffer, _len);
+    __Fix();
+}
+
+void LogBaseBuffer::Pack(const void* _staged, size_t _len, AutoBuffer& _block) {
+    uint32_t header_len = log_crypt_->GetHeaderLen();
+    const char* staged = (const char*)_staged;
+    uint32_t log_len = log_crypt_->GetLogLen(staged, _len);
+    if (0 == log_len || header_len + log_len > _len) return;
+
+    char magic_start = staged[0];
+    const void* body = staged + header_len;
+    size_t body_len = log_len;
+    AutoBuffer plain;
+    AutoBuffer compressed;
+    AutoBuffer crypted;
+    bool crypted_here = false;
+
+    // raw lines, plain or crypted under our key, are compressed and crypted as one block. Anything else goes
+    // out as it is: a block of an older version is compressed and crypted line by line already, and lines a
+    // crashed process staged crypted stay under its key.
+    bool repack = LogMagicNum::kMagicAsyncRawStart == magic_start;
+    if (LogMagicNum::kMagicAsyncRawCryptStart == magic_start && log_crypt_->DecryptStagedLog(staged, staged + header_len, log_len, plain)) {
+        body = plain.Ptr();
+        repack = true;
+    }
+
+    if (repack) {
+        ScopedLock lock(mutex_pack_);
+        if (is_compress_) {
+            compressed.AllocWrite(CompressBound(log_len));
+            size_t len = Compress(body, log_len, compressed.Ptr(), compressed.Length());
+            if ((size_t)-1 == len) return;
+            compressed.Length(len, len);
+            body = compressed.Ptr();
+            body_len = len;
+        }
+
+        size_t remain_nocrypt_len = 0;
+        log_crypt_->CryptAsyncLog((const char*)body, body_len, crypted, remain_nocrypt_len);
+        body = crypted.Ptr();
+        magic_start = __GetMagicAsyncStart();
+        crypted_here = true;
+    }
+
+    off_t begin = _block.Pos();
+    _block.Write(staged, header_len);
+    _block.Write(body, body_len);
+    char magic_end = __GetMagicEnd();
+    _block.Write(&magic_end, log_crypt_->GetTailerLen());
+
+    char* header = (char*)_block.Ptr(begin);
+    header[0] = magic_start;
+    log_crypt_->SetLogLen(header, (uint32_t)body_len);
+    log_crypt_->UpdateLogHour(header);
+    // plain lines a crash left carry the key of the process that staged them, they are crypted with ours
+    if (crypted_here) log_crypt_->SetClientPubKey(header);
+}
+
 bool LogBaseBuffer::Write(const void* _data, size_t _inputlen, AutoBuffer& _out_buff) {
     if (NULL == _data || 0 == _inputlen) {
         return false;
@@ -230,33 +283,18 @@ bool LogBaseBuffer::Write(const void* _data, size_t _length) {
         if (!__Reset()) return false;
     }
 
-    size_t before_len = buff_.Length();
-    size_t write_len = _length;
-    
-    if (is_compress_) {
-        uInt avail_out = (uInt)(buff_.MaxLength() - buff_.Length());
-        write_len = Compress(_data, _length, buff_.PosPtr(), avail_out);
-        if (write_len == (size_t)-1) {
-            return false;
-        }
-        
-    } else {
-        buff_.Write(_data, _length);
+    if (_length > buff_.MaxLength() - buff_.Length()) {
+        return false;
     }
 
-    before_len -= remain_nocrypt_len_;
-
-    AutoBuffer out_buffer;
-    size_t last_remain_len = remain_nocrypt_len_;
-
-    log_crypt_->CryptAsyncLog((char*)buff_.Ptr() + before_len, write_len + remain_nocrypt_len_, out_buffer, remain_nocrypt_len_);
-
-    buff_.Write(out_buffer.Ptr(), out_buffer.Length(), before_len);
-
-    before_len += out_buffer.Length();
-    buff_.Length(before_len, before_len);
-
-    log_crypt_->UpdateLogLen((char*)buff_.Ptr(), (uint32_t)(out_buffer.Length() - last_remain_len));
+    // the length goes in behind the line, a crash in between leaves the lines before it to __Fix
+    char* header = (char*)buff_.Ptr();
+    size_t old_len = buff_.Length() - log_crypt_->GetHeaderLen();
+    buff_.Write(_data, _length);
+    if (LogMagicNum::kMagicAsyncRawCryptStart == header[0]) {
+        log_crypt_->CryptStagedLog(header + log_crypt_->GetHeaderLen(), old_len, old_len + _length);
+    }
+    log_crypt_->UpdateLogLen(header, (uint32_t)_length);
 
     return true;
 }
@@ -264,28 +302,23 @@ bool LogBaseBuffer::Write(const void* _data, size_t _length) {
 bool LogBaseBuffer::__Reset() {
     __Clear();
 
-    log_crypt_->SetHeaderInfo((char*)buff_.Ptr(), is_compress_, __GetMagicAsyncStart());
+    // with a public key the lines are tea crypted as they are staged, the mmap file holds no plain text
+    char magic = is_crypt_ ? LogMagicNum::kMagicAsyncRawCryptStart : LogMagicNum::kMagicAsyncRawStart;
+    log_crypt_->SetHeaderInfo((char*)buff_.Ptr(), is_compress_, magic);
     buff_.Length(log_crypt_->GetHeaderLen(), log_crypt_->GetHeaderLen());
     return true;
 }
 
-void LogBaseBuffer::__Flush() {
-    assert(buff_.Length() >= log_crypt_->GetHeaderLen());
-
-    log_crypt_->UpdateLogHour((char*)buff_.Ptr());
-    log_crypt_->SetTailerInfo((char*)buff_.Ptr() + buff_.Length(), __GetMagicEnd());
-    buff_.Length(buff_.Length() + log_crypt_->GetTailerLen(), buff_.Length() + log_crypt_->GetTailerLen());
-}
-
 void LogBaseBuffer::__Clear() {
     memset(buff_.Ptr(), 0, buff_.MaxLength());
     buff_.Length(0, 0);
-    remain_nocrypt_len_ = 0;
 }
 
+// the staged lines a crash left, raw or of an older version, go out with the first Flush
 void LogBaseBuffer::__Fix() {
     uint32_t raw_log_len = 0;
-    if (log_crypt_->Fix((char*) buff_.Ptr(), buff_.Length(), raw_log_len)) {
+    if (log_crypt_->Fix((char*) buff_.Ptr(), buff_.Length(), raw_log_len)
+            && raw_log_len <= buff_.Length() - log_crypt_->GetHeaderLen()) {
         buff_.Length(raw_log_len + log_crypt_->GetHeaderLen(), raw_log_len + log_crypt_->GetHeaderLen());
     } else {
         buff_.Length(0, 0);
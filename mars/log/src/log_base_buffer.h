@@ -26,6 +26,7 @@
 
 #include "mars/comm/ptrbuffer.h"
 #include "mars/comm/autobuffer.h"
+#include "mars/comm/thread/lock.h"
 
 class LogCrypt;
 
@@ -41,14 +42,21 @@ public:
 
 public:
     PtrBuffer& GetData();
+    // compresses a whole block in one frame, -1 if it fails
     virtual size_t Compress(const void* src, size_t inLen, void* dst, size_t outLen) = 0;
+    virtual size_t CompressBound(size_t _len) = 0;
     virtual void Flush(AutoBuffer& _buff);
+    // compresses and crypts the lines staged in _staged, this buffer or one it was attached to before,
+    // into a log block. It does not touch the buffer Write goes to, so it needs no lock of the writers.
+    void Pack(const void* _staged, size_t _len, AutoBuffer& _block);
+    // moves the writes to another buffer, lines staged in it already are kept
+    void Attach(void* _pbuffer, size_t _len);
+    // async lines are staged raw, a memcpy and the length in the header, tea crypted in place with a public key
     bool Write(const void* _data, size_t _length);
     bool Write(const void* _data, size_t _inputlen, AutoBuffer& _out_buff);
 
 protected:
     virtual bool __Reset();
-    void __Flush();
     void __Clear();
     void __Fix();
     char __GetMagicEnd();
@@ -60,7 +68,7 @@ protected:
     bool is_compress_;
     class LogCrypt* log_crypt_;
     bool is_crypt_;
-    size_t remain_nocrypt_len_;
+    Mutex mutex_pack_;  // the compress stream of Pack
 };
 
 
@@ -0,0 +1,188 @@
+#include "log_base_buffer.h"
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "log_zlib_buffer.h"
+#include "log_zstd_buffer.h"
+#include "xlog_decoder.h"
+#include "log/crypt/log_crypt.h"
+#include "log/crypt/log_magic_num.h"
+#include "zstd/lib/zstd.h"
+
+using namespace testing;
+
+static const size_t kBlockLength = 150 * 1024;
+static const char* kPubKey = "572d1e2710ae5fbca54c76a382fdd44050b3a675cb2bf39feebe85ef63d947aff0fa4943f1112e8b6af34bebebbaefa1a0aae055d9259b89a1858f7cc9af9df1";
+static const char* kPrivKey = "145aa7717bf9745b91e9569b80bbf1eedaa6cc6cd0e26317d810e35710f44cf8";
+
+static int __Line(char* _line, size_t _len, int _i) {
+    return snprintf(_line, _len, "[I][2026-10-18 +8.0 10:00:%02d.%03d][1234, %d][tag][file.cc, Func, %d][line %d, some payload to compress\n",
+                    _i / 1000 % 60, _i % 1000, 5678 + _i % 7, 100 + _i % 50, _i);
+}
+
+static void __Write(LogBaseBuffer& _buffer, int _begin, int _end, std::string& _text) {
+    char line[256];
+    for (int i = _begin; i < _end; ++i) {
+        int len = __Line(line, sizeof(line), i);
+        ASSERT_TRUE(_buffer.Write(line, len));
+        _text.append(line, len);
+    }
+}
+
+static std::string __Decode(const AutoBuffer& _file, const char* _privkey = NULL) {
+    XlogDecoder decoder(_privkey);
+    std::string err;
+    EXPECT_TRUE(decoder.Open((const char*)_file.Ptr(), _file.Length(), err));
+
+    std::string text;
+    for (size_t i = 0; i < decoder.Blocks().size(); ++i) {
+        AutoBuffer block;
+        EXPECT_TRUE(decoder.DecodeBlock(i, block, err)) << err;
+        text.append((const char*)block.Ptr(), block.Length());
+    }
+    return text;
+}
+
+TEST(log_base_buffer, staged_raw) {
+    std::vector<char> mem(kBlockLength);
+    LogZstdBuffer buffer(&mem[0], mem.size(), true, "", 3);
+    std::string text;
+    __Write(buffer, 0, 100, text);
+
+    // the lines as they are, behind the header of a block
+    EXPECT_EQ((int)LogMagicNum::kMagicAsyncRawStart, (int)mem[0]);
+    EXPECT_EQ(LogCrypt::GetHeaderLen() + text.size(), buffer.GetData().Length());
+    EXPECT_EQ(text, std::string(&mem[LogCrypt::GetHeaderLen()], text.size()));
+
+    // packed from where they are, the buffer goes on with another one
+    std::vector<char> staged(mem);
+    std::vector<char> next(kBlockLength);
+    buffer.Attach(&next[0], next.size());
+    EXPECT_EQ(0u, buffer.GetData().Length());
+
+    AutoBuffer file;
+    buffer.Pack(&staged[0], staged.size(), file);
+    EXPECT_EQ((int)LogMagicNum::kMagicAsyncNoCryptZstdStart, (int)((const char*)file.Ptr())[0]);
+    EXPECT_LT(file.Length(), text.size() / 4);
+    EXPECT_EQ(text, __Decode(file));
+
+    // a line longer than what is left stays out
+    std::string huge(kBlockLength, 'x');
+    EXPECT_FALSE(buffer.Write(huge.data(), huge.size()));
+}
+
+TEST(log_base_buffer, recovers_raw_tail) {
+    std::vector<char> mem(kBlockLength);
+    std::string text;
+    AutoBuffer file;
+    {
+        LogZlibBuffer buffer(&mem[0], mem.size(), true, "");
+        __Write(buffer, 0, 200, text);
+        buffer.Flush(file);
+        __Write(buffer, 200, 500, text);
+    }
+
+    // a crash in the middle of the next line, its bytes are in but not its length
+    size_t len = LogCrypt::GetHeaderLen() + LogCrypt::GetLogLen(&mem[0], mem.size());
+    memcpy(&mem[len], "[I][torn", 8);
+
+    LogZlibBuffer buffer(&mem[0], mem.size(), true, "");
+    EXPECT_EQ(len, buffer.GetData().Length());
+    buffer.Flush(file);
+    EXPECT_EQ(text, __Decode(file));
+    EXPECT_EQ('\0', mem[0]);
+
+    // garbage is dropped
+    memset(&mem[0], 0x5a, 64);
+    LogZlibBuffer garbage(&mem[0], mem.size(), true, "");
+    EXPECT_EQ(0u, garbage.GetData().Length());
+}
+
+TEST(log_base_buffer, staged_crypted) {
+    std::vector<char> mem(kBlockLength);
+    LogZstdBuffer buffer(&mem[0], mem.size(), true, kPubKey, 3);
+    std::string text;
+    __Write(buffer, 0, 100, text);
+
+    // no plain text in the mmap file, only the tail short of a tea block
+    EXPECT_EQ((int)LogMagicNum::kMagicAsyncRawCryptStart, (int)mem[0]);
+    EXPECT_EQ(LogCrypt::GetHeaderLen() + text.size(), buffer.GetData().Length());
+    std::string staged(&mem[LogCrypt::GetHeaderLen()], text.size());
+    EXPECT_EQ(std::string::npos, staged.find("payload"));
+    size_t tail = text.size() % 8;
+    EXPECT_EQ(text.substr(text.size() - tail), staged.substr(staged.size() - tail));
+
+    AutoBuffer file;
+    buffer.Flush(file);
+    EXPECT_EQ((int)LogMagicNum::kMagicAsyncZstdStart, (int)((const char*)file.Ptr())[0]);
+    EXPECT_LT(file.Length(), text.size() / 4);
+    EXPECT_EQ(text, __Decode(file, kPrivKey));
+}
+
+// lines a crashed process staged crypted stay under its key, plain ones are crypted with the key of the
+// process that recovers them
+TEST(log_base_buffer, recovers_crypted_raw_tail) {
+    std::vector<char> mem(kBlockLength);
+    std::string text;
+    {
+        LogZstdBuffer buffer(&mem[0], mem.size(), true, kPubKey, 3);
+        __Write(buffer, 0, 301, text);
+    }
+
+    LogZstdBuffer buffer(&mem[0], mem.size(), true, kPubKey, 3);
+    AutoBuffer file;
+    buffer.Flush(file);
+    EXPECT_EQ((int)LogMagicNum::kMagicAsyncRawCryptStart, (int)((const char*)file.Ptr())[0]);
+    EXPECT_EQ(text, __Decode(file, kPrivKey));
+
+    std::string plain;
+    {
+        LogZstdBuffer buffer(&mem[0], mem.size(), true, "", 3);
+        __Write(buffer, 0, 300, plain);
+    }
+
+    LogZstdBuffer crypting(&mem[0], mem.size(), true, kPubKey, 3);
+    file.Reset();
+    crypting.Flush(file);
+    EXPECT_EQ((int)LogMagicNum::kMagicAsyncZstdStart, (int)((const char*)file.Ptr())[0]);
+    EXPECT_EQ(plain, __Decode(file, kPrivKey));
+}
+
+// the mmap buffer of an older version holds a block compressed and flushed line by line
+TEST(log_base_buffer, recovers_legacy_block) {
+    std::vector<char> mem(kBlockLength);
+    std::string text;
+    {
+        LogZstdBuffer buffer(&mem[0], mem.size(), true, "", 3);
+        __Write(buffer, 0, 1, text);
+    }
+    mem[0] = LogMagicNum::kMagicAsyncNoCryptZstdStart;
+    LogCrypt::SetLogLen(&mem[0], 0);
+    text.clear();
+
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+    size_t pos = LogCrypt::GetHeaderLen();
+    char line[256];
+    for (int i = 0; i < 300; ++i) {
+        int len = __Line(line, sizeof(line), i);
+        ZSTD_inBuffer input = {line, (size_t)len, 0};
+        ZSTD_outBuffer output = {&mem[pos], mem.size() - pos, 0};
+        ZSTD_compressStream2(cctx, &output, &input, ZSTD_e_flush);
+        pos += output.pos;
+        text.append(line, len);
+    }
+    ZSTD_freeCCtx(cctx);
+    LogCrypt::SetLogLen(&mem[0], (uint32_t)(pos - LogCrypt::GetHeaderLen()));
+
+    LogZstdBuffer buffer(&mem[0], mem.size(), true, "", 3);
+    AutoBuffer file;
+    buffer.Flush(file);
+    EXPECT_EQ((int)LogMagicNum::kMagicAsyncNoCryptZstdStart, (int)((const char*)file.Ptr())[0]);
+    EXPECT_EQ(text, __Decode(file));
+}
+
+EXPORT_GTEST_SYMBOLS(log_export_log_base_buffer_unittest)
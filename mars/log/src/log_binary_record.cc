@@ -0,0 +1,165 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * log_binary_record.cc
+ *
+ *  Created on: 2026-10-18
+ */
+
+#include "log_binary_record.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+
+#include "mars/comm/xlogger/loginfo_extract.h"
+
+extern void log_formater(const XLoggerInfo* _info, const char* _logbody, PtrBuffer& _log);
+
+static_assert(28 == sizeof(LogBinaryRecord::Header), "the record header is part of the file format");
+
+static const size_t kMaxStringLen = 100;    // log_formater cuts tag, file and function names there too
+
+// hour since the epoch << 16 | minutes + 0x8000; one localtime_r an hour instead of one a line.
+// offsets change on hour boundaries of local time, which are hour boundaries of utc for whole hour zones.
+static std::atomic<int64_t> sg_gmtoff_cache(-1);
+
+static int16_t __GmtOffset(time_t _sec) {
+    int64_t hour = _sec / 3600;
+    int64_t cache = sg_gmtoff_cache.load(std::memory_order_relaxed);
+    if (0 <= cache && (cache >> 16) == hour) return (int16_t)((cache & 0xffff) - 0x8000);
+
+#ifdef _WIN32
+    int minutes = (int)(-_timezone / 60);
+#else
+    struct tm tm;
+    localtime_r(&_sec, &tm);
+    int minutes = (int)(tm.tm_gmtoff / 60);
+#endif
+    sg_gmtoff_cache.store((hour << 16) | (minutes + 0x8000), std::memory_order_relaxed);
+    return (int16_t)minutes;
+}
+
+void LogBinaryRecord::Format(const XLoggerInfo* _info, const char* _logbody, PtrBuffer& _log) {
+    // the overflow line of a full buffer is log_formater's
+    if (NULL == _info || _log.MaxLength() <= _log.Length() + 5 * 1024) {
+        log_formater(_info, _logbody, _log);
+        return;
+    }
+
+    const char* filename = ExtractFileName(_info->filename);
+#if _WIN32
+    char func_name[128] = {0};
+    ExtractFunctionName(_info->func_name, func_name, sizeof(func_name));
+#else
+    const char* func_name = NULL == _info->func_name ? "" : _info->func_name;
+#endif
+    const char* tag = NULL == _info->tag ? "" : _info->tag;
+    const char* body = NULL == _logbody ? "error!! NULL==_logbody" : _logbody;
+
+    Header header;
+    header.magic = kMagic;
+    header.level = (uint8_t)(NULL == _logbody ? kLevelFatal : std::min(_info->level, kLevelFatal));
+    header.flags = _info->tid == _info->maintid ? kFlagMainThread : 0;
+    header.tag_len = (uint8_t)strnlen(tag, kMaxStringLen);
+    header.filename_len = (uint8_t)strnlen(filename, kMaxStringLen);
+    header.func_len = (uint8_t)strnlen(func_name, kMaxStringLen);
+    header.sec = (uint32_t)_info->timeval.tv_sec;
+    header.msec = (uint16_t)(_info->timeval.tv_usec / 1000);
+    header.gmtoff = 0 == _info->timeval.tv_sec ? 0 : __GmtOffset(_info->timeval.tv_sec);
+    header.pid = (uint32_t)_info->pid;
+    header.tid = (uint32_t)_info->tid;
+    header.line = (uint32_t)_info->line;
+
+    size_t body_len = _log.MaxLength() - _log.Length() - sizeof(header) - 3 * kMaxStringLen;
+    body_len = strnlen(body, std::min(body_len, (size_t)0xFFFFU));
+    header.body_len = (uint16_t)body_len;
+
+    _log.Write(&header, sizeof(header));
+    _log.Write(tag, header.tag_len);
+    _log.Write(filename, header.filename_len);
+    _log.Write(func_name, header.func_len);
+    _log.Write(body, body_len);
+}
+
+bool LogBinaryRecord::HasRecord(const void* _data, size_t _len) {
+    return 0 < _len && NULL != memchr(_data, kMagic, _len);
+}
+
+// the text of the posix branch of log_formater
+static void __RenderRecord(const LogBinaryRecord::Header& _header, const char* _strings, AutoBuffer& _out) {
+    static const char* kLevelStrings[] = {"V", "D", "I", "W", "E", "F"};
+
+    const char* tag = _strings;
+    const char* filename = tag + _header.tag_len;
+    const char* func_name = filename + _header.filename_len;
+    const char* body = func_name + _header.func_len;
+
+    char time_str[64] = {0};
+    if (0 != _header.sec) {
+        int gmtoff = _header.gmtoff * 60;
+        time_t local_sec = (time_t)_header.sec + gmtoff;
+        struct tm tm;
+        gmtime_r(&local_sec, &tm);
+        snprintf(time_str, sizeof(time_str), "%04d-%02d-%02d %s%d %02d:%02d:%02d.%03d", 1900 + tm.tm_year, 1 + tm.tm_mon, tm.tm_mday,
+                 0 < gmtoff ? "+" : "", gmtoff / 360, tm.tm_hour, tm.tm_min, tm.tm_sec, (int)_header.msec);
+    }
+
+    char text[256];
+    int len = snprintf(text, sizeof(text), "[%s][%s][%d, %d%s][", kLevelStrings[_header.level], time_str, (int)_header.pid,
+                       (int)_header.tid, (_header.flags & LogBinaryRecord::kFlagMainThread) ? "*" : "");
+    _out.Write(text, len);
+    _out.Write(tag, _header.tag_len);
+    _out.Write("][", 2);
+    _out.Write(filename, _header.filename_len);
+    _out.Write(", ", 2);
+    _out.Write(func_name, _header.func_len);
+    len = snprintf(text, sizeof(text), ", %d][", (int)_header.line);
+    _out.Write(text, len);
+    _out.Write(body, _header.body_len);
+    if (0 == _header.body_len || '\n' != body[_header.body_len - 1]) _out.Write("\n", 1);
+}
+
+void LogBinaryRecord::Render(const void* _data, size_t _len, AutoBuffer& _out) {
+    const char* data = (const char*)_data;
+    const char* end = data + _len;
+
+    while (data < end) {
+        const char* record = (const char*)memchr(data, kMagic, end - data);
+        if (NULL == record) {
+            _out.Write(data, end - data);
+            break;
+        }
+        _out.Write(data, record - data);
+
+        Header header;
+        size_t left = end - record;
+        size_t record_len = 0;
+        if (sizeof(header) <= left) {
+            memcpy(&header, record, sizeof(header));
+            record_len = sizeof(header) + header.tag_len + header.filename_len + header.func_len + header.body_len;
+        }
+
+        // a stray byte of a text line, or a record torn by a crash: kept as it is
+        if (0 == record_len || left < record_len || kLevelFatal < header.level) {
+            _out.Write(record, 1);
+            data = record + 1;
+            continue;
+        }
+
+        __RenderRecord(header, record + sizeof(header), _out);
+        data = record + record_len;
+    }
+}
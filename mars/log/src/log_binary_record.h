@@ -0,0 +1,75 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * log_binary_record.h
+ *
+ *  Created on: 2026-10-18
+ */
+
+#ifndef LOG_BINARY_RECORD_H_
+#define LOG_BINARY_RECORD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/ptrbuffer.h"
+#include "mars/comm/xlogger/xloggerbase.h"
+
+/*
+ * Lines of XLogConfig::binary_record_. Instead of the text log_formater builds on the logging thread
+ * (localtime_r, itoa and the brackets), a line is a fixed header with the raw fields of its XLoggerInfo,
+ * followed by the tag, file name, function name and body bytes:
+ *
+ *   |Header|tag|filename|func_name|body|
+ *
+ * Records go through the buffers, compression and crypt like text lines, and may be mixed with the
+ * text lines the appender writes itself. XlogDecoder (and the python decoders) render them back to the
+ * exact text of log_formater, so decoded files do not tell the two modes apart.
+ */
+class LogBinaryRecord {
+  public:
+    // never the first byte of a text line
+    static const char kMagic = '\x1e';
+
+    enum {
+        kFlagMainThread = 0x01,
+    };
+
+    // host byte order, as the block headers
+    struct Header {
+        char     magic;
+        uint8_t  level;
+        uint8_t  flags;
+        uint8_t  tag_len;
+        uint8_t  filename_len;
+        uint8_t  func_len;
+        uint16_t body_len;
+        int16_t  gmtoff;        // of the writer, in minutes
+        uint16_t msec;
+        uint32_t sec;
+        uint32_t pid;
+        uint32_t tid;
+        uint32_t line;
+    };
+
+  public:
+    // the binary counterpart of log_formater; lines without _info are written as text
+    static void Format(const XLoggerInfo* _info, const char* _logbody, PtrBuffer& _log);
+
+    static bool HasRecord(const void* _data, size_t _len);
+    // appends _data to _out with every record rendered as log_formater text, anything else is copied
+    static void Render(const void* _data, size_t _len, AutoBuffer& _out);
+};
+
+#endif /* LOG_BINARY_RECORD_H_ */
@@ -0,0 +1,135 @@
+#include "log_binary_record.h"
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+
+#include "xlog_decoder.h"
+#include "xlogger_appender.h"
+
+using namespace testing;
+
+extern void log_formater(const XLoggerInfo* _info, const char* _logbody, PtrBuffer& _log);
+
+static const size_t kLineLength = 16 * 1024;     // the format buffer of the appender
+
+static XLoggerInfo __Info(TLogLevel _level, const char* _tag, int _line, time_t _sec, intmax_t _tid) {
+    XLoggerInfo info;
+    memset(&info, 0, sizeof(info));
+    info.level = _level;
+    info.tag = _tag;
+    info.filename = "/home/mars/stn/src/longlink.cc";
+    info.func_name = "__RunReadWrite";
+    info.line = _line;
+    info.timeval.tv_sec = _sec;
+    info.timeval.tv_usec = 123456;
+    info.pid = 4242;
+    info.tid = _tid;
+    info.maintid = 4242;
+    return info;
+}
+
+static std::string __Text(const XLoggerInfo* _info, const char* _body) {
+    std::vector<char> temp(kLineLength);
+    PtrBuffer line(&temp[0], 0, temp.size());
+    log_formater(_info, _body, line);
+    return std::string((const char*)line.Ptr(), line.Length());
+}
+
+static std::string __Binary(const XLoggerInfo* _info, const char* _body) {
+    std::vector<char> temp(kLineLength);
+    PtrBuffer line(&temp[0], 0, temp.size());
+    LogBinaryRecord::Format(_info, _body, line);
+    return std::string((const char*)line.Ptr(), line.Length());
+}
+
+TEST(log_binary_record, renders_like_formater) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    XLoggerInfo infos[] = {
+        __Info(kLevelInfo, "stn", 10, now.tv_sec, 4242),
+        __Info(kLevelError, NULL, 20, now.tv_sec - 180 * 24 * 3600, 4243),  // the other side of a dst change, if any
+        __Info(kLevelDebug, "sdt", 30, 0, 4244),
+    };
+    const char* bodies[] = {"connect 10.0.0.1:443 cost 13ms", "ends with a newline\n", "", NULL};
+
+    std::string binary, expect;
+    for (size_t i = 0; i < sizeof(infos) / sizeof(infos[0]); ++i) {
+        for (size_t j = 0; j < sizeof(bodies) / sizeof(bodies[0]); ++j) {
+            binary += __Binary(&infos[i], bodies[j]);
+            expect += __Text(&infos[i], bodies[j]);
+        }
+        // the appender's own lines stay text
+        binary += "^^^^^^^^^^ mark info ^^^^^^^^^^\n";
+        expect += "^^^^^^^^^^ mark info ^^^^^^^^^^\n";
+    }
+    ASSERT_TRUE(LogBinaryRecord::HasRecord(binary.data(), binary.size()));
+    EXPECT_FALSE(LogBinaryRecord::HasRecord(expect.data(), expect.size()));
+    EXPECT_LT(binary.size(), expect.size());
+
+    // lines without info are text in both modes
+    EXPECT_EQ(__Text(NULL, "no info"), __Binary(NULL, "no info"));
+
+    // a record cut short by a crash is copied as it is
+    std::string torn = __Binary(&infos[0], bodies[0]);
+    torn.resize(torn.size() - 3);
+    binary += torn;
+    expect += torn;
+
+    AutoBuffer text;
+    LogBinaryRecord::Render(binary.data(), binary.size(), text);
+    EXPECT_EQ(expect, std::string((const char*)text.Ptr(), text.Length()));
+}
+
+TEST(log_binary_record, decoded_from_appender) {
+    std::string dir = boost::filesystem::temp_directory_path().string() + "/log_binary_record_unittest";
+    boost::filesystem::remove_all(dir);
+    boost::filesystem::create_directories(dir);
+
+    XLogConfig config;
+    config.mode_ = kAppenderAsync;
+    config.logdir_ = dir;
+    config.nameprefix_ = "binary";
+    config.compress_mode_ = kZstd;
+    config.binary_record_ = true;
+    XloggerAppender* appender = XloggerAppender::NewInstance(config);
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    std::string expect;
+    for (int i = 0; i < 100; ++i) {
+        XLoggerInfo info = __Info(0 == i % 10 ? kLevelWarn : kLevelInfo, "stn", i, now.tv_sec, 4242 + i % 3);
+        char body[64];
+        snprintf(body, sizeof(body), "binary line %d", i);
+        appender->Write(&info, body);
+        expect += __Text(&info, body);
+    }
+    appender->FlushSync();
+
+    std::vector<std::string> files;
+    ASSERT_TRUE(appender->GetfilepathFromTimespan(0, "binary", files));
+    XloggerAppender::Release(appender);
+    ASSERT_EQ(1u, files.size());
+
+    XlogDecoder decoder;
+    std::string err;
+    ASSERT_TRUE(decoder.Open(files[0].c_str(), err)) << err;
+    std::string decoded;
+    for (size_t i = 0; i < decoder.Blocks().size(); ++i) {
+        AutoBuffer out;
+        ASSERT_TRUE(decoder.DecodeBlock(i, out, err)) << err;
+        decoded.append((const char*)out.Ptr(), out.Length());
+    }
+    decoder.Close();
+    boost::filesystem::remove_all(dir);
+
+    EXPECT_NE(std::string::npos, decoded.find(expect));
+    EXPECT_EQ(std::string::npos, decoded.find(LogBinaryRecord::kMagic));
+}
+
+EXPORT_GTEST_SYMBOLS(log_export_log_binary_record_unittest)
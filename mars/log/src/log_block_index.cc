@@ -0,0 +1,415 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * log_block_index.cc
+ *
+ *  Created on: 2026-10-18
+ */
+
+#include "log_block_index.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "boost/filesystem.hpp"
+#include "boost/iostreams/device/mapped_file.hpp"
+
+#include "log/crypt/log_crypt.h"
+#include "xlog_decoder.h"
+
+#ifdef _WIN32
+#define fileno _fileno
+#endif
+
+static const char kIndexMagic[4] = {'X', 'I', 'D', 'X'};
+static const uint16_t kIndexVersion = 1;
+static const long kIndexHeaderLen = 16;     // |magic(4)|version(uint16_t)|entry len(uint16_t)|reserved(8)|
+
+static const uint64_t kAttrLevelUnknown = 0xff;
+static const uint64_t kAttrHasTag = 1ULL << 52;
+
+static uint32_t __Hash(const char* _str) {
+    uint32_t hash = 2166136261u;    // fnv-1a
+    for (; '\0' != *_str; ++_str) {
+        hash ^= (uint8_t)*_str;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t __ClampTime(time_t _time) {
+    if (_time < 0) return 0;
+    if ((uint64_t)_time > 0xffffffffULL) return 0xffffffffu;
+    return (uint32_t)_time;
+}
+
+// appender file names end with _YYYYMMDD[_N].xlog, otherwise the day the file was last written
+static bool __FileDay(const std::string& _log_path, tm& _day) {
+    std::string name = boost::filesystem::path(_log_path).filename().string();
+
+    for (size_t pos = name.rfind('_'); std::string::npos != pos; pos = (0 == pos ? std::string::npos : name.rfind('_', pos - 1))) {
+        if (name.size() < pos + 9) continue;
+
+        bool digits = true;
+        for (size_t i = pos + 1; i < pos + 9 && digits; ++i) digits = (0 != isdigit((unsigned char)name[i]));
+        if (!digits || (name.size() > pos + 9 && isdigit((unsigned char)name[pos + 9]))) continue;
+
+        int date = atoi(name.substr(pos + 1, 8).c_str());
+        memset(&_day, 0, sizeof(_day));
+        _day.tm_year = date / 10000 - 1900;
+        _day.tm_mon = date / 100 % 100 - 1;
+        _day.tm_mday = date % 100;
+        return true;
+    }
+
+    struct stat st;
+    if (0 != stat(_log_path.c_str(), &st)) return false;
+    time_t mtime = st.st_mtime;
+    _day = *localtime(&mtime);
+    return true;
+}
+
+static time_t __LocalTime(const tm& _day, int _hour, int _min, int _sec) {
+    tm local = _day;
+    local.tm_hour = _hour;
+    local.tm_min = _min;
+    local.tm_sec = _sec;
+    local.tm_isdst = -1;
+    return mktime(&local);
+}
+
+const uint16_t LogBlockIndex::kFlagApprox;
+
+std::string LogBlockIndex::IndexPath(const std::string& _log_path) {
+    return _log_path + ".idx";
+}
+
+uint64_t LogBlockIndex::TagBloom(const char* _tag) {
+    uint32_t hash = __Hash(NULL == _tag ? "" : _tag);
+    return (1ULL << (hash & 63)) | (1ULL << ((hash >> 6) & 63));
+}
+
+void LogBlockIndex::ResetMeta(LogIndexEntry& _meta) {
+    memset(&_meta, 0, sizeof(_meta));
+    _meta.first_time = 0xffffffffu;
+    _meta.min_level = kLevelNone;
+    _meta.max_level = kLevelAll;
+}
+
+bool LogBlockIndex::EmptyMeta(const LogIndexEntry& _meta) {
+    return _meta.first_time > _meta.last_time;
+}
+
+// |time(32)|level(8)|tag bit 1(6)|tag bit 2(6)|has tag(1)|
+uint64_t LogBlockIndex::LineAttr(const XLoggerInfo* _info) {
+    if (NULL == _info) return __ClampTime(time(NULL)) | (kAttrLevelUnknown << 32);
+
+    uint64_t attr = __ClampTime(_info->timeval.tv_sec) | ((uint64_t)(uint8_t)_info->level << 32);
+    if (NULL != _info->tag && '\0' != *_info->tag) {
+        uint32_t hash = __Hash(_info->tag);
+        attr |= ((uint64_t)(hash & 63) << 40) | ((uint64_t)((hash >> 6) & 63) << 46) | kAttrHasTag;
+    }
+    return attr;
+}
+
+void LogBlockIndex::AddLine(LogIndexEntry& _meta, uint64_t _attr) {
+    uint32_t time = (uint32_t)_attr;
+    _meta.first_time = std::min(_meta.first_time, time);
+    _meta.last_time = std::max(_meta.last_time, time);
+
+    uint8_t level = (uint8_t)(_attr >> 32);
+    if (kAttrLevelUnknown == level) {
+        // lines of the appender itself, no level and no tag
+        _meta.min_level = kLevelAll;
+        _meta.max_level = kLevelFatal;
+        _meta.tag_bloom = ~0ULL;
+        return;
+    }
+
+    _meta.min_level = std::min(_meta.min_level, level);
+    _meta.max_level = std::max(_meta.max_level, level);
+    if (0 != (_attr & kAttrHasTag)) {
+        _meta.tag_bloom |= (1ULL << ((_attr >> 40) & 63)) | (1ULL << ((_attr >> 46) & 63));
+    }
+}
+
+bool LogBlockIndex::__ReadIndex(FILE* _file, std::vector<LogIndexEntry>* _entries, uint64_t& _covered_end, long& _valid_len) {
+    _covered_end = 0;
+    _valid_len = 0;
+
+    if (0 != fseek(_file, 0, SEEK_END)) return false;
+    long size = ftell(_file);
+    if (size < kIndexHeaderLen || 0 != fseek(_file, 0, SEEK_SET)) return false;
+
+    char header[kIndexHeaderLen];
+    if (1 != fread(header, sizeof(header), 1, _file)) return false;
+
+    uint16_t version = 0, entry_len = 0;
+    memcpy(&version, header + 4, sizeof(version));
+    memcpy(&entry_len, header + 6, sizeof(entry_len));
+    if (0 != memcmp(header, kIndexMagic, sizeof(kIndexMagic)) || kIndexVersion != version || sizeof(LogIndexEntry) != entry_len) return false;
+
+    // a torn entry at the end is dropped
+    size_t count = (size - kIndexHeaderLen) / sizeof(LogIndexEntry);
+    _valid_len = kIndexHeaderLen + (long)(count * sizeof(LogIndexEntry));
+    if (0 == count) return true;
+
+    LogIndexEntry last;
+    if (NULL != _entries) {
+        size_t begin = _entries->size();
+        _entries->resize(begin + count);
+        if (count != fread(&(*_entries)[begin], sizeof(LogIndexEntry), count, _file)) return false;
+        last = _entries->back();
+    } else {
+        if (0 != fseek(_file, _valid_len - (long)sizeof(LogIndexEntry), SEEK_SET)) return false;
+        if (1 != fread(&last, sizeof(last), 1, _file)) return false;
+    }
+
+    _covered_end = last.offset + last.length;
+    return true;
+}
+
+// approximate entries of the blocks in [_begin, _end) of the log file
+bool LogBlockIndex::__ScanLog(const std::string& _log_path, uint64_t _begin, uint64_t _end, std::vector<LogIndexEntry>& _entries) {
+    if (_begin >= _end) return true;
+
+    tm day;
+    if (!__FileDay(_log_path, day)) return false;
+
+    boost::iostreams::mapped_file_source file;
+    file.open(_log_path);
+    if (!file.is_open()) return false;
+
+    _end = std::min(_end, (uint64_t)file.size());
+    if (_begin >= _end) return true;
+
+    XlogDecoder decoder;
+    std::string err;
+    if (!decoder.Open(file.data() + _begin, (size_t)(_end - _begin), err)) return false;
+
+    const std::vector<XlogDecoder::Block>& blocks = decoder.Blocks();
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        const XlogDecoder::Block& block = blocks[i];
+
+        LogIndexEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.offset = _begin + block.offset;
+        entry.length = LogCrypt::GetHeaderLen() + block.body_len + LogCrypt::GetTailerLen();
+        // the block is flushed on the day of the file, it may have been begun the day before
+        time_t first = __LocalTime(day, block.begin_hour, 0, 0);
+        if (block.begin_hour > block.end_hour) first -= 24 * 60 * 60;
+        entry.first_time = __ClampTime(first);
+        entry.last_time = __ClampTime(__LocalTime(day, block.end_hour, 59, 59));
+        entry.min_level = kLevelAll;
+        entry.max_level = kLevelFatal;
+        entry.flags = kFlagApprox;
+        entry.tag_bloom = ~0ULL;
+        _entries.push_back(entry);
+    }
+
+    return true;
+}
+
+bool LogBlockIndex::__WriteHeader(FILE* _file) {
+    char header[kIndexHeaderLen] = {0};
+    uint16_t entry_len = sizeof(LogIndexEntry);
+    memcpy(header, kIndexMagic, sizeof(kIndexMagic));
+    memcpy(header + 4, &kIndexVersion, sizeof(kIndexVersion));
+    memcpy(header + 6, &entry_len, sizeof(entry_len));
+    return 1 == fwrite(header, sizeof(header), 1, _file);
+}
+
+bool LogBlockIndex::Load(const std::string& _log_path, std::vector<LogIndexEntry>& _entries, std::string& _err) {
+    _entries.clear();
+
+    struct stat st;
+    if (0 != stat(_log_path.c_str(), &st)) {
+        _err = std::string("stat log file fail: ") + strerror(errno);
+        return false;
+    }
+    uint64_t log_size = (uint64_t)st.st_size;
+
+    uint64_t covered_end = 0;
+    FILE* file = fopen(IndexPath(_log_path).c_str(), "rb");
+    if (NULL != file) {
+        long valid_len = 0;
+        if (!__ReadIndex(file, &_entries, covered_end, valid_len)) {
+            _entries.clear();
+            covered_end = 0;
+        }
+        fclose(file);
+    }
+
+    // the log file was replaced or truncated behind the index
+    if (covered_end > log_size) {
+        _entries.clear();
+        covered_end = 0;
+    }
+
+    if (!__ScanLog(_log_path, covered_end, log_size, _entries)) {
+        _err = "scan log file fail";
+        return false;
+    }
+    return true;
+}
+
+bool LogBlockIndex::Rebuild(const std::string& _log_path, std::string& _err) {
+    boost::filesystem::remove(IndexPath(_log_path));
+
+    std::vector<LogIndexEntry> entries;
+    if (!Load(_log_path, entries, _err)) return false;
+
+    std::string tmp_path = IndexPath(_log_path) + ".tmp";
+    FILE* file = fopen(tmp_path.c_str(), "wb");
+    if (NULL == file) {
+        _err = std::string("open index file fail: ") + strerror(errno);
+        return false;
+    }
+
+    bool ok = __WriteHeader(file) && (entries.empty() || 1 == fwrite(&entries[0], sizeof(LogIndexEntry) * entries.size(), 1, file));
+    ok = (0 == fclose(file)) && ok;
+    if (!ok || 0 != rename(tmp_path.c_str(), IndexPath(_log_path).c_str())) {
+        _err = "write index file fail";
+        remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool LogBlockIndex::Query(const std::string& _log_path, time_t _begin_time, time_t _end_time, TLogLevel _min_level,
+                          const char* _tag, std::vector<Range>& _ranges, std::string& _err) {
+    _ranges.clear();
+
+    std::vector<LogIndexEntry> entries;
+    if (!Load(_log_path, entries, _err)) return false;
+    if (entries.empty()) return true;
+
+    // blocks are mostly in time order, but the mmap of a crashed process or a clock change can go back,
+    // so search on the running max of last_time and the running min of first_time from the end
+    size_t count = entries.size();
+    std::vector<uint32_t> reach(count), floor(count);
+    for (size_t i = 0; i < count; ++i) {
+        reach[i] = 0 == i ? entries[i].last_time : std::max(reach[i - 1], entries[i].last_time);
+        size_t j = count - 1 - i;
+        floor[j] = 0 == i ? entries[j].first_time : std::min(floor[j + 1], entries[j].first_time);
+    }
+
+    uint32_t begin_time = __ClampTime(_begin_time);
+    uint32_t end_time = __ClampTime(_end_time);
+    size_t begin = std::lower_bound(reach.begin(), reach.end(), begin_time) - reach.begin();
+    size_t end = std::upper_bound(floor.begin(), floor.end(), end_time) - floor.begin();
+    uint64_t tag_bits = NULL == _tag ? 0 : TagBloom(_tag);
+
+    for (size_t i = begin; i < end; ++i) {
+        const LogIndexEntry& entry = entries[i];
+        if (entry.first_time > end_time || entry.last_time < begin_time) continue;
+        if (entry.max_level < (uint8_t)_min_level) continue;
+        if ((entry.tag_bloom & tag_bits) != tag_bits) continue;
+
+        if (!_ranges.empty() && _ranges.back().offset + _ranges.back().length == entry.offset) {
+            _ranges.back().length += entry.length;
+        } else {
+            Range range = {entry.offset, entry.length};
+            _ranges.push_back(range);
+        }
+    }
+    return true;
+}
+
+LogBlockIndex::LogBlockIndex(): file_(NULL), covered_end_(0) {
+}
+
+LogBlockIndex::~LogBlockIndex() {
+    Close();
+}
+
+bool LogBlockIndex::Open(const std::string& _log_path) {
+    Close();
+
+    std::string path = IndexPath(_log_path);
+    file_ = fopen(path.c_str(), "r+b");
+    if (NULL == file_) file_ = fopen(path.c_str(), "w+b");
+    if (NULL == file_) return false;
+
+    log_path_ = _log_path;
+
+    long valid_len = 0;
+    if (!__ReadIndex(file_, NULL, covered_end_, valid_len)) return __Truncate();
+
+    struct stat st;
+    uint64_t log_size = 0 == stat(_log_path.c_str(), &st) ? (uint64_t)st.st_size : 0;
+    if (covered_end_ > log_size) return __Truncate();
+
+    if (0 == fseek(file_, 0, SEEK_END) && ftell(file_) != valid_len) {
+        fflush(file_);
+        ftruncate(fileno(file_), valid_len);
+    }
+    return true;
+}
+
+void LogBlockIndex::Close() {
+    if (NULL == file_) return;
+
+    fclose(file_);
+    file_ = NULL;
+    covered_end_ = 0;
+}
+
+bool LogBlockIndex::__Truncate() {
+    fflush(file_);
+    if (0 != ftruncate(fileno(file_), 0) || 0 != fseek(file_, 0, SEEK_SET) || !__WriteHeader(file_)) {
+        Close();
+        return false;
+    }
+    fflush(file_);
+    covered_end_ = 0;
+    return true;
+}
+
+bool LogBlockIndex::Append(uint64_t _offset, uint32_t _length, const LogIndexEntry* _meta) {
+    if (NULL == file_) return false;
+
+    if (covered_end_ > _offset && !__Truncate()) return false;
+
+    std::vector<LogIndexEntry> entries;
+    __ScanLog(log_path_, covered_end_, _offset, entries);
+
+    if (NULL != _meta && !EmptyMeta(*_meta)) {
+        LogIndexEntry entry = *_meta;
+        entry.offset = _offset;
+        entry.length = _length;
+        entry.flags = 0;
+        entries.push_back(entry);
+    } else {
+        __ScanLog(log_path_, _offset, _offset + _length, entries);
+    }
+
+    if (0 != fseek(file_, 0, SEEK_END)) {
+        Close();
+        return false;
+    }
+
+    if (!entries.empty() && 1 != fwrite(&entries[0], sizeof(LogIndexEntry) * entries.size(), 1, file_)) {
+        // a torn entry is dropped by the next Open
+        Close();
+        return false;
+    }
+
+    fflush(file_);
+    covered_end_ = _offset + _length;
+    return true;
+}
@@ -0,0 +1,113 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * log_block_index.h
+ *
+ *  Created on: 2026-10-18
+ */
+
+#ifndef LOG_BLOCK_INDEX_H_
+#define LOG_BLOCK_INDEX_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "mars/comm/xlogger/xloggerbase.h"
+
+/*
+ * One entry per block of a log file, 32 bytes in the index file.
+ * Block headers only know the hours a block was begun and flushed, the appender knows every line.
+ */
+struct LogIndexEntry {
+    uint64_t offset;        // of the block in the log file
+    uint32_t length;        // header, body and tail
+    uint32_t first_time;    // seconds since epoch of the oldest line
+    uint32_t last_time;     // and of the newest
+    uint8_t  min_level;     // TLogLevel
+    uint8_t  max_level;
+    uint16_t flags;
+    uint64_t tag_bloom;     // two bits per tag, see LogBlockIndex::TagBloom
+};
+
+/*
+ * Sidecar "<log file>.idx": a 16 bytes header and a LogIndexEntry per block, in file order.
+ * The appender appends an entry behind every block it writes. Blocks it cannot describe (mmap recovery,
+ * tips, a crash between the two writes, an index deleted by hand) get an approximate entry from the
+ * block header instead: the hour range on the day of the file name, every level and every tag.
+ * So a missing or stale index is rebuilt from the log file itself and queries stay correct, only wider.
+ *
+ *   std::vector<LogBlockIndex::Range> ranges;
+ *   LogBlockIndex::Query(path, begin, end, kLevelWarn, "stn", ranges, err);   // then seek and decode ranges
+ */
+class LogBlockIndex {
+  public:
+    static const uint16_t kFlagApprox = 0x01;  // from the block header, not from the lines
+
+    struct Range {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    static std::string IndexPath(const std::string& _log_path);
+    static uint64_t TagBloom(const char* _tag);
+
+    // the meta of a block is the merge of its lines, a line travels as a 64 bits attr through LogRingBuffer
+    static void ResetMeta(LogIndexEntry& _meta);
+    static bool EmptyMeta(const LogIndexEntry& _meta);
+    static uint64_t LineAttr(const XLoggerInfo* _info);
+    static void AddLine(LogIndexEntry& _meta, uint64_t _attr);
+
+    // the entries of _log_path, missing or stale parts are filled in from the log file
+    static bool Load(const std::string& _log_path, std::vector<LogIndexEntry>& _entries, std::string& _err);
+    static bool Rebuild(const std::string& _log_path, std::string& _err);
+
+    // byte ranges of the blocks that may hold lines of [_begin_time, _end_time] at _min_level or above,
+    // tagged _tag if not NULL; adjacent blocks are merged into one range
+    static bool Query(const std::string& _log_path, time_t _begin_time, time_t _end_time, TLogLevel _min_level,
+                      const char* _tag, std::vector<Range>& _ranges, std::string& _err);
+
+  public:
+    LogBlockIndex();
+    ~LogBlockIndex();
+
+    bool Open(const std::string& _log_path);
+    void Close();
+    bool IsOpen() const { return NULL != file_; }
+    const std::string& LogPath() const { return log_path_; }
+
+    // true if the entry of a block at _offset needs no look at the log file
+    bool Covers(uint64_t _offset) const { return NULL != file_ && covered_end_ == _offset; }
+
+    // _meta NULL or empty: the entry is taken from the block header. The log file must be flushed up to
+    // _offset + _length unless Covers(_offset) and _meta is set.
+    bool Append(uint64_t _offset, uint32_t _length, const LogIndexEntry* _meta);
+
+  private:
+    LogBlockIndex(const LogBlockIndex&);
+    LogBlockIndex& operator=(const LogBlockIndex&);
+
+    static bool __ReadIndex(FILE* _file, std::vector<LogIndexEntry>* _entries, uint64_t& _covered_end, long& _valid_len);
+    static bool __ScanLog(const std::string& _log_path, uint64_t _begin, uint64_t _end, std::vector<LogIndexEntry>& _entries);
+    static bool __WriteHeader(FILE* _file);
+    bool __Truncate();
+
+  private:
+    std::string log_path_;
+    FILE* file_;
+    uint64_t covered_end_;
+};
+
+#endif /* LOG_BLOCK_INDEX_H_ */
@@ -0,0 +1,230 @@
+#include "log_block_index.h"
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <string>
+
+#include "boost/filesystem.hpp"
+
+#include "log_zstd_buffer.h"
+#include "xlogger_appender.h"
+
+using namespace testing;
+
+static const size_t kBlockLength = 150 * 1024;
+
+static time_t __Time(int _hour, int _min) {
+    tm day;
+    memset(&day, 0, sizeof(day));
+    day.tm_year = 2026 - 1900;
+    day.tm_mon = 9;
+    day.tm_mday = 18;
+    day.tm_hour = _hour;
+    day.tm_min = _min;
+    day.tm_isdst = -1;
+    return mktime(&day);
+}
+
+class LogBlockIndexTest : public Test {
+  protected:
+    virtual void SetUp() {
+        dir_ = boost::filesystem::temp_directory_path().string() + "/log_block_index_unittest";
+        boost::filesystem::remove_all(dir_);
+        boost::filesystem::create_directories(dir_);
+        path_ = dir_ + "/test_20261018.xlog";
+        mem_ = new char[kBlockLength];
+        buffer_ = new LogZstdBuffer(mem_, kBlockLength, true, "", 3);
+    }
+
+    virtual void TearDown() {
+        delete buffer_;
+        delete[] mem_;
+        boost::filesystem::remove_all(dir_);
+    }
+
+    // a sync block of one line at _hour:_min, indexed if _index is set
+    void __Append(LogBlockIndex* _index, int _hour, int _min, TLogLevel _level, const char* _tag) {
+        XLoggerInfo info;
+        memset(&info, 0, sizeof(info));
+        info.level = _level;
+        info.tag = _tag;
+        info.timeval.tv_sec = __Time(_hour, _min);
+
+        char line[128];
+        int len = snprintf(line, sizeof(line), "[%d][%s] line at %02d:%02d\n", _level, _tag, _hour, _min);
+        AutoBuffer block;
+        ASSERT_TRUE(buffer_->Write(line, len, block));
+
+        FILE* file = fopen(path_.c_str(), "ab");
+        ASSERT_TRUE(NULL != file);
+        fseek(file, 0, SEEK_END);
+        uint64_t offset = ftell(file);
+        ASSERT_EQ(1u, fwrite(block.Ptr(), block.Length(), 1, file));
+        fclose(file);
+
+        offsets_.push_back(offset);
+        lengths_.push_back(block.Length());
+        if (NULL == _index) return;
+
+        LogIndexEntry meta;
+        LogBlockIndex::ResetMeta(meta);
+        LogBlockIndex::AddLine(meta, LogBlockIndex::LineAttr(&info));
+        ASSERT_TRUE(_index->Append(offset, (uint32_t)block.Length(), &meta));
+    }
+
+    std::vector<LogBlockIndex::Range> __Query(time_t _begin, time_t _end, TLogLevel _level, const char* _tag) {
+        std::vector<LogBlockIndex::Range> ranges;
+        std::string err;
+        EXPECT_TRUE(LogBlockIndex::Query(path_, _begin, _end, _level, _tag, ranges, err));
+        return ranges;
+    }
+
+    std::string dir_;
+    std::string path_;
+    char* mem_;
+    LogBaseBuffer* buffer_;
+    std::vector<uint64_t> offsets_;
+    std::vector<uint64_t> lengths_;
+};
+
+TEST_F(LogBlockIndexTest, query_exact) {
+    LogBlockIndex index;
+    ASSERT_TRUE(index.Open(path_));
+    __Append(&index, 10, 0, kLevelInfo, "stn");
+    __Append(&index, 10, 10, kLevelError, "stn");
+    __Append(&index, 10, 20, kLevelInfo, "sdt");
+    __Append(&index, 11, 30, kLevelWarn, "stn");
+    index.Close();
+
+    std::vector<LogIndexEntry> entries;
+    std::string err;
+    ASSERT_TRUE(LogBlockIndex::Load(path_, entries, err));
+    ASSERT_EQ(4u, entries.size());
+    EXPECT_EQ(0, entries[3].flags);
+    EXPECT_EQ((uint32_t)__Time(11, 30), entries[3].first_time);
+
+    // time only, adjacent blocks come back as one range
+    std::vector<LogBlockIndex::Range> ranges = __Query(__Time(10, 5), __Time(10, 25), kLevelAll, NULL);
+    ASSERT_EQ(1u, ranges.size());
+    EXPECT_EQ(offsets_[1], ranges[0].offset);
+    EXPECT_EQ(lengths_[1] + lengths_[2], ranges[0].length);
+
+    ranges = __Query(__Time(9, 0), __Time(12, 0), kLevelWarn, NULL);
+    ASSERT_EQ(2u, ranges.size());
+    EXPECT_EQ(offsets_[1], ranges[0].offset);
+    EXPECT_EQ(offsets_[3], ranges[1].offset);
+
+    ranges = __Query(__Time(9, 0), __Time(12, 0), kLevelAll, "sdt");
+    ASSERT_EQ(1u, ranges.size());
+    EXPECT_EQ(offsets_[2], ranges[0].offset);
+    EXPECT_EQ(lengths_[2], ranges[0].length);
+
+    EXPECT_TRUE(__Query(__Time(12, 0), __Time(13, 0), kLevelAll, NULL).empty());
+    EXPECT_TRUE(__Query(__Time(9, 0), __Time(12, 0), kLevelFatal, NULL).empty());
+}
+
+TEST_F(LogBlockIndexTest, rebuilt_from_block_headers) {
+    {
+        LogBlockIndex index;
+        ASSERT_TRUE(index.Open(path_));
+        __Append(&index, 10, 0, kLevelInfo, "stn");
+        __Append(&index, 11, 0, kLevelInfo, "stn");
+    }
+    boost::filesystem::remove(LogBlockIndex::IndexPath(path_));
+
+    // hours of the block headers are the hours the blocks were written, not the times of the lines
+    std::vector<LogIndexEntry> entries;
+    std::string err;
+    ASSERT_TRUE(LogBlockIndex::Load(path_, entries, err));
+    ASSERT_EQ(2u, entries.size());
+    EXPECT_EQ(LogBlockIndex::kFlagApprox, entries[0].flags);
+    EXPECT_EQ(offsets_[1], entries[1].offset);
+    EXPECT_EQ(lengths_[1], entries[1].length);
+
+    ASSERT_TRUE(LogBlockIndex::Rebuild(path_, err));
+    ASSERT_TRUE(boost::filesystem::exists(LogBlockIndex::IndexPath(path_)));
+
+    // approximate entries match every level and tag of their hours
+    std::vector<LogBlockIndex::Range> ranges = __Query(__Time(0, 0), __Time(23, 59), kLevelFatal, "any");
+    ASSERT_EQ(1u, ranges.size());
+    EXPECT_EQ(0u, ranges[0].offset);
+    EXPECT_EQ(lengths_[0] + lengths_[1], ranges[0].length);
+}
+
+TEST_F(LogBlockIndexTest, gap_filled) {
+    __Append(NULL, 10, 0, kLevelInfo, "stn");
+    __Append(NULL, 10, 1, kLevelInfo, "stn");
+
+    LogBlockIndex index;
+    ASSERT_TRUE(index.Open(path_));
+    EXPECT_FALSE(index.Covers(offsets_[1] + lengths_[1]));
+    __Append(&index, 10, 2, kLevelError, "stn");
+    EXPECT_TRUE(index.Covers(offsets_[2] + lengths_[2]));
+    index.Close();
+
+    std::vector<LogIndexEntry> entries;
+    std::string err;
+    ASSERT_TRUE(LogBlockIndex::Load(path_, entries, err));
+    ASSERT_EQ(3u, entries.size());
+    EXPECT_EQ(LogBlockIndex::kFlagApprox, entries[0].flags);
+    EXPECT_EQ(LogBlockIndex::kFlagApprox, entries[1].flags);
+    EXPECT_EQ(0, entries[2].flags);
+    EXPECT_EQ(kLevelError, entries[2].min_level);
+
+    // a log file rewritten behind the index starts it over
+    boost::filesystem::resize_file(path_, 0);
+    ASSERT_TRUE(index.Open(path_));
+    EXPECT_TRUE(index.Covers(0));
+}
+
+TEST_F(LogBlockIndexTest, appender_sync) {
+    XLogConfig config;
+    config.mode_ = kAppenderSync;
+    config.logdir_ = dir_;
+    config.nameprefix_ = "sync";
+    config.compress_mode_ = kZstd;
+    config.block_index_ = true;
+    XloggerAppender* appender = XloggerAppender::NewInstance(config);
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    XLoggerInfo info;
+    memset(&info, 0, sizeof(info));
+    info.timeval = now;
+    for (int i = 0; i < 20; ++i) {
+        info.level = 0 == i % 8 ? kLevelError : kLevelDebug;
+        info.tag = 0 == i % 4 ? "stn" : "cdn";
+        appender->Write(&info, "indexed line");
+    }
+
+    std::vector<std::string> files;
+    ASSERT_TRUE(appender->GetfilepathFromTimespan(0, "sync", files));
+    XloggerAppender::Release(appender);
+    ASSERT_EQ(1u, files.size());
+
+    std::vector<LogIndexEntry> entries;
+    std::string err;
+    ASSERT_TRUE(LogBlockIndex::Load(files[0], entries, err));
+    size_t exact = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (0 == entries[i].flags) ++exact;
+    }
+    EXPECT_LE(20u, exact);
+
+    // the appender's own lines match every query, the lines of stn and the debug lines of cdn are left out
+    uint64_t lens[3] = {0};
+    const char* tags[3] = {NULL, "cdn", "cdn"};
+    TLogLevel levels[3] = {kLevelAll, kLevelAll, kLevelError};
+    for (int i = 0; i < 3; ++i) {
+        std::vector<LogBlockIndex::Range> ranges;
+        ASSERT_TRUE(LogBlockIndex::Query(files[0], now.tv_sec, now.tv_sec, levels[i], tags[i], ranges, err));
+        for (size_t j = 0; j < ranges.size(); ++j) lens[i] += ranges[j].length;
+    }
+    EXPECT_EQ(boost::filesystem::file_size(files[0]), lens[0]);
+    EXPECT_LT(lens[1], lens[0]);
+    EXPECT_LT(lens[2], lens[1]);
+}
+
+EXPORT_GTEST_SYMBOLS(log_export_log_block_index_unittest)
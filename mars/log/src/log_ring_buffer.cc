@@ -0,0 +1,121 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * log_ring_buffer.cc
+ *
+ *  Created on: 2026-10-18
+ */
+
+#include "log_ring_buffer.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "log_block_index.h"
+
+LogRingBuffer::LogRingBuffer(size_t _capacity)
+: buffer_(NULL), capacity_(1), mask_(0), head_(0), tail_(0), ref_(2), producer_exited_(false) {
+    while (capacity_ < _capacity) capacity_ <<= 1;
+    mask_ = capacity_ - 1;
+    buffer_ = (char*)malloc(capacity_);
+}
+
+LogRingBuffer::~LogRingBuffer() {
+    free(buffer_);
+}
+
+bool LogRingBuffer::Push(const void* _data, size_t _len, uint64_t _attr) {
+    if (NULL == buffer_ || NULL == _data || 0 == _len) return false;
+
+    uint32_t record_len = (uint32_t)_len;
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+
+    if (capacity_ - (tail - head) < sizeof(record_len) + sizeof(_attr) + _len) return false;
+
+    __CopyIn(tail, &record_len, sizeof(record_len));
+    __CopyIn(tail + sizeof(record_len), &_attr, sizeof(_attr));
+    __CopyIn(tail + sizeof(record_len) + sizeof(_attr), _data, _len);
+
+    tail_.store(tail + sizeof(record_len) + sizeof(_attr) + _len, std::memory_order_release);
+    return true;
+}
+
+void LogRingBuffer::MarkProducerExited() {
+    producer_exited_.store(true, std::memory_order_release);
+}
+
+bool LogRingBuffer::Pop(AutoBuffer& _out, size_t _max_len, LogIndexEntry* _meta) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    size_t pop_len = 0;
+
+    while (head != tail) {
+        uint32_t record_len = 0;
+        uint64_t attr = 0;
+        __CopyOut(head, &record_len, sizeof(record_len));
+        assert(tail - head >= sizeof(record_len) + sizeof(attr) + record_len);
+
+        if (pop_len + record_len > _max_len) break;
+
+        __CopyOut(head + sizeof(record_len), &attr, sizeof(attr));
+        if (NULL != _meta) LogBlockIndex::AddLine(*_meta, attr);
+
+        _out.AllocWrite(record_len, false);
+        __CopyOut(head + sizeof(record_len) + sizeof(attr), _out.PosPtr(), record_len);
+        _out.Length(_out.Pos() + record_len, _out.Length() + record_len);
+
+        head += sizeof(record_len) + sizeof(attr) + record_len;
+        pop_len += record_len;
+    }
+
+    head_.store(head, std::memory_order_release);
+    return head == tail;
+}
+
+bool LogRingBuffer::ProducerExited() const {
+    return producer_exited_.load(std::memory_order_acquire);
+}
+
+size_t LogRingBuffer::Length() const {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+}
+
+size_t LogRingBuffer::Capacity() const {
+    return capacity_;
+}
+
+bool LogRingBuffer::Empty() const {
+    return 0 == Length();
+}
+
+void LogRingBuffer::Release() {
+    if (1 == ref_.fetch_sub(1, std::memory_order_acq_rel)) {
+        delete this;
+    }
+}
+
+void LogRingBuffer::__CopyIn(size_t _pos, const void* _data, size_t _len) {
+    size_t offset = _pos & mask_;
+    size_t first = capacity_ - offset < _len ? capacity_ - offset : _len;
+    memcpy(buffer_ + offset, _data, first);
+    memcpy(buffer_, (const char*)_data + first, _len - first);
+}
+
+void LogRingBuffer::__CopyOut(size_t _pos, void* _data, size_t _len) const {
+    size_t offset = _pos & mask_;
+    size_t first = capacity_ - offset < _len ? capacity_ - offset : _len;
+    memcpy(_data, buffer_ + offset, first);
+    memcpy((char*)_data + first, buffer_, _len - first);
+}
@@ -0,0 +1,82 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * log_ring_buffer.h
+ *
+ *  Created on: 2026-10-18
+ */
+
+#ifndef LOGRINGBUFFER_H_
+#define LOGRINGBUFFER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#include "mars/comm/autobuffer.h"
+
+struct LogIndexEntry;
+
+/*
+ * Single producer / single consumer ring of formatted log lines.
+ *
+ * Every record is stored as |length(uint32_t)|attr(uint64_t)|data|, the producer publishes a record only
+ * after it has been copied completely, so the consumer always pops whole lines. attr is the
+ * LogBlockIndex::LineAttr of the line, merged into the meta of the block the line is popped into.
+ * The ring is shared between the logging thread and the async thread, so it is reference counted:
+ * both sides hold one reference and whoever releases last frees it.
+ */
+class LogRingBuffer {
+  public:
+    explicit LogRingBuffer(size_t _capacity);     // rounded up to power of 2
+
+  private:
+    ~LogRingBuffer();
+    LogRingBuffer(const LogRingBuffer&);
+    LogRingBuffer& operator=(const LogRingBuffer&);
+
+  public:
+    // producer
+    bool Push(const void* _data, size_t _len, uint64_t _attr = 0);
+    void MarkProducerExited();
+
+    // consumer, appends payloads of whole records to _out until _max_len would be exceeded.
+    // returns false if it stopped because of _max_len. attrs of the popped lines go to _meta if not NULL.
+    bool Pop(AutoBuffer& _out, size_t _max_len, LogIndexEntry* _meta = NULL);
+    bool ProducerExited() const;
+
+    size_t Length() const;
+    size_t Capacity() const;
+    bool Empty() const;
+
+    void Release();
+
+  private:
+    void __CopyIn(size_t _pos, const void* _data, size_t _len);
+    void __CopyOut(size_t _pos, void* _data, size_t _len) const;
+
+  private:
+    char* buffer_;
+    size_t capacity_;
+    size_t mask_;
+
+    std::atomic<size_t> head_;      // read index, written by consumer only
+    char pad_head_[64];
+    std::atomic<size_t> tail_;      // write index, written by producer only
+    char pad_tail_[64];
+
+    std::atomic<int> ref_;
+    std::atomic<bool> producer_exited_;
+};
+
+#endif /* LOGRINGBUFFER_H_ */
@@ -0,0 +1,77 @@
+#include "log_ring_buffer.h"
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "boost/bind.hpp"
+#include "mars/comm/thread/thread.h"
+
+using namespace testing;
+
+TEST(log_ring_buffer, push_pop_wrap) {
+    LogRingBuffer* ring = new LogRingBuffer(100);
+    EXPECT_EQ(ring->Capacity(), 128u);
+
+    char line[40];
+    for (int round = 0; round < 10; ++round) {
+        memset(line, 'a' + round, sizeof(line));
+        EXPECT_TRUE(ring->Push(line, sizeof(line)));
+        EXPECT_TRUE(ring->Push(line, sizeof(line)));
+        EXPECT_FALSE(ring->Push(line, sizeof(line)));    // 3 * (4 + 8 + 40) > 128
+
+        AutoBuffer out;
+        EXPECT_FALSE(ring->Pop(out, sizeof(line) + 1));
+        EXPECT_EQ(out.Length(), sizeof(line));
+        EXPECT_TRUE(ring->Pop(out, 1024));
+        EXPECT_EQ(out.Length(), 2 * sizeof(line));
+        EXPECT_EQ(((char*)out.Ptr())[2 * sizeof(line) - 1], 'a' + round);
+        EXPECT_TRUE(ring->Empty());
+    }
+
+    ring->Release();
+    ring->Release();
+}
+
+static void __ProduceRing(LogRingBuffer* _ring, int _count) {
+    char line[64];
+    for (int i = 0; i < _count;) {
+        int len = snprintf(line, sizeof(line), "%d\n", i);
+        if (_ring->Push(line, len)) ++i;
+        else ThreadUtil::yield();   // full, let the consumer run
+    }
+}
+
+TEST(log_ring_buffer, spsc_order) {
+    const int kCount = 5000;        // ~24KB through a 256 byte ring, wraps around ~100 times
+    LogRingBuffer* ring = new LogRingBuffer(256);
+    Thread producer(boost::bind(&__ProduceRing, ring, kCount));
+    producer.start();
+
+    std::string received;
+    AutoBuffer out;
+    while (producer.isruning()) {
+        out.Length(0, 0);
+        ring->Pop(out, 4096);
+        if (0 == out.Length()) ThreadUtil::yield();
+        received.append((const char*)out.Ptr(), out.Length());
+    }
+    producer.join();
+    out.Length(0, 0);
+    ring->Pop(out, 1024 * 1024);
+    received.append((const char*)out.Ptr(), out.Length());
+
+    int expect = 0;
+    size_t begin = 0;
+    for (size_t end = received.find('\n'); end != std::string::npos; begin = end + 1, end = received.find('\n', begin)) {
+        ASSERT_EQ(atoi(received.c_str() + begin), expect);
+        ++expect;
+    }
+    EXPECT_EQ(expect, kCount);
+
+    ring->Release();
+    ring->Release();
+}
+
+EXPORT_GTEST_SYMBOLS(log_export_log_ring_buffer_unittest)
@@ -40,8 +40,15 @@
 LogZlibBuffer::LogZlibBuffer(void* _pbuffer, size_t _len, bool _isCompress, const char* _pubkey)
     :LogBaseBuffer(_pbuffer, _len, _isCompress, _pubkey) {
 
+    memset(&cstream_, 0, sizeof(cstream_));
     if (is_compress_) {
-        memset(&cstream_, 0, sizeof(cstream_));
+        cstream_.zalloc = Z_NULL;
+        cstream_.zfree = Z_NULL;
+        cstream_.opaque = Z_NULL;
+
+        if (Z_OK != deflateInit2(&cstream_, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY)) {
+            memset(&cstream_, 0, sizeof(cstream_));
+        }
     }
 }
 
@@ -51,44 +58,29 @@ LogZlibBuffer::~LogZlibBuffer() {
     }
 }
 
-void LogZlibBuffer::Flush(AutoBuffer& _buff) {
-    if (is_compress_ && Z_NULL != cstream_.state) {
-        deflateEnd(&cstream_);
+size_t LogZlibBuffer::Compress(const void* src, size_t inLen, void* dst, size_t outLen){
+    if (Z_NULL == cstream_.state || Z_OK != deflateReset(&cstream_)) {
+        return -1;
     }
 
-    LogBaseBuffer::Flush(_buff);
-}
-
-size_t LogZlibBuffer::Compress(const void* src, size_t inLen, void* dst, size_t outLen){
     cstream_.avail_in = (uInt)inLen;
     cstream_.next_in = (Bytef*)src;
 
     cstream_.next_out = (Bytef*)dst;
     cstream_.avail_out = (uInt)outLen;
 
-    if (Z_OK != deflate(&cstream_, Z_SYNC_FLUSH)) {
+    if (Z_STREAM_END != deflate(&cstream_, Z_FINISH)) {
         return -1;
     }
     
     return outLen - cstream_.avail_out;
 }
 
-bool LogZlibBuffer::__Reset() {
-    if (!LogBaseBuffer::__Reset()) {
-        return false;
+size_t LogZlibBuffer::CompressBound(size_t _len) {
+    if (Z_NULL == cstream_.state) {
+        return compressBound((uLong)_len);
     }
-    
-    if (is_compress_) {
-        cstream_.zalloc = Z_NULL;
-        cstream_.zfree = Z_NULL;
-        cstream_.opaque = Z_NULL;
-
-        if (Z_OK != deflateInit2(&cstream_, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY)) {
-            return false;
-        }
-    }
-
-    return true;
+    return deflateBound(&cstream_, (uLong)_len);
 }
 
 char LogZlibBuffer::__GetMagicSyncStart() {
@@ -37,10 +37,9 @@ public:
     
 public:
     virtual size_t Compress(const void* src, size_t inLen, void* dst, size_t outLen);
-    virtual void Flush(AutoBuffer& _buff);
+    virtual size_t CompressBound(size_t _len);
 
 private:
-    bool __Reset();
     char __GetMagicSyncStart();
     char __GetMagicAsyncStart();
 
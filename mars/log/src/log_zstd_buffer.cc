@@ -36,58 +36,51 @@
 #endif
 
 
-LogZstdBuffer::LogZstdBuffer(void* _pbuffer, size_t _len, bool _isCompress, const char* _pubkey, int level)
-:LogBaseBuffer(_pbuffer, _len, _isCompress, _pubkey) {
+LogZstdBuffer::LogZstdBuffer(void* _pbuffer, size_t _len, bool _isCompress, const char* _pubkey, int level,
+                             const void* _dict, size_t _dict_len)
+:LogBaseBuffer(_pbuffer, _len, _isCompress, _pubkey), cctx_(nullptr), dict_id_(0) {
 
     if (is_compress_) {
         cctx_ = ZSTD_createCCtx();
         ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, level);
-        ZSTD_CCtx_setParameter(cctx_, ZSTD_c_windowLog, 16);
+        // a frame a block, the window covers the whole block so any line can refer to the lines before it
+        int window_log = 16;
+        while (window_log < 22 && ((size_t)1 << window_log) < _len) ++window_log;
+        ZSTD_CCtx_setParameter(cctx_, ZSTD_c_windowLog, window_log);
+
+        // a raw content dictionary has no id, decoders could not tell which one to use
+        unsigned dict_id = (nullptr == _dict || 0 == _dict_len) ? 0 : ZSTD_getDictID_fromDict(_dict, _dict_len);
+        if (0 != dict_id && !ZSTD_isError(ZSTD_CCtx_loadDictionary(cctx_, _dict, _dict_len))) {
+            dict_id_ = dict_id;
+        }
     }
 }
 
 LogZstdBuffer::~LogZstdBuffer() {
 
     if (is_compress_ && cctx_ != nullptr) {
-        ZSTD_inBuffer input = {nullptr, 0, 0};
-        ZSTD_outBuffer output = {nullptr, 0, 0};
-        ZSTD_compressStream2(cctx_, &output , &input, ZSTD_e_end);
         ZSTD_freeCCtx(cctx_);
     }
 }
 
-void LogZstdBuffer::Flush(AutoBuffer& _buff) {
-
-    if (is_compress_ && cctx_ != nullptr) {
-        ZSTD_inBuffer input = {nullptr, 0, 0 };
-        ZSTD_outBuffer output = {nullptr, 0, 0 };
-        ZSTD_compressStream2(cctx_, &output , &input, ZSTD_e_end);
-    }
-
-    LogBaseBuffer::Flush(_buff);
-}
-
 
 size_t LogZstdBuffer::Compress(const void* src, size_t inLen, void* dst, size_t outLen){
 
-    ZSTD_inBuffer input = { src, inLen, 0 };
-    ZSTD_outBuffer output = { dst, outLen,  0};
-    
-    ZSTD_compressStream2(cctx_, &output, &input, ZSTD_e_flush);
-    
-    return output.pos;
-}
-
-bool LogZstdBuffer::__Reset() {
-    if (!LogBaseBuffer::__Reset()) {
-        return false;
+    if (nullptr == cctx_) {
+        return -1;
     }
 
-    if (is_compress_) {
-        ZSTD_CCtx_reset(cctx_, ZSTD_reset_session_only);
+    // resets the session, the parameters and the dictionary stay
+    size_t ret = ZSTD_compress2(cctx_, dst, outLen, src, inLen);
+    if (ZSTD_isError(ret)) {
+        return -1;
     }
 
-    return true;
+    return ret;
+}
+
+size_t LogZstdBuffer::CompressBound(size_t _len) {
+    return ZSTD_compressBound(_len);
 }
 
 char LogZstdBuffer::__GetMagicSyncStart() {
@@ -95,5 +88,8 @@ char LogZstdBuffer::__GetMagicSyncStart() {
 }
 
 char LogZstdBuffer::__GetMagicAsyncStart() {
+    if (0 != dict_id_) {
+        return is_crypt_ ? LogMagicNum::kMagicAsyncZstdDictStart : LogMagicNum::kMagicAsyncNoCryptZstdDictStart;
+    }
     return is_crypt_ ? LogMagicNum::kMagicAsyncZstdStart : LogMagicNum::kMagicAsyncNoCryptZstdStart;
 }
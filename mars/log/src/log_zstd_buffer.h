@@ -32,20 +32,22 @@ class LogCrypt;
 
 class LogZstdBuffer : public LogBaseBuffer{
 public:
-    LogZstdBuffer(void* _pbuffer, size_t _len, bool _is_compress, const char* _pubkey, int level);
+    // _dict: a trained zstd dictionary, blocks get the ZstdDict magics if it is loaded
+    LogZstdBuffer(void* _pbuffer, size_t _len, bool _is_compress, const char* _pubkey, int level,
+                  const void* _dict = nullptr, size_t _dict_len = 0);
     ~LogZstdBuffer();
     
 public:
     virtual size_t Compress(const void* src, size_t inLen, void* dst, size_t outLen);
-    virtual void Flush(AutoBuffer& _buff);
+    virtual size_t CompressBound(size_t _len);
 
 private:
-    bool __Reset();
     char __GetMagicSyncStart();
     char __GetMagicAsyncStart();
 
 private:
     ZSTD_CCtx* cctx_;
+    unsigned dict_id_;  // 0 without a dictionary
 };
 
 #endif /* LOGZSTDBUFFER_H_ */
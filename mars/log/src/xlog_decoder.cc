@@ -0,0 +1,520 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * xlog_decoder.cc
+ *
+ *  Created on: 2026-10-18
+ */
+
+#include "xlog_decoder.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <thread>
+
+#include "boost/bind.hpp"
+#include "zlib.h"
+#include "zstd/lib/zstd.h"
+
+#include "mars/comm/thread/thread.h"
+#include "mars/comm/time_utils.h"
+#include "log/crypt/log_crypt.h"
+#include "log/crypt/log_magic_num.h"
+#include "log_binary_record.h"
+
+#ifndef XLOG_NO_CRYPT
+#include "log/crypt/micro-ecc-master/uECC.h"
+#endif
+
+static const size_t kPubKeyLen = 64;
+static const size_t kPubKeyOffset = 1 + sizeof(uint16_t) + 1 + 1 + sizeof(uint32_t);
+static const size_t kWindowBlocks = 4096;
+static const size_t kWindowBytes = 64 * 1024 * 1024;
+static const size_t kTeaBlockLen = 8;
+
+struct XlogDecoder::Context {
+    Context(): zstd(NULL), zlib_inited(false) {
+        memset(&zlib, 0, sizeof(zlib));
+    }
+
+    ~Context() {
+        if (NULL != zstd) ZSTD_freeDCtx(zstd);
+        if (zlib_inited) inflateEnd(&zlib);
+    }
+
+    ZSTD_DCtx* zstd;
+    z_stream zlib;
+    bool zlib_inited;
+    AutoBuffer plain;   // decrypted body
+    AutoBuffer text;    // rendered binary records
+};
+
+static void __TeaDecrypt(uint32_t* v, const uint32_t* k) {
+    uint32_t v0 = v[0], v1 = v[1], sum = 0xe3779b90, i;  // delta * 16
+    const static uint32_t delta = 0x9e3779b9;
+    uint32_t k0 = k[0], k1 = k[1], k2 = k[2], k3 = k[3];
+    for (i = 0; i < 16; i++) {
+        v1 -= ((v0 << 4) + k2) ^ (v0 + sum) ^ ((v0 >> 5) + k3);
+        v0 -= ((v1 << 4) + k0) ^ (v1 + sum) ^ ((v1 >> 5) + k1);
+        sum -= delta;
+    }
+    v[0] = v0; v[1] = v1;
+}
+
+#ifndef XLOG_NO_CRYPT
+static bool __Hex2Buffer(const char* _str, size_t _len, unsigned char* _buffer) {
+    if (NULL == _str || 0 == _len || 0 != _len % 2) return false;
+
+    for (size_t i = 0; i < _len; i += 2) {
+        unsigned char byte = 0;
+        for (size_t j = 0; j < 2; ++j) {
+            char c = _str[i + j];
+            byte <<= 4;
+            if ('0' <= c && c <= '9') byte |= (unsigned char)(c - '0');
+            else if ('a' <= c && c <= 'f') byte |= (unsigned char)(c - 'a' + 10);
+            else if ('A' <= c && c <= 'F') byte |= (unsigned char)(c - 'A' + 10);
+            else return false;
+        }
+        _buffer[i / 2] = byte;
+    }
+    return true;
+}
+#endif
+
+// at least _len writable bytes behind Pos(), doubling so a long block costs a few reallocs
+static void __Reserve(AutoBuffer& _buffer, size_t _len) {
+    size_t free_len = _buffer.Capacity() - _buffer.Pos();
+    if (free_len < _len) _buffer.AddCapacity(std::max(_len - free_len, _buffer.Capacity()));
+}
+
+static bool __IsCrypt(char _magic) {
+    return LogMagicNum::kMagicAsyncZlibStart == _magic || LogMagicNum::kMagicAsyncZstdStart == _magic
+            || LogMagicNum::kMagicAsyncZstdDictStart == _magic || LogMagicNum::kMagicAsyncRawCryptStart == _magic;
+}
+
+static bool __IsZlib(char _magic) {
+    return LogMagicNum::kMagicAsyncZlibStart == _magic || LogMagicNum::kMagicAsyncNoCryptZlibStart == _magic;
+}
+
+static bool __IsZstdDict(char _magic) {
+    return LogMagicNum::kMagicAsyncZstdDictStart == _magic || LogMagicNum::kMagicAsyncNoCryptZstdDictStart == _magic;
+}
+
+static bool __IsZstd(char _magic) {
+    return LogMagicNum::kMagicAsyncZstdStart == _magic || LogMagicNum::kMagicAsyncNoCryptZstdStart == _magic
+            || __IsZstdDict(_magic);
+}
+
+XlogDecoder::XlogDecoder(const char* _privkey)
+: data_(NULL), size_(0), skipped_bytes_(0) {
+#ifndef XLOG_NO_CRYPT
+    if (NULL != _privkey && 64 == strnlen(_privkey, 128)) {
+        privkey_.resize(32);
+        if (!__Hex2Buffer(_privkey, 64, &privkey_[0])) privkey_.clear();
+    }
+#endif
+}
+
+XlogDecoder::~XlogDecoder() {
+    Close();
+    for (std::map<unsigned, ZSTD_DDict*>::iterator iter = dicts_.begin(); iter != dicts_.end(); ++iter) {
+        ZSTD_freeDDict(iter->second);
+    }
+}
+
+bool XlogDecoder::AddDict(const void* _dict, size_t _len, std::string& _err) {
+    unsigned dict_id = ZSTD_getDictID_fromDict(_dict, _len);
+    if (0 == dict_id) {
+        _err = "not a zstd dictionary";
+        return false;
+    }
+
+    ZSTD_DDict* ddict = ZSTD_createDDict(_dict, _len);
+    if (NULL == ddict) {
+        _err = "ZSTD_createDDict fail";
+        return false;
+    }
+
+    std::map<unsigned, ZSTD_DDict*>::iterator iter = dicts_.find(dict_id);
+    if (iter != dicts_.end()) ZSTD_freeDDict(iter->second);
+    dicts_[dict_id] = ddict;
+    return true;
+}
+
+bool XlogDecoder::Open(const char* _path, std::string& _err) {
+    Close();
+
+    struct stat st;
+    if (0 != stat(_path, &st)) {
+        _err = std::string("stat fail: ") + strerror(errno);
+        return false;
+    }
+
+    if (!S_ISREG(st.st_mode)) {
+        _err = "not a regular file";
+        return false;
+    }
+
+    // mapping an empty file fails, it just has no blocks
+    if (0 == st.st_size) return true;
+
+    file_.open(_path);
+    if (!file_.is_open()) {
+        _err = "mmap fail";
+        return false;
+    }
+
+    data_ = file_.data();
+    size_ = file_.size();
+    __Scan();
+    return true;
+}
+
+bool XlogDecoder::Open(const char* _data, size_t _len, std::string& _err) {
+    Close();
+    data_ = _data;
+    size_ = _len;
+    __Scan();
+    return true;
+}
+
+void XlogDecoder::Close() {
+    if (file_.is_open()) file_.close();
+    data_ = NULL;
+    size_ = 0;
+    blocks_.clear();
+    skipped_bytes_ = 0;
+}
+
+bool XlogDecoder::IsValidBlock(const char* _data, size_t _len, size_t _offset, int _count) {
+    while (0 < _count--) {
+        if (_offset == _len) return true;
+
+        if (_offset > _len || !LogMagicNum::MagicStartIsValid(_data[_offset])) return false;
+        if (_len - _offset < LogCrypt::GetHeaderLen() + LogCrypt::GetTailerLen()) return false;
+
+        // stricter than the python decoder, header bytes of a neighbour often pass as a magic and a length
+        int begin_hour = 0, end_hour = 0;
+        LogCrypt::GetLogHour(_data + _offset, _len - _offset, begin_hour, end_hour);
+        if (begin_hour < 0 || 23 < begin_hour || end_hour < 0 || 23 < end_hour) return false;
+
+        uint64_t end = (uint64_t)_offset + LogCrypt::GetHeaderLen() + LogCrypt::GetLogLen(_data + _offset, _len - _offset);
+        if (end + LogCrypt::GetTailerLen() > _len) return false;
+        if (LogMagicNum::kMagicEnd != _data[end]) return false;
+
+        _offset = (size_t)end + LogCrypt::GetTailerLen();
+    }
+    return true;
+}
+
+size_t XlogDecoder::BlockAt(size_t _offset) const {
+    size_t low = 0, high = blocks_.size();
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        const Block& block = blocks_[mid];
+        if (block.offset + LogCrypt::GetHeaderLen() + block.body_len + LogCrypt::GetTailerLen() <= _offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// same resync rules as decode_mars_crypt_log_file.py: the first block must be followed by another good one,
+// later a single good block is enough
+void XlogDecoder::__Scan() {
+    size_t offset = 0;
+    while (offset < size_ && !IsValidBlock(data_, size_, offset, 2)) ++offset;
+    skipped_bytes_ = offset;
+
+    while (offset < size_) {
+        size_t skipped = 0;
+        if (!IsValidBlock(data_, size_, offset)) {
+            size_t fix = offset + 1;
+            while (fix < size_ && !IsValidBlock(data_, size_, fix)) ++fix;
+            skipped = fix - offset;
+            skipped_bytes_ += skipped;
+            if (fix >= size_) break;
+            offset = fix;
+        }
+
+        const char* header = data_ + offset;
+        Block block;
+        block.offset = offset;
+        block.skipped = skipped;
+        block.body_len = LogCrypt::GetLogLen(header, size_ - offset);
+        memcpy(&block.seq, header + 1, sizeof(block.seq));
+        block.magic = header[0];
+        LogCrypt::GetLogHour(header, size_ - offset, block.begin_hour, block.end_hour);
+        block.key_index = __IsCrypt(block.magic) ? __KeyIndex(header + kPubKeyOffset) : -1;
+        blocks_.push_back(block);
+
+        offset += LogCrypt::GetHeaderLen() + block.body_len + LogCrypt::GetTailerLen();
+    }
+}
+
+// one ecdh per client key, and a client key lives as long as the process that wrote the file
+int XlogDecoder::__KeyIndex(const char* _pubkey) {
+#ifdef XLOG_NO_CRYPT
+    return -1;
+#else
+    if (privkey_.empty()) return -1;
+
+    std::string pubkey(_pubkey, kPubKeyLen);
+    for (size_t i = 0; i < pubkeys_.size(); ++i) {
+        if (pubkeys_[i] == pubkey) return (int)i;
+    }
+
+    uint8_t ecdh_key[32] = {0};
+    std::vector<uint32_t> tea_key(4, 0);
+    if (0 == uECC_shared_secret((const uint8_t*)_pubkey, &privkey_[0], ecdh_key, uECC_secp256k1())) return -1;
+    memcpy(&tea_key[0], ecdh_key, 4 * sizeof(uint32_t));
+
+    pubkeys_.push_back(pubkey);
+    tea_keys_.push_back(tea_key);
+    return (int)(pubkeys_.size() - 1);
+#endif
+}
+
+bool XlogDecoder::DecodeBlock(size_t _index, AutoBuffer& _out, std::string& _err) const {
+    if (_index >= blocks_.size()) {
+        _err = "block index out of range";
+        return false;
+    }
+
+    Context context;
+    return __DecodeBlock(blocks_[_index], context, _out, _err);
+}
+
+bool XlogDecoder::__DecodeBlock(const Block& _block, Context& _context, AutoBuffer& _out, std::string& _err) const {
+    size_t begin = _out.Length();
+    if (!__DecompressBlock(_block, _context, _out, _err)) return false;
+
+    // lines of XLogConfig::binary_record_ get their text here
+    if (!LogBinaryRecord::HasRecord(_out.Ptr(begin), _out.Length() - begin)) return true;
+
+    _context.text.Length(0, 0);
+    LogBinaryRecord::Render(_out.Ptr(begin), _out.Length() - begin, _context.text);
+    _out.Length(begin, begin);
+    _out.Write(_context.text.Ptr(), _context.text.Length());
+    return true;
+}
+
+bool XlogDecoder::__DecompressBlock(const Block& _block, Context& _context, AutoBuffer& _out, std::string& _err) const {
+    const char* body = data_ + _block.offset + LogCrypt::GetHeaderLen();
+    size_t body_len = _block.body_len;
+
+    if (__IsCrypt(_block.magic)) {
+        if (0 > _block.key_index) {
+            _err = privkey_.empty() ? "crypted block, no private key" : "crypted block, bad client key";
+            return false;
+        }
+
+        const uint32_t* key = &tea_keys_[_block.key_index][0];
+        _context.plain.Length(0, 0);
+        _context.plain.Write(body, body_len);
+        char* plain = (char*)_context.plain.Ptr();
+        // tail bytes behind the last whole tea block are left in plain text by LogCrypt
+        for (size_t i = 0; i + kTeaBlockLen <= body_len; i += kTeaBlockLen) {
+            uint32_t v[2];
+            memcpy(v, plain + i, kTeaBlockLen);
+            __TeaDecrypt(v, key);
+            memcpy(plain + i, v, kTeaBlockLen);
+        }
+        body = plain;
+    }
+
+    // sync blocks, and the staged lines a crash left
+    if (!__IsZlib(_block.magic) && !__IsZstd(_block.magic)) {
+        _out.Write(body, body_len);
+        return true;
+    }
+
+    if (0 == body_len) return true;
+
+    size_t grow = std::max(body_len * 2, (size_t)4096);
+
+    if (__IsZlib(_block.magic)) {
+        z_stream& zs = _context.zlib;
+        if (!_context.zlib_inited) {
+            if (Z_OK != inflateInit2(&zs, -MAX_WBITS)) {
+                _err = "inflateInit2 fail";
+                return false;
+            }
+            _context.zlib_inited = true;
+        } else {
+            inflateReset(&zs);
+        }
+
+        zs.next_in = (Bytef*)body;
+        zs.avail_in = (uInt)body_len;
+        // a block is a run of Z_SYNC_FLUSH chunks of one raw deflate stream, it usually never ends
+        while (0 < zs.avail_in) {
+            __Reserve(_out, grow);
+            zs.next_out = (Bytef*)_out.PosPtr();
+            zs.avail_out = (uInt)(_out.Capacity() - _out.Pos());
+            int ret = inflate(&zs, Z_SYNC_FLUSH);
+            size_t produced = (char*)zs.next_out - (char*)_out.PosPtr();
+            _out.Length(_out.Pos() + produced, _out.Length() + produced);
+
+            if (Z_STREAM_END == ret) break;
+            if (Z_OK != ret && Z_BUF_ERROR != ret) {
+                _err = std::string("inflate fail: ") + (NULL != zs.msg ? zs.msg : "");
+                return false;
+            }
+            if (Z_BUF_ERROR == ret && 0 != zs.avail_out) {
+                _err = "inflate no progress";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (NULL == _context.zstd) {
+        _context.zstd = ZSTD_createDCtx();
+        if (NULL == _context.zstd) {
+            _err = "ZSTD_createDCtx fail";
+            return false;
+        }
+    } else {
+        ZSTD_DCtx_reset(_context.zstd, ZSTD_reset_session_only);
+    }
+
+    // the dictionary stays referenced by the context, so set or clear it for every block
+    const ZSTD_DDict* ddict = NULL;
+    if (__IsZstdDict(_block.magic)) {
+        unsigned dict_id = ZSTD_getDictID_fromFrame(body, body_len);
+        std::map<unsigned, ZSTD_DDict*>::const_iterator iter = dicts_.find(dict_id);
+        if (iter == dicts_.end()) {
+            char err[64];
+            snprintf(err, sizeof(err), "zstd dictionary %u not loaded", dict_id);
+            _err = err;
+            return false;
+        }
+        ddict = iter->second;
+    }
+    ZSTD_DCtx_refDDict(_context.zstd, ddict);
+
+    ZSTD_inBuffer input = {body, body_len, 0};
+    while (input.pos < input.size) {
+        __Reserve(_out, grow);
+        ZSTD_outBuffer output = {_out.PosPtr(), _out.Capacity() - _out.Pos(), 0};
+        size_t ret = ZSTD_decompressStream(_context.zstd, &output, &input);
+        _out.Length(_out.Pos() + output.pos, _out.Length() + output.pos);
+
+        if (ZSTD_isError(ret)) {
+            _err = std::string("zstd fail: ") + ZSTD_getErrorName(ret);
+            return false;
+        }
+    }
+    return true;
+}
+
+void XlogDecoder::__DecodeWindow(size_t _begin, size_t _end, std::vector<AutoBuffer>* _outs,
+                                 std::vector<std::string>* _errs, std::atomic<size_t>* _next) const {
+    Context context;
+    while (true) {
+        size_t index = _next->fetch_add(1);
+        if (index >= _end - _begin) break;
+
+        // keeps the memory of the previous window
+        AutoBuffer& out = (*_outs)[index];
+        out.Length(0, 0);
+        (*_errs)[index].clear();
+        if (!__DecodeBlock(blocks_[_begin + index], context, out, (*_errs)[index])) {
+            out.Length(0, 0);
+        }
+    }
+}
+
+bool XlogDecoder::DecodeTo(FILE* _out, int _threads, size_t _begin, size_t _end, Stat& _stat) const {
+    memset(&_stat, 0, sizeof(_stat));
+    uint64_t begin_time = gettickcount();
+
+    _end = std::min(_end, blocks_.size());
+    if (0 >= _threads) _threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    if (0 == _begin && _end == blocks_.size()) _stat.skipped_bytes = skipped_bytes_;
+
+    std::vector<AutoBuffer> outs(std::min(kWindowBlocks, _end - std::min(_begin, _end)));
+    std::vector<std::string> errs(outs.size());
+    uint16_t lastseq = 0;
+    bool ok = true;
+
+    size_t window_begin = _begin;
+    while (window_begin < _end) {
+        // a window is bounded in input bytes too, so the decoded text of huge blocks cannot pile up
+        size_t window_end = window_begin;
+        size_t window_bytes = 0;
+        while (window_end < _end && window_end - window_begin < kWindowBlocks && window_bytes < kWindowBytes) {
+            window_bytes += LogCrypt::GetHeaderLen() + blocks_[window_end].body_len + LogCrypt::GetTailerLen();
+            ++window_end;
+        }
+
+        std::atomic<size_t> next(0);
+        size_t thread_count = std::min((size_t)_threads, window_end - window_begin);
+        if (1 == thread_count) {
+            __DecodeWindow(window_begin, window_end, &outs, &errs, &next);
+        } else {
+            std::vector<Thread*> threads;
+            for (size_t i = 0; i < thread_count; ++i) {
+                Thread* thread = new Thread(boost::bind(&XlogDecoder::__DecodeWindow, this, window_begin, window_end, &outs, &errs, &next),
+                                            "xlog_decode", true);
+                thread->start();
+                threads.push_back(thread);
+            }
+            for (size_t i = 0; i < threads.size(); ++i) {
+                threads[i]->join();
+                delete threads[i];
+            }
+        }
+
+        for (size_t i = window_begin; i < window_end; ++i) {
+            const Block& block = blocks_[i];
+            AutoBuffer& out = outs[i - window_begin];
+            const std::string& err = errs[i - window_begin];
+            char note[256];
+
+            if (0 < block.skipped) {
+                int len = snprintf(note, sizeof(note), "[F]xlog_decode decode error len=%d\n", (int)block.skipped);
+                fwrite(note, 1, len, _out);
+            }
+
+            if (0 != block.seq && 1 != block.seq && 0 != lastseq && block.seq != (uint16_t)(lastseq + 1)) {
+                int len = snprintf(note, sizeof(note), "[F]xlog_decode log seq:%d-%d is missing\n", lastseq + 1, block.seq - 1);
+                fwrite(note, 1, len, _out);
+            }
+            if (0 != block.seq) lastseq = block.seq;
+
+            ++_stat.blocks;
+            _stat.input_bytes += LogCrypt::GetHeaderLen() + block.body_len + LogCrypt::GetTailerLen();
+
+            if (!err.empty()) {
+                ++_stat.failed_blocks;
+                int len = snprintf(note, sizeof(note), "[F]xlog_decode decompress err, %s\n", err.c_str());
+                fwrite(note, 1, len, _out);
+                continue;
+            }
+
+            if (out.Length() != fwrite(out.Ptr(), 1, out.Length(), _out)) ok = false;
+            _stat.output_bytes += out.Length();
+        }
+
+        window_begin = window_end;
+    }
+
+    _stat.cost_ms = gettickcount() - begin_time;
+    return ok && 0 == ferror(_out);
+}
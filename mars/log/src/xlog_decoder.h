@@ -0,0 +1,122 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * xlog_decoder.h
+ *
+ *  Created on: 2026-10-18
+ */
+
+#ifndef XLOG_DECODER_H_
+#define XLOG_DECODER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "boost/iostreams/device/mapped_file.hpp"
+#include "zstd/lib/zstd.h"
+
+#include "mars/comm/autobuffer.h"
+
+/*
+ * Decoder of .xlog files, the native counterpart of crypt/decode_mars_*_log_file.py.
+ * Open() maps the file and indexes every block by its LogMagicNum start, the length of its
+ * LogCrypt header and the kMagicEnd behind the body. Garbage between blocks (a torn write, the
+ * unfinished block of a crashed process) is skipped and counted. Blocks are independent, so
+ * DecodeBlock() can run on any thread and DecodeTo() spreads them over a thread pool and still
+ * writes them in file order.
+ *
+ *   XlogDecoder decoder(privkey);
+ *   std::string err;
+ *   if (decoder.Open("app.xlog", err)) decoder.DecodeTo(out, 0, 0, decoder.Blocks().size(), stat);
+ */
+class XlogDecoder {
+  public:
+    struct Block {
+        size_t   offset;        // of the magic start
+        size_t   skipped;       // garbage bytes in front of this block
+        uint32_t body_len;
+        uint16_t seq;
+        char     magic;
+        int      begin_hour;
+        int      end_hour;
+        int      key_index;     // into the tea keys of the file, -1 if not crypted
+    };
+
+    struct Stat {
+        uint64_t blocks;
+        uint64_t failed_blocks;     // found but not decodable
+        uint64_t skipped_bytes;     // not part of any block
+        uint64_t input_bytes;
+        uint64_t output_bytes;
+        uint64_t cost_ms;
+    };
+
+  public:
+    // _privkey: hex of the 32 bytes server private key, NULL or empty for files without crypt
+    explicit XlogDecoder(const char* _privkey = NULL);
+    ~XlogDecoder();
+
+    // a dictionary of kZstdDict blocks, which pick theirs by id; kept across Open()
+    bool AddDict(const void* _dict, size_t _len, std::string& _err);
+
+    bool Open(const char* _path, std::string& _err);
+    // a memory image of a log file, must outlive the decoder
+    bool Open(const char* _data, size_t _len, std::string& _err);
+    void Close();
+
+    const std::vector<Block>& Blocks() const { return blocks_; }
+    const char* Data() const { return data_; }
+    size_t Size() const { return size_; }
+
+    // plain log text of one block, thread safe
+    bool DecodeBlock(size_t _index, AutoBuffer& _out, std::string& _err) const;
+
+    // decodes blocks [_begin, _end) with _threads workers (0 for one per core) and writes them in order,
+    // with the same "[F]" notes about missing seqs and broken blocks as the python decoder
+    bool DecodeTo(FILE* _out, int _threads, size_t _begin, size_t _end, Stat& _stat) const;
+
+    // index of the block whose data reaches past _offset, Blocks().size() if none
+    size_t BlockAt(size_t _offset) const;
+
+    // a complete block at _offset, followed by _count - 1 more complete blocks or the end of data
+    static bool IsValidBlock(const char* _data, size_t _len, size_t _offset, int _count = 1);
+
+  private:
+    XlogDecoder(const XlogDecoder&);
+    XlogDecoder& operator=(const XlogDecoder&);
+
+    struct Context;
+    void __Scan();
+    int __KeyIndex(const char* _pubkey);
+    bool __DecodeBlock(const Block& _block, Context& _context, AutoBuffer& _out, std::string& _err) const;
+    bool __DecompressBlock(const Block& _block, Context& _context, AutoBuffer& _out, std::string& _err) const;
+    void __DecodeWindow(size_t _begin, size_t _end, std::vector<AutoBuffer>* _outs, std::vector<std::string>* _errs, std::atomic<size_t>* _next) const;
+
+  private:
+    std::vector<uint8_t> privkey_;
+    std::vector<std::string> pubkeys_;
+    std::vector<std::vector<uint32_t> > tea_keys_;
+    std::map<unsigned, ZSTD_DDict*> dicts_;
+
+    boost::iostreams::mapped_file_source file_;
+    const char* data_;
+    size_t size_;
+    std::vector<Block> blocks_;
+    uint64_t skipped_bytes_;
+};
+
+#endif /* XLOG_DECODER_H_ */
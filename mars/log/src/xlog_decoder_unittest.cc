@@ -0,0 +1,221 @@
+#include "xlog_decoder.h"
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "log_zlib_buffer.h"
+#include "log_zstd_buffer.h"
+#include "log/crypt/log_magic_num.h"
+#include "zstd/lib/dictBuilder/zdict.h"
+
+using namespace testing;
+
+// the sample pair of crypt/gen_key.py
+static const char* kPubKey = "572d1e2710ae5fbca54c76a382fdd44050b3a675cb2bf39feebe85ef63d947aff0fa4943f1112e8b6af34bebebbaefa1a0aae055d9259b89a1858f7cc9af9df1";
+static const char* kPrivKey = "145aa7717bf9745b91e9569b80bbf1eedaa6cc6cd0e26317d810e35710f44cf8";
+
+static const size_t kBlockLength = 150 * 1024;
+
+// _lines log lines through the mmap buffer of the appender into one block, appended to _file
+static void __AppendAsyncBlock(LogBaseBuffer& _buffer, int _lines, int _id, std::string& _file, std::string& _text) {
+    char line[256];
+    for (int i = 0; i < _lines; ++i) {
+        int len = snprintf(line, sizeof(line), "[I][2026-10-18 +8.0 10:00:00.%03d][%d, %d][tag][file.cc, Func, %d][block %d line %d, some payload to compress\n",
+                           i % 1000, 1234, 5678 + i % 7, i, _id, i);
+        ASSERT_TRUE(_buffer.Write(line, len));
+        _text.append(line, len);
+    }
+
+    AutoBuffer block;
+    _buffer.Flush(block);
+    _file.append((const char*)block.Ptr(), block.Length());
+}
+
+static void __AppendSyncBlock(LogBaseBuffer& _buffer, const char* _line, std::string& _file, std::string& _text) {
+    AutoBuffer block;
+    ASSERT_TRUE(_buffer.Write(_line, strlen(_line), block));
+    _file.append((const char*)block.Ptr(), block.Length());
+    _text.append(_line);
+}
+
+static std::string __DecodeAll(const XlogDecoder& _decoder, int _threads, XlogDecoder::Stat& _stat) {
+    FILE* out = tmpfile();
+    EXPECT_TRUE(_decoder.DecodeTo(out, _threads, 0, _decoder.Blocks().size(), _stat));
+
+    std::string text(ftell(out), '\0');
+    rewind(out);
+    EXPECT_EQ(text.size(), fread(&text[0], 1, text.size(), out));
+    fclose(out);
+    return text;
+}
+
+TEST(xlog_decoder, all_formats_in_order) {
+    std::string file, text;
+    {
+        char* mem = new char[kBlockLength];
+        LogZlibBuffer zlib(mem, kBlockLength, true, "");
+        __AppendAsyncBlock(zlib, 300, 0, file, text);
+        __AppendSyncBlock(zlib, "sync zlib line\n", file, text);
+        delete[] mem;
+    }
+    {
+        char* mem = new char[kBlockLength];
+        LogZstdBuffer zstd(mem, kBlockLength, true, "", 3);
+        __AppendAsyncBlock(zstd, 300, 1, file, text);
+        __AppendSyncBlock(zstd, "sync zstd line\n", file, text);
+        __AppendAsyncBlock(zstd, 1000, 2, file, text);
+        delete[] mem;
+    }
+
+    XlogDecoder decoder;
+    std::string err;
+    ASSERT_TRUE(decoder.Open(file.data(), file.size(), err));
+    ASSERT_EQ(decoder.Blocks().size(), 5u);
+
+    for (int threads = 1; threads <= 4; threads += 3) {
+        XlogDecoder::Stat stat;
+        EXPECT_EQ(__DecodeAll(decoder, threads, stat), text);
+        EXPECT_EQ(stat.blocks, 5u);
+        EXPECT_EQ(stat.failed_blocks, 0u);
+        EXPECT_EQ(stat.input_bytes, file.size());
+    }
+
+    // random access
+    AutoBuffer block;
+    ASSERT_TRUE(decoder.DecodeBlock(3, block, err));
+    EXPECT_EQ(std::string((const char*)block.Ptr(), block.Length()), "sync zstd line\n");
+}
+
+TEST(xlog_decoder, crypt) {
+    std::string file, text;
+    {
+        char* mem = new char[kBlockLength];
+        LogZlibBuffer zlib(mem, kBlockLength, true, kPubKey);
+        __AppendAsyncBlock(zlib, 500, 0, file, text);
+        delete[] mem;
+    }
+    {
+        char* mem = new char[kBlockLength];
+        LogZstdBuffer zstd(mem, kBlockLength, true, kPubKey, 3);
+        __AppendAsyncBlock(zstd, 500, 1, file, text);
+        delete[] mem;
+    }
+
+    std::string err;
+    XlogDecoder decoder(kPrivKey);
+    ASSERT_TRUE(decoder.Open(file.data(), file.size(), err));
+    XlogDecoder::Stat stat;
+    EXPECT_EQ(__DecodeAll(decoder, 2, stat), text);
+
+    XlogDecoder keyless;
+    ASSERT_TRUE(keyless.Open(file.data(), file.size(), err));
+    __DecodeAll(keyless, 2, stat);
+    EXPECT_EQ(stat.failed_blocks, 2u);
+}
+
+TEST(xlog_decoder, corrupt_block_skipped) {
+    std::string file, text, lost;
+    std::vector<size_t> ends;
+    char* mem = new char[kBlockLength];
+    {
+        LogZstdBuffer zstd(mem, kBlockLength, true, "", 3);
+        __AppendAsyncBlock(zstd, 100, 0, file, text);
+        ends.push_back(file.size());
+        __AppendAsyncBlock(zstd, 100, 1, file, text);
+        ends.push_back(file.size());
+        __AppendAsyncBlock(zstd, 100, 2, file, lost);
+        ends.push_back(file.size());
+        __AppendAsyncBlock(zstd, 100, 3, file, text);
+    }
+    delete[] mem;
+
+    // a torn write in front and a broken end magic in the third block
+    file.insert(0, "garbage");
+    file[ends[2] + 7 - 1] = 'x';
+
+    XlogDecoder decoder;
+    std::string err;
+    ASSERT_TRUE(decoder.Open(file.data(), file.size(), err));
+    ASSERT_EQ(decoder.Blocks().size(), 3u);
+    EXPECT_EQ(decoder.Blocks()[2].skipped, ends[2] - ends[1]);
+
+    XlogDecoder::Stat stat;
+    std::string decoded = __DecodeAll(decoder, 3, stat);
+    EXPECT_EQ(stat.skipped_bytes, 7 + ends[2] - ends[1]);
+    EXPECT_EQ(stat.failed_blocks, 0u);
+    EXPECT_NE(std::string::npos, decoded.find("[F]xlog_decode decode error"));
+    EXPECT_NE(std::string::npos, decoded.find("is missing"));
+
+    // everything but the notes is the text of the good blocks
+    std::string plain;
+    size_t pos = 0;
+    while (pos < decoded.size()) {
+        size_t end = decoded.find('\n', pos) + 1;
+        if (0 != decoded.compare(pos, 3, "[F]")) plain.append(decoded, pos, end - pos);
+        pos = end;
+    }
+    EXPECT_EQ(plain, text);
+}
+
+TEST(xlog_decoder, zstd_dict) {
+    // lines like the ones of __AppendAsyncBlock, as xlog_zstd_train reads them from decoded logs
+    std::string corpus, unused;
+    std::vector<size_t> sizes;
+    {
+        char* mem = new char[kBlockLength];
+        LogZstdBuffer plain(mem, kBlockLength, false, "", 3);
+        for (int i = 0; i < 20; ++i) {
+            std::string file, text;
+            __AppendAsyncBlock(plain, 300, 100 + i, file, text);
+            for (size_t pos = 0; pos < text.size();) {
+                size_t end = text.find('\n', pos) + 1;
+                sizes.push_back(end - pos);
+                pos = end;
+            }
+            corpus += text;
+        }
+        delete[] mem;
+    }
+    std::string dict(16 * 1024, '\0');
+    size_t dict_len = ZDICT_trainFromBuffer(&dict[0], dict.size(), corpus.data(), &sizes[0], (unsigned)sizes.size());
+    ASSERT_FALSE(ZDICT_isError(dict_len)) << ZDICT_getErrorName(dict_len);
+    dict.resize(dict_len);
+
+    // a dictionary pays off at the start of a block, the lines after that find their matches in the window
+    static const int kLines = 10;
+    std::string file, text, file_nodict, text_nodict;
+    char* mem = new char[kBlockLength];
+    {
+        LogZstdBuffer zstd(mem, kBlockLength, true, kPubKey, 3, dict.data(), dict.size());
+        for (int i = 0; i < 4; ++i) __AppendAsyncBlock(zstd, kLines, i, file, text);
+        ASSERT_EQ((int)LogMagicNum::kMagicAsyncZstdDictStart, (int)file[0]);
+    }
+    {
+        LogZstdBuffer zstd(mem, kBlockLength, true, kPubKey, 3);
+        for (int i = 0; i < 4; ++i) __AppendAsyncBlock(zstd, kLines, i, file_nodict, text_nodict);
+    }
+    delete[] mem;
+    EXPECT_LT(file.size(), file_nodict.size());
+
+    std::string err;
+    XlogDecoder decoder(kPrivKey);
+    ASSERT_TRUE(decoder.AddDict(dict.data(), dict.size(), err));
+    ASSERT_TRUE(decoder.Open(file.data(), file.size(), err));
+    XlogDecoder::Stat stat;
+    EXPECT_EQ(__DecodeAll(decoder, 2, stat), text);
+    EXPECT_EQ(stat.failed_blocks, 0u);
+
+    // the same decoder still reads blocks without a dictionary
+    ASSERT_TRUE(decoder.Open(file_nodict.data(), file_nodict.size(), err));
+    EXPECT_EQ(__DecodeAll(decoder, 2, stat), text_nodict);
+
+    XlogDecoder no_dict(kPrivKey);
+    ASSERT_TRUE(no_dict.Open(file.data(), file.size(), err));
+    __DecodeAll(no_dict, 1, stat);
+    EXPECT_EQ(stat.failed_blocks, 4u);
+}
+
+EXPORT_GTEST_SYMBOLS(log_export_xlog_decoder_unittest)
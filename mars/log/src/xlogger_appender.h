@@ -1,11 +1,19 @@
 #include "mars/log/appender.h"
 
+#include <atomic>
+
 #include "boost/iostreams/device/mapped_file.hpp"
 #include "mars/comm/xlogger/xloggerbase.h"
 #include "mars/comm/thread/thread.h"
 #include "mars/comm/thread/condition.h"
+#include "mars/comm/thread/tss.h"
+#include "mars/comm/tickcount.h"
+#include "log_block_index.h"
 
+class AutoBuffer;
 class LogBaseBuffer;
+class LogRingBuffer;
+class PtrBuffer;
 class XloggerAppender {
  public:
     static XloggerAppender* NewInstance(const XLogConfig& _config);
@@ -25,6 +33,7 @@ class XloggerAppender {
     bool GetCurrentLogPath(char* _log_path, unsigned int _len);
     bool GetCurrentLogCachePath(char* _logPath, unsigned int _len);
     void SetConsoleLog(bool _is_open);
+    uint64_t GetOverflowCount() const;
     void SetMaxFileSize(uint64_t _max_byte_size);
     void SetMaxAliveDuration(long _max_time);
     bool GetfilepathFromTimespan(int _timespan, const char* _prefix,
@@ -35,6 +44,12 @@ class XloggerAppender {
  private:
     XloggerAppender(const XLogConfig& _config);
 
+    struct LogBlock {
+        const void* data;
+        size_t len;
+        const LogIndexEntry* meta;
+    };
+
     
     
     std::string __MakeLogFileNamePrefix(const timeval& _tv, const char* _prefix);
@@ -56,27 +71,71 @@ class XloggerAppender {
     
     void __GetMarkInfo(char* _info, size_t _info_len);
     void __WriteTips2Console(const char* _tips_format, ...);
-    bool __WriteFile(const void* _data, size_t _len, FILE* _file);
+    bool __WriteFile(const LogBlock* _blocks, size_t _count);
+    bool __WriteBlocks(const LogBlock* _blocks, size_t _count);
     bool __OpenLogFile(const std::string& _log_dir);
+    bool __LogFileChanged(uint64_t _now_tick);
     void __CloseLogFile();
+    LogIndexEntry __TakeBlockMeta();
+    LogBaseBuffer* __NewBuffer(void* _pbuffer, size_t _len);
+    bool __OpenMmap(const char* _path, size_t _len, AutoBuffer& _recovered);
+    bool __WriteBuffer(ScopedLock& _lock, const void* _data, size_t _len);
+    bool __WaitSegment(ScopedLock& _lock, const tickcount_t& _begin);
+    bool __SwitchSegment();
+    void __FlushSegments(bool _move_file);
     bool __CacheLogs();
-    void __Log2File(const void* _data, size_t _len, bool _move_file);
+    void __UpdateFileState(const timeval& _tv);
+    void __Log2File(const void* _data, size_t _len, bool _move_file, const LogIndexEntry* _meta = nullptr);
+    void __Log2File(const LogBlock* _blocks, size_t _count, bool _move_file);
     void __AsyncLogThread();
+    void __FormatLine(const XLoggerInfo* _info, const char* _log, PtrBuffer& _line);
     void __WriteSync(const XLoggerInfo* _info, const char* _log);
     void __WriteAsync(const XLoggerInfo* _info, const char* _log);
+    void __WriteAsyncRing(const XLoggerInfo* _info, const char* _log);
+    LogRingBuffer* __GetThreadRing();
+    bool __DrainRings();
+    void __ReleaseRings();
     void __DelTimeoutFile(const std::string& _log_path);
     bool __AppendFile(const std::string& _src_file, const std::string& _dst_file);
     void __MoveOldFiles(const std::string& _src_path, const std::string& _dest_path,
                             const std::string& _nameprefix);
 
  private:
+    struct BufferSegment {
+        char* data;
+        bool full;              // writers moved on, it waits for the async thread
+        LogIndexEntry meta;     // of its lines, once full
+    };
+
+    // what __Log2File asks the file system for every block, looked up again after a while, on a new day or with a new file
+    struct LogFileState {
+        uint64_t tick = 0;      // 0 if stale
+        time_t time = 0;
+        bool cache_logs = false;
+        bool cache_exists = false;
+    };
+
     XLogConfig config_;
-    LogBaseBuffer* log_buff_ = nullptr;
+    LogBaseBuffer* log_buff_ = nullptr;     // writes to segments_[current_segment_]
     boost::iostreams::mapped_file mmap_file_;
+    char* buffer_data_ = nullptr;           // the mmap cache, or memory if it could not be mapped
+    size_t buffer_len_ = 0;
+    size_t segment_len_ = 0;
+    std::vector<BufferSegment> segments_;   // guarded by mutex_buffer_async_
+    size_t current_segment_ = 0;
+    uint64_t dropped_lines_ = 0;            // since the last overflow tips, guarded by mutex_buffer_async_
+    std::atomic<uint64_t> overflow_count_;
     Thread thread_async_;
+    Mutex mutex_flush_;                     // one writer of full segments at a time, taken before mutex_buffer_async_
     Mutex mutex_buffer_async_;
     Mutex mutex_log_file_;
-    FILE* logfile_ = nullptr;
+    int logfile_fd_ = -1;           // O_APPEND, kept open until the day or max_file_size_ asks for the next file
+    uint64_t logfile_size_ = 0;     // where the next block of logfile_fd_ goes
+    uint64_t logfile_check_tick_ = 0;
+    std::string logfile_path_;
+    LogFileState file_state_;       // guarded by mutex_log_file_
+    LogBlockIndex block_index_;     // of logfile_fd_, guarded by mutex_log_file_
+    LogIndexEntry block_meta_;      // of the lines in log_buff_, guarded by mutex_buffer_async_
     time_t openfiletime_ = 0;
 #ifdef DEBUG
     bool consolelog_open_ = true;
@@ -85,6 +144,12 @@ class XloggerAppender {
 #endif
     bool log_close_ = true;
     Condition cond_buffer_async_;
+    Condition cond_segment_free_;   // with mutex_buffer_async_
+    std::atomic<bool> flush_requested_;
+    Tss tss_ring_;                          // a ThreadRing, of the Open it was made for
+    Mutex mutex_rings_;
+    std::vector<LogRingBuffer*> rings_;
+    std::atomic<unsigned int> rings_generation_{0};    // one up on every Close, tells rings of an earlier Open apart
     uint64_t max_file_size_ = 0; // 0, will not split log file.
     long max_alive_time_ = 10 * 24 * 60 * 60;    // 10 days in second
 
@@ -0,0 +1,484 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * xlog_bench.cc
+ *
+ *  Created on: 2026-10-18
+ */
+
+// xlog_bench [benchmark]...
+// times the hot paths of the appender and the decoder on the host, all benchmarks without a name.
+// The unit tests check what these do, this only prints how long it takes.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/bind.hpp"
+#include "boost/filesystem.hpp"
+#include "mars/comm/thread/thread.h"
+#include "mars/comm/tickcount.h"
+#include "mars/comm/xlogger/xloggerbase.h"
+#include "log/crypt/log_tea.h"
+#include "log/src/log_binary_record.h"
+#include "log/src/log_zlib_buffer.h"
+#include "log/src/log_zstd_buffer.h"
+#include "log/src/xlog_decoder.h"
+#include "log/src/xlogger_appender.h"
+#include "zstd/lib/zstd.h"
+
+extern void log_formater(const XLoggerInfo* _info, const char* _logbody, PtrBuffer& _log);
+
+// thread info for comm's asserts and the console of the appender, the mobile platforms bring their own
+extern "C" {
+intmax_t xlogger_pid() {
+    static intmax_t pid = getpid();
+    return pid;
+}
+
+intmax_t xlogger_tid() {
+    return syscall(SYS_gettid);
+}
+
+intmax_t xlogger_maintid() {
+    return xlogger_pid();
+}
+}
+
+void ConsoleLog(const XLoggerInfo* _info, const char* _log) {}
+
+static XLogConfig __Config(const char* _name) {
+    XLogConfig config;
+    config.mode_ = kAppenderAsync;
+    config.logdir_ = (boost::filesystem::temp_directory_path() / "xlog_bench" / _name).string();
+    config.nameprefix_ = _name;
+    boost::filesystem::remove_all(config.logdir_);
+    return config;
+}
+
+static unsigned long long __PerSecond(uint64_t _count, uint64_t _ms) {
+    return (unsigned long long)(_count * 1000 / (_ms ? _ms : 1));
+}
+
+static void __ProduceLog(XloggerAppender* _appender, int _count) {
+    XLoggerInfo info;
+    memset(&info, 0, sizeof(info));
+    info.level = kLevelInfo;
+    info.tag = "bench";
+    info.filename = __FILE__;
+    info.func_name = __FUNCTION__;
+    info.pid = xlogger_pid();
+    info.tid = xlogger_tid();
+    info.maintid = xlogger_maintid();
+
+    for (int i = 0; i < _count; ++i) {
+        info.line = __LINE__;
+        gettimeofday(&info.timeval, NULL);
+        _appender->Write(&info, "longlink send task, cmdid:1000 taskid:123456 len:512 seq:42");
+    }
+}
+
+// ms _threads threads take to hand _lines lines each to the appender
+static uint64_t __RunProducers(const XLogConfig& _config, int _threads, int _lines, uint64_t* _overflow = NULL) {
+    XloggerAppender* appender = XloggerAppender::NewInstance(_config);
+
+    std::vector<Thread*> producers;
+    for (int i = 0; i < _threads; ++i) {
+        producers.push_back(new Thread(boost::bind(&__ProduceLog, appender, _lines)));
+    }
+
+    tickcount_t begin(true);
+    for (size_t i = 0; i < producers.size(); ++i)  producers[i]->start();
+    for (size_t i = 0; i < producers.size(); ++i) {
+        producers[i]->join();
+        delete producers[i];
+    }
+    uint64_t cost = (int64_t)begin.gettickspan();
+    if (NULL != _overflow) *_overflow = appender->GetOverflowCount();
+
+    XloggerAppender::Release(appender);
+    boost::filesystem::remove_all(_config.logdir_);
+    return cost;
+}
+
+// producers on the one mutex of the async buffer against a ring each, XLogConfig::async_ring_
+static void __RingContention() {
+    const int kLinesPerThread = 100000;
+    const int kThreads[] = {1, 2, 4, 8};
+
+    for (size_t i = 0; i < sizeof(kThreads) / sizeof(kThreads[0]); ++i) {
+        XLogConfig locked = __Config("locked");
+        XLogConfig ring = __Config("ring");
+        ring.async_ring_ = true;
+
+        uint64_t locked_cost = __RunProducers(locked, kThreads[i], kLinesPerThread);
+        uint64_t ring_cost = __RunProducers(ring, kThreads[i], kLinesPerThread);
+        uint64_t total = (uint64_t)kThreads[i] * kLinesPerThread;
+        printf("threads:%d lines:%d locked:%llu ms (%llu lines/s) ring:%llu ms (%llu lines/s)\n",
+               kThreads[i], kLinesPerThread,
+               (unsigned long long)locked_cost, __PerSecond(total, locked_cost),
+               (unsigned long long)ring_cost, __PerSecond(total, ring_cost));
+    }
+}
+
+// 4 threads logging as fast as they can, the single 150k block of older versions against the segments
+static void __Burst() {
+    const int kThreads = 4;
+    const int kLinesPerThread = 50000;
+    const size_t kSizes[] = {150 * 1024, 150 * 1024, 512 * 1024};
+    const int kSegments[] = {2, 4, 4};
+
+    for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); ++i) {
+        XLogConfig config = __Config("burst");
+        config.compress_mode_ = kZstd;
+        config.buffer_size_ = kSizes[i];
+        config.buffer_segments_ = kSegments[i];
+
+        uint64_t overflow = 0;
+        uint64_t cost = __RunProducers(config, kThreads, kLinesPerThread, &overflow);
+        printf("buffer:%dk segments:%d, %d lines in %llu ms, dropped:%llu\n", (int)(kSizes[i] / 1024), kSegments[i],
+               kThreads * kLinesPerThread, (unsigned long long)cost, (unsigned long long)overflow);
+    }
+}
+
+// the file work of a flush the way __Log2File did it before, a lookup and an open and close per block,
+// against the descriptor kept open and the blocks of the full segments in one writev
+static void __FlushFile() {
+    const int kFlushes = 2000;
+    const int kBlocks = 4;
+    std::string dir = __Config("flush").logdir_;
+    std::string cachedir = dir + "/cache";
+    boost::filesystem::create_directories(cachedir);
+    std::string block(8 * 1024, 'x');
+    std::string path = dir + "/bench_20261018.xlog";
+
+    tickcount_t begin(true);
+    for (int i = 0; i < kFlushes; ++i) {
+        for (int j = 0; j < kBlocks; ++j) {
+            boost::filesystem::exists(cachedir + "/bench_20261018.xlog");
+            boost::filesystem::exists(path);
+            boost::filesystem::space(cachedir);
+            FILE* file = fopen(path.c_str(), "ab");
+            if (NULL == file) {
+                fprintf(stderr, "open %s fail: %s\n", path.c_str(), strerror(errno));
+                return;
+            }
+            ftell(file);
+            fwrite(block.data(), block.size(), 1, file);
+            fclose(file);
+        }
+    }
+    uint64_t reopen_cost = (int64_t)begin.gettickspan();
+    boost::filesystem::remove(path);
+
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0666);
+    if (-1 == fd) {
+        fprintf(stderr, "open %s fail: %s\n", path.c_str(), strerror(errno));
+        return;
+    }
+    struct iovec iov[kBlocks];
+    for (int j = 0; j < kBlocks; ++j) {
+        iov[j].iov_base = const_cast<char*>(block.data());
+        iov[j].iov_len = block.size();
+    }
+    begin.gettickcount();
+    for (int i = 0; i < kFlushes; ++i)  writev(fd, iov, kBlocks);
+    uint64_t kept_cost = (int64_t)begin.gettickspan();
+    close(fd);
+    boost::filesystem::remove_all(dir);
+
+    printf("%d flushes of %d blocks, reopened: %.1f us, kept open: %.1f us\n", kFlushes, kBlocks,
+           reopen_cost * 1000.0 / kFlushes, kept_cost * 1000.0 / kFlushes);
+}
+
+// the sample pair of crypt/gen_key.py
+static const char* kPubKey = "572d1e2710ae5fbca54c76a382fdd44050b3a675cb2bf39feebe85ef63d947aff0fa4943f1112e8b6af34bebebbaefa1a0aae055d9259b89a1858f7cc9af9df1";
+static const char* kPrivKey = "145aa7717bf9745b91e9569b80bbf1eedaa6cc6cd0e26317d810e35710f44cf8";
+
+static const size_t kBlockLength = 150 * 1024;
+
+// _lines log lines through the mmap buffer of the appender into one block, appended to _file
+static void __AppendAsyncBlock(LogBaseBuffer& _buffer, int _lines, int _id, std::string& _file) {
+    char line[256];
+    for (int i = 0; i < _lines; ++i) {
+        int len = snprintf(line, sizeof(line), "[I][2026-10-18 +8.0 10:00:00.%03d][%d, %d][tag][file.cc, Func, %d][block %d line %d, some payload to compress\n",
+                           i % 1000, 1234, 5678 + i % 7, i, _id, i);
+        _buffer.Write(line, len);
+    }
+
+    AutoBuffer block;
+    _buffer.Flush(block);
+    _file.append((const char*)block.Ptr(), block.Length());
+}
+
+// XlogDecoder::DecodeTo over 64MB of crypted zstd and zlib blocks, on one thread and on every core
+static void __DecoderThroughput() {
+    std::string file;
+    char* mem = new char[kBlockLength];
+    {
+        LogZstdBuffer zstd(mem, kBlockLength, true, kPubKey, 3);
+        for (int i = 0; i < 64; ++i) __AppendAsyncBlock(zstd, 1000, i, file);
+    }
+    {
+        LogZlibBuffer zlib(mem, kBlockLength, true, kPubKey);
+        for (int i = 64; i < 128; ++i) __AppendAsyncBlock(zlib, 1000, i, file);
+    }
+    delete[] mem;
+
+    // blocks are independent, a copied file is as good as a longer one
+    std::string big;
+    while (big.size() < 64 * 1024 * 1024) big.append(file);
+
+    XlogDecoder decoder(kPrivKey);
+    std::string err;
+    if (!decoder.Open(big.data(), big.size(), err)) {
+        fprintf(stderr, "open fail: %s\n", err.c_str());
+        return;
+    }
+
+    FILE* null = fopen("/dev/null", "wb");
+    int cores = (int)std::max(1u, std::thread::hardware_concurrency());
+    for (int threads = 1; threads <= cores; threads = (threads < cores ? cores : threads + 1)) {
+        XlogDecoder::Stat stat;
+        decoder.DecodeTo(null, threads, 0, decoder.Blocks().size(), stat);
+        double seconds = (0 == stat.cost_ms ? 1 : stat.cost_ms) / 1000.0;
+        printf("threads:%d blocks:%llu failed:%llu in:%.3f GB/s out:%.3f GB/s (%llu ms)\n", threads, (unsigned long long)stat.blocks,
+               (unsigned long long)stat.failed_blocks, stat.input_bytes / seconds / (1 << 30), stat.output_bytes / seconds / (1 << 30),
+               (unsigned long long)stat.cost_ms);
+    }
+    fclose(null);
+}
+
+// every TEA kernel the cpu runs over random data the size of a flushed mmap block
+static void __TeaKernels() {
+    static const uint32_t kKey[4] = {0x01234567, 0x89abcdef, 0xfedcba98, 0x76543210};
+    static const TTeaKernel kKernels[] = {kTeaScalar, kTeaSSE2, kTeaAVX2, kTeaNEON};
+    static const size_t kBlocks = 150 * 1024 / kTeaBlockLen;
+    static const int kLoops = 200;
+
+    std::vector<char> in(kBlocks * kTeaBlockLen);
+    for (size_t i = 0; i < in.size(); ++i) in[i] = (char)(rand() & 0xff);
+    std::vector<char> out(in.size());
+
+    for (size_t k = 0; k < sizeof(kKernels) / sizeof(kKernels[0]); ++k) {
+        if (!TeaKernelSupported(kKernels[k])) {
+            printf("%s: not supported\n", TeaKernelName(kKernels[k]));
+            continue;
+        }
+
+        tickcount_t begin(true);
+        for (int i = 0; i < kLoops; ++i) TeaEncryptBlocks(&in[0], &out[0], kBlocks, kKey, kKernels[k]);
+        uint64_t cost = (int64_t)begin.gettickspan();
+        printf("%s: %.1f MB/s (%llu ms)\n", TeaKernelName(kKernels[k]),
+               in.size() * kLoops / ((0 == cost ? 1 : cost) / 1000.0) / (1024 * 1024), (unsigned long long)cost);
+    }
+}
+
+// the text formatter against LogBinaryRecord: time per line, and bytes per line before and after zstd
+static void __BinaryRecord() {
+    static const int kLines = 200000;
+    static const size_t kLineLength = 16 * 1024;     // the format buffer of the appender
+    const char* body = "task:12 cmdid:1002 send 2048 bytes to 10.0.0.1:443, cost:13ms, retry:0";
+
+    XLoggerInfo info;
+    memset(&info, 0, sizeof(info));
+    info.level = kLevelInfo;
+    info.tag = "stn";
+    info.filename = "/home/mars/stn/src/longlink.cc";
+    info.func_name = "__RunReadWrite";
+    info.line = 100;
+    gettimeofday(&info.timeval, NULL);
+    info.pid = 4242;
+    info.tid = 4243;
+    info.maintid = 4242;
+
+    std::vector<char> temp(kLineLength);
+    std::vector<char> mem(kBlockLength);
+
+    for (int mode = 0; mode < 2; ++mode) {
+        const char* name = 0 == mode ? "text" : "binary";
+
+        uint64_t bytes = 0;
+        tickcount_t begin(true);
+        for (int i = 0; i < kLines; ++i) {
+            PtrBuffer line(&temp[0], 0, temp.size());
+            info.timeval.tv_usec = i % 1000000;
+            if (0 == mode) log_formater(&info, body, line);
+            else LogBinaryRecord::Format(&info, body, line);
+            bytes += line.Length();
+        }
+        uint64_t cost = (int64_t)begin.gettickspan();
+
+        // what reaches the file: staged and packed at a third of a block, as the async appender does
+        LogZstdBuffer buffer(&mem[0], mem.size(), true, "", 3);
+        uint64_t compressed = 0;
+        for (int i = 0; i < kLines / 10; ++i) {
+            PtrBuffer line(&temp[0], 0, temp.size());
+            if (0 == mode) log_formater(&info, body, line);
+            else LogBinaryRecord::Format(&info, body, line);
+            buffer.Write(line.Ptr(), line.Length());
+            if (buffer.GetData().Length() >= kBlockLength / 3) {
+                AutoBuffer block;
+                buffer.Flush(block);
+                compressed += block.Length();
+            }
+        }
+        AutoBuffer block;
+        buffer.Flush(block);
+        compressed += block.Length();
+
+        printf("%s: %.0f ns/line, %.1f bytes/line, %.1f compressed bytes/line\n", name, cost * 1000000.0 / kLines,
+               (double)bytes / kLines, (double)compressed / (kLines / 10));
+    }
+}
+
+// log_formater with the time text cached across the lines of a second, and with a new second every line
+static void __FormaterTime() {
+    static const int kLines = 200000;
+    const char* names[] = {"same second", "new second every line"};
+
+    XLoggerInfo info;
+    memset(&info, 0, sizeof(info));
+    info.level = kLevelInfo;
+    info.tag = "stn";
+    info.filename = "longlink.cc";
+    info.func_name = "__RunReadWrite";
+    info.line = 100;
+    timeval now;
+    gettimeofday(&now, NULL);
+
+    std::vector<char> temp(16 * 1024);
+    for (int mode = 0; mode < 2; ++mode) {
+        uint64_t bytes = 0;
+        tickcount_t begin(true);
+        for (int i = 0; i < kLines; ++i) {
+            info.timeval.tv_sec = now.tv_sec + (0 == mode ? 0 : i);
+            info.timeval.tv_usec = i % 1000000;
+            PtrBuffer line(&temp[0], 0, temp.size());
+            log_formater(&info, "connect 10.0.0.1:443 cost 13ms", line);
+            bytes += line.Length();
+        }
+        uint64_t cost = (int64_t)begin.gettickspan();
+        printf("%s: %.0f ns/line (%llu bytes)\n", names[mode], cost * 1000000.0 / kLines, (unsigned long long)bytes);
+    }
+}
+
+static int __Line(char* _line, size_t _len, int _i) {
+    return snprintf(_line, _len, "[I][2026-10-18 +8.0 10:00:%02d.%03d][1234, %d][tag][file.cc, Func, %d][line %d, some payload to compress\n",
+                    _i / 1000 % 60, _i % 1000, 5678 + _i % 7, 100 + _i % 50, _i);
+}
+
+// the cost of a line on the logging thread and what reaches the file, staged and packed once a third of
+// the buffer is full against a ZSTD_e_flush with a 64k window every line, what LogZstdBuffer did before
+static void __StagedBuffer() {
+    static const int kLines = 200000;
+    static const size_t kFlushLen = kBlockLength / 3;
+    std::vector<char> mem(kBlockLength);
+    char line[256];
+
+    LogZstdBuffer buffer(&mem[0], mem.size(), true, "", 3);
+    uint64_t pack_cost = 0, packed = 0, raw = 0;
+    tickcount_t total(true);
+    for (int i = 0; i < kLines; ++i) {
+        int len = __Line(line, sizeof(line), i);
+        buffer.Write(line, len);
+        raw += len;
+
+        if (buffer.GetData().Length() >= kFlushLen || kLines - 1 == i) {
+            tickcount_t begin(true);
+            AutoBuffer block;
+            buffer.Flush(block);
+            pack_cost += (int64_t)begin.gettickspan();
+            packed += block.Length();
+        }
+    }
+    uint64_t write_cost = (int64_t)total.gettickspan() - pack_cost;
+
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, 3);
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_windowLog, 16);
+    uint64_t flushed = 0;
+    size_t pos = 0;
+    total.gettickcount();
+    for (int i = 0; i < kLines; ++i) {
+        int len = __Line(line, sizeof(line), i);
+        ZSTD_inBuffer input = {line, (size_t)len, 0};
+        ZSTD_outBuffer output = {&mem[pos], mem.size() - pos, 0};
+        ZSTD_compressStream2(cctx, &output, &input, ZSTD_e_flush);
+        pos += output.pos;
+
+        if (pos >= kFlushLen || kLines - 1 == i) {
+            flushed += pos;
+            pos = 0;
+            ZSTD_CCtx_reset(cctx, ZSTD_reset_session_only);
+        }
+    }
+    uint64_t line_cost = (int64_t)total.gettickspan();
+    ZSTD_freeCCtx(cctx);
+
+    printf("staged: %.0f ns/line to write, %.0f ns/line to pack, ratio %.2f\n", write_cost * 1000000.0 / kLines,
+           pack_cost * 1000000.0 / kLines, (double)raw / (packed ? packed : 1));
+    printf("line by line: %.0f ns/line, ratio %.2f\n", line_cost * 1000000.0 / kLines, (double)raw / (flushed ? flushed : 1));
+}
+
+struct Benchmark {
+    const char* name;
+    void (*run)();
+};
+
+static const Benchmark sg_benchmarks[] = {
+    {"ring_contention", &__RingContention},
+    {"burst", &__Burst},
+    {"flush_file", &__FlushFile},
+    {"decoder_throughput", &__DecoderThroughput},
+    {"tea_kernels", &__TeaKernels},
+    {"binary_record", &__BinaryRecord},
+    {"formater_time", &__FormaterTime},
+    {"staged_buffer", &__StagedBuffer},
+};
+
+static const size_t kBenchmarkCount = sizeof(sg_benchmarks) / sizeof(sg_benchmarks[0]);
+
+int main(int argc, char* argv[]) {
+    std::vector<const Benchmark*> selected;
+    for (int i = 1; i < argc; ++i) {
+        size_t j = 0;
+        while (j < kBenchmarkCount && 0 != strcmp(argv[i], sg_benchmarks[j].name)) ++j;
+        if (j == kBenchmarkCount) {
+            fprintf(stderr, "usage: %s [benchmark]...\nbenchmarks:", argv[0]);
+            for (j = 0; j < kBenchmarkCount; ++j)  fprintf(stderr, " %s", sg_benchmarks[j].name);
+            fprintf(stderr, "\n");
+            return 1;
+        }
+        selected.push_back(&sg_benchmarks[j]);
+    }
+    if (selected.empty()) {
+        for (size_t j = 0; j < kBenchmarkCount; ++j)  selected.push_back(&sg_benchmarks[j]);
+    }
+
+    for (size_t i = 0; i < selected.size(); ++i) {
+        printf("[%s]\n", selected[i]->name);
+        selected[i]->run();
+    }
+    return 0;
+}
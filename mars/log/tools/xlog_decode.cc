@@ -0,0 +1,161 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * xlog_decode.cc
+ *
+ *  Created on: 2026-10-18
+ */
+
+// xlog_decode [-k privkey] [-d dict]... [-j threads] [-s] <file.xlog|dir> [out.log]
+// decodes a file to <file>.xlog.log (or out.log, "-" for stdout), or every *.xlog of a directory
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "mars/comm/xlogger/xloggerbase.h"
+#include "log/src/xlog_decoder.h"
+
+// thread info for comm's asserts, the mobile platforms bring their own
+extern "C" {
+intmax_t xlogger_pid() {
+    static intmax_t pid = getpid();
+    return pid;
+}
+
+intmax_t xlogger_tid() {
+    return syscall(SYS_gettid);
+}
+
+intmax_t xlogger_maintid() {
+    return xlogger_pid();
+}
+}
+
+static void __Usage(const char* _name) {
+    fprintf(stderr, "usage: %s [-k privkey] [-d dict]... [-j threads] [-s] <file.xlog|dir> [out.log]\n"
+                    "  -k  hex server private key, $XLOG_PRIV_KEY by default\n"
+                    "  -d  zstd dictionary of kZstdDict logs, may be repeated\n"
+                    "  -j  decode threads, one per core by default\n"
+                    "  -s  print block and throughput statistics\n", _name);
+}
+
+static bool __ReadFile(const char* _path, std::string& _data) {
+    FILE* file = fopen(_path, "rb");
+    if (NULL == file) return false;
+
+    char buf[64 * 1024];
+    size_t len = 0;
+    while (0 < (len = fread(buf, 1, sizeof(buf), file))) _data.append(buf, len);
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+static bool __DecodeFile(XlogDecoder& _decoder, const std::string& _in, const std::string& _out, int _threads, bool _stat) {
+    std::string err;
+    if (!_decoder.Open(_in.c_str(), err)) {
+        fprintf(stderr, "open %s fail: %s\n", _in.c_str(), err.c_str());
+        return false;
+    }
+
+    FILE* out = "-" == _out ? stdout : fopen(_out.c_str(), "wb");
+    if (NULL == out) {
+        fprintf(stderr, "open %s fail\n", _out.c_str());
+        _decoder.Close();
+        return false;
+    }
+
+    XlogDecoder::Stat stat;
+    bool ok = _decoder.DecodeTo(out, _threads, 0, _decoder.Blocks().size(), stat);
+    if (stdout != out) fclose(out);
+    _decoder.Close();
+
+    if (!ok) fprintf(stderr, "write %s fail\n", _out.c_str());
+
+    if (_stat) {
+        double seconds = (0 == stat.cost_ms ? 1 : stat.cost_ms) / 1000.0;
+        fprintf(stderr, "%s: blocks:%llu failed:%llu skipped bytes:%llu in:%llu out:%llu cost:%llums %.3f GB/s\n",
+                _in.c_str(), (unsigned long long)stat.blocks, (unsigned long long)stat.failed_blocks,
+                (unsigned long long)stat.skipped_bytes, (unsigned long long)stat.input_bytes,
+                (unsigned long long)stat.output_bytes, (unsigned long long)stat.cost_ms,
+                stat.input_bytes / seconds / (1024.0 * 1024 * 1024));
+    }
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    const char* privkey = getenv("XLOG_PRIV_KEY");
+    int threads = 0;
+    bool stat = false;
+    std::vector<std::string> dicts;
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "k:d:j:sh"))) {
+        switch (opt) {
+        case 'k': privkey = optarg; break;
+        case 'd': dicts.push_back(optarg); break;
+        case 'j': threads = atoi(optarg); break;
+        case 's': stat = true; break;
+        default:
+            __Usage(argv[0]);
+            return 'h' == opt ? 0 : 1;
+        }
+    }
+
+    std::string path = optind < argc ? argv[optind] : ".";
+    XlogDecoder decoder(privkey);
+
+    for (size_t i = 0; i < dicts.size(); ++i) {
+        std::string dict, err;
+        if (!__ReadFile(dicts[i].c_str(), dict) || !decoder.AddDict(dict.data(), dict.size(), err)) {
+            fprintf(stderr, "load dictionary %s fail %s\n", dicts[i].c_str(), err.c_str());
+            return 1;
+        }
+    }
+
+    struct stat path_stat;
+    if (0 != ::stat(path.c_str(), &path_stat)) {
+        fprintf(stderr, "stat %s fail\n", path.c_str());
+        return 1;
+    }
+
+    if (!S_ISDIR(path_stat.st_mode)) {
+        std::string out = optind + 1 < argc ? argv[optind + 1] : path + ".log";
+        return __DecodeFile(decoder, path, out, threads, stat) ? 0 : 1;
+    }
+
+    DIR* dir = opendir(path.c_str());
+    if (NULL == dir) {
+        fprintf(stderr, "opendir %s fail\n", path.c_str());
+        return 1;
+    }
+
+    int ret = 0;
+    struct dirent* ent = NULL;
+    while (NULL != (ent = readdir(dir))) {
+        size_t len = strlen(ent->d_name);
+        if (len <= 5 || 0 != strcmp(ent->d_name + len - 5, ".xlog")) continue;
+
+        std::string in = path + "/" + ent->d_name;
+        if (!__DecodeFile(decoder, in, in + ".log", threads, stat)) ret = 1;
+    }
+    closedir(dir);
+    return ret;
+}
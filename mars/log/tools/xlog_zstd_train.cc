@@ -0,0 +1,140 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * xlog_zstd_train.cc
+ *
+ *  Created on: 2026-10-18
+ */
+
+// xlog_zstd_train [-o out.dict] [-s dict size] [-m corpus MB] <decoded.log|dir>...
+// trains the zstd dictionary of XLogConfig::zstd_dict_ from logs decoded by xlog_decode (*.log of a directory).
+// LogZstdBuffer compresses and flushes line by line, so every line is one sample.
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "zstd/lib/zstd.h"
+#include "zstd/lib/dictBuilder/zdict.h"
+
+static const size_t kMaxLineLen = 16 * 1024;    // the format buffer of the appender
+
+static void __Usage(const char* _name) {
+    fprintf(stderr, "usage: %s [-o out.dict] [-s dict size] [-m corpus MB] <decoded.log|dir>...\n"
+                    "  -o  dictionary file, xlog.dict by default\n"
+                    "  -s  dictionary size in bytes, 32768 by default\n"
+                    "  -m  lines read at most, in MB, 128 by default\n", _name);
+}
+
+// appends the lines of _path to _corpus, one sample each, until _corpus holds _max_len bytes
+static bool __AddFile(const std::string& _path, size_t _max_len, std::string& _corpus, std::vector<size_t>& _sizes) {
+    FILE* file = fopen(_path.c_str(), "rb");
+    if (NULL == file) {
+        fprintf(stderr, "open %s fail\n", _path.c_str());
+        return false;
+    }
+
+    std::vector<char> line(kMaxLineLen);
+    while (_corpus.size() < _max_len && NULL != fgets(&line[0], (int)line.size(), file)) {
+        size_t len = strlen(&line[0]);
+        // notes of the decoder are not what the appender writes
+        if (0 == len || 0 == strncmp(&line[0], "[F]xlog_decode", 14)) continue;
+
+        _corpus.append(&line[0], len);
+        _sizes.push_back(len);
+    }
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string out_path = "xlog.dict";
+    size_t dict_size = 32 * 1024;
+    size_t max_len = 128 * 1024 * 1024;
+
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "o:s:m:h"))) {
+        switch (opt) {
+        case 'o': out_path = optarg; break;
+        case 's': dict_size = (size_t)atol(optarg); break;
+        case 'm': max_len = (size_t)atol(optarg) * 1024 * 1024; break;
+        default:
+            __Usage(argv[0]);
+            return 'h' == opt ? 0 : 1;
+        }
+    }
+
+    if (optind >= argc || 0 == dict_size) {
+        __Usage(argv[0]);
+        return 1;
+    }
+
+    std::string corpus;
+    std::vector<size_t> sizes;
+    for (int i = optind; i < argc; ++i) {
+        struct stat path_stat;
+        if (0 != stat(argv[i], &path_stat)) {
+            fprintf(stderr, "stat %s fail\n", argv[i]);
+            return 1;
+        }
+
+        if (!S_ISDIR(path_stat.st_mode)) {
+            if (!__AddFile(argv[i], max_len, corpus, sizes)) return 1;
+            continue;
+        }
+
+        DIR* dir = opendir(argv[i]);
+        if (NULL == dir) {
+            fprintf(stderr, "opendir %s fail\n", argv[i]);
+            return 1;
+        }
+
+        struct dirent* ent = NULL;
+        while (NULL != (ent = readdir(dir))) {
+            size_t len = strlen(ent->d_name);
+            if (len <= 4 || 0 != strcmp(ent->d_name + len - 4, ".log")) continue;
+            __AddFile(std::string(argv[i]) + "/" + ent->d_name, max_len, corpus, sizes);
+        }
+        closedir(dir);
+    }
+
+    if (sizes.empty()) {
+        fprintf(stderr, "no lines to train on\n");
+        return 1;
+    }
+
+    std::vector<char> dict(dict_size);
+    size_t ret = ZDICT_trainFromBuffer(&dict[0], dict.size(), corpus.data(), &sizes[0], (unsigned)sizes.size());
+    if (ZDICT_isError(ret)) {
+        fprintf(stderr, "train fail: %s, %u lines %u bytes\n", ZDICT_getErrorName(ret),
+                (unsigned)sizes.size(), (unsigned)corpus.size());
+        return 1;
+    }
+
+    FILE* out = fopen(out_path.c_str(), "wb");
+    if (NULL == out || 1 != fwrite(&dict[0], ret, 1, out)) {
+        fprintf(stderr, "write %s fail\n", out_path.c_str());
+        if (NULL != out) fclose(out);
+        return 1;
+    }
+    fclose(out);
+
+    fprintf(stderr, "%s: id %u, %u bytes from %u lines %u bytes\n", out_path.c_str(), ZSTD_getDictID_fromDict(&dict[0], ret),
+            (unsigned)ret, (unsigned)sizes.size(), (unsigned)corpus.size());
+    return 0;
+}
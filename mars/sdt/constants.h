@@ -23,6 +23,7 @@
 #define NET_CHECK_BASIC 1
 #define NET_CHECK_LONG (1 << 1)
 #define NET_CHECK_SHORT (1 << 2)
+#define NET_CHECK_CONCURRENT (1 << 3)   // all checks and targets at once, within one timeout
 
 // Error sequence.
 #define ERR_SEQ (-1)
@@ -30,6 +31,7 @@
 #define MODE_BASIC(mode) ((mode) & NET_CHECK_BASIC)
 #define MODE_LONG(mode) ((mode) & NET_CHECK_LONG)
 #define MODE_SHORT(mode) ((mode) & NET_CHECK_SHORT)
+#define MODE_CONCURRENT(mode) ((mode) & NET_CHECK_CONCURRENT)
 
 // For default host.
 #define DEFAULT_HTTP_HOST "www.qq.com"
@@ -62,6 +64,7 @@
 #define DEFAULT_DNS_TIMEOUT         (3*1000)   // 3000ms
 // For net check timeout
 #define UNUSE_TIMEOUT               (INT_MAX)        // ms
+#define DEFAULT_CONCURRENT_TIMEOUT  (5*1000)   // 5000ms, the longest of the defaults above
 
 // For HTTP User agent.
 #ifdef ANDROID
@@ -41,7 +41,7 @@ class BaseChecker {
 
   public:
     virtual int StartDoCheck(CheckRequestProfile& _check_request) = 0;
-    int CancelDoCheck();
+    virtual int CancelDoCheck();
 
   protected:
     virtual void __DoCheck(CheckRequestProfile& _check_request) = 0;
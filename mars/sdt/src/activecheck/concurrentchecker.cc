@@ -0,0 +1,450 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * concurrentchecker.cc
+ *
+ *  Created on: 2026-10-18
+ */
+
+#include "concurrentchecker.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <set>
+
+#include "boost/bind.hpp"
+
+#include "mars/comm/socket/socket_address.h"
+#include "mars/comm/socket/socketpoll.h"
+#include "mars/comm/thread/lock.h"
+#include "mars/comm/thread/thread.h"
+#include "mars/comm/time_utils.h"
+#include "mars/comm/xlogger/xlogger.h"
+#include "mars/sdt/constants.h"
+#include "mars/stn/proto/longlink_packer.h"
+
+#include "sdt/src/activecheck/httpchecker.h"
+#include "sdt/src/activecheck/tcpchecker.h"
+#include "sdt/src/checkimpl/dnsquery.h"
+#include "sdt/src/checkimpl/http_url_parser.h"
+#include "sdt/src/checkimpl/httpquery.h"
+#include "sdt/src/checkimpl/icmpprober.h"
+#include "sdt/src/checkimpl/pingquery.h"
+
+using namespace mars::sdt;
+using namespace mars::stn;
+
+static const size_t kHttpRecvLimit = 1024;          // as SendHttpQuery, the status line is all it looks at
+static const size_t kTcpRecvLimit = 64 * 1024;
+static const int kPingReportTime = 100;             // ms, for the ping results to make it back before the deadline
+
+static void fill_ping_result(CheckResultProfile& _profile, double _loss_rate, double _avgrtt) {
+    char loss_rate[16] = {0};
+    char avgrtt[16] = {0};
+    snprintf(loss_rate, sizeof(loss_rate), "%f", _loss_rate);
+    snprintf(avgrtt, sizeof(avgrtt), "%f", _avgrtt);
+    _profile.loss_rate = loss_rate;
+    _profile.rtt_str = avgrtt;
+}
+
+ConcurrentChecker::ConcurrentChecker(int _mode)
+    : mode_(_mode)
+    , start_tick_(0)
+    , threads_(new ThreadProbes) {
+    xverbose_function();
+}
+
+ConcurrentChecker::~ConcurrentChecker() {
+    xverbose_function();
+    for (std::vector<SocketProbe*>::iterator iter = socket_probes_.begin(); iter != socket_probes_.end(); ++iter) {
+        if (INVALID_SOCKET != (*iter)->fd) ::socket_close((*iter)->fd);
+        delete *iter;
+    }
+}
+
+int ConcurrentChecker::StartDoCheck(CheckRequestProfile& _check_request) {
+    xinfo_function();
+    return BaseChecker::StartDoCheck(_check_request);
+}
+
+int ConcurrentChecker::CancelDoCheck() {
+    BaseChecker::CancelDoCheck();
+    threads_->breaker.Break();
+    return 1;
+}
+
+void ConcurrentChecker::__DoCheck(CheckRequestProfile& _check_request) {
+    xinfo_function();
+
+    int timeout = (UNUSE_TIMEOUT == _check_request.total_timeout ? DEFAULT_CONCURRENT_TIMEOUT : (int)_check_request.total_timeout);
+    start_tick_ = gettickcount();
+    uint64_t deadline = start_tick_ + timeout;
+
+    SocketPoll poll(threads_->breaker);
+    __AddProbes(_check_request, timeout);
+
+    size_t pending = thread_probes_.size();
+    for (std::vector<SocketProbe*>::iterator iter = socket_probes_.begin(); iter != socket_probes_.end(); ++iter) {
+        if (INVALID_SOCKET == (*iter)->fd) {
+            __Finish(_check_request, (*iter)->profile);
+            continue;
+        }
+        poll.AddEvent((*iter)->fd, false, true, *iter);
+        ++pending;
+    }
+
+    xinfo2(TSF"concurrent check, %_ socket probes, %_ thread probes, timeout:%_", socket_probes_.size(), thread_probes_.size(), timeout);
+
+    std::vector<std::pair<size_t, CheckResultProfile> > finished;
+    while (0 < pending && !is_canceled_) {
+        uint64_t now = gettickcount();
+        if (now >= deadline) break;
+
+        if (0 > poll.Poll((int)(deadline - now))) {
+            xerror2(TSF"poll error:%_", poll.Errno());
+            break;
+        }
+
+        if (poll.BreakerIsBreak()) {
+            threads_->breaker.Clear();
+            ScopedLock lock(threads_->mutex);
+            finished.swap(threads_->finished);
+            lock.unlock();
+
+            for (size_t i = 0; i < finished.size(); ++i) {
+                thread_finished_[finished[i].first] = true;
+                __Finish(_check_request, finished[i].second);
+                --pending;
+            }
+            finished.clear();
+        }
+
+        std::vector<PollEvent> events = poll.TriggeredEvents();
+        for (std::vector<PollEvent>::iterator iter = events.begin(); iter != events.end(); ++iter) {
+            SocketProbe* probe = (SocketProbe*)iter->UserData();
+            if (!__OnSocketEvent(*probe, *iter, poll)) continue;
+
+            poll.DelEvent(probe->fd);
+            ::socket_close(probe->fd);
+            probe->fd = INVALID_SOCKET;
+            __Finish(_check_request, probe->profile);
+            --pending;
+        }
+    }
+
+    // what did not make it in time is reported as such, late threads find the probes closed
+    ScopedLock lock(threads_->mutex);
+    threads_->closed = true;
+    finished.swap(threads_->finished);
+    lock.unlock();
+
+    for (size_t i = 0; i < finished.size(); ++i) {
+        thread_finished_[finished[i].first] = true;
+        __Finish(_check_request, finished[i].second);
+    }
+
+    uint64_t cost_time = gettickcount() - start_tick_;
+    for (std::vector<SocketProbe*>::iterator iter = socket_probes_.begin(); iter != socket_probes_.end(); ++iter) {
+        if (INVALID_SOCKET == (*iter)->fd) continue;
+
+        poll.DelEvent((*iter)->fd);
+        ::socket_close((*iter)->fd);
+        (*iter)->fd = INVALID_SOCKET;
+        (*iter)->profile.error_code = kTimeoutErr;
+        (*iter)->profile.rtt = cost_time;
+        __Finish(_check_request, (*iter)->profile);
+    }
+
+    for (size_t i = 0; i < thread_probes_.size(); ++i) {
+        if (thread_finished_[i]) continue;
+
+        thread_probes_[i].error_code = kTimeoutErr;
+        thread_probes_[i].rtt = cost_time;
+        __Finish(_check_request, thread_probes_[i]);
+    }
+
+    if (UNUSE_TIMEOUT != _check_request.total_timeout) {
+        _check_request.total_timeout = (cost_time < _check_request.total_timeout) ? _check_request.total_timeout - (uint32_t)cost_time : 0;
+    }
+
+    xinfo2(TSF"concurrent check end, cost:%_, canceled:%_, results:%_", cost_time, is_canceled_, _check_request.checkresult_profiles.size());
+}
+
+void ConcurrentChecker::__AddProbes(const CheckRequestProfile& _check_request, int _timeout) {
+    const CheckIPPorts* items[] = {&_check_request.longlink_items, &_check_request.shortlink_items};
+
+    if (MODE_BASIC(mode_)) {
+        std::set<std::string> pinged;
+        std::vector<std::pair<size_t, CheckResultProfile> > pings;
+        for (size_t i = 0; i < sizeof(items) / sizeof(items[0]); ++i) {
+            for (CheckIPPorts::const_iterator iter = items[i]->begin(); iter != items[i]->end(); ++iter) {
+                CheckResultProfile profile;
+                profile.netcheck_type = kDnsCheck;
+                profile.network_type = ::getNetInfo();
+                profile.domain_name = iter->first;
+                __StartThreadProbe(profile, _timeout);
+
+#if defined(__linux__) || defined(__APPLE__)
+                // one ping an ip, the ports of an ip make no difference to it
+                for (std::vector<CheckIPPort>::const_iterator ipport = iter->second.begin(); ipport != iter->second.end(); ++ipport) {
+                    std::string host = ipport->ip.empty() ? DEFAULT_PING_HOST : ipport->ip;
+                    if (!pinged.insert(host).second) continue;
+
+                    CheckResultProfile ping;
+                    ping.netcheck_type = kPingCheck;
+                    ping.network_type = ::getNetInfo();
+                    ping.ip = host;
+                    ping.checkcount = DEFAULT_PING_COUNT;
+                    thread_probes_.push_back(ping);
+                    thread_finished_.push_back(false);
+                    pings.push_back(std::make_pair(thread_probes_.size() - 1, ping));
+                }
+#endif
+            }
+        }
+
+        // all of the pings go out together, from one socket
+        if (!pings.empty() && 0 != Thread(boost::bind(&ConcurrentChecker::__RunPingProbes, threads_, pings, _timeout), "sdt_ping").start()) {
+            xerror2(TSF"start ping thread fail");
+        }
+    }
+
+    if (MODE_SHORT(mode_)) {
+        for (CheckIPPorts::const_iterator iter = _check_request.shortlink_items.begin(); iter != _check_request.shortlink_items.end(); ++iter) {
+            std::string url = HttpChecker::MakeUrl(iter->first);
+            AutoBuffer request;
+            std::string str_req = MakeHttpQueryRequest(url);
+            request.Write(str_req.data(), str_req.size());
+
+            for (std::vector<CheckIPPort>::const_iterator ipport = iter->second.begin(); ipport != iter->second.end(); ++ipport) {
+                CheckResultProfile profile;
+                profile.netcheck_type = kHttpCheck;
+                profile.network_type = ::getNetInfo();
+                profile.ip = ipport->ip;
+                profile.port = ipport->port;
+                profile.url = url;
+
+                // each ip of the host is asked itself, without one it is up to the dns
+                if (socket_address(ipport->ip.c_str(), 0).valid()) {
+                    uint16_t port = 0 != ipport->port ? ipport->port : (uint16_t)HttpUrlParser(url).Port();
+                    __AddSocketProbe(profile, ipport->ip, port, request);
+                } else {
+                    __StartThreadProbe(profile, _timeout);
+                }
+            }
+        }
+    }
+
+    if (MODE_LONG(mode_)) {
+        AutoBuffer noop;
+        TcpChecker::NoopReq(noop);
+
+        for (CheckIPPorts::const_iterator iter = _check_request.longlink_items.begin(); iter != _check_request.longlink_items.end(); ++iter) {
+            for (std::vector<CheckIPPort>::const_iterator ipport = iter->second.begin(); ipport != iter->second.end(); ++ipport) {
+                CheckResultProfile profile;
+                profile.netcheck_type = kTcpCheck;
+                profile.network_type = ::getNetInfo();
+                profile.ip = ipport->ip;
+                profile.port = ipport->port;
+                __AddSocketProbe(profile, ipport->ip, ipport->port, noop);
+            }
+        }
+    }
+}
+
+// connects without blocking, a probe that fails right away is left with an invalid fd and its error
+void ConcurrentChecker::__AddSocketProbe(const CheckResultProfile& _profile, const std::string& _ip, uint16_t _port, AutoBuffer& _request) {
+    SocketProbe* probe = new SocketProbe;
+    probe->profile = _profile;
+    probe->connected = false;
+    probe->send.Write(_request.Ptr(), _request.Length());
+    probe->send.Seek(0, AutoBuffer::ESeekStart);
+    socket_probes_.push_back(probe);
+
+    socket_address addr(_ip.c_str(), _port);
+    probe->fd = addr.valid() ? socket(addr.address().sa_family, SOCK_STREAM, IPPROTO_TCP) : INVALID_SOCKET;
+    if (INVALID_SOCKET == probe->fd) {
+        xerror2(TSF"socket fail, ip:%_, port:%_, errno:%_", _ip, _port, socket_errno);
+        probe->profile.error_code = kConnectErr;
+        return;
+    }
+
+    if (0 != socket_set_nobio(probe->fd)
+            || (0 != connect(probe->fd, &addr.address(), addr.address_length()) && !IS_NOBLOCK_CONNECT_ERRNO(socket_errno))) {
+        xerror2(TSF"connect fail, ip:%_, port:%_, errno:%_", _ip, _port, socket_errno);
+        ::socket_close(probe->fd);
+        probe->fd = INVALID_SOCKET;
+        probe->profile.error_code = kConnectErr;
+    }
+}
+
+void ConcurrentChecker::__StartThreadProbe(const CheckResultProfile& _profile, int _timeout) {
+    thread_probes_.push_back(_profile);
+    thread_finished_.push_back(false);
+
+    // not joined, a probe past the timeout must not hold the check up
+    Thread thread(boost::bind(&ConcurrentChecker::__RunThreadProbe, threads_, thread_probes_.size() - 1, _profile, _timeout), "sdt_probe");
+    if (0 != thread.start()) {
+        xerror2(TSF"start probe thread fail, type:%_", _profile.netcheck_type);
+    }
+}
+
+// true once the probe is done, with its result in _probe.profile
+bool ConcurrentChecker::__OnSocketEvent(SocketProbe& _probe, const PollEvent& _event, SocketPoll& _poll) {
+    if (!_probe.connected) {
+        if (_event.Error() || _event.HangUp() || 0 != socket_error(_probe.fd)) {
+            _probe.profile.error_code = kConnectErr;
+            _probe.profile.rtt = gettickcount() - start_tick_;
+            return true;
+        }
+        if (!_event.Writealbe()) return false;
+
+        _probe.connected = true;
+        _probe.profile.conntime = gettickcount() - start_tick_;
+    }
+
+    if (0 < _probe.send.PosLength()) {
+        ssize_t len = ::send(_probe.fd, (const char*)_probe.send.PosPtr(), _probe.send.PosLength(), 0);
+        if (0 > len) {
+            if (IS_NOBLOCK_SEND_ERRNO(socket_errno)) return false;
+            _probe.profile.error_code = kSndRcvErr;
+            return true;
+        }
+
+        _probe.send.Seek(len, AutoBuffer::ESeekCur);
+        if (0 == _probe.send.PosLength()) {
+            _poll.WriteEvent(_probe.fd, false);
+            _poll.ReadEvent(_probe.fd, true);
+        }
+        return false;
+    }
+
+    char buffer[4096];
+    ssize_t len = ::recv(_probe.fd, buffer, sizeof(buffer), 0);
+    if (0 > len) {
+        if (IS_NOBLOCK_RECV_ERRNO(socket_errno)) return false;
+        _probe.profile.error_code = kSndRcvErr;
+        return true;
+    }
+
+    _probe.recv.Write(buffer, len);
+    _probe.profile.rtt = gettickcount() - start_tick_;
+    bool closed = (0 == len);
+
+    if (kHttpCheck == _probe.profile.netcheck_type) {
+        bool head_end = (NULL != memmem(_probe.recv.Ptr(), _probe.recv.Length(), "\r\n\r\n", 4));
+        if (!head_end && !closed && _probe.recv.Length() < kHttpRecvLimit) return false;
+        if (0 == _probe.recv.Length()) {
+            _probe.profile.error_code = kSndRcvErr;
+            return true;
+        }
+
+        _probe.recv.Write("", 1);      // the head is parsed as a string
+        _probe.profile.status_code = ParseHttpQueryStatus(_probe.recv);
+        return true;
+    }
+
+    uint32_t cmdid = 0, seq = 0;
+    size_t package_len = 0;
+    AutoBuffer body, extension;
+    int unpack = gDefaultLongLinkEncoder.longlink_unpack(_probe.recv, cmdid, seq, package_len, body, extension, NULL);
+    if (LONGLINK_UNPACK_CONTINUE == unpack && !closed && _probe.recv.Length() < kTcpRecvLimit) return false;
+
+    body.Reset();
+    if (!TcpChecker::NoopResp(_probe.recv, cmdid, seq, package_len, body)) {
+        _probe.profile.error_code = 0 == _probe.recv.Length() ? kSndRcvErr : kTcpRespErr;
+    }
+    return true;
+}
+
+void ConcurrentChecker::__Finish(CheckRequestProfile& _check_request, CheckResultProfile& _profile) {
+    xinfo2(TSF"concurrent check result, type:%_, error_code:%_, ip:%_, port:%_, host:%_, status_code:%_, rtt:%_%_",
+           _profile.netcheck_type, _profile.error_code, _profile.ip, _profile.port, _profile.domain_name, _profile.status_code, _profile.rtt, _profile.rtt_str);
+
+    _check_request.checkresult_profiles.push_back(_profile);
+    if (0 != _profile.error_code) _check_request.check_status = kCheckFinish;
+}
+
+void ConcurrentChecker::__RunThreadProbe(std::shared_ptr<ThreadProbes> _probes, size_t _index, CheckResultProfile _profile, int _timeout) {
+    uint64_t start_time = gettickcount();
+
+    if (kDnsCheck == _profile.netcheck_type) {
+        struct socket_ipinfo_t ipinfo;
+        _profile.error_code = socket_gethostbyname(_profile.domain_name.c_str(), &ipinfo, _timeout, NULL);
+        // inet_ntoa returns a static buffer, the probes of this check run on several threads
+        char ip[INET_ADDRSTRLEN] = {0};
+        if (0 == _profile.error_code && 0 < ipinfo.size) _profile.ip1 = socket_inet_ntop(AF_INET, &ipinfo.ip[0], ip, sizeof(ip));
+        if (0 == _profile.error_code && 1 < ipinfo.size) _profile.ip2 = socket_inet_ntop(AF_INET, &ipinfo.ip[1], ip, sizeof(ip));
+    } else if (kHttpCheck == _profile.netcheck_type) {
+        std::string errmsg;
+        int ret = SendHttpQuery(_profile.url, _profile.status_code, errmsg, _timeout);
+        _profile.error_code = (0 > ret ? ret : 0);
+    } else if (kPingCheck == _profile.netcheck_type) {
+#if defined(ANDROID) || defined(__APPLE__)
+        PingQuery ping_query;
+        _profile.error_code = ping_query.RunPingQuery(0, 0, std::max(_timeout / 1000, 1), _profile.ip.c_str());
+
+        struct PingStatus ping_status;
+        if (0 == _profile.error_code && 0 == ping_query.GetPingStatus(ping_status)) {
+            fill_ping_result(_profile, ping_status.loss_rate, ping_status.avgrtt);
+        }
+#endif
+    }
+    _profile.rtt = gettickcount() - start_time;
+
+    ScopedLock lock(_probes->mutex);
+    if (_probes->closed) return;
+
+    _probes->finished.push_back(std::make_pair(_index, _profile));
+    _probes->breaker.Break();
+}
+
+void ConcurrentChecker::__RunPingProbes(std::shared_ptr<ThreadProbes> _probes, std::vector<std::pair<size_t, CheckResultProfile> > _pings, int _timeout) {
+    uint64_t start_time = gettickcount();
+
+    IcmpProber prober;
+    for (size_t i = 0; i < _pings.size(); ++i) {
+        prober.AddHost(_pings[i].second.ip);
+    }
+
+    if (0 != prober.Run(DEFAULT_PING_COUNT, DEFAULT_PING_INTERVAL * 1000, std::max(_timeout - kPingReportTime, 1))) {
+#if defined(ANDROID) || defined(__APPLE__)
+        // no icmp socket for the app, PingQuery has its own way one host at a time
+        for (size_t i = 0; i < _pings.size(); ++i) {
+            Thread(boost::bind(&ConcurrentChecker::__RunThreadProbe, _probes, _pings[i].first, _pings[i].second, _timeout), "sdt_probe").start();
+        }
+        return;
+#else
+        for (size_t i = 0; i < _pings.size(); ++i) {
+            _pings[i].second.error_code = -1;
+        }
+#endif
+    } else {
+        for (size_t i = 0; i < _pings.size(); ++i) {
+            const IcmpProbeStat& stat = prober.Stats()[i];
+            _pings[i].second.error_code = stat.ip.empty() ? -1 : 0;
+            if (!stat.ip.empty()) fill_ping_result(_pings[i].second, stat.loss_rate, stat.avgrtt);
+        }
+    }
+
+    uint64_t cost_time = gettickcount() - start_time;
+    ScopedLock lock(_probes->mutex);
+    if (_probes->closed) return;
+
+    for (size_t i = 0; i < _pings.size(); ++i) {
+        _pings[i].second.rtt = cost_time;
+        _probes->finished.push_back(_pings[i]);
+    }
+    _probes->breaker.Break();
+}
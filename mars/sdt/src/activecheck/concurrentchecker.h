@@ -0,0 +1,95 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * concurrentchecker.h
+ *
+ *  Created on: 2026-10-18
+ */
+
+#ifndef SDT_SRC_ACTIVECHECK_CONCURRENTCHECKER_H_
+#define SDT_SRC_ACTIVECHECK_CONCURRENTCHECKER_H_
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/socket/socketbreaker.h"
+#include "mars/comm/socket/unix_socket.h"
+#include "mars/comm/thread/mutex.h"
+#include "mars/sdt/sdt.h"
+
+#include "basechecker.h"
+
+class PollEvent;
+class SocketPoll;
+
+namespace mars {
+namespace sdt {
+
+/*
+ * The checks of the ping, dns, http and tcp checkers all at once, against one timeout for the whole.
+ * Tcp and http probes share one poller on the check thread, the pings go out together from one icmp
+ * socket on a thread of their own, dns and http probes without an ip have blocking apis only and each
+ * get a thread. Results go to the request as the probes finish, probes still running at the timeout
+ * are reported as kTimeoutErr.
+ */
+class ConcurrentChecker : public BaseChecker {
+  public:
+    ConcurrentChecker(int _mode);
+    virtual ~ConcurrentChecker();
+
+    virtual int StartDoCheck(CheckRequestProfile& _check_request);
+    virtual int CancelDoCheck();
+
+  protected:
+    virtual void __DoCheck(CheckRequestProfile& _check_request);
+
+  private:
+    struct SocketProbe {
+        CheckResultProfile profile;
+        SOCKET fd;
+        bool connected;
+        AutoBuffer send;
+        AutoBuffer recv;
+    };
+
+    // shared with the probe threads, which may outlive a check cut short by the timeout
+    struct ThreadProbes {
+        Mutex mutex;
+        SocketBreaker breaker;      // wakes the poller up for a finished probe, or a cancel
+        std::vector<std::pair<size_t, CheckResultProfile> > finished;
+        bool closed = false;
+    };
+
+    void __AddProbes(const CheckRequestProfile& _check_request, int _timeout);
+    void __AddSocketProbe(const CheckResultProfile& _profile, const std::string& _ip, uint16_t _port, AutoBuffer& _request);
+    void __StartThreadProbe(const CheckResultProfile& _profile, int _timeout);
+    bool __OnSocketEvent(SocketProbe& _probe, const PollEvent& _event, SocketPoll& _poll);
+    void __Finish(CheckRequestProfile& _check_request, CheckResultProfile& _profile);
+
+    static void __RunThreadProbe(std::shared_ptr<ThreadProbes> _probes, size_t _index, CheckResultProfile _profile, int _timeout);
+    static void __RunPingProbes(std::shared_ptr<ThreadProbes> _probes, std::vector<std::pair<size_t, CheckResultProfile> > _pings, int _timeout);
+
+  private:
+    int mode_;
+    uint64_t start_tick_;
+    std::vector<SocketProbe*> socket_probes_;
+    std::vector<CheckResultProfile> thread_probes_;     // as started, for the ones the timeout cuts short
+    std::vector<bool> thread_finished_;
+    std::shared_ptr<ThreadProbes> threads_;
+};
+
+}}
+
+#endif	// SDT_SRC_ACTIVECHECK_CONCURRENTCHECKER_H_
@@ -55,6 +55,16 @@ int HttpChecker::StartDoCheck(CheckRequestProfile& _check_request) {
     return BaseChecker::StartDoCheck(_check_request);
 }
 
+std::string HttpChecker::MakeUrl(const std::string& _host) {
+    std::string url = (_host.empty() ? DEFAULT_HTTP_HOST : _host);
+    url.append(sg_netcheck_cgi.c_str());
+
+    if (!strutil::StartsWith(url, "http://")) {
+        url = std::string("http://") + url;
+    }
+    return url;
+}
+
 
 void HttpChecker::__DoCheck(CheckRequestProfile& _check_request) {
     xinfo_function();
@@ -74,15 +84,10 @@ void HttpChecker::__DoCheck(CheckRequestProfile& _check_request) {
     		profile.ip = (*ipport).ip;
     		profile.port = (*ipport).port;
 
-    		profile.url = (iter->first.empty() ? DEFAULT_HTTP_HOST : (iter->first));
-    		profile.url.append(sg_netcheck_cgi.c_str());
+    		profile.url = MakeUrl(iter->first);
     		uint64_t start_time = gettickcount();
     		std::string errmsg;
-            
-            if (!strutil::StartsWith(profile.url, "http://")) {
-                profile.url = std::string("http://") + profile.url;
-            }
-            
+
     		int ret = SendHttpQuery(profile.url, profile.status_code, errmsg, _check_request.total_timeout);
     		uint64_t cost_time = gettickcount() - start_time;
     		profile.rtt = cost_time;
@@ -37,6 +37,9 @@ class HttpChecker : public BaseChecker {
 
     virtual int StartDoCheck(CheckRequestProfile& _check_request);
 
+    // the url checked for _host, with the cgi of SetHttpNetcheckCGI
+    static std::string MakeUrl(const std::string& _host);
+
   protected:
     virtual void __DoCheck(CheckRequestProfile& _check_request);
 };
@@ -70,7 +70,7 @@ void TcpChecker::__DoCheck(CheckRequestProfile& _check_request) {
     		TcpQuery tcp_query(profile.ip.c_str(), profile.port, 0);
 
             AutoBuffer noop_send;
-            __NoopReq(noop_send);
+            NoopReq(noop_send);
 
             int ret = tcp_query.tcp_send((const unsigned char *)noop_send.Ptr(), (int)noop_send.Length(), timeout);
 
@@ -97,7 +97,7 @@ void TcpChecker::__DoCheck(CheckRequestProfile& _check_request) {
 				} else {
 					uint32_t cmdid = 0, seq = 0; size_t packlen = 0; AutoBuffer recv_body;
 					profile.rtt = cost_time;
-					if (!__NoopResp(recv_buff, cmdid, seq, packlen, recv_body)) {	//not noop resp
+					if (!NoopResp(recv_buff, cmdid, seq, packlen, recv_body)) {	//not noop resp
 						profile.error_code = kTcpRespErr;
 					}
 				}
@@ -118,14 +118,14 @@ void TcpChecker::__DoCheck(CheckRequestProfile& _check_request) {
     }
 }
 
-void TcpChecker::__NoopReq(AutoBuffer& _noop_send) {
+void TcpChecker::NoopReq(AutoBuffer& _noop_send) {
 	AutoBuffer noop_body;
 	AutoBuffer noop_extension;
 	gDefaultLongLinkEncoder.longlink_noop_req_body(noop_body, noop_extension);
 	gDefaultLongLinkEncoder.longlink_pack(gDefaultLongLinkEncoder.longlink_noop_cmdid(), Task::kNoopTaskID, noop_body, noop_extension, _noop_send, NULL);
 }
 
-bool TcpChecker::__NoopResp(const AutoBuffer& _packed, uint32_t& _cmdid, uint32_t& _seq, size_t& _package_len, AutoBuffer& _body) {
+bool TcpChecker::NoopResp(const AutoBuffer& _packed, uint32_t& _cmdid, uint32_t& _seq, size_t& _package_len, AutoBuffer& _body) {
     AutoBuffer extension;
 	int unpackret = gDefaultLongLinkEncoder.longlink_unpack(_packed, _cmdid, _seq, _package_len, _body, extension, NULL);
 	if (unpackret == LONGLINK_UNPACK_OK) {
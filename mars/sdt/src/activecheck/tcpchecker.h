@@ -36,12 +36,11 @@ class TcpChecker : public BaseChecker {
 
     virtual int StartDoCheck(CheckRequestProfile& _check_request);
 
+    static void NoopReq(AutoBuffer& noop_send);
+    static bool NoopResp(const AutoBuffer& _packed, uint32_t& _cmdid, uint32_t& _seq, size_t& _package_len, AutoBuffer& _body);
+
   protected:
     virtual void __DoCheck(CheckRequestProfile& _check_request);
-
-  private:
-    void __NoopReq(AutoBuffer& noop_send);
-    bool __NoopResp(const AutoBuffer& _packed, uint32_t& _cmdid, uint32_t& _seq, size_t& _package_len, AutoBuffer& _body);
 };
 
 }}
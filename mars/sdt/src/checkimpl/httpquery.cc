@@ -76,6 +76,34 @@ static int SplitHttpHeadAndBody(const AutoBuffer& buf, std::string& strHead) {
 }
 
 
+std::string MakeHttpQueryRequest(const std::string& _url) {
+    HttpUrlParser http_url_parser(_url);
+
+    std::string str_req("");
+    http::RequestLine reqLine(http::RequestLine::kGet, http_url_parser.Path(), http::kVersion_1_1);
+    str_req.append(reqLine.ToString());
+
+    http::HeaderFields header;
+    header.HeaderFiled("Accept", "text/html, application/xhtml+xml, */*");
+    header.HeaderFiled("Accept-Language", "zh-CN");
+    header.HeaderFiled("User-Agent", USER_AGENT);
+    header.HeaderFiled("Accept-Encoding", "gzip, deflate");
+    header.HeaderFiled("Proxy-Connection", "Keep-Alive");
+    header.HeaderFiled("Host", http_url_parser.Host());
+    str_req.append(header.ToString());
+    str_req.append("\r\n\r\n");  // important
+
+    return str_req;
+}
+
+int ParseHttpQueryStatus(const AutoBuffer& _recv) {
+    std::string str_statusline;
+    SplitHttpHeadAndBody(_recv, str_statusline);
+    http::StatusLine statusLine;
+    statusLine.FromString(str_statusline);
+    return statusLine.StatusCode();
+}
+
 int SendHttpQuery(const std::string& _url, int& _status_code, std::string& _errmsg, int _timeout) {
     xinfo2(TSF"httpQuery:_url=%_", _url);
     if (!strutil::StartsWith(_url, "http://")) {
@@ -92,22 +120,9 @@ int SendHttpQuery(const std::string& _url, int& _status_code, std::string& _errm
     std::string host = http_url_parser.Host();
     xdebug2(TSF"host=%0", host);
 
-    std::string str_req("");
-    http::RequestLine reqLine(http::RequestLine::kGet, http_url_parser.Path(), http::kVersion_1_1);
-    str_req.append(reqLine.ToString());
-
-    http::HeaderFields header;
-    header.HeaderFiled("Accept", "text/html, application/xhtml+xml, */*");
-    header.HeaderFiled("Accept-Language", "zh-CN");
-    header.HeaderFiled("User-Agent", USER_AGENT);
-    header.HeaderFiled("Accept-Encoding", "gzip, deflate");
-    header.HeaderFiled("Proxy-Connection", "Keep-Alive");
-
     bool domain_is_ipaddr = socket_address(host.c_str(), 0).valid();  // 判断strHost是否是一个点分十进制IP
 
-    header.HeaderFiled("Host", host.c_str());
-    str_req.append(header.ToString());
-    str_req.append("\r\n\r\n");  // important
+    std::string str_req = MakeHttpQueryRequest(_url);
 
     xdebug2(TSF"str_req=%_", str_req);
 
@@ -191,11 +206,7 @@ int SendHttpQuery(const std::string& _url, int& _status_code, std::string& _errm
         }
 
         xdebug2(TSF"recvAutoBuf=%0", (char*)recv_autobuf.Ptr());
-        std::string str_statusline;
-        SplitHttpHeadAndBody(recv_autobuf, str_statusline);
-        http::StatusLine statusLine;
-        statusLine.FromString(str_statusline);
-        _status_code = statusLine.StatusCode();
+        _status_code = ParseHttpQueryStatus(recv_autobuf);
     } while (false);
 
     xdebug2(TSF"ret=%0", ret);
@@ -31,6 +31,13 @@
  */
 int SendHttpQuery(const std::string& _url, int& _status_code, std::string& _errmsg, int _timeout/*ms*/);
 
+class AutoBuffer;
+
+// the GET request SendHttpQuery sends for _url
+std::string MakeHttpQueryRequest(const std::string& _url);
+// the status code of the response head in _recv
+int ParseHttpQueryStatus(const AutoBuffer& _recv);
+
 
 
 #endif /* SDT_SRC_CHECKIMPL_HTTPQUERY_H_ */
@@ -0,0 +1,434 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * icmpprober.cc
+ *
+ *  Created on: 2026-10-18
+ */
+
+#include "icmpprober.h"
+
+#include <string.h>
+
+#include "mars/comm/xlogger/xlogger.h"
+#include "mars/sdt/constants.h"
+
+using namespace mars::sdt;
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <atomic>
+
+#include "mars/comm/socket/socketpoll.h"
+#include "mars/comm/time_utils.h"
+
+#if defined(__linux__) && !(defined(__ANDROID_API__) && __ANDROID_API__ < 21)
+#define ICMP_PROBER_MMSG
+#endif
+
+static const uint8_t kIcmpEchoReply = 0;
+static const uint8_t kIcmpEcho = 8;
+static const size_t kIcmpHeaderLen = 8;
+static const size_t kIcmpDataLen = 56;          // as ping
+static const size_t kRecvLen = 512;             // an echo reply with its ip header, or the start of an icmp error
+static const size_t kControlLen = 64;
+static const size_t kBatch = 32;
+static const size_t kMaxProbes = 0x10000;       // seq is 16 bits
+
+struct IcmpEchoHeader {
+    uint8_t type;
+    uint8_t code;
+    uint16_t cksum;
+    uint16_t id;
+    uint16_t seq;
+};
+
+static std::atomic<uint16_t> sg_ident_seed(0);
+
+static uint64_t realtime_ns() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000000ULL + (uint64_t)tv.tv_usec * 1000ULL;
+}
+
+static uint16_t icmp_checksum(const void* _data, size_t _len) {
+    const uint8_t* p = (const uint8_t*)_data;
+    uint32_t sum = 0;
+
+    for (; _len > 1; p += 2, _len -= 2) sum += (uint32_t)(p[0] << 8 | p[1]);
+    if (1 == _len) sum += (uint32_t)(p[0] << 8);
+
+    sum = (sum >> 16) + (sum & 0xffff);
+    sum += (sum >> 16);
+    return htons((uint16_t)~sum);
+}
+
+// the kernel's receive time if the socket was asked for it, _now otherwise; both are wall clock
+static uint64_t recv_time(struct msghdr& _msg, uint64_t _now) {
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&_msg); NULL != cmsg; cmsg = CMSG_NXTHDR(&_msg, cmsg)) {
+        if (SOL_SOCKET != cmsg->cmsg_level) continue;
+#if defined(SCM_TIMESTAMPNS)
+        if (SCM_TIMESTAMPNS == cmsg->cmsg_type) {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+        }
+#elif defined(SCM_TIMESTAMP)
+        if (SCM_TIMESTAMP == cmsg->cmsg_type) {
+            struct timeval tv;
+            memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+            return (uint64_t)tv.tv_sec * 1000000000ULL + (uint64_t)tv.tv_usec * 1000ULL;
+        }
+#endif
+    }
+    return _now;
+}
+
+IcmpProber::IcmpProber()
+    : fd_(INVALID_SOCKET)
+    , raw_(false)
+    , kernel_timestamp_(false)
+    , ident_((uint16_t)(getpid() + sg_ident_seed.fetch_add(1)))
+    , replied_(0) {
+}
+
+IcmpProber::~IcmpProber() {
+    if (INVALID_SOCKET != fd_) ::socket_close(fd_);
+}
+
+bool IcmpProber::AddHost(const std::string& _host) {
+    IcmpProbeStat stat;
+    stat.host = _host;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_UNSPEC;
+
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    int ret = getaddrinfo(_host.c_str(), NULL, &hints, &res);
+    if (0 == ret && NULL != res) {
+        memcpy(&addr, res->ai_addr, sizeof(addr));
+        char ip[INET_ADDRSTRLEN] = {0};
+        stat.ip = socket_inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+    } else {
+        xerror2(TSF"resolve %_ fail:%_", _host, gai_strerror(ret));
+    }
+    if (NULL != res) freeaddrinfo(res);
+
+    addrs_.push_back(addr);
+    stats_.push_back(stat);
+    return AF_INET == addr.sin_family;
+}
+
+int IcmpProber::Run(int _count, int _interval, int _timeout) {
+    if (_count <= 0) _count = DEFAULT_PING_COUNT;
+    if (_interval <= 0) _interval = DEFAULT_PING_INTERVAL * 1000;
+    if (_timeout <= 0) _timeout = DEFAULT_PING_TIMEOUT * 1000;
+
+    if (!__Open()) return -1;
+
+    xinfo2(TSF"icmp probe %_ hosts, count:%_, interval:%_, timeout:%_, raw:%_, kernel timestamp:%_", stats_.size(), _count, _interval, _timeout, raw_, kernel_timestamp_);
+
+    int ret = 0;
+    SocketPoll poll(breaker_);
+    poll.AddEvent(fd_, true, false, NULL);
+
+    uint64_t deadline = gettickcount() + _timeout;
+    uint64_t next_round = 0;
+    int rounds = 0;
+
+    while (true) {
+        uint64_t now = gettickcount();
+        if (rounds < _count && now >= next_round) {
+            __SendRound();
+            ++rounds;
+            next_round = now + _interval;
+        }
+
+        size_t sent = 0;
+        for (std::vector<Probe>::const_iterator iter = probes_.begin(); iter != probes_.end(); ++iter) {
+            if (0 != iter->send_ns) ++sent;
+        }
+        if ((rounds == _count && replied_ == sent) || now >= deadline) break;
+
+        uint64_t wake = (rounds < _count && next_round < deadline) ? next_round : deadline;
+        if (0 > poll.Poll((int)(wake - now))) {
+            xerror2(TSF"poll error:%_", poll.Errno());
+            ret = -1;
+            break;
+        }
+
+        if (poll.BreakerIsBreak()) {
+            xinfo2(TSF"icmp probe canceled");
+            break;
+        }
+
+        if (!poll.TriggeredEvents().empty()) __Recv();
+    }
+
+    poll.DelEvent(fd_);
+    ::socket_close(fd_);
+    fd_ = INVALID_SOCKET;
+
+    __Summarize();
+    return ret;
+}
+
+void IcmpProber::Cancel() {
+    breaker_.Break();
+}
+
+bool IcmpProber::__Open() {
+    fd_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_ICMP);
+    raw_ = false;
+
+    if (INVALID_SOCKET == fd_) {
+        xinfo2(TSF"icmp dgram socket unavailable, errno:%_, try raw", socket_errno);
+        fd_ = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+        raw_ = true;
+    }
+
+    if (INVALID_SOCKET == fd_) {
+        xerror2(TSF"icmp socket fail, errno:%_(%_)", socket_errno, strerror(socket_errno));
+        return false;
+    }
+
+    if (0 != socket_set_nobio(fd_)) {
+        xerror2(TSF"set nonblock socket error:%_", socket_strerror(socket_errno));
+        ::socket_close(fd_);
+        fd_ = INVALID_SOCKET;
+        return false;
+    }
+
+    int size = 256 * 1024;      // OK if setsockopt fails
+    setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    int on = 1;
+#if defined(SO_TIMESTAMPNS)
+    kernel_timestamp_ = (0 == setsockopt(fd_, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)));
+#elif defined(SO_TIMESTAMP)
+    kernel_timestamp_ = (0 == setsockopt(fd_, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof(on)));
+#endif
+    return true;
+}
+
+// one echo request to every resolved host, seq is the index of its probe
+void IcmpProber::__SendRound() {
+    char packets[kBatch][kIcmpHeaderLen + kIcmpDataLen];
+    size_t seqs[kBatch];
+
+    for (size_t host = 0; host < addrs_.size();) {
+        size_t count = 0;
+        for (; host < addrs_.size() && count < kBatch && probes_.size() < kMaxProbes; ++host) {
+            if (AF_INET != addrs_[host].sin_family) continue;
+
+            Probe probe = {host, 0, -1.0};
+            seqs[count] = probes_.size();
+            probes_.push_back(probe);
+
+            IcmpEchoHeader header = {kIcmpEcho, 0, 0, htons(ident_), htons((uint16_t)seqs[count])};
+            memcpy(packets[count], &header, sizeof(header));
+            memset(packets[count] + kIcmpHeaderLen, 0xa5, kIcmpDataLen);
+            header.cksum = icmp_checksum(packets[count], sizeof(packets[count]));
+            memcpy(packets[count], &header, sizeof(header));
+            ++count;
+        }
+        if (0 == count) break;
+
+        uint64_t send_ns = realtime_ns();
+#ifdef ICMP_PROBER_MMSG
+        struct mmsghdr msgs[kBatch];
+        struct iovec iovs[kBatch];
+        memset(msgs, 0, sizeof(msgs));
+        for (size_t i = 0; i < count; ++i) {
+            iovs[i].iov_base = packets[i];
+            iovs[i].iov_len = sizeof(packets[i]);
+            msgs[i].msg_hdr.msg_name = &addrs_[probes_[seqs[i]].host];
+            msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        // sendmmsg stops at the first that fails, which is skipped and never counted as sent
+        for (size_t done = 0; done < count;) {
+            int ret = sendmmsg(fd_, msgs + done, (unsigned int)(count - done), 0);
+            if (0 > ret) {
+                xwarn2(TSF"sendmmsg to %_ fail, errno:%_", stats_[probes_[seqs[done]].host].ip, socket_errno);
+                ++done;
+                continue;
+            }
+            for (int i = 0; i < ret; ++i) probes_[seqs[done + i]].send_ns = send_ns;
+            done += ret;
+        }
+#else
+        for (size_t i = 0; i < count; ++i) {
+            Probe& probe = probes_[seqs[i]];
+            if ((ssize_t)sizeof(packets[i]) != sendto(fd_, packets[i], sizeof(packets[i]), 0, (struct sockaddr*)&addrs_[probe.host], sizeof(struct sockaddr_in))) {
+                xwarn2(TSF"sendto %_ fail, errno:%_", stats_[probe.host].ip, socket_errno);
+                continue;
+            }
+            probe.send_ns = send_ns;
+        }
+#endif
+    }
+}
+
+// drains what the socket has
+void IcmpProber::__Recv() {
+    char buffers[kBatch][kRecvLen];
+    char controls[kBatch][kControlLen];
+    struct sockaddr_in froms[kBatch];
+    struct iovec iovs[kBatch];
+
+#ifdef ICMP_PROBER_MMSG
+    struct mmsghdr msgs[kBatch];
+    while (true) {
+        memset(msgs, 0, sizeof(msgs));
+        for (size_t i = 0; i < kBatch; ++i) {
+            iovs[i].iov_base = buffers[i];
+            iovs[i].iov_len = kRecvLen;
+            msgs[i].msg_hdr.msg_name = &froms[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(froms[i]);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_control = controls[i];
+            msgs[i].msg_hdr.msg_controllen = kControlLen;
+        }
+
+        int n = recvmmsg(fd_, msgs, kBatch, MSG_DONTWAIT, NULL);
+        if (0 > n) {
+            // drained, or an icmp error the kernel matched to the socket and reports once
+            if (!IS_NOBLOCK_RECV_ERRNO(socket_errno)) xwarn2(TSF"recvmmsg errno:%_(%_)", socket_errno, strerror(socket_errno));
+            return;
+        }
+
+        uint64_t now = realtime_ns();
+        for (int i = 0; i < n; ++i) {
+            __OnReply(buffers[i], msgs[i].msg_len, froms[i], recv_time(msgs[i].msg_hdr, now));
+        }
+        if ((size_t)n < kBatch) return;
+    }
+#else
+    while (true) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        iovs[0].iov_base = buffers[0];
+        iovs[0].iov_len = kRecvLen;
+        msg.msg_name = &froms[0];
+        msg.msg_namelen = sizeof(froms[0]);
+        msg.msg_iov = &iovs[0];
+        msg.msg_iovlen = 1;
+        msg.msg_control = controls[0];
+        msg.msg_controllen = kControlLen;
+
+        ssize_t n = recvmsg(fd_, &msg, 0);
+        if (0 > n) {
+            if (!IS_NOBLOCK_RECV_ERRNO(socket_errno)) xwarn2(TSF"recvmsg errno:%_(%_)", socket_errno, strerror(socket_errno));
+            return;
+        }
+
+        __OnReply(buffers[0], (size_t)n, froms[0], recv_time(msg, realtime_ns()));
+    }
+#endif
+}
+
+void IcmpProber::__OnReply(const char* _data, size_t _len, const struct sockaddr_in& _from, uint64_t _recv_ns) {
+    // raw sockets, and the dgram ones of Apple, hand the ip header over as well
+    if (0 < _len && 4 == ((uint8_t)_data[0] >> 4)) {
+        size_t ihl = ((uint8_t)_data[0] & 0x0f) * 4;
+        if (_len < ihl) return;
+        _data += ihl;
+        _len -= ihl;
+    }
+    if (_len < kIcmpHeaderLen) return;
+
+    IcmpEchoHeader header;
+    memcpy(&header, _data, sizeof(header));
+    if (kIcmpEchoReply != header.type) return;
+
+    // dgram sockets get their own replies only, with an id the kernel picked in place of ident_
+    if (raw_ && ntohs(header.id) != ident_) return;
+
+    size_t seq = ntohs(header.seq);
+    if (seq >= probes_.size()) return;
+
+    Probe& probe = probes_[seq];
+    if (0 == probe.send_ns || 0 <= probe.rtt) return;      // never sent, or a duplicate
+    if (addrs_[probe.host].sin_addr.s_addr != _from.sin_addr.s_addr) return;
+
+    probe.rtt = _recv_ns > probe.send_ns ? (double)(_recv_ns - probe.send_ns) / 1000000.0 : 0.0;
+    ++replied_;
+}
+
+void IcmpProber::__Summarize() {
+    for (std::vector<Probe>::const_iterator iter = probes_.begin(); iter != probes_.end(); ++iter) {
+        if (0 == iter->send_ns) continue;
+
+        IcmpProbeStat& stat = stats_[iter->host];
+        ++stat.sent;
+        if (0 <= iter->rtt) stat.rtts.push_back(iter->rtt);
+    }
+
+    for (std::vector<IcmpProbeStat>::iterator stat = stats_.begin(); stat != stats_.end(); ++stat) {
+        stat->received = (int)stat->rtts.size();
+        if (0 < stat->sent) stat->loss_rate = 1.0 - (double)stat->received / stat->sent;
+
+        if (!stat->rtts.empty()) {
+            double sum = 0.0, diff = 0.0;
+            stat->minrtt = stat->maxrtt = stat->rtts[0];
+            for (size_t i = 0; i < stat->rtts.size(); ++i) {
+                stat->minrtt = std::min(stat->minrtt, stat->rtts[i]);
+                stat->maxrtt = std::max(stat->maxrtt, stat->rtts[i]);
+                sum += stat->rtts[i];
+                if (0 < i) diff += fabs(stat->rtts[i] - stat->rtts[i - 1]);
+            }
+            stat->avgrtt = sum / stat->rtts.size();
+            if (1 < stat->rtts.size()) stat->jitter = diff / (stat->rtts.size() - 1);
+        }
+
+        xinfo2(TSF"icmp probe %_(%_): sent:%_, received:%_, loss:%_, rtt min/avg/max:%_/%_/%_ ms, jitter:%_ ms",
+               stat->host, stat->ip, stat->sent, stat->received, stat->loss_rate, stat->minrtt, stat->avgrtt, stat->maxrtt, stat->jitter);
+    }
+}
+
+#else
+
+IcmpProber::IcmpProber()
+    : fd_(INVALID_SOCKET), raw_(false), kernel_timestamp_(false), ident_(0), replied_(0) {}
+IcmpProber::~IcmpProber() {}
+
+bool IcmpProber::AddHost(const std::string& _host) {
+    IcmpProbeStat stat;
+    stat.host = _host;
+    stats_.push_back(stat);
+    return false;
+}
+
+int IcmpProber::Run(int _count, int _interval, int _timeout) {
+    xerror2(TSF"icmp probe is not support on win32 now!");
+    return -1;
+}
+
+void IcmpProber::Cancel() {}
+
+#endif
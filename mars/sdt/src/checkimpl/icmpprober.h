@@ -0,0 +1,101 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * icmpprober.h
+ *
+ *  Created on: 2026-10-18
+ */
+
+#ifndef SDT_SRC_CHECKIMPL_ICMPPROBER_H_
+#define SDT_SRC_CHECKIMPL_ICMPPROBER_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "mars/comm/socket/socketbreaker.h"
+#include "mars/comm/socket/unix_socket.h"
+
+namespace mars {
+namespace sdt {
+
+struct IcmpProbeStat {
+    std::string host;
+    std::string ip;             // as resolved, empty if it did not
+    int sent = 0;
+    int received = 0;
+    double loss_rate = 1.0;
+    double minrtt = 0.0;        // ms
+    double avgrtt = 0.0;        // ms
+    double maxrtt = 0.0;        // ms
+    double jitter = 0.0;        // ms, mean difference of consecutive rtts
+    std::vector<double> rtts;   // ms, in the order sent
+};
+
+/*
+ * Echo requests to many hosts over one ICMP socket. Every round sends a request to each host at once
+ * (sendmmsg where there is one), replies are drained in batches (recvmmsg) and matched back by id and
+ * seq, timed by the kernel receive timestamp when the socket gives one. The unprivileged SOCK_DGRAM
+ * ICMP socket of Linux and Apple is tried first, SOCK_RAW after it. IPv4 only, as PingQuery.
+ */
+class IcmpProber {
+  public:
+    IcmpProber();
+    ~IcmpProber();
+
+    // false if _host does not resolve to an ipv4 address, it is still reported with nothing sent
+    bool AddHost(const std::string& _host);
+
+    /**
+     * _count rounds _interval ms apart, all of it within _timeout ms.
+     * return value:
+     * 0---->done, see Stats()
+     * -1--->no icmp socket could be opened, or the poll failed
+     */
+    int Run(int _count, int _interval /*ms*/, int _timeout /*ms*/);
+    void Cancel();
+
+    const std::vector<IcmpProbeStat>& Stats() const { return stats_; }
+    bool KernelTimestamp() const { return kernel_timestamp_; }
+
+  private:
+    struct Probe {
+        size_t host;
+        uint64_t send_ns;
+        double rtt;             // ms, < 0 until replied
+    };
+
+    bool __Open();
+    void __SendRound();
+    void __Recv();
+    void __OnReply(const char* _data, size_t _len, const struct sockaddr_in& _from, uint64_t _recv_ns);
+    void __Summarize();
+
+    IcmpProber(const IcmpProber&);
+    IcmpProber& operator=(const IcmpProber&);
+
+  private:
+    SOCKET fd_;
+    bool raw_;                  // replies carry the ip header and everyone's echo replies
+    bool kernel_timestamp_;
+    uint16_t ident_;
+    size_t replied_;
+    std::vector<struct sockaddr_in> addrs_;    // of stats_, sin_family is AF_UNSPEC if unresolved
+    std::vector<IcmpProbeStat> stats_;
+    std::vector<Probe> probes_;                 // indexed by seq
+    SocketBreaker breaker_;
+};
+
+}}
+
+#endif  // SDT_SRC_CHECKIMPL_ICMPPROBER_H_
@@ -0,0 +1,41 @@
+#include "icmpprober.h"
+#include "gtest/gtest.h"
+
+using namespace testing;
+using namespace mars::sdt;
+
+TEST(icmpprober, loopback_and_unresolved) {
+    const int kCount = 3;
+    IcmpProber prober;
+    EXPECT_TRUE(prober.AddHost("127.0.0.1"));
+    EXPECT_TRUE(prober.AddHost("127.0.0.2"));
+    EXPECT_FALSE(prober.AddHost("no.such.host.invalid"));
+
+    // neither an unprivileged nor a raw icmp socket, e.g. ping_group_range excludes us and we are not root
+    if (-1 == prober.Run(kCount, 20, 3000)) GTEST_SKIP() << "no icmp socket";
+
+    const std::vector<IcmpProbeStat>& stats = prober.Stats();
+    ASSERT_EQ(3u, stats.size());
+
+    for (size_t i = 0; i < 2; ++i) {
+        const IcmpProbeStat& stat = stats[i];
+        EXPECT_EQ(stat.host, stat.ip);
+        EXPECT_EQ(kCount, stat.sent) << stat.host;
+        EXPECT_EQ(kCount, stat.received) << stat.host;
+        EXPECT_EQ(0.0, stat.loss_rate) << stat.host;
+        ASSERT_EQ((size_t)kCount, stat.rtts.size()) << stat.host;
+        EXPECT_LE(0.0, stat.minrtt);
+        EXPECT_LE(stat.minrtt, stat.avgrtt);
+        EXPECT_LE(stat.avgrtt, stat.maxrtt);
+    }
+
+    // reported, with nothing sent and everything lost
+    const IcmpProbeStat& unresolved = stats[2];
+    EXPECT_EQ("no.such.host.invalid", unresolved.host);
+    EXPECT_TRUE(unresolved.ip.empty());
+    EXPECT_EQ(0, unresolved.sent);
+    EXPECT_EQ(0, unresolved.received);
+    EXPECT_EQ(1.0, unresolved.loss_rate);
+}
+
+EXPORT_GTEST_SYMBOLS(sdt_export_icmpprober_unittest)
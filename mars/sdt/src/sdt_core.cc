@@ -28,6 +28,7 @@
 #include "mars/comm/messagequeue/message_queue.h"
 #include "mars/sdt/constants.h"
 
+#include "activecheck/concurrentchecker.h"
 #include "activecheck/dnschecker.h"
 #include "activecheck/httpchecker.h"
 #include "activecheck/pingchecker.h"
@@ -79,6 +80,12 @@ void SdtCore::__InitCheckReq(CheckIPPorts& _longlink_items, CheckIPPorts& _short
 	check_request_.mode = _mode;
 	check_request_.total_timeout = _timeout;
 
+    if (MODE_CONCURRENT(_mode)) {
+        if (MODE_SHORT(_mode)) check_request_.shortlink_items.insert(_shortlink_items.begin(), _shortlink_items.end());
+        check_list_.push_back(new ConcurrentChecker(_mode));
+        return;
+    }
+
     if (MODE_BASIC(_mode)) {
         PingChecker* ping_checker = new PingChecker();
         check_list_.push_back(ping_checker);
@@ -156,5 +156,28 @@ static int __unpack_test(const void* _packed, size_t _packed_len, uint32_t& _cmd
         };
     }
 
+    void LongLinkEncoder::EnableDefaultPackHeader() {
+        longlink_pack_header = [](uint32_t _cmdid, uint32_t _seq, const AutoBuffer& _body, const AutoBuffer& _extension, AutoBuffer& _header, longlink_tracker* _tracker) {
+            __STNetMsgXpHeader st = {0};
+            st.head_length = htonl(sizeof(__STNetMsgXpHeader));
+            st.client_version = htonl(sg_client_version);
+            st.cmdid = htonl(_cmdid);
+            st.seq = htonl(_seq);
+            st.body_length = htonl(_body.Length());
+            
+            _header.Write(&st, sizeof(st));
+            _header.Seek(0, AutoBuffer::ESeekStart);
+            return true;
+        };
+    }
+
+    void LongLinkEncoder::EnableDefaultUnpackView() {
+        longlink_unpack_view = [](const AutoBuffer& _packed, uint32_t& _cmdid, uint32_t& _seq, size_t& _package_len, size_t& _body_offset, size_t& _body_len, longlink_tracker* _tracker) {
+            int ret = __unpack_test(_packed.Ptr(), _packed.Length(), _cmdid,  _seq, _package_len, _body_len);
+            _body_offset = _package_len - _body_len;
+            return ret;
+        };
+    }
+
 }
 }
@@ -0,0 +1,99 @@
+#include "longlink_packer.h"
+#include "gtest/gtest.h"
+
+#include <string.h>
+
+#include "mars/comm/autobuffer.h"
+
+using namespace testing;
+using namespace mars::stn;
+
+static void __Pack(uint32_t _cmdid, uint32_t _seq, size_t _body_len, AutoBuffer& _packed) {
+    AutoBuffer body;
+    body.AllocWrite(_body_len);
+    for (size_t i = 0; i < _body_len; ++i) ((char*)body.Ptr())[i] = (char)i;
+    body.Length(0, _body_len);
+    gDefaultLongLinkEncoder.longlink_pack(_cmdid, _seq, body, AutoBuffer(), _packed, NULL);
+}
+
+TEST(longlink_packer, unpack_view_agrees_with_unpack) {
+    LongLinkEncoder encoder;
+    EXPECT_FALSE((bool)encoder.longlink_unpack_view);    // opt-in, a custom longlink_unpack may do more
+    encoder.EnableDefaultUnpackView();
+
+    AutoBuffer packed;
+    __Pack(1000, 42, 300, packed);
+
+    uint32_t cmdid = 0;
+    uint32_t seq = 0;
+    size_t packlen = 0;
+    AutoBuffer body;
+    AutoBuffer extension;
+    ASSERT_EQ(LONGLINK_UNPACK_OK, gDefaultLongLinkEncoder.longlink_unpack(packed, cmdid, seq, packlen, body, extension, NULL));
+
+    uint32_t view_cmdid = 0;
+    uint32_t view_seq = 0;
+    size_t view_packlen = 0;
+    size_t body_offset = 0;
+    size_t body_len = 0;
+    ASSERT_EQ(LONGLINK_UNPACK_OK, encoder.longlink_unpack_view(packed, view_cmdid, view_seq, view_packlen, body_offset, body_len, NULL));
+
+    EXPECT_EQ(cmdid, view_cmdid);
+    EXPECT_EQ(seq, view_seq);
+    EXPECT_EQ(packlen, view_packlen);
+    EXPECT_EQ(packed.Length(), packlen);
+    ASSERT_EQ(body.Length(), body_len);
+    EXPECT_EQ(packlen, body_offset + body_len);
+    EXPECT_EQ(0, memcmp(body.Ptr(), packed.Ptr(body_offset), body_len));
+}
+
+TEST(longlink_packer, unpack_view_partial) {
+    LongLinkEncoder encoder;
+    encoder.EnableDefaultUnpackView();
+
+    AutoBuffer packed;
+    __Pack(1000, 42, 64 * 1024, packed);
+
+    uint32_t cmdid = 0;
+    uint32_t seq = 0;
+    size_t packlen = 0;
+    size_t body_offset = 0;
+    size_t body_len = 0;
+
+    // not even a header yet
+    AutoBuffer head;
+    head.Attach(packed.Ptr(), 4);
+    EXPECT_EQ(LONGLINK_UNPACK_CONTINUE, encoder.longlink_unpack_view(head, cmdid, seq, packlen, body_offset, body_len, NULL));
+    head.Detach();
+
+    // the header and a part of the body: the whole layout is known already
+    AutoBuffer part;
+    part.Attach(packed.Ptr(), 100);
+    EXPECT_EQ(LONGLINK_UNPACK_CONTINUE, encoder.longlink_unpack_view(part, cmdid, seq, packlen, body_offset, body_len, NULL));
+    part.Detach();
+    EXPECT_EQ(1000u, cmdid);
+    EXPECT_EQ(42u, seq);
+    EXPECT_EQ(packed.Length(), packlen);
+    EXPECT_EQ(64u * 1024, body_len);
+    EXPECT_EQ(packlen - body_len, body_offset);
+}
+
+TEST(longlink_packer, pack_header_then_body_is_pack) {
+    AutoBuffer packed;
+    __Pack(1000, 42, 300, packed);
+
+    AutoBuffer body;
+    body.Write(packed.Ptr(packed.Length() - 300), 300);
+    LongLinkEncoder encoder;
+    EXPECT_FALSE((bool)encoder.longlink_pack_header);    // opt-in, a custom longlink_pack may do more
+    encoder.EnableDefaultPackHeader();
+
+    AutoBuffer header;
+    ASSERT_TRUE(encoder.longlink_pack_header(1000, 42, body, AutoBuffer(), header, NULL));
+
+    ASSERT_EQ(packed.Length(), header.Length() + body.Length());
+    EXPECT_EQ(0, header.Pos());
+    EXPECT_EQ(0, memcmp(packed.Ptr(), header.Ptr(), header.Length()));
+}
+
+EXPORT_GTEST_SYMBOLS(stn_export_longlink_packer_unittest)
@@ -0,0 +1,316 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+/*
+ * ipport_history.cc
+ *
+ *  Created on: 2026-10-18
+ */
+
+#include "ipport_history.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "boost/bind.hpp"
+
+#include "mars/comm/tinyxml2.h"
+#include "mars/comm/xlogger/xlogger.h"
+
+#define IPPORT_HISTORY_FILENAME "/ipportrecords3.bin"
+#define IPPORT_RECORDS_FILENAME "/ipportrecords2.xml"
+
+static const uint32_t kMagic = 0x31485049;  // host byte order, the file never leaves the device
+static const time_t kRecordTimeout = 60 * 60 * 24;
+static const long kFlushDelay = 5 * 1000;   // the results of one connect burst go out in one write
+
+static const char* const kRecord = "record";
+static const char* const kItem = "item";
+static const char* const kTime = "time";
+static const char* const kNetInfo = "netinfo";
+static const char* const kIP = "ip";
+static const char* const kPort = "port";
+static const char* const kHistoryResult = "historyresult";
+
+#define SET_BIT(SET, RECORDS)  RECORDS = (((RECORDS)<<1) | (bool(SET)))
+
+using namespace mars::stn;
+
+IPPortHistory::IPPortHistory(const std::string& _dir)
+: path_(_dir + IPPORT_HISTORY_FILENAME)
+, xml_path_(_dir + IPPORT_RECORDS_FILENAME)
+, dirty_(false)
+, flush_now_(false)
+, stop_(false)
+, seq_(0)
+, written_seq_(0)
+, xml_imported_(false)
+, thread_(boost::bind(&IPPortHistory::__RunFlush, this), "ipport_history") {
+    ScopedLock lock(mutex_);
+    bool changed = !__Load() && __ImportXml();
+    changed = __RemoveTimeout() || changed;
+    if (changed) __MarkDirty(lock);
+}
+
+IPPortHistory::~IPPortHistory() {
+    ScopedLock lock(mutex_);
+    stop_ = true;
+    cond_.notifyAll(lock);
+    lock.unlock();
+
+    thread_.join();
+    FlushSync();
+}
+
+void IPPortHistory::Get(const std::string& _netinfo, std::vector<Item>& _items) const {
+    _items.clear();
+
+    ScopedLock lock(mutex_);
+    std::map<std::string, Record>::const_iterator record = records_.find(_netinfo);
+    if (records_.end() != record) _items = record->second.items;
+}
+
+void IPPortHistory::Update(const std::string& _netinfo, const std::string& _ip, uint16_t _port, bool _is_success) {
+    ScopedLock lock(mutex_);
+
+    Record& record = records_[_netinfo];
+    if (0 == record.time) record.time = time(NULL);
+
+    std::vector<Item>::iterator item = record.items.begin();
+    for (; item != record.items.end(); ++item) {
+        if (item->port == _port && item->ip == _ip) break;
+    }
+
+    if (record.items.end() == item) {
+        record.items.push_back(Item());
+        item = record.items.end() - 1;
+        item->ip = _ip;
+        item->port = _port;
+    }
+
+    SET_BIT(!_is_success, item->results);
+    __MarkDirty(lock);
+}
+
+void IPPortHistory::Flush() {
+    ScopedLock lock(mutex_);
+    if (!dirty_) return;
+
+    flush_now_ = true;
+    cond_.notifyAll(lock);
+}
+
+void IPPortHistory::FlushSync() {
+    ScopedLock lock(mutex_);
+    if (!dirty_) return;
+
+    AutoBuffer data;
+    __Serialize(data);
+    uint64_t seq = seq_;
+    lock.unlock();
+
+    __Write(data, seq);
+}
+
+bool IPPortHistory::__Load() {
+    FILE* file = fopen(path_.c_str(), "rb");
+    if (NULL == file) return false;
+
+    AutoBuffer data;
+    char buffer[4096];
+    size_t len = 0;
+    while (0 < (len = fread(buffer, 1, sizeof(buffer), file))) {
+        data.Write(buffer, len);
+    }
+    fclose(file);
+    data.Seek(0, AutoBuffer::ESeekStart);
+
+    uint32_t magic = 0;
+    uint32_t record_count = 0;
+    std::map<std::string, Record> records;
+    bool valid = sizeof(magic) == data.Read(magic) && kMagic == magic && sizeof(record_count) == data.Read(record_count);
+
+    for (uint32_t i = 0; valid && i < record_count; ++i) {
+        uint16_t netinfo_len = 0;
+        uint64_t lasttime = 0;
+        uint32_t item_count = 0;
+        std::string netinfo;
+
+        valid = sizeof(netinfo_len) == data.Read(netinfo_len) && netinfo_len <= data.PosLength();
+        if (!valid) break;
+        netinfo.assign((const char*)data.PosPtr(), netinfo_len);
+        data.Seek(netinfo_len, AutoBuffer::ESeekCur);
+        valid = sizeof(lasttime) == data.Read(lasttime) && sizeof(item_count) == data.Read(item_count);
+
+        Record& record = records[netinfo];
+        record.time = (time_t)lasttime;
+        for (uint32_t j = 0; valid && j < item_count; ++j) {
+            uint8_t ip_len = 0;
+            Item item;
+            valid = sizeof(ip_len) == data.Read(ip_len) && ip_len <= data.PosLength();
+            if (!valid) break;
+            item.ip.assign((const char*)data.PosPtr(), ip_len);
+            data.Seek(ip_len, AutoBuffer::ESeekCur);
+            valid = sizeof(item.port) == data.Read(item.port) && sizeof(item.results) == data.Read(item.results);
+            if (valid) record.items.push_back(item);
+        }
+    }
+
+    // a file cut short is dropped as a whole, the history comes back with the next connects
+    if (!valid) {
+        xerror2(TSF"bad history file %_, len:%_", path_, data.Length());
+        return true;
+    }
+
+    records_.swap(records);
+    return true;
+}
+
+bool IPPortHistory::__ImportXml() {
+    tinyxml2::XMLDocument recordsxml;
+    if (tinyxml2::XML_SUCCESS != recordsxml.LoadFile(xml_path_.c_str())) return false;
+
+    for (const tinyxml2::XMLElement* record = recordsxml.FirstChildElement(kRecord);
+            NULL != record; record = record->NextSiblingElement(kRecord)) {
+        const char* netinfo = record->Attribute(kNetInfo);
+        const char* lasttime = record->Attribute(kTime);
+        if (NULL == netinfo || NULL == lasttime) continue;
+
+        Record& imported = records_[netinfo];
+        imported.time = (time_t)strtoul(lasttime, NULL, 10);
+
+        for (const tinyxml2::XMLElement* item = record->FirstChildElement(kItem); NULL != item; item = item->NextSiblingElement(kItem)) {
+            const char* ip = item->Attribute(kIP);
+            if (NULL == ip) continue;
+
+            Item history;
+            history.ip = ip;
+            history.port = (uint16_t)item->UnsignedAttribute(kPort);
+            history.results = (uint64_t)item->Int64Attribute(kHistoryResult);
+            imported.items.push_back(history);
+        }
+    }
+
+    xinfo2(TSF"import %_ networks from %_", records_.size(), xml_path_);
+    xml_imported_ = true;
+    return true;
+}
+
+bool IPPortHistory::__RemoveTimeout() {
+    time_t now = time(NULL);
+    bool removed = false;
+
+    for (std::map<std::string, Record>::iterator iter = records_.begin(); iter != records_.end();) {
+        if (now < iter->second.time || now - iter->second.time >= kRecordTimeout) {
+            records_.erase(iter++);
+            removed = true;
+        } else {
+            ++iter;
+        }
+    }
+
+    return removed;
+}
+
+void IPPortHistory::__MarkDirty(ScopedLock& _lock) {
+    if (dirty_) return;
+
+    dirty_ = true;
+    cond_.notifyAll(_lock);
+    thread_.start();
+}
+
+void IPPortHistory::__Serialize(AutoBuffer& _data) {
+    __RemoveTimeout();
+
+    uint32_t record_count = (uint32_t)records_.size();
+    _data.Write(&kMagic, sizeof(kMagic));
+    _data.Write(&record_count, sizeof(record_count));
+
+    for (std::map<std::string, Record>::const_iterator iter = records_.begin(); iter != records_.end(); ++iter) {
+        uint16_t netinfo_len = (uint16_t)std::min(iter->first.size(), (size_t)0xFFFF);
+        uint64_t lasttime = (uint64_t)iter->second.time;
+        uint32_t item_count = (uint32_t)iter->second.items.size();
+        _data.Write(&netinfo_len, sizeof(netinfo_len));
+        _data.Write(iter->first.data(), netinfo_len);
+        _data.Write(&lasttime, sizeof(lasttime));
+        _data.Write(&item_count, sizeof(item_count));
+
+        for (std::vector<Item>::const_iterator item = iter->second.items.begin(); item != iter->second.items.end(); ++item) {
+            uint8_t ip_len = (uint8_t)std::min(item->ip.size(), (size_t)0xFF);
+            _data.Write(&ip_len, sizeof(ip_len));
+            _data.Write(item->ip.data(), ip_len);
+            _data.Write(&item->port, sizeof(item->port));
+            _data.Write(&item->results, sizeof(item->results));
+        }
+    }
+
+    dirty_ = false;
+    flush_now_ = false;
+    ++seq_;
+}
+
+// writes a new file and renames it over the old one, so a crash leaves one or the other
+void IPPortHistory::__Write(AutoBuffer& _data, uint64_t _seq) {
+    ScopedLock lock(write_mutex_);
+    // FlushSync and the flush thread may come out of order
+    if (_seq <= written_seq_) return;
+
+    std::string temp_path = path_ + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "wb");
+    if (NULL == file) {
+        xerror2(TSF"open %_ fail, errno:%_", temp_path, errno);
+        return;
+    }
+
+    bool written = _data.Length() == fwrite(_data.Ptr(), 1, _data.Length(), file);
+    written = (0 == fclose(file)) && written;
+    if (!written || 0 != rename(temp_path.c_str(), path_.c_str())) {
+        xerror2(TSF"write %_ fail, errno:%_", path_, errno);
+        remove(temp_path.c_str());
+        return;
+    }
+
+    written_seq_ = _seq;
+    if (xml_imported_) {
+        remove(xml_path_.c_str());
+        xml_imported_ = false;
+    }
+}
+
+void IPPortHistory::__RunFlush() {
+    ScopedLock lock(mutex_);
+
+    while (!stop_) {
+        if (!dirty_) {
+            cond_.wait(lock);
+            continue;
+        }
+
+        // the destructor and Flush cut the delay short
+        if (!flush_now_) cond_.wait(lock, kFlushDelay);
+        if (stop_) break;
+        if (!dirty_) continue;
+
+        AutoBuffer data;
+        __Serialize(data);
+        uint64_t seq = seq_;
+        lock.unlock();
+
+        __Write(data, seq);
+        lock.lock();
+    }
+}
@@ -0,0 +1,110 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+/*
+ * ipport_history.h
+ *
+ *  Created on: 2026-10-18
+ */
+
+#ifndef STN_SRC_IPPORT_HISTORY_H_
+#define STN_SRC_IPPORT_HISTORY_H_
+
+#include <stdint.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/thread/condition.h"
+#include "mars/comm/thread/lock.h"
+#include "mars/comm/thread/thread.h"
+
+namespace mars {
+namespace stn {
+
+/*
+ * The connect results SimpleIPPortSort keeps for each network, by the label of getCurrNetLabel.
+ * Updates only change memory; a flush thread writes them behind to a compact binary file, so
+ * neither an update nor a network switch waits for the disk:
+ *
+ *   file:   |magic|record count|records|
+ *   record: |netinfo len u16|netinfo|time u64|item count u32|items|
+ *   item:   |ip len u8|ip|port u16|results u64|
+ *
+ * The ipportrecords2.xml of older versions is imported once and removed with the first write.
+ */
+class IPPortHistory {
+  public:
+    struct Item {
+        std::string ip;
+        uint16_t port;
+        uint64_t results;   // a bit a result, the latest in bit 0, set for a failure
+        Item(): port(0), results(0) {}
+    };
+
+  public:
+    // loads the file of _dir, if any
+    explicit IPPortHistory(const std::string& _dir);
+    // writes what is not written yet
+    ~IPPortHistory();
+
+    void Get(const std::string& _netinfo, std::vector<Item>& _items) const;
+    void Update(const std::string& _netinfo, const std::string& _ip, uint16_t _port, bool _is_success);
+
+    // wakes the flush thread without waiting for the write delay
+    void Flush();
+    void FlushSync();
+
+  private:
+    struct Record {
+        time_t time;        // of the first result on the network, records expire a day later
+        std::vector<Item> items;
+        Record(): time(0) {}
+    };
+
+    bool __Load();
+    bool __ImportXml();
+    bool __RemoveTimeout();
+    void __MarkDirty(ScopedLock& _lock);
+    void __Serialize(AutoBuffer& _data);
+    void __Write(AutoBuffer& _data, uint64_t _seq);
+    void __RunFlush();
+
+  private:
+    IPPortHistory(const IPPortHistory&);
+    IPPortHistory& operator=(const IPPortHistory&);
+
+  private:
+    const std::string path_;
+    const std::string xml_path_;
+
+    mutable Mutex mutex_;
+    Condition cond_;
+    std::map<std::string, Record> records_;
+    bool dirty_;
+    bool flush_now_;
+    bool stop_;
+    uint64_t seq_;
+
+    Mutex write_mutex_;
+    uint64_t written_seq_;
+    bool xml_imported_;
+
+    Thread thread_;
+};
+
+}}
+
+#endif // STN_SRC_IPPORT_HISTORY_H_
@@ -0,0 +1,129 @@
+#include "ipport_history.h"
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+
+#include "mars/comm/tinyxml2.h"
+
+using namespace testing;
+using namespace mars::stn;
+
+static const char* const kXmlName = "/ipportrecords2.xml";
+static const char* const kBinName = "/ipportrecords3.bin";
+
+static std::string __Dir(const char* _name) {
+    std::string dir = boost::filesystem::temp_directory_path().string() + "/" + _name;
+    boost::filesystem::remove_all(dir);
+    boost::filesystem::create_directories(dir);
+    return dir;
+}
+
+static std::string __IP(int _net, int _i) {
+    char ip[32];
+    snprintf(ip, sizeof(ip), "10.%d.%d.%d", _net, _i / 256, _i % 256);
+    return ip;
+}
+
+// the file of the old SimpleIPPortSort
+static void __BuildXml(tinyxml2::XMLDocument& _doc, int _nets, int _ips, time_t _time) {
+    char timebuf[32];
+    snprintf(timebuf, sizeof(timebuf), "%ld", (long)_time);
+    for (int n = 0; n < _nets; ++n) {
+        tinyxml2::XMLElement* record = _doc.NewElement("record");
+        record->SetAttribute("netinfo", ("wifi_" + std::to_string(n)).c_str());
+        record->SetAttribute("time", timebuf);
+        _doc.InsertEndChild(record);
+        for (int i = 0; i < _ips; ++i) {
+            tinyxml2::XMLElement* item = _doc.NewElement("item");
+            item->SetAttribute("ip", __IP(n, i).c_str());
+            item->SetAttribute("port", 443 + i % 2);
+            item->SetAttribute("historyresult", (int64_t)(0x5a5a5a5a5a5aLL + i));
+            record->InsertEndChild(item);
+        }
+    }
+}
+
+TEST(ipport_history, update_and_reload) {
+    std::string dir = __Dir("ipport_history_unittest");
+    {
+        IPPortHistory history(dir);
+        history.Update("wifi", "10.0.0.1", 443, true);
+        history.Update("wifi", "10.0.0.1", 443, false);
+        history.Update("wifi", "10.0.0.2", 80, false);
+        history.Update("4g", "10.0.0.1", 443, true);
+
+        // written behind, not by the update
+        EXPECT_FALSE(boost::filesystem::exists(dir + kBinName));
+    }
+    ASSERT_TRUE(boost::filesystem::exists(dir + kBinName));
+
+    IPPortHistory history(dir);
+    std::vector<IPPortHistory::Item> items;
+    history.Get("wifi", items);
+    ASSERT_EQ(2u, items.size());
+    EXPECT_EQ("10.0.0.1", items[0].ip);
+    EXPECT_EQ(443, items[0].port);
+    EXPECT_EQ(1u, items[0].results);
+    EXPECT_EQ("10.0.0.2", items[1].ip);
+    EXPECT_EQ(80, items[1].port);
+    EXPECT_EQ(1u, items[1].results);
+
+    history.Get("4g", items);
+    ASSERT_EQ(1u, items.size());
+    EXPECT_EQ(0u, items[0].results);
+
+    history.Get("none", items);
+    EXPECT_TRUE(items.empty());
+    boost::filesystem::remove_all(dir);
+}
+
+TEST(ipport_history, imports_xml) {
+    std::string dir = __Dir("ipport_history_unittest");
+    tinyxml2::XMLDocument doc;
+    __BuildXml(doc, 2, 3, time(NULL));
+    // expired a day after its first result
+    doc.FirstChildElement("record")->NextSiblingElement("record")->SetAttribute("time", "1");
+    ASSERT_EQ(tinyxml2::XML_SUCCESS, doc.SaveFile((dir + kXmlName).c_str()));
+
+    {
+        IPPortHistory history(dir);
+        std::vector<IPPortHistory::Item> items;
+        history.Get("wifi_0", items);
+        ASSERT_EQ(3u, items.size());
+        EXPECT_EQ(__IP(0, 2), items[2].ip);
+        EXPECT_EQ(443, items[2].port);
+        EXPECT_EQ(0x5a5a5a5a5a5aULL + 2, items[2].results);
+        history.Get("wifi_1", items);
+        EXPECT_TRUE(items.empty());
+    }
+    EXPECT_FALSE(boost::filesystem::exists(dir + kXmlName));
+
+    IPPortHistory history(dir);
+    std::vector<IPPortHistory::Item> items;
+    history.Get("wifi_0", items);
+    EXPECT_EQ(3u, items.size());
+    boost::filesystem::remove_all(dir);
+}
+
+TEST(ipport_history, bad_file) {
+    std::string dir = __Dir("ipport_history_unittest");
+    {
+        IPPortHistory history(dir);
+        history.Update("wifi", "10.0.0.1", 443, true);
+    }
+    boost::filesystem::resize_file(dir + kBinName, boost::filesystem::file_size(dir + kBinName) - 3);
+
+    IPPortHistory history(dir);
+    std::vector<IPPortHistory::Item> items;
+    history.Get("wifi", items);
+    EXPECT_TRUE(items.empty());
+    boost::filesystem::remove_all(dir);
+}
+
+EXPORT_GTEST_SYMBOLS(stn_export_ipport_history_unittest)
@@ -45,6 +45,7 @@
 #include "mars/stn/config.h"
 
 #include "smart_heartbeat.h"
+#include "longlink_reactor.h"
 
 #define AYNC_HANDLER  asyncreg_.Get()
 #define STATIC_RETURN_SYNC2ASYNC_FUNC(func) RETURN_SYNC2ASYNC_FUNC(func, )
@@ -57,6 +58,11 @@ static const int kAlarmNoopInternalType = 103;
 static const int kAlarmNoopTimeOutType = 104;
 #endif
 
+static const size_t kDirectRecvBodyMinSize = 16 * 1024;   // smaller bodies stay in bufrecv, saving a recv per package
+static const size_t kMaxSendIovec = 64;
+static const size_t kMaxFreeSendData = 32;
+static const size_t kMaxFreeSendDataCapacity = 16 * 1024;
+
 namespace {
 class LongLinkConnectObserver : public MComplexConnect {
   public:
@@ -134,6 +140,33 @@ class LongLinkConnectObserver : public MComplexConnect {
 
 }
 
+LongLink::ReadWriteContext::ReadWriteContext(LongLink& _longlink, SOCKET _sock, const ConnectProfile& _profile)
+: sock(_sock)
+, profile(_profile)
+, alarmnoopinterval(boost::bind(&LongLink::__OnAlarm, &_longlink, false), false)
+, alarmnooptimeout(boost::bind(&LongLink::__OnAlarm, &_longlink, true), false)
+, body_remain(0)
+, body_cmdid(0)
+, body_taskid(Task::kInvalidTaskID)
+, body_packlen(0)
+, first_noop_sent(false)
+, nooping(false)
+, errtype(kEctOK)
+, errcode(0)
+, select_ret(0)
+, select_errno(0)
+, breaker_exception(false)
+, sock_exception(false)
+, writable(false)
+, readable(false)
+, close_log(kLevelAll, XLOGGER_TAG, __XFILE__, __XFUNCTION__, __LINE__, XLOGGER_HOOK) {
+#ifdef __ANDROID__
+    alarmnoopinterval.SetType(kAlarmNoopInternalType);
+    alarmnooptimeout.SetType(kAlarmNoopTimeOutType);
+#endif
+    bufrecv.SetAllocator(&SizeClassBufferPool::Instance());
+}
+
 LongLink::LongLink(const mq::MessageQueue_t& _messagequeueid, NetSource& _netsource, const LonglinkConfig& _config, LongLinkEncoder& _encoder)
     : asyncreg_(MessageQueue::InstallAsyncHandler(_messagequeueid))
     , netsource_(_netsource)
@@ -150,6 +183,9 @@ LongLink::LongLink(const mq::MessageQueue_t& _messagequeueid, NetSource& _netsou
     , wakelock_(NULL)
 #endif
     , encoder_(_encoder)
+    , reactor_running_(false)
+    , reactor_recreate_breaker_(false)
+    , reactor_reconnect_(false)
 {
     xinfo2(TSF"handler:(%_,%_)", asyncreg_.Get().queue, asyncreg_.Get().seq);
 }
@@ -174,9 +210,20 @@ bool LongLink::Send(const AutoBuffer& _body, const AutoBuffer& _extension, const
 
     xassert2(tracker_.get());
     
-    lstsenddata_.push_back(std::make_pair(_task, move_wrapper<AutoBuffer>(AutoBuffer())));
-    Encoder().longlink_pack(_task.cmdid, _task.taskid, _body, _extension, lstsenddata_.back().second, tracker_.get());
-    lstsenddata_.back().second->Seek(0, AutoBuffer::ESeekStart);
+    __PushSendData(_body, NULL, _extension, _task);
+
+    readwritebreak_.Break();
+    return true;
+}
+
+bool LongLink::SendMove(AutoBuffer& _body, const AutoBuffer& _extension, const Task& _task) {
+    ScopedLock lock(mutex_);
+
+    if (kConnected != connectstatus_) return false;
+
+    xassert2(tracker_.get());
+    
+    __PushSendData(_body, &_body, _extension, _task);
 
     readwritebreak_.Break();
     return true;
@@ -194,14 +241,42 @@ bool LongLink::SendWhenNoData(const AutoBuffer& _body, const AutoBuffer& _extens
     task.send_only = true;
     task.cmdid = _cmdid;
     task.taskid = _taskid;
-    lstsenddata_.push_back(std::make_pair(task, move_wrapper<AutoBuffer>(AutoBuffer())));
-    Encoder().longlink_pack(_cmdid, _taskid, _body, _extension, lstsenddata_.back().second, tracker_.get());
-    lstsenddata_.back().second->Seek(0, AutoBuffer::ESeekStart);
+    __PushSendData(_body, NULL, _extension, task);
     
     readwritebreak_.Break();
     return true;
 }
 
+void LongLink::__PushSendData(const AutoBuffer& _body, AutoBuffer* _move_body, const AutoBuffer& _extension, const Task& _task) {
+    // reuse a sent node together with the capacity of its buffers
+    if (lstsenddata_free_.empty()) {
+        lstsenddata_.emplace_back(_task);
+    } else {
+        lstsenddata_.splice(lstsenddata_.end(), lstsenddata_free_, lstsenddata_free_.begin());
+        lstsenddata_.back().task = _task;
+        lstsenddata_.back().pos = 0;
+    }
+    
+    LongLinkSendData& data = lstsenddata_.back();
+    data.packed.Length(0, 0);
+    data.body.Length(0, 0);
+    
+    // header as its own buffer, so the body goes out as a separate iovec
+    if (Encoder().longlink_pack_header && Encoder().longlink_pack_header(_task.cmdid, _task.taskid, _body, _extension, data.packed, tracker_.get())) {
+        if (NULL != _move_body) {
+            data.body.Attach(*_move_body);
+        } else {
+            data.body.Write(_body);
+        }
+    } else {
+        data.packed.Length(0, 0);
+        Encoder().longlink_pack(_task.cmdid, _task.taskid, _body, _extension, data.packed, tracker_.get());
+    }
+    
+    data.packed.Seek(0, AutoBuffer::ESeekStart);
+    data.body.Seek(0, AutoBuffer::ESeekStart);
+}
+
 bool LongLink::__SendNoopWhenNoData() {
     AutoBuffer body;
     AutoBuffer extension;
@@ -213,7 +288,7 @@ bool LongLink::Stop(uint32_t _taskid) {
     ScopedLock lock(mutex_);
 
     for (auto it = lstsenddata_.begin(); it != lstsenddata_.end(); ++it) {
-        if (_taskid == it->first.taskid && 0 == it->second->Pos()) {
+        if (_taskid == it->task.taskid && 0 == it->pos) {
             lstsenddata_.erase(it);
             return true;
         }
@@ -229,6 +304,11 @@ bool LongLink::MakeSureConnected(bool* _newone) {
 
     ScopedLock lock(mutex_);
 
+    if (reactor_running_ && (kConnected != ConnectStatus() || kNone != disconnectinternalcode_)) {
+        // the connection is on its way out, connect again once the reactor let it go
+        reactor_reconnect_ = true;
+        return false;
+    }
     if (kConnected == ConnectStatus()) return true;
 
     bool newone = false;
@@ -254,9 +334,10 @@ void LongLink::Disconnect(TDisconnectInternalCode _scene) {
     
     ScopedLock lock(mutex_);
 
-    if (!thread_.isruning()) return;
+    if (!thread_.isruning() && !reactor_running_) return;
 
     disconnectinternalcode_ = _scene;
+    reactor_reconnect_ = false;
 
     bool recreate = false;
 
@@ -271,6 +352,23 @@ void LongLink::Disconnect(TDisconnectInternalCode _scene) {
     dns_util_.Cancel();
     thread_.join();
 
+#ifndef _WIN32
+    // a link running on the reactor ends there, unless this is called from one of its callbacks
+    if (!LongLinkReactor::Instance().InReactorThread()) {
+        lock.lock();
+        while (reactor_running_) reactor_end_cond_.wait(lock);
+        lock.unlock();
+    } else if (recreate) {
+        // readwritebreak_ is still registered in the poll of the reactor, __RunReactorEnd recreates them
+        lock.lock();
+        if (reactor_running_) {
+            reactor_recreate_breaker_ = true;
+            recreate = false;
+        }
+        lock.unlock();
+    }
+#endif
+
     if (recreate) {
         connectbreak_.ReCreate();
         readwritebreak_.ReCreate();
@@ -414,29 +512,44 @@ void LongLink::__Run() {
         return;
     }
     
+#ifndef _WIN32
+    if (config_.shared_reactor) {
+        // hand the connected socket over, this thread ends here
+        {
+            ScopedLock lock(mutex_);
+            reactor_running_ = true;
+        }
+        LongLinkReactor::Instance().Add(this, new ReadWriteContext(*this, sock, conn_profile));
+        return;
+    }
+#endif
+    
     ErrCmdType errtype = kEctOK;
     int errcode = 0;
     __RunReadWrite(sock, errtype, errcode, conn_profile);
+    __RunDisconnected(sock, errtype, errcode, conn_profile);
     
-    socket_close(sock);
+    ScopedLock lock(mutex_);
+    tracker_.reset();
+}
+
+void LongLink::__RunDisconnected(SOCKET _sock, ErrCmdType _errtype, int _errcode, ConnectProfile& _conn_profile) {
+    socket_close(_sock);
     
-    conn_profile.disconn_time = ::gettickcount();
-    conn_profile.disconn_errtype = errtype;
-    conn_profile.disconn_errcode = errcode;
-    conn_profile.disconn_signal = ::getSignal(::getNetInfo() == kWifi);
+    _conn_profile.disconn_time = ::gettickcount();
+    _conn_profile.disconn_errtype = _errtype;
+    _conn_profile.disconn_errcode = _errcode;
+    _conn_profile.disconn_signal = ::getSignal(::getNetInfo() == kWifi);
     
     __ConnectStatus(kDisConnected);
-    xinfo2(TSF"longlink lifetime:%_", (gettickcount() - conn_profile.conn_time));
-    __UpdateProfile(conn_profile);
+    xinfo2(TSF"longlink lifetime:%_", (gettickcount() - _conn_profile.conn_time));
+    __UpdateProfile(_conn_profile);
 
-    if (kEctOK != errtype) __RunResponseError(errtype, errcode, conn_profile);
+    if (kEctOK != _errtype) __RunResponseError(_errtype, _errcode, _conn_profile);
     
 #ifdef ANDROID
     wakelock_->Lock(1000);
 #endif
-    
-    ScopedLock lock(mutex_);
-    tracker_.reset();
 }
 
 SOCKET LongLink::__RunConnect(ConnectProfile& _conn_profile) {
@@ -570,264 +683,378 @@ SOCKET LongLink::__RunConnect(ConnectProfile& _conn_profile) {
 
 void LongLink::__RunReadWrite(SOCKET _sock, ErrCmdType& _errtype, int& _errcode, ConnectProfile& _profile) {
     
-    Alarm alarmnoopinterval(boost::bind(&LongLink::__OnAlarm, this, false), false);
-    Alarm alarmnooptimeout(boost::bind(&LongLink::__OnAlarm, this, true), false);
+    ReadWriteContext context(*this, _sock, _profile);
     
-#ifdef __ANDROID__
-    alarmnoopinterval.SetType(kAlarmNoopInternalType);
-    alarmnooptimeout.SetType(kAlarmNoopTimeOutType);
-#endif
+    // registrations stay in place across loops, only the write interest follows lstsenddata_
+    SocketSelect sel(readwritebreak_, true);
+    sel.PreSelect();
+    sel.Read_FD_SET(_sock);
+    sel.Exception_FD_SET(_sock);
     
-    std::map <uint32_t, StreamResp> sent_taskids;
-    std::vector<LongLinkNWriteData> nsent_datas;
-    
-    AutoBuffer bufrecv;
-    bool first_noop_sent = false;
-    bool nooping = false;
-    xgroup2_define(close_log);
-    
-    while (true) {
-        if (!alarmnoopinterval.IsWaiting()) {
-            if (first_noop_sent && alarmnoopinterval.Status() != Alarm::kOnAlarm) {
-                xassert2(false, "noop interval alarm not running");
-            }
-          
-            if(first_noop_sent && alarmnoopinterval.Status() == Alarm::kOnAlarm) {
-              __NotifySmartHeartbeatJudgeDozeStyle();
-            }
-            xgroup2_define(noop_xlog);
-            uint64_t last_noop_interval = alarmnoopinterval.After();
-            uint64_t last_noop_actual_interval = (alarmnoopinterval.Status() == Alarm::kOnAlarm) ? alarmnoopinterval.ElapseTime() : 0;
-            bool has_late_toomuch = (last_noop_actual_interval >= (15*60*1000));
-            
-            if (__NoopReq(noop_xlog, alarmnooptimeout, has_late_toomuch)) {
-                nooping = true;
-                __NotifySmartHeartbeatHeartReq(_profile, last_noop_interval, last_noop_actual_interval);
-            }
-            
-            first_noop_sent = true;
-
-            lastheartbeat_ = __GetNextHeartbeatInterval();
-            xinfo2(TSF" last:(%_,%_), next:%_", last_noop_interval, last_noop_actual_interval, lastheartbeat_) >> noop_xlog;
-            alarmnoopinterval.Cancel();
-            alarmnoopinterval.Start((int)lastheartbeat_);
-        }
-        
-        if (nooping && (alarmnooptimeout.Status() == Alarm::kInit || alarmnooptimeout.Status() == Alarm::kCancel)) {
-            xassert2(false, "noop but alarmnooptimeout not running, take as noop timeout");
-            _errtype = kEctSocket;
-            _errcode = kEctSocketRecvErr;
-            goto End;
-        }
+    while (__RunReadWriteBefore(context)) {
+        ScopedLock lock(mutex_);
         
-        SocketSelect sel(readwritebreak_, true);
+#ifdef _WIN32
         sel.PreSelect();
         sel.Read_FD_SET(_sock);
         sel.Exception_FD_SET(_sock);
-        
-        ScopedLock lock(mutex_);
-        
         if (!lstsenddata_.empty()) sel.Write_FD_SET(_sock);
+#else
+        sel.Poll().WriteEvent(_sock, !lstsenddata_.empty());
+#endif
         
         lock.unlock();
         
-        int retsel = sel.Select(10 * 60 * 1000);
-        
-        if (kNone != disconnectinternalcode_) {
-            xwarn2(TSF"task socket close sock:%0, user disconnect:%1, nread:%_, nwrite:%_", _sock, disconnectinternalcode_, socket_nread(_sock), socket_nwrite(_sock)) >> close_log;
-            _errtype = kEctCanceld;
-            _errcode = kEctSocketUserBreak;
-            goto End;
-        }
+        context.select_ret = sel.Select(10 * 60 * 1000);
+        context.select_errno = sel.Errno();
+        context.breaker_exception = sel.IsException();
+        context.sock_exception = 0 != sel.Exception_FD_ISSET(_sock);
+        context.writable = 0 != sel.Write_FD_ISSET(_sock);
+        context.readable = 0 != sel.Read_FD_ISSET(_sock);
         
-        if (0 > retsel) {
-            xfatal2(TSF"task socket close sock:%0, 0 > retsel, errno:%_, nread:%_, nwrite:%_", _sock, sel.Errno(), socket_nread(_sock), socket_nwrite(_sock)) >> close_log;
-            _errtype = kEctSocket;
-            _errcode = sel.Errno();
-            goto End;
+        if (!__RunReadWriteAfter(context)) break;
+    }
+    
+    __RunReadWriteEnd(context);
+    
+    _errtype = context.errtype;
+    _errcode = context.errcode;
+    _profile = context.profile;
+}
+
+bool LongLink::__RunReadWriteBefore(ReadWriteContext& _context) {
+    Alarm& alarmnoopinterval = _context.alarmnoopinterval;
+    
+    if (!alarmnoopinterval.IsWaiting()) {
+        if (_context.first_noop_sent && alarmnoopinterval.Status() != Alarm::kOnAlarm) {
+            xassert2(false, "noop interval alarm not running");
         }
-        
-        if (sel.IsException()) {
-            xerror2(TSF"task socket close sock:%0, socketselect excptoin:%1(%2), nread:%_, nwrite:%_", _sock, socket_errno, socket_strerror(socket_errno), socket_nread(_sock), socket_nwrite(_sock)) >> close_log;
-            _errtype = kEctSocket;
-            _errcode = socket_errno;
-            goto End;
+      
+        if(_context.first_noop_sent && alarmnoopinterval.Status() == Alarm::kOnAlarm) {
+          __NotifySmartHeartbeatJudgeDozeStyle();
         }
+        xgroup2_define(noop_xlog);
+        uint64_t last_noop_interval = alarmnoopinterval.After();
+        uint64_t last_noop_actual_interval = (alarmnoopinterval.Status() == Alarm::kOnAlarm) ? alarmnoopinterval.ElapseTime() : 0;
+        bool has_late_toomuch = (last_noop_actual_interval >= (15*60*1000));
         
-        if (sel.Exception_FD_ISSET(_sock)) {
-            int error = socket_error(_sock);
-            xerror2(TSF"task socket close sock:%0, excptoin:%1(%2), nread:%_, nwrite:%_", _sock, error, socket_strerror(error), socket_nread(_sock), socket_nwrite(_sock)) >> close_log;
-            _errtype = kEctSocket;
-            _errcode = error;
-            goto End;
+        if (__NoopReq(noop_xlog, _context.alarmnooptimeout, has_late_toomuch)) {
+            _context.nooping = true;
+            __NotifySmartHeartbeatHeartReq(_context.profile, last_noop_interval, last_noop_actual_interval);
         }
         
-        if (nooping && alarmnooptimeout.Status() == Alarm::kOnAlarm) {
-            xerror2(TSF"task socket close sock:%0, noop timeout, nread:%_, nwrite:%_", _sock, socket_nread(_sock), socket_nwrite(_sock)) >> close_log;
+        _context.first_noop_sent = true;
+
+        lastheartbeat_ = __GetNextHeartbeatInterval();
+        xinfo2(TSF" last:(%_,%_), next:%_", last_noop_interval, last_noop_actual_interval, lastheartbeat_) >> noop_xlog;
+        alarmnoopinterval.Cancel();
+        alarmnoopinterval.Start((int)lastheartbeat_);
+    }
+    
+    if (_context.nooping && (_context.alarmnooptimeout.Status() == Alarm::kInit || _context.alarmnooptimeout.Status() == Alarm::kCancel)) {
+        xassert2(false, "noop but alarmnooptimeout not running, take as noop timeout");
+        _context.errtype = kEctSocket;
+        _context.errcode = kEctSocketRecvErr;
+        return false;
+    }
+    
+    return true;
+}
+
+bool LongLink::__RunReadWriteAfter(ReadWriteContext& _context) {
+    SOCKET _sock = _context.sock;
+    XLogger& close_log = _context.close_log;
+    
+    if (kNone != disconnectinternalcode_) {
+        xwarn2(TSF"task socket close sock:%0, user disconnect:%1, nread:%_, nwrite:%_", _sock, disconnectinternalcode_, socket_nread(_sock), socket_nwrite(_sock)) >> close_log;
+        _context.errtype = kEctCanceld;
+        _context.errcode = kEctSocketUserBreak;
+        return false;
+    }
+    
+    if (0 > _context.select_ret) {
+        xfatal2(TSF"task socket close sock:%0, 0 > retsel, errno:%_, nread:%_, nwrite:%_", _sock, _context.select_errno, socket_nread(_sock), socket_nwrite(_sock)) >> close_log;
+        _context.errtype = kEctSocket;
+        _context.errcode = _context.select_errno;
+        return false;
+    }
+    
+    if (_context.breaker_exception) {
+        xerror2(TSF"task socket close sock:%0, socketselect excptoin:%1(%2), nread:%_, nwrite:%_", _sock, socket_errno, socket_strerror(socket_errno), socket_nread(_sock), socket_nwrite(_sock)) >> close_log;
+        _context.errtype = kEctSocket;
+        _context.errcode = socket_errno;
+        return false;
+    }
+    
+    if (_context.sock_exception) {
+        int error = socket_error(_sock);
+        xerror2(TSF"task socket close sock:%0, excptoin:%1(%2), nread:%_, nwrite:%_", _sock, error, socket_strerror(error), socket_nread(_sock), socket_nwrite(_sock)) >> close_log;
+        _context.errtype = kEctSocket;
+        _context.errcode = error;
+        return false;
+    }
+    
+    if (_context.nooping && _context.alarmnooptimeout.Status() == Alarm::kOnAlarm) {
+        xerror2(TSF"task socket close sock:%0, noop timeout, nread:%_, nwrite:%_", _sock, socket_nread(_sock), socket_nwrite(_sock)) >> close_log;
 //            __NotifySmartHeartbeatJudgeDozeStyle();
-            _errtype = kEctSocket;
-            _errcode = kEctSocketRecvErr;
-            goto End;
-        }
-        
-        lock.lock();
-        if (socket_nwrite(_sock) == 0 && !nsent_datas.empty()) {
-            nsent_datas.clear();
-        }
+        _context.errtype = kEctSocket;
+        _context.errcode = kEctSocketRecvErr;
+        return false;
+    }
+    
+    ScopedLock lock(mutex_);
+    if (socket_nwrite(_sock) == 0 && !_context.nsent_datas.empty()) {
+        _context.nsent_datas.clear();
+    }
+    
+    if (_context.writable && !lstsenddata_.empty()) {
+        xgroup2_define(xlog_group);
+        xinfo2(TSF"task socket send sock:%0, ", _sock) >> xlog_group;
         
-        if (sel.Write_FD_ISSET(_sock) && !lstsenddata_.empty()) {
-            xgroup2_define(xlog_group);
-            xinfo2(TSF"task socket send sock:%0, ", _sock) >> xlog_group;
-            
 #ifndef WIN32
-            iovec* vecwrite = (iovec*)calloc(lstsenddata_.size(), sizeof(iovec));
-            unsigned int offset = 0;
+        // header and body of every queued package as separate iovecs, the vector is kept across rounds
+        std::vector<iovec>& vecwrite = _context.vecwrite;
+        vecwrite.clear();
+        
+        for (auto it = lstsenddata_.begin(); it != lstsenddata_.end() && vecwrite.size() + 2 <= kMaxSendIovec; ++it) {
+            size_t pos = it->pos;
             
-            for (auto it = lstsenddata_.begin(); it != lstsenddata_.end(); ++it) {
-                vecwrite[offset].iov_base = it->second->PosPtr();
-                vecwrite[offset].iov_len = it->second->PosLength();
-                
-                ++offset;
+            if (pos < it->packed.Length()) {
+                iovec vec = {it->packed.Ptr(pos), it->packed.Length() - pos};
+                vecwrite.push_back(vec);
+                pos = 0;
+            } else {
+                pos -= it->packed.Length();
             }
             
-            ssize_t writelen = writev(_sock, vecwrite, (int)lstsenddata_.size());
-            
-            free(vecwrite);
+            if (pos < it->body.Length()) {
+                iovec vec = {it->body.Ptr(pos), it->body.Length() - pos};
+                vecwrite.push_back(vec);
+            }
+        }
+        
+        ssize_t writelen = writev(_sock, &vecwrite[0], (int)vecwrite.size());
 #else
-
-            //ssize_t writelen = ::send(_sock, lstsenddata_.begin()->data.PosPtr(), lstsenddata_.begin()->data.PosLength(), 0);
-			ssize_t writelen = ::send(_sock, lstsenddata_.begin()->second->PosPtr(), lstsenddata_.begin()->second->PosLength(), 0);
+        LongLinkSendData& front = lstsenddata_.front();
+        ssize_t writelen = 0;
+        if (front.pos < front.packed.Length()) {
+            writelen = ::send(_sock, (const char*)front.packed.Ptr(front.pos), (int)(front.packed.Length() - front.pos), 0);
+        } else {
+            size_t pos = front.pos - front.packed.Length();
+            writelen = ::send(_sock, (const char*)front.body.Ptr(pos), (int)(front.body.Length() - pos), 0);
+        }
 #endif
+        
+        if (0 == writelen || (0 > writelen && !IS_NOBLOCK_SEND_ERRNO(socket_errno))) {
+            int error = socket_error(_sock);
             
-            if (0 == writelen || (0 > writelen && !IS_NOBLOCK_SEND_ERRNO(socket_errno))) {
-                int error = socket_error(_sock);
-                
-                _errtype = kEctSocket;
-                _errcode = error;
-                xerror2(TSF"sock:%0, send:%1(%2)", _sock, error, socket_strerror(error)) >> xlog_group;
-                goto End;
-            }
-            
-            if (0 > writelen) writelen = 0;
+            _context.errtype = kEctSocket;
+            _context.errcode = error;
+            xerror2(TSF"sock:%0, send:%1(%2)", _sock, error, socket_strerror(error)) >> xlog_group;
+            return false;
+        }
+        
+        if (0 > writelen) writelen = 0;
 
-            unsigned long long noop_interval = __GetNextHeartbeatInterval();
-            alarmnoopinterval.Cancel();
-            alarmnoopinterval.Start((int)noop_interval);
-            
-            xinfo2(TSF"all send:%_, count:%_, ", writelen, lstsenddata_.size()) >> xlog_group;
-            
-            GetSignalOnNetworkDataChange()(XLOGGER_TAG, writelen, 0);
-            
-            auto it = lstsenddata_.begin();
+        unsigned long long noop_interval = __GetNextHeartbeatInterval();
+        _context.alarmnoopinterval.Cancel();
+        _context.alarmnoopinterval.Start((int)noop_interval);
+        
+        xinfo2(TSF"all send:%_, count:%_, ", writelen, lstsenddata_.size()) >> xlog_group;
+        
+        GetSignalOnNetworkDataChange()(XLOGGER_TAG, writelen, 0);
+        
+        auto it = lstsenddata_.begin();
+        
+        while (it != lstsenddata_.end() && 0 < writelen) {
+            if (0 == it->pos && OnSend) OnSend(it->task.taskid);
             
-            while (it != lstsenddata_.end() && 0 < writelen) {
-                if (0 == it->second->Pos() && OnSend) OnSend(it->first.taskid);
+            size_t remain = it->Length() - it->pos;
+            if ((size_t)writelen >= remain) {
+                xinfo2(TSF"sub send taskid:%_, cmdid:%_, %_, len(S:%_, %_/%_), ", it->task.taskid, it->task.cmdid, it->task.cgi, remain, remain, it->Length()) >> xlog_group;
+                writelen -= remain;
+                if (!it->task.send_only) { _context.sent_taskids[it->task.taskid].task = it->task; }
+                
+                LongLinkNWriteData nwrite(it->Length(), it->task);
+                _context.nsent_datas.push_back(nwrite);
                 
-                if ((size_t)writelen >= it->second->PosLength()) {
-                    xinfo2(TSF"sub send taskid:%_, cmdid:%_, %_, len(S:%_, %_/%_), ", it->first.taskid, it->first.cmdid, it->first.cgi, it->second->PosLength(), it->second->PosLength(), it->second->Length()) >> xlog_group;
-                    writelen -= it->second->PosLength();
-                    if (!it->first.send_only) { sent_taskids[it->first.taskid].task = it->first; }
-                    
-                    LongLinkNWriteData nwrite(it->second->Length(), it->first);
-                    nsent_datas.push_back(nwrite);
-                    
-                    it = lstsenddata_.erase(it);
+                auto sent = it++;
+                if (lstsenddata_free_.size() < kMaxFreeSendData && sent->packed.Capacity() + sent->body.Capacity() <= kMaxFreeSendDataCapacity) {
+                    lstsenddata_free_.splice(lstsenddata_free_.end(), lstsenddata_, sent);
                 } else {
-                    xinfo2(TSF"sub send taskid:%_, cmdid:%_, %_, len(S:%_, %_/%_), ", it->first.taskid, it->first.cmdid, it->first.cgi, writelen, it->second->PosLength(), it->second->Length()) >> xlog_group;
-                    it->second->Seek(writelen, AutoBuffer::ESeekCur);
-                    writelen = 0;
+                    lstsenddata_.erase(sent);
                 }
+            } else {
+                xinfo2(TSF"sub send taskid:%_, cmdid:%_, %_, len(S:%_, %_/%_), ", it->task.taskid, it->task.cmdid, it->task.cgi, writelen, remain, it->Length()) >> xlog_group;
+                it->pos += writelen;
+                writelen = 0;
             }
         }
+    }
+    
+    lock.unlock();
+    
+    if (_context.readable) {
+        AutoBuffer& bufrecv = _context.bufrecv;
+        AutoBuffer& bufbody = _context.bufbody;
         
-        lock.unlock();
+        // a large body whose header already arrived is received straight into its own buffer
+        bool recv_body = 0 < _context.body_remain;
+        size_t recvsize = recv_body ? _context.body_remain : 64 * 1024;
+        if (!recv_body) bufrecv.AllocWrite(recvsize, false);
+        ssize_t recvlen = recv(_sock, recv_body ? bufbody.PosPtr() : bufrecv.PosPtr(), recvsize, 0);
         
-        if (sel.Read_FD_ISSET(_sock)) {
-            bufrecv.AllocWrite(64 * 1024, false);
-            ssize_t recvlen = recv(_sock, bufrecv.PosPtr(), 64 * 1024, 0);
-            
-            if (0 == recvlen) {
-                _errtype = kEctSocket;
-                _errcode = kEctSocketShutdown;
-                xwarn2(TSF"task socket close sock:%0, remote disconnect", _sock) >> close_log;
-                goto End;
-            }
+        if (0 == recvlen) {
+            _context.errtype = kEctSocket;
+            _context.errcode = kEctSocketShutdown;
+            xwarn2(TSF"task socket close sock:%0, remote disconnect", _sock) >> close_log;
+            return false;
+        }
+        
+        if (0 > recvlen && !IS_NOBLOCK_READ_ERRNO(socket_errno)) {
+            _context.errtype = kEctSocket;
+            _context.errcode = socket_errno;
+            xerror2(TSF"task socket close sock:%0, recv len: %1 errno:%2(%3)", _sock, recvlen, socket_errno, socket_strerror(socket_errno)) >> close_log;
+            return false;
+        }
+        
+        if (0 > recvlen) recvlen = 0;
+        
+        GetSignalOnNetworkDataChange()(XLOGGER_TAG, 0, recvlen);
+        
+        if (recv_body) {
+            bufbody.Length(bufbody.Pos() + recvlen, bufbody.Length() + recvlen);
+            _context.body_remain -= recvlen;
+            xinfo2(TSF"task socket recv sock:%_, recv len:%_, body remain:%_", _sock, recvlen, _context.body_remain);
             
-            if (0 > recvlen && !IS_NOBLOCK_READ_ERRNO(socket_errno)) {
-                _errtype = kEctSocket;
-                _errcode = socket_errno;
-                xerror2(TSF"task socket close sock:%0, recv len: %1 errno:%2(%3)", _sock, recvlen, socket_errno, socket_strerror(socket_errno)) >> close_log;
-                goto End;
+            if (0 < _context.body_remain) {
+                if (OnRecv)
+                    OnRecv(_context.body_taskid, _context.body_packlen - _context.body_remain, _context.body_packlen);
+                return true;
             }
             
-            if (0 > recvlen) recvlen = 0;
+            AutoBuffer extension;
+            bufbody.Seek(0, AutoBuffer::ESeekStart);
+            __OnRecvPackage(_context, LONGLINK_UNPACK_OK, _context.body_cmdid, _context.body_taskid, _context.body_packlen, bufbody, extension);
+            bufbody.Reset();
+            return true;
+        }
+        
+        bufrecv.Length(bufrecv.Pos() + recvlen, bufrecv.Length() + recvlen);
+        xinfo2(TSF"task socket recv sock:%_, recv len:%_, buff len:%_", _sock, recvlen, bufrecv.Length());
+        
+        // unpack from a moving offset and compact the unconsumed tail once afterwards
+        size_t offset = 0;
+        while (offset < bufrecv.Length()) {
+            uint32_t cmdid = 0;
+            uint32_t taskid = Task::kInvalidTaskID;
+            size_t packlen = 0;
+            AutoBuffer body;
+            AutoBuffer extension;
             
-            GetSignalOnNetworkDataChange()(XLOGGER_TAG, 0, recvlen);
+            AutoBuffer packed;
+            packed.Attach(bufrecv.Ptr(offset), bufrecv.Length() - offset);
+            int unpackret = Encoder().longlink_unpack(packed, cmdid, taskid, packlen, body, extension, tracker_.get());
             
-            bufrecv.Length(bufrecv.Pos() + recvlen, bufrecv.Length() + recvlen);
-            xinfo2(TSF"task socket recv sock:%_, recv len:%_, buff len:%_", _sock, recvlen, bufrecv.Length());
+            if (LONGLINK_UNPACK_FALSE == unpackret) {
+                xerror2(TSF"task socket recv sock:%0, unpack error dump:%1", _sock, xdump(packed.Ptr(), packed.Length()));
+                packed.Detach();
+                _context.errtype = kEctNetMsgXP;
+                _context.errcode = kEctNetMsgXPHandleBufferErr;
+                return false;
+            }
             
-            while (0 < bufrecv.Length()) {
-                uint32_t cmdid = 0;
-                uint32_t taskid = Task::kInvalidTaskID;
-                size_t packlen = 0;
-                AutoBuffer body;
-                AutoBuffer extension;
-                
-                int unpackret = Encoder().longlink_unpack(bufrecv, cmdid, taskid, packlen, body, extension, tracker_.get());
-                
-                if (LONGLINK_UNPACK_FALSE == unpackret) {
-                    xerror2(TSF"task socket recv sock:%0, unpack error dump:%1", _sock, xdump(bufrecv.Ptr(), bufrecv.Length()));
-                    _errtype = kEctNetMsgXP;
-                    _errcode = kEctNetMsgXPHandleBufferErr;
-                    goto End;
-                }
-                
-                StreamResp& stream_resp = sent_taskids[taskid];
-                xinfo2(TSF"task socket recv sock:%_, pack recv %_ taskid:%_, cmdid:%_, %_, packlen:(%_/%_)", _sock, LONGLINK_UNPACK_CONTINUE == unpackret ? "continue" : "finish", taskid, cmdid, stream_resp.task.cgi, LONGLINK_UNPACK_CONTINUE == unpackret ? bufrecv.Length() : packlen, packlen);
+            if (LONGLINK_UNPACK_CONTINUE == unpackret) {
+                xinfo2(TSF"task socket recv sock:%_, pack recv continue taskid:%_, cmdid:%_, %_, packlen:(%_/%_)", _sock, taskid, cmdid, _context.sent_taskids[taskid].task.cgi, packed.Length(), packlen);
                 lastrecvtime_.gettickcount();
+                if (OnRecv)
+                    OnRecv(taskid, packed.Length(), packlen);
                 
-                if (LONGLINK_UNPACK_CONTINUE == unpackret) {
-                    if (OnRecv)
-                        OnRecv(taskid, bufrecv.Length(), packlen);
-                    break;
-                }
-                
-                if (stream_resp.stream->Ptr()) {
-                    stream_resp.stream->Write(body);
-                } else {
-                    stream_resp.stream->Attach(body);
-                }
-                
-                if (stream_resp.extension->Ptr()) {
-                    stream_resp.extension->Write(extension);
-                } else {
-                    stream_resp.extension->Attach(extension);
-                }
-                
-                bufrecv.Move(-(int)(packlen));
-                xassert2(   unpackret == LONGLINK_UNPACK_STREAM_END
-                         || unpackret == LONGLINK_UNPACK_OK
-                         || unpackret == LONGLINK_UNPACK_STREAM_PACKAGE,
-                         TSF"unpackret: %_", unpackret);
-                
-                if (LONGLINK_UNPACK_STREAM_PACKAGE == unpackret) {
-                    if (OnRecv)
-                        OnRecv(taskid, packlen, packlen);
-                } else if (!__NoopResp(cmdid, taskid, stream_resp.stream, stream_resp.extension, alarmnooptimeout, nooping, _profile)) {
-                    if (OnResponse)
-                        OnResponse(config_.name, kEctOK, 0, cmdid, taskid, stream_resp.stream, stream_resp.extension, _profile);
-					sent_taskids.erase(taskid);
+                size_t body_offset = 0;
+                if (__StartRecvBody(_context, packed, packlen, body_offset)) {
+                    bufbody.Write(packed.Ptr(body_offset), packed.Length() - body_offset);
+                    offset = bufrecv.Length();
                 }
+                packed.Detach();
+                break;
             }
+            
+            packed.Detach();
+            offset += packlen;
+            __OnRecvPackage(_context, unpackret, cmdid, taskid, packlen, body, extension);
         }
+        
+        if (0 < offset) bufrecv.Move(-(off_t)offset);
     }
     
+    return true;
+}
+
+bool LongLink::__StartRecvBody(ReadWriteContext& _context, const AutoBuffer& _packed, size_t _packlen, size_t& _body_offset) {
+    if (!Encoder().longlink_unpack_view) return false;
+    
+    uint32_t cmdid = 0;
+    uint32_t taskid = Task::kInvalidTaskID;
+    size_t packlen = 0;
+    size_t body_len = 0;
+    int ret = Encoder().longlink_unpack_view(_packed, cmdid, taskid, packlen, _body_offset, body_len, tracker_.get());
     
-End:
-    if (nooping) {
+    // longlink_unpack must agree, it may have been replaced without the view
+    if (LONGLINK_UNPACK_CONTINUE != ret || 0 == packlen || packlen != _packlen) return false;
+    if (_body_offset + body_len != packlen || _body_offset > _packed.Length()) return false;
+    if (body_len < kDirectRecvBodyMinSize) return false;
+    
+    _context.bufbody.Reset();
+    _context.bufbody.AllocWrite(body_len, false);
+    _context.body_remain = packlen - _packed.Length();
+    _context.body_cmdid = cmdid;
+    _context.body_taskid = taskid;
+    _context.body_packlen = packlen;
+    xinfo2(TSF"recv body of taskid:%_ directly, body len:%_, remain:%_", taskid, body_len, _context.body_remain);
+    return true;
+}
+
+void LongLink::__OnRecvPackage(ReadWriteContext& _context, int _unpackret, uint32_t _cmdid, uint32_t _taskid, size_t _packlen, AutoBuffer& _body, AutoBuffer& _extension) {
+    StreamResp& stream_resp = _context.sent_taskids[_taskid];
+    xinfo2(TSF"task socket recv sock:%_, pack recv finish taskid:%_, cmdid:%_, %_, packlen:(%_/%_)", _context.sock, _taskid, _cmdid, stream_resp.task.cgi, _packlen, _packlen);
+    lastrecvtime_.gettickcount();
+    
+    if (stream_resp.stream->Ptr()) {
+        stream_resp.stream->Write(_body);
+    } else {
+        stream_resp.stream->Attach(_body);
+    }
+    
+    if (stream_resp.extension->Ptr()) {
+        stream_resp.extension->Write(_extension);
+    } else {
+        stream_resp.extension->Attach(_extension);
+    }
+    
+    xassert2(   _unpackret == LONGLINK_UNPACK_STREAM_END
+             || _unpackret == LONGLINK_UNPACK_OK
+             || _unpackret == LONGLINK_UNPACK_STREAM_PACKAGE,
+             TSF"unpackret: %_", _unpackret);
+    
+    if (LONGLINK_UNPACK_STREAM_PACKAGE == _unpackret) {
+        if (OnRecv)
+            OnRecv(_taskid, _packlen, _packlen);
+    } else if (!__NoopResp(_cmdid, _taskid, stream_resp.stream, stream_resp.extension, _context.alarmnooptimeout, _context.nooping, _context.profile)) {
+        if (OnResponse)
+            OnResponse(config_.name, kEctOK, 0, _cmdid, _taskid, stream_resp.stream, stream_resp.extension, _context.profile);
+        _context.sent_taskids.erase(_taskid);
+    }
+}
+
+void LongLink::__RunReadWriteEnd(ReadWriteContext& _context) {
+    SOCKET _sock = _context.sock;
+    XLogger& close_log = _context.close_log;
+    std::map <uint32_t, StreamResp>& sent_taskids = _context.sent_taskids;
+    std::vector<LongLinkNWriteData>& nsent_datas = _context.nsent_datas;
+    
+    if (_context.nooping) {
         xerror2(TSF"noop fail timeout, interval:%_", lastheartbeat_);
-        __NotifySmartHeartbeatHeartResult(false, (_errcode == kEctSocketRecvErr), _profile);
+        __NotifySmartHeartbeatHeartResult(false, (_context.errcode == kEctSocketRecvErr), _context.profile);
     }
         
     std::string netInfo;
@@ -851,7 +1078,7 @@ End:
     }
     nsent_datas.clear();
     
-    if (nread_size > 0 && _errtype != kEctNetMsgXP && _errcode != kEctNetMsgXPHandleBufferErr) {
+    if (nread_size > 0 && _context.errtype != kEctNetMsgXP && _context.errcode != kEctNetMsgXPHandleBufferErr) {
         xinfo2(TSF", info nread:%_ ", nread_size) >> close_log;
         AutoBuffer bufrecv;
         bufrecv.AllocWrite(64 * 1024, false);
@@ -889,6 +1116,34 @@ End:
 #endif
 }
 
+void LongLink::__RunReactorEnd(ReadWriteContext* _context) {
+    __RunReadWriteEnd(*_context);
+    
+    SOCKET sock = _context->sock;
+    ErrCmdType errtype = _context->errtype;
+    int errcode = _context->errcode;
+    ConnectProfile conn_profile = _context->profile;
+    delete _context;
+    
+    __RunDisconnected(sock, errtype, errcode, conn_profile);
+    
+    ScopedLock lock(mutex_);
+    tracker_.reset();
+    reactor_running_ = false;
+    if (reactor_recreate_breaker_) {
+        reactor_recreate_breaker_ = false;
+        connectbreak_.ReCreate();
+        readwritebreak_.ReCreate();
+    }
+    bool reconnect = reactor_reconnect_;
+    reactor_reconnect_ = false;
+    reactor_end_cond_.notifyAll(lock);
+    lock.unlock();
+
+    // on the queue of the link like its other callers, conn_profile_ belongs to it
+    if (reconnect) MessageQueue::AsyncInvoke(boost::bind(&LongLink::MakeSureConnected, this, (bool*)NULL), AYNC_HANDLER);
+}
+
 void LongLink::__NotifySmartHeartbeatHeartReq(ConnectProfile& _profile, uint64_t _internal, uint64_t _actual_internal) {
     if (Encoder().longlink_noop_interval() > 0) {
         return;
@@ -29,8 +29,12 @@
 
 #include "mars/comm/thread/mutex.h"
 #include "mars/comm/thread/thread.h"
+#include "mars/comm/thread/condition.h"
 #include "mars/comm/alarm.h"
 #include "mars/comm/tickcount.h"
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/buffer_pool.h"
+#include "mars/comm/xlogger/xlogger.h"
 #include "mars/comm/move_wrapper.h"
 #include "mars/comm/messagequeue/message_queue.h"
 #include "mars/comm/socket/socketselect.h"
@@ -65,6 +69,24 @@ struct LongLinkNWriteData {
     Task task;
 };
         
+struct LongLinkSendData {
+    explicit LongLinkSendData(const Task& _task)
+    : task(_task), pos(0) {
+        packed.SetAllocator(&SizeClassBufferPool::Instance());
+    }
+    
+    size_t Length() const { return packed.Length() + body.Length(); }
+    
+    Task task;
+    AutoBuffer packed;      // the whole package, or only its header when body is used
+    AutoBuffer body;        // sent as is right after packed
+    size_t pos;             // bytes already written
+    
+  private:
+    LongLinkSendData(const LongLinkSendData&);
+    LongLinkSendData& operator=(const LongLinkSendData&);
+};
+        
 struct StreamResp {
     StreamResp(const Task& _task = Task(Task::kInvalidTaskID))
     : task(_task), stream(KNullAtuoBuffer), extension(KNullAtuoBuffer) {}
@@ -124,6 +146,7 @@ class LongLink {
     virtual ~LongLink();
 
     bool    Send(const AutoBuffer& _body, const AutoBuffer& _extension, const Task& _task);
+    bool    SendMove(AutoBuffer& _body, const AutoBuffer& _extension, const Task& _task);  // may take over _body instead of copying it
     bool    SendWhenNoData(const AutoBuffer& _body, const AutoBuffer& _extension, uint32_t _cmdid, uint32_t _taskid);
     bool    Stop(uint32_t _taskid);
 
@@ -146,12 +169,16 @@ class LongLink {
     LongLink(const LongLink&);
     LongLink& operator=(const LongLink&);
 
+    friend class LongLinkReactor;
+    struct ReadWriteContext;
+
   protected:
     void    __ConnectStatus(TLongLinkStatus _status);
     void    __UpdateProfile(const ConnectProfile _conn_profile);
     void    __RunResponseError(ErrCmdType _type, int _errcode, ConnectProfile& _profile, bool _networkreport = true);
 
     bool    __SendNoopWhenNoData();
+    void    __PushSendData(const AutoBuffer& _body, AutoBuffer* _move_body, const AutoBuffer& _extension, const Task& _task);
     bool    __NoopReq(XLogger& _xlog, Alarm& _alarm, bool need_active_timeout);
     bool    __NoopResp(uint32_t _cmdid, uint32_t _taskid, AutoBuffer& _buf, AutoBuffer& _extension, Alarm& _alarm, bool& _nooping, ConnectProfile& _profile);
 
@@ -159,6 +186,16 @@ class LongLink {
     virtual void     __Run();
     virtual SOCKET   __RunConnect(ConnectProfile& _conn_profile);
     virtual void     __RunReadWrite(SOCKET _sock, ErrCmdType& _errtype, int& _errcode, ConnectProfile& _profile);
+    void             __RunDisconnected(SOCKET _sock, ErrCmdType _errtype, int _errcode, ConnectProfile& _conn_profile);
+
+    // one select round of __RunReadWrite split in steps, so that LongLinkReactor can drive them too.
+    // Before/After return false once the link has to be closed.
+    bool             __RunReadWriteBefore(ReadWriteContext& _context);
+    bool             __RunReadWriteAfter(ReadWriteContext& _context);
+    void             __RunReadWriteEnd(ReadWriteContext& _context);
+    void             __RunReactorEnd(ReadWriteContext* _context);
+    bool             __StartRecvBody(ReadWriteContext& _context, const AutoBuffer& _packed, size_t _packlen, size_t& _body_offset);
+    void             __OnRecvPackage(ReadWriteContext& _context, int _unpackret, uint32_t _cmdid, uint32_t _taskid, size_t _packlen, AutoBuffer& _body, AutoBuffer& _extension);
   protected:
     
     uint32_t   __GetNextHeartbeatInterval();
@@ -184,7 +221,8 @@ class LongLink {
     
     SocketBreaker                               readwritebreak_;
     LongLinkIdentifyChecker                     identifychecker_;
-    std::list<std::pair<Task, move_wrapper<AutoBuffer>>> lstsenddata_;
+    std::list<LongLinkSendData>                 lstsenddata_;
+    std::list<LongLinkSendData>                 lstsenddata_free_;  // sent nodes kept with their buffers for reuse
     tickcount_t                                 lastrecvtime_;
     
     SmartHeartbeat*                       smartheartbeat_;
@@ -193,6 +231,50 @@ class LongLink {
     LongLinkEncoder&                             encoder_;
     unsigned long long              lastheartbeat_;
     std::string longlink_disconnect_reason_text_;
+
+    bool                                         reactor_running_;
+    bool                                         reactor_recreate_breaker_;  // by __RunReactorEnd, the reactor polls the old ones until then
+    bool                                         reactor_reconnect_;         // MakeSureConnected while the reactor still ran the last connection
+    Condition                                    reactor_end_cond_;
+};
+
+// state of one connection in __RunReadWrite, shared with LongLinkReactor
+struct LongLink::ReadWriteContext {
+    ReadWriteContext(LongLink& _longlink, SOCKET _sock, const ConnectProfile& _profile);
+
+    SOCKET sock;
+    ConnectProfile profile;
+
+    Alarm alarmnoopinterval;
+    Alarm alarmnooptimeout;
+
+    std::map <uint32_t, StreamResp> sent_taskids;
+    std::vector<LongLinkNWriteData> nsent_datas;
+#ifndef WIN32
+    std::vector<iovec> vecwrite;
+#endif
+
+    AutoBuffer bufrecv;
+    AutoBuffer bufbody;         // body of the package being received by __StartRecvBody
+    size_t body_remain;
+    uint32_t body_cmdid;
+    uint32_t body_taskid;
+    size_t body_packlen;
+    bool first_noop_sent;
+    bool nooping;
+
+    ErrCmdType errtype;
+    int errcode;
+
+    // result of the last select round, filled by __RunReadWrite or LongLinkReactor
+    int  select_ret;
+    int  select_errno;
+    bool breaker_exception;
+    bool sock_exception;
+    bool writable;
+    bool readable;
+
+    XLogger close_log;
 };
         
 }}
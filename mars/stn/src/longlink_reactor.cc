@@ -0,0 +1,166 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+/*
+ * longlink_reactor.cc
+ *
+ *  Created on: 2026-10-18
+ */
+
+#include "longlink_reactor.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+
+#include "boost/bind.hpp"
+
+#include "mars/comm/thread/lock.h"
+#include "mars/comm/xlogger/xlogger.h"
+
+using namespace mars::stn;
+
+LongLinkReactor& LongLinkReactor::Instance() {
+    // never destroyed, links may still be handed over while statics are torn down
+    static LongLinkReactor* reactor = new LongLinkReactor();
+    return *reactor;
+}
+
+LongLinkReactor::LongLinkReactor()
+: poll_(breaker_, true)
+, thread_(boost::bind(&LongLinkReactor::__Run, this), XLOGGER_TAG "::longlink_reactor") {
+}
+
+LongLinkReactor::~LongLinkReactor() {
+}
+
+void LongLinkReactor::Add(LongLink* _longlink, LongLink::ReadWriteContext* _context) {
+    xassert2(NULL != _longlink && NULL != _context);
+
+    Link* link = new Link;
+    link->longlink = _longlink;
+    link->context = _context;
+    link->breaker_fd = INVALID_SOCKET;
+    link->triggered = false;
+
+    ScopedLock lock(mutex_);
+    pending_.push_back(link);
+    thread_.start();
+
+    if (!breaker_.Break()) {
+        xassert2(false, "breaker fail");
+    }
+}
+
+bool LongLinkReactor::InReactorThread() const {
+    return thread_.isruning() && thread_.tid() == ThreadUtil::currentthreadid();
+}
+
+void LongLinkReactor::__Run() {
+    while (true) {
+        __Adopt();
+
+        for (std::list<Link*>::iterator it = links_.begin(); it != links_.end(); ++it) {
+            LongLink::ReadWriteContext& context = *(*it)->context;
+            (*it)->triggered = false;
+            context.breaker_exception = false;
+            context.sock_exception = false;
+            context.writable = false;
+            context.readable = false;
+        }
+
+        int ret = poll_.Poll(10 * 60 * 1000);
+        int err = poll_.Errno();
+
+        if (0 > ret && EINTR == err) continue;
+        xerror2_if(0 > ret, TSF"poll ret:%_, errno:%_, links:%_", ret, err, links_.size());
+
+        std::vector<PollEvent> events = poll_.TriggeredEvents();
+        for (std::vector<PollEvent>::iterator it = events.begin(); it != events.end(); ++it) {
+            Link* link = (Link*)it->UserData();
+            LongLink::ReadWriteContext& context = *link->context;
+            link->triggered = true;
+
+            if (it->FD() == context.sock) {
+                context.sock_exception = it->Error() || it->Invalid();
+                context.writable = it->Writealbe();
+                context.readable = it->Readable() || it->HangUp();
+            } else {
+                context.breaker_exception = it->Error() || it->Invalid();
+                if (it->Readable()) link->longlink->readwritebreak_.Clear();
+            }
+        }
+
+        // a timeout or a poll error reaches every link, like the select of __RunReadWrite would
+        for (std::list<Link*>::iterator it = links_.begin(); it != links_.end();) {
+            Link* link = *it;
+            if (0 < ret && !link->triggered) {
+                ++it;
+                continue;
+            }
+
+            link->context->select_ret = ret;
+            link->context->select_errno = err;
+
+            if (link->longlink->__RunReadWriteAfter(*link->context) && __RunBefore(*link)) {
+                ++it;
+                continue;
+            }
+
+            it = links_.erase(it);
+            __End(link);
+        }
+    }
+}
+
+void LongLinkReactor::__Adopt() {
+    std::list<Link*> adopted;
+    {
+        ScopedLock lock(mutex_);
+        adopted.swap(pending_);
+    }
+
+    for (std::list<Link*>::iterator it = adopted.begin(); it != adopted.end(); ++it) {
+        Link* link = *it;
+        poll_.AddEvent(link->context->sock, true, false, link);
+        link->breaker_fd = link->longlink->readwritebreak_.BreakerFD();
+        poll_.AddEvent(link->breaker_fd, true, false, link);
+        xinfo2(TSF"adopt longlink:%_, sock:%_, links:%_", link->longlink->ChannelId(), link->context->sock, links_.size() + 1);
+
+        if (__RunBefore(*link)) {
+            links_.push_back(link);
+        } else {
+            __End(link);
+        }
+    }
+}
+
+bool LongLinkReactor::__RunBefore(Link& _link) {
+    if (!_link.longlink->__RunReadWriteBefore(*_link.context)) return false;
+
+    ScopedLock lock(_link.longlink->mutex_);
+    poll_.WriteEvent(_link.context->sock, !_link.longlink->lstsenddata_.empty());
+    return true;
+}
+
+void LongLinkReactor::__End(Link* _link) {
+    // unregister before the socket gets closed, its fd number may come back at once
+    poll_.DelEvent(_link->context->sock);
+    poll_.DelEvent(_link->breaker_fd);
+
+    xinfo2(TSF"remove longlink:%_, sock:%_, links:%_", _link->longlink->ChannelId(), _link->context->sock, links_.size());
+    _link->longlink->__RunReactorEnd(_link->context);
+    delete _link;
+}
+
+#endif // _WIN32
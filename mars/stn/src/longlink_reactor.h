@@ -0,0 +1,81 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+/*
+ * longlink_reactor.h
+ *
+ *  Created on: 2026-10-18
+ */
+
+#ifndef STN_SRC_LONGLINK_REACTOR_H_
+#define STN_SRC_LONGLINK_REACTOR_H_
+
+#ifndef _WIN32
+
+#include <list>
+
+#include "mars/comm/thread/mutex.h"
+#include "mars/comm/thread/thread.h"
+#include "mars/comm/socket/socketpoll.h"
+
+#include "longlink.h"
+
+namespace mars {
+namespace stn {
+
+/*
+ * One thread driving the read/write loop of every LongLink configured with shared_reactor.
+ * A link still connects on its own thread, then hands the socket over with Add().
+ * The socket and the link's readwritebreak_ stay registered in one persistent SocketPoll
+ * until the link ends, and LongLink::__RunReactorEnd runs the usual disconnect path here.
+ * Callbacks of a link run on this thread and hold up all other links while they run.
+ */
+class LongLinkReactor {
+  public:
+    static LongLinkReactor& Instance();
+
+    void Add(LongLink* _longlink, LongLink::ReadWriteContext* _context);
+    bool InReactorThread() const;
+
+  private:
+    struct Link {
+        LongLink* longlink;
+        LongLink::ReadWriteContext* context;
+        SOCKET breaker_fd;      // as registered, a failed Disconnect may close readwritebreak_ before the link ends
+        bool triggered;
+    };
+
+    LongLinkReactor();
+    ~LongLinkReactor();
+    LongLinkReactor(const LongLinkReactor&);
+    LongLinkReactor& operator=(const LongLinkReactor&);
+
+    void __Run();
+    void __Adopt();
+    bool __RunBefore(Link& _link);
+    void __End(Link* _link);
+
+  private:
+    Mutex               mutex_;
+    std::list<Link*>    pending_;
+    std::list<Link*>    links_;     // only touched by the reactor thread
+
+    SocketBreaker       breaker_;
+    SocketPoll          poll_;
+    Thread              thread_;
+};
+
+}}
+
+#endif // _WIN32
+#endif // STN_SRC_LONGLINK_REACTOR_H_
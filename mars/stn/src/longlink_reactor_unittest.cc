@@ -0,0 +1,173 @@
+#include "longlink_reactor.h"
+#include "gtest/gtest.h"
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "boost/filesystem.hpp"
+#include "mars/app/app_logic.h"
+#include "mars/baseevent/active_logic.h"
+#include "mars/comm/messagequeue/message_queue.h"
+#include "mars/comm/thread/thread.h"
+
+#include "net_source.h"
+
+using namespace testing;
+using namespace mars::stn;
+using namespace mars::comm;
+
+class AppCallback : public mars::app::Callback {
+  public:
+    virtual std::string GetAppFilePath() { return boost::filesystem::temp_directory_path().string(); }
+    virtual mars::app::AccountInfo GetAccountInfo() { return mars::app::AccountInfo(); }
+    virtual unsigned int GetClientVersion() { return 0; }
+    virtual mars::app::DeviceInfo GetDeviceInfo() { return mars::app::DeviceInfo(); }
+};
+
+static SOCKET __Listen(uint16_t& _port) {
+    SOCKET fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (0 != bind(fd, (sockaddr*)&addr, sizeof(addr)) || 0 != listen(fd, 4)) return INVALID_SOCKET;
+
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (sockaddr*)&addr, &len);
+    _port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static bool __Readable(SOCKET _fd, int _timeout) {
+    pollfd pfd = {_fd, POLLIN, 0};
+    return 1 == poll(&pfd, 1, _timeout);
+}
+
+static SOCKET __Accept(SOCKET _listen) {
+    return __Readable(_listen, 5000) ? accept(_listen, NULL, NULL) : INVALID_SOCKET;
+}
+
+static bool __WaitStatus(LongLink& _longlink, LongLink::TLongLinkStatus _status) {
+    for (int i = 0; i < 500 && _longlink.ConnectStatus() != _status; ++i) ThreadUtil::usleep(10 * 1000);
+    return _longlink.ConnectStatus() == _status;
+}
+
+TEST(longlink_reactor, add_wake_remove) {
+    uint16_t port = 0;
+    SOCKET listen_fd = __Listen(port);
+    ASSERT_NE(INVALID_SOCKET, listen_fd);
+
+    AppCallback app_callback;
+    mars::app::SetCallback(&app_callback);
+    NetSource::SetLongLink(std::vector<std::string>(1, "reactor.ut"), std::vector<uint16_t>(1, port), "127.0.0.1");
+    MessageQueue::MessageQueueCreater mq_creater(true, "longlink_reactor_ut");
+    ActiveLogic active_logic;
+    NetSource netsource(active_logic);
+
+    LonglinkConfig config("reactor_ut");
+    config.host_list.push_back("reactor.ut");
+    config.shared_reactor = true;
+
+    {
+        LongLink longlink(mq_creater.GetMessageQueue(), netsource, config);
+        std::atomic<int> sent_by_reactor(0);
+        longlink.OnSend = [&sent_by_reactor](uint32_t) {
+            if (LongLinkReactor::Instance().InReactorThread()) ++sent_by_reactor;
+        };
+
+        // adopted once connected
+        bool newone = false;
+        longlink.MakeSureConnected(&newone);
+        EXPECT_TRUE(newone);
+        SOCKET peer = __Accept(listen_fd);
+        ASSERT_NE(INVALID_SOCKET, peer);
+        ASSERT_TRUE(__WaitStatus(longlink, LongLink::kConnected));
+
+        // a send from this thread wakes the reactor up, which writes it
+        Task task(1);
+        task.cmdid = 1000;
+        AutoBuffer body;
+        body.Write("reactor", 7);
+        EXPECT_TRUE(longlink.Send(body, AutoBuffer(), task));
+
+        char buf[1024];
+        ASSERT_TRUE(__Readable(peer, 5000));
+        EXPECT_LT(0, recv(peer, buf, sizeof(buf), 0));
+        for (int i = 0; i < 500 && 0 == sent_by_reactor; ++i) ThreadUtil::usleep(10 * 1000);
+        EXPECT_EQ(1, sent_by_reactor);
+
+        // Disconnect from outside waits for the reactor to let the link go
+        longlink.Disconnect(LongLink::kReset);
+        EXPECT_EQ(LongLink::kDisConnected, longlink.ConnectStatus());
+        ASSERT_TRUE(__Readable(peer, 5000));
+        EXPECT_EQ(0, recv(peer, buf, sizeof(buf), 0));
+        close(peer);
+
+        // the reactor removes a link the server closed by itself
+        longlink.MakeSureConnected(&newone);
+        EXPECT_TRUE(newone);
+        peer = __Accept(listen_fd);
+        ASSERT_NE(INVALID_SOCKET, peer);
+        ASSERT_TRUE(__WaitStatus(longlink, LongLink::kConnected));
+        close(peer);
+        EXPECT_TRUE(__WaitStatus(longlink, LongLink::kDisConnected));
+    }
+
+    close(listen_fd);
+    mars::app::SetCallback(NULL);
+}
+
+// a callback on the reactor disconnects and asks for a new connection, which comes once the reactor let the old one go
+TEST(longlink_reactor, reconnect_from_callback) {
+    uint16_t port = 0;
+    SOCKET listen_fd = __Listen(port);
+    ASSERT_NE(INVALID_SOCKET, listen_fd);
+
+    AppCallback app_callback;
+    mars::app::SetCallback(&app_callback);
+    NetSource::SetLongLink(std::vector<std::string>(1, "reactor.ut"), std::vector<uint16_t>(1, port), "127.0.0.1");
+    MessageQueue::MessageQueueCreater mq_creater(true, "longlink_reactor_ut");
+    ActiveLogic active_logic;
+    NetSource netsource(active_logic);
+
+    LonglinkConfig config("reactor_ut");
+    config.host_list.push_back("reactor.ut");
+    config.shared_reactor = true;
+
+    {
+        LongLink longlink(mq_creater.GetMessageQueue(), netsource, config);
+        // OnResponse runs for the failures of a link going down as well, only the push asks for the new connection
+        longlink.OnResponse = [&longlink](const std::string&, ErrCmdType _errtype, int, uint32_t _cmdid, uint32_t, AutoBuffer&, AutoBuffer&, const ConnectProfile&) {
+            if (kEctOK != _errtype || 1000 != _cmdid) return;
+            longlink.Disconnect(LongLink::kReset);
+            longlink.MakeSureConnected();
+        };
+
+        longlink.MakeSureConnected();
+        SOCKET peer = __Accept(listen_fd);
+        ASSERT_NE(INVALID_SOCKET, peer);
+        ASSERT_TRUE(__WaitStatus(longlink, LongLink::kConnected));
+
+        // a push, its response runs the callback
+        AutoBuffer body;
+        body.Write("push", 4);
+        AutoBuffer packed;
+        longlink.Encoder().longlink_pack(1000, 0, body, AutoBuffer(), packed, NULL);
+        ASSERT_EQ((ssize_t)packed.Length(), send(peer, packed.Ptr(), packed.Length(), 0));
+
+        SOCKET again = __Accept(listen_fd);
+        EXPECT_NE(INVALID_SOCKET, again);
+        EXPECT_TRUE(__WaitStatus(longlink, LongLink::kConnected));
+        close(peer);
+        if (INVALID_SOCKET != again) close(again);
+    }
+
+    close(listen_fd);
+    mars::app::SetCallback(NULL);
+}
+
+EXPORT_GTEST_SYMBOLS(stn_export_longlink_reactor_unittest)
@@ -95,7 +95,9 @@ bool LongLinkTaskManager::StartTask(const Task& _task) {
     task.link_type = Task::kChannelLong;
 
     lst_cmd_.push_back(task);
-    lst_cmd_.sort(__CompareTask);
+    task_index_[_task.taskid] = --lst_cmd_.end();
+    deadlines_.Schedule(_task.taskid, __NextDeadline(lst_cmd_.back()));
+    lst_cmd_.sort(__CompareTask);   // list::sort keeps the iterators of task_index_ valid
 
     __RunLoop();
     return true;
@@ -104,44 +106,25 @@ bool LongLinkTaskManager::StartTask(const Task& _task) {
 bool LongLinkTaskManager::StopTask(uint32_t _taskid) {
     xverbose_function();
 
-    std::list<TaskProfile>::iterator first = lst_cmd_.begin();
-    std::list<TaskProfile>::iterator last = lst_cmd_.end();
-
-    while (first != last) {
-        if (_taskid == first->task.taskid) {
-            xinfo2(TSF"find the task taskid:%0", _taskid);
-
-            auto longlink = GetLongLink(first->task.channel_name);
-            if(longlink == nullptr) {
-                xwarn2(TSF"longlink nullptr name:%_", first->task.channel_name);
-                return false;
-            }
+    std::list<TaskProfile>::iterator it = __Locate(_taskid);
+    if (lst_cmd_.end() == it) return false;
 
-	        longlink->Channel()->Stop(first->task.taskid);
-            lst_cmd_.erase(first);
-            return true;
-        }
+    xinfo2(TSF"find the task taskid:%0", _taskid);
 
-        ++first;
+    auto longlink = GetLongLink(it->task.channel_name);
+    if(longlink == nullptr) {
+        xwarn2(TSF"longlink nullptr name:%_", it->task.channel_name);
+        return false;
     }
 
-    return false;
+    longlink->Channel()->Stop(it->task.taskid);
+    __EraseTask(it);
+    return true;
 }
 
 bool LongLinkTaskManager::HasTask(uint32_t _taskid) const {
     xverbose_function();
-
-    std::list<TaskProfile>::const_iterator first = lst_cmd_.begin();
-    std::list<TaskProfile>::const_iterator last = lst_cmd_.end();
-
-    while (first != last) {
-    	if (_taskid == first->task.taskid) {
-    		return true;
-    	}
-    	++first;
-    }
-
-    return false;
+    return task_index_.end() != task_index_.find(_taskid);
 }
 
 void LongLinkTaskManager::ClearTasks() {
@@ -155,6 +138,8 @@ void LongLinkTaskManager::ClearTasks() {
     
     MessageQueue::CancelMessage(asyncreg_.Get(), 0);
     lst_cmd_.clear();
+    task_index_.clear();
+    deadlines_.Clear();
 }
 
 unsigned int LongLinkTaskManager::GetTaskCount(const std::string& _name) {
@@ -242,15 +227,21 @@ void LongLinkTaskManager::__RunLoop() {
     }
 
     __RunOnTimeout();
-    __RunOnStartTask();
+    bool waiting = __RunOnStartTask();
 
     if (!lst_cmd_.empty()) {
+        // tasks waiting for auth, connection or the retry interval are still polled every second,
+        // otherwise sleep until the next timeout is due
+        uint64_t next_deadline = deadlines_.Next();
+        uint64_t cur_time = ::gettickcount();
+        int64_t after = 1000;
+        if (0 != next_deadline && (!waiting || next_deadline < cur_time + after)) {
+            after = next_deadline > cur_time ? (int64_t)(next_deadline - cur_time) : 0;
+        }
 #ifdef ANDROID
-        wakeup_lock_->Lock(30 * 1000);
+        wakeup_lock_->Lock(std::max<int64_t>(30 * 1000, after + 1000));
 #endif
-      MessageQueue::FasterMessage(asyncreg_.Get(),
-                                  MessageQueue::Message((MessageQueue::MessageTitle_t)this, boost::bind(&LongLinkTaskManager::__RunLoop, this), "LongLinkTaskManager::__RunLoop"),
-                                  MessageQueue::MessageTiming(1000));
+        __WakeUpRunLoop(after);
     } else {
 #ifdef ANDROID
         /*cancel the last wakeuplock*/
@@ -262,61 +253,16 @@ void LongLinkTaskManager::__RunLoop() {
 void LongLinkTaskManager::__RunOnTimeout() {
     xdebug_function();
 
-    std::list<TaskProfile>::iterator first = lst_cmd_.begin();
-    std::list<TaskProfile>::iterator last = lst_cmd_.end();
-
     uint64_t cur_time = ::gettickcount();
     std::map<std::string, std::pair<int, uint32_t> > batchMap;
+    std::vector<uint32_t> due_taskids;
 
-    while (first != last) {
-        int socket_timeout_code = 0;
-        uint32_t src_taskid = Task::kInvalidTaskID;
-
-        std::list<TaskProfile>::iterator next = first;
-        ++next;
-
-        if (first->running_id && 0 < first->transfer_profile.start_send_time) {
-            if (0 == first->transfer_profile.last_receive_pkg_time && cur_time - first->transfer_profile.start_send_time >= first->transfer_profile.first_pkg_timeout) {
-                xerror2(TSF"task first-pkg timeout taskid:%_,  nStartSendTime=%_, nfirstpkgtimeout=%_",
-                        first->task.taskid, first->transfer_profile.start_send_time / 1000, first->transfer_profile.first_pkg_timeout / 1000);
-                socket_timeout_code = kEctLongFirstPkgTimeout;
-                src_taskid = first->task.taskid;
-                batchMap[first->task.channel_name] = std::make_pair(socket_timeout_code, src_taskid);
-                __SetLastFailedStatus(first);
-            }
-
-            if (0 < first->transfer_profile.last_receive_pkg_time && cur_time - first->transfer_profile.last_receive_pkg_time >= ((kMobile != getNetInfo()) ? kWifiPackageInterval : kGPRSPackageInterval)) {
-                xerror2(TSF"task pkg-pkg timeout, taskid:%_, nLastRecvTime=%_, pkg-pkg timeout=%_",
-                        first->task.taskid, first->transfer_profile.last_receive_pkg_time / 1000, ((kMobile != getNetInfo()) ? kWifiPackageInterval : kGPRSPackageInterval) / 1000);
-                socket_timeout_code = kEctLongPkgPkgTimeout;
-                src_taskid = first->task.taskid;
-                batchMap[first->task.channel_name] = std::make_pair(socket_timeout_code, src_taskid);
-            }
-            
-            if (cur_time - first->transfer_profile.start_send_time >= first->transfer_profile.read_write_timeout) {
-                xerror2(TSF"task read-write timeout, taskid:%_, , nStartSendTime=%_, nReadWriteTimeOut=%_",
-                        first->task.taskid, first->transfer_profile.start_send_time / 1000, first->transfer_profile.read_write_timeout / 1000);
-                socket_timeout_code = kEctLongReadWriteTimeout;
-                src_taskid = first->task.taskid;
-                batchMap[first->task.channel_name] = std::make_pair(socket_timeout_code, src_taskid);
-            }
-        }
+    uint32_t taskid = Task::kInvalidTaskID;
+    while (deadlines_.PopDue(cur_time, taskid)) {
+        due_taskids.push_back(taskid);
 
-        auto longlink = GetLongLink(first->task.channel_name);
-
-        if (longlink && cur_time - first->start_task_time >= first->task_timeout) {
-	        auto longlink_channel = longlink->Channel();
-            xerror2(TSF"task timeout, taskid:%_, nStartSendTime=%_, cur_time=%_, timeout:%_",
-                    first->task.taskid, first->transfer_profile.start_send_time / 1000, cur_time / 1000, first->task_timeout / 1000);
-            if(batchMap.find(first->task.channel_name) == batchMap.end()) {
-                socket_timeout_code = kEctLongTaskTimeout;
-                src_taskid = first->task.taskid;
-                batchMap[first->task.channel_name] = std::make_pair(socket_timeout_code, src_taskid);
-            }
-            __SingleRespHandle(first, kEctLocal, kEctLocalTaskTimeout, kTaskFailHandleTaskTimeout, longlink_channel->Profile());
-        }
-
-        first = next;
+        std::list<TaskProfile>::iterator it = __Locate(taskid);
+        if (lst_cmd_.end() != it) __CheckTimeout(it, cur_time, batchMap);
     }
 
     for(auto item : batchMap) {
@@ -330,9 +276,92 @@ void LongLinkTaskManager::__RunOnTimeout() {
             __BatchErrorRespHandle(item.first, kEctNetMsgXP, item.second.first, kTaskFailHandleDefault, item.second.second);
         }
     }
+
+    // survivors are checked again at their next deadline, or polled if it already passed (e.g. channel released)
+    for (auto id : due_taskids) {
+        std::list<TaskProfile>::iterator it = __Locate(id);
+        if (lst_cmd_.end() == it) continue;
+
+        uint64_t deadline = __NextDeadline(*it);
+        deadlines_.Schedule(id, deadline > cur_time ? deadline : cur_time + 1000);
+    }
+}
+
+void LongLinkTaskManager::__CheckTimeout(std::list<TaskProfile>::iterator _it, uint64_t _cur_time, std::map<std::string, std::pair<int, uint32_t> >& _batch_map) {
+    int socket_timeout_code = 0;
+    uint32_t src_taskid = Task::kInvalidTaskID;
+
+    if (_it->running_id && 0 < _it->transfer_profile.start_send_time) {
+        if (0 == _it->transfer_profile.last_receive_pkg_time && _cur_time - _it->transfer_profile.start_send_time >= _it->transfer_profile.first_pkg_timeout) {
+            xerror2(TSF"task first-pkg timeout taskid:%_,  nStartSendTime=%_, nfirstpkgtimeout=%_",
+                    _it->task.taskid, _it->transfer_profile.start_send_time / 1000, _it->transfer_profile.first_pkg_timeout / 1000);
+            socket_timeout_code = kEctLongFirstPkgTimeout;
+            src_taskid = _it->task.taskid;
+            _batch_map[_it->task.channel_name] = std::make_pair(socket_timeout_code, src_taskid);
+            __SetLastFailedStatus(_it);
+        }
+
+        if (0 < _it->transfer_profile.last_receive_pkg_time && _cur_time - _it->transfer_profile.last_receive_pkg_time >= ((kMobile != getNetInfo()) ? kWifiPackageInterval : kGPRSPackageInterval)) {
+            xerror2(TSF"task pkg-pkg timeout, taskid:%_, nLastRecvTime=%_, pkg-pkg timeout=%_",
+                    _it->task.taskid, _it->transfer_profile.last_receive_pkg_time / 1000, ((kMobile != getNetInfo()) ? kWifiPackageInterval : kGPRSPackageInterval) / 1000);
+            socket_timeout_code = kEctLongPkgPkgTimeout;
+            src_taskid = _it->task.taskid;
+            _batch_map[_it->task.channel_name] = std::make_pair(socket_timeout_code, src_taskid);
+        }
+
+        if (_cur_time - _it->transfer_profile.start_send_time >= _it->transfer_profile.read_write_timeout) {
+            xerror2(TSF"task read-write timeout, taskid:%_, , nStartSendTime=%_, nReadWriteTimeOut=%_",
+                    _it->task.taskid, _it->transfer_profile.start_send_time / 1000, _it->transfer_profile.read_write_timeout / 1000);
+            socket_timeout_code = kEctLongReadWriteTimeout;
+            src_taskid = _it->task.taskid;
+            _batch_map[_it->task.channel_name] = std::make_pair(socket_timeout_code, src_taskid);
+        }
+    }
+
+    auto longlink = GetLongLink(_it->task.channel_name);
+
+    if (longlink && _cur_time - _it->start_task_time >= _it->task_timeout) {
+        auto longlink_channel = longlink->Channel();
+        xerror2(TSF"task timeout, taskid:%_, nStartSendTime=%_, cur_time=%_, timeout:%_",
+                _it->task.taskid, _it->transfer_profile.start_send_time / 1000, _cur_time / 1000, _it->task_timeout / 1000);
+        if(_batch_map.find(_it->task.channel_name) == _batch_map.end()) {
+            socket_timeout_code = kEctLongTaskTimeout;
+            src_taskid = _it->task.taskid;
+            _batch_map[_it->task.channel_name] = std::make_pair(socket_timeout_code, src_taskid);
+        }
+        __SingleRespHandle(_it, kEctLocal, kEctLocalTaskTimeout, kTaskFailHandleTaskTimeout, longlink_channel->Profile());
+    }
 }
 
-void LongLinkTaskManager::__RunOnStartTask() {
+void LongLinkTaskManager::__ScheduleTimeout(const TaskProfile& _task) {
+    uint64_t deadline = __NextDeadline(_task);
+    if (!deadlines_.Schedule(_task.task.taskid, deadline)) return;
+
+    // FasterMessage never postpones, a loop due earlier stays as it is
+    uint64_t cur_time = ::gettickcount();
+    __WakeUpRunLoop(deadline > cur_time ? (int64_t)(deadline - cur_time) : 0);
+}
+
+void LongLinkTaskManager::__WakeUpRunLoop(int64_t _after) {
+    MessageQueue::FasterMessage(asyncreg_.Get(),
+                                MessageQueue::Message((MessageQueue::MessageTitle_t)this, boost::bind(&LongLinkTaskManager::__RunLoop, this), "LongLinkTaskManager::__RunLoop"),
+                                MessageQueue::MessageTiming(_after));
+}
+
+uint64_t LongLinkTaskManager::__NextDeadline(const TaskProfile& _task) const {
+    uint64_t deadline = _task.start_task_time + _task.task_timeout;
+    if (!_task.running_id || 0 == _task.transfer_profile.start_send_time) return deadline;
+
+    const TransferProfile& profile = _task.transfer_profile;
+    if (0 == profile.last_receive_pkg_time) {
+        deadline = std::min(deadline, profile.start_send_time + profile.first_pkg_timeout);
+    } else {
+        deadline = std::min<uint64_t>(deadline, profile.last_receive_pkg_time + ((kMobile != getNetInfo()) ? kWifiPackageInterval : kGPRSPackageInterval));
+    }
+    return std::min(deadline, profile.start_send_time + profile.read_write_timeout);
+}
+
+bool LongLinkTaskManager::__RunOnStartTask() {
     xdebug_function();
     std::list<TaskProfile>::iterator first = lst_cmd_.begin();
     std::list<TaskProfile>::iterator last = lst_cmd_.end();
@@ -341,6 +370,7 @@ void LongLinkTaskManager::__RunOnStartTask() {
 
     bool canretry = curtime - lastbatcherrortime_ >= retry_interval_;
     bool canprint = true;
+    bool waiting = false;
     int sent_count = 0;
 
     while (first != last) {
@@ -359,6 +389,7 @@ void LongLinkTaskManager::__RunOnStartTask() {
                        retry_interval_, curtime, lastbatcherrortime_, curtime - lastbatcherrortime_);
             
             canprint = false;
+            waiting = true;
             first = next;
             continue;
         }
@@ -379,6 +410,7 @@ void LongLinkTaskManager::__RunOnStartTask() {
             xinfo2(TSF"makesureauth host:%_, auth result:%_, cgi:%_, channal name:%_", host, ismakesureauthsuccess,first->task.cgi, first->task.channel_name);
             if (!ismakesureauthsuccess) {
                 xinfo2_if(curtime % 3 == 0, TSF"makeSureAuth retsult=%0", ismakesureauthsuccess);
+                waiting = true;
                 first = next;
                 continue;
             }
@@ -391,6 +423,7 @@ void LongLinkTaskManager::__RunOnStartTask() {
         auto longlink = GetLongLink(first->task.channel_name);
 	    if(longlink == nullptr) {
 		    xerror2(TSF"longlink nullptr:%_", first->task.channel_name);
+		    waiting = true;
 		    first = next;
 		    continue;
 	    }
@@ -417,6 +450,8 @@ void LongLinkTaskManager::__RunOnStartTask() {
 		if (!longlink->Monitor()->MakeSureConnected()) {
             if (0 != first->task.channel_id) {
                 __SingleRespHandle(first, kEctLocal, kEctLocalChannelID, kTaskFailHandleTaskEnd, longlink_channel->Profile());
+            } else {
+                waiting = true;
             }
             
             first = next;
@@ -450,10 +485,11 @@ void LongLinkTaskManager::__RunOnStartTask() {
         first->current_dyntime_status = (first->task.server_process_cost <= 0) ? dynamic_timeout_.GetStatus() : kEValuating;
         first->transfer_profile.read_write_timeout = __ReadWriteTimeout(first->transfer_profile.first_pkg_timeout);
         first->transfer_profile.send_data_size = bufreq.Length();
-        first->running_id = longlink_channel->Send(bufreq, buffer_extension, first->task);
+        first->running_id = longlink_channel->SendMove(bufreq, buffer_extension, first->task);
 
         if (!first->running_id) {
             xwarn2(TSF"task add into longlink readwrite fail cgi:%_, cmdid:%_, taskid:%_", first->task.cgi, first->task.cmdid, first->task.taskid);
+            waiting = true;
             first = next;
             continue;
         }
@@ -468,6 +504,8 @@ void LongLinkTaskManager::__RunOnStartTask() {
         ++sent_count;
         first = next;
     }
+
+    return waiting;
 }
 
 bool LongLinkTaskManager::__SingleRespHandle(std::list<TaskProfile>::iterator _it, ErrCmdType _err_type, int _err_code, int _fail_handle, const ConnectProfile& _connect_profile) {
@@ -525,7 +563,7 @@ bool LongLinkTaskManager::__SingleRespHandle(std::list<TaskProfile>::iterator _i
         ReportTaskProfile(*_it);
         WeakNetworkLogic::Singleton::Instance()->OnTaskEvent(*_it);
 
-        lst_cmd_.erase(_it);
+        __EraseTask(_it);
         return true;
     }
 
@@ -633,22 +671,17 @@ void LongLinkTaskManager::__Disconnect(const std::string& _name, LongLink::TDisc
     }
 }
 
-struct find_task {
-  public:
-    bool operator()(const TaskProfile& value) {return taskid == value.task.taskid;}
-
-  public:
-    uint32_t taskid;
-};
-
 std::list<TaskProfile>::iterator LongLinkTaskManager::__Locate(uint32_t _taskid) {
     if (Task::kInvalidTaskID == _taskid) return lst_cmd_.end();
 
-    find_task find_functor;
-    find_functor.taskid = _taskid;
-    std::list<TaskProfile>::iterator it = std::find_if(lst_cmd_.begin(), lst_cmd_.end(), find_functor);
+    std::unordered_map<uint32_t, std::list<TaskProfile>::iterator>::iterator it = task_index_.find(_taskid);
+    return task_index_.end() == it ? lst_cmd_.end() : it->second;
+}
 
-    return it;
+void LongLinkTaskManager::__EraseTask(std::list<TaskProfile>::iterator _it) {
+    task_index_.erase(_it->task.taskid);
+    deadlines_.Remove(_it->task.taskid);
+    lst_cmd_.erase(_it);
 }
 
 void LongLinkTaskManager::__OnResponse(const std::string& _name, ErrCmdType _error_type, int _error_code, uint32_t _cmdid, uint32_t _taskid, AutoBuffer& _body, AutoBuffer& _extension, const ConnectProfile& _connect_profile) {
@@ -691,6 +724,7 @@ void LongLinkTaskManager::__OnResponse(const std::string& _name, ErrCmdType _err
     it->transfer_profile.received_size = body->Length();
     it->transfer_profile.receive_data_size = body->Length();
     it->transfer_profile.last_receive_pkg_time = ::gettickcount();
+    __ScheduleTimeout(*it);
     
     int err_code = 0;
     int handle_type = Buf2Resp(it->task.taskid, it->task.user_context, it->task.user_id, body, extension, err_code, Task::kChannelLong);
@@ -738,7 +772,7 @@ void LongLinkTaskManager::__OnResponse(const std::string& _name, ErrCmdType _err
                     _connect_profile.port, IPSourceTypeString[_connect_profile.ip_type], _connect_profile.host, handle_type, err_code,
                     xlogger_memory_dump(body->Ptr(), std::min<size_t>(body->Length(), 1024)));
             
-            lst_cmd_.erase(it);
+            __EraseTask(it);
         }
             break;
         default:
@@ -764,6 +798,7 @@ void LongLinkTaskManager::__OnSend(uint32_t _taskid) {
     		it->transfer_profile.first_start_send_time = ::gettickcount();
         it->transfer_profile.start_send_time = ::gettickcount();
         xdebug2(TSF"taskid:%_, starttime:%_", it->task.taskid, it->transfer_profile.start_send_time / 1000);
+        __ScheduleTimeout(*it);
     }
 }
 
@@ -780,6 +815,7 @@ void LongLinkTaskManager::__OnRecv(uint32_t _taskid, size_t _cachedsize, size_t
         it->transfer_profile.received_size = _cachedsize;
         it->transfer_profile.receive_data_size = _totalsize;
         it->transfer_profile.last_receive_pkg_time = ::gettickcount();
+        __ScheduleTimeout(*it);
         xdebug2(TSF"taskid:%_, cachedsize:%_, _totalsize:%_", it->task.taskid, _cachedsize, _totalsize);
     } else {
         xwarn2(TSF"not found taskid:%_ cachedsize:%_, _totalsize:%_", _taskid, _cachedsize, _totalsize);
@@ -793,12 +829,8 @@ void LongLinkTaskManager::__SignalConnection(LongLink::TLongLinkStatus _connect_
 
 std::shared_ptr<LongLinkMetaData> LongLinkTaskManager::GetLongLink(const std::string& _name) {
     ScopedLock lock(meta_mutex_);
-    for(auto& item : longlink_metas_) {
-        if(item.first == _name) {
-            return item.second;
-        }
-    }
-    return nullptr;
+    auto it = longlink_metas_.find(_name);
+    return longlink_metas_.end() == it ? nullptr : it->second;
 }
 
 void LongLinkTaskManager::OnNetworkChange() {
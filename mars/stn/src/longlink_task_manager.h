@@ -24,6 +24,7 @@
 #include <list>
 #include <stdint.h>
 #include <set>
+#include <unordered_map>
 
 #include "boost/function.hpp"
 
@@ -31,6 +32,7 @@
 #include "mars/stn/stn.h"
 
 #include "longlink_metadata.h"
+#include "task_deadline_queue.h"
 
 class AutoBuffer;
 class ActiveLogic;
@@ -102,13 +104,18 @@ class LongLinkTaskManager {
 
     void __RunLoop();
     void __RunOnTimeout();
-    void __RunOnStartTask();
+    bool __RunOnStartTask();
+    void __CheckTimeout(std::list<TaskProfile>::iterator _it, uint64_t _cur_time, std::map<std::string, std::pair<int, uint32_t> >& _batch_map);
+    uint64_t __NextDeadline(const TaskProfile& _task) const;
+    void __ScheduleTimeout(const TaskProfile& _task);
+    void __WakeUpRunLoop(int64_t _after);
 
     void __BatchErrorRespHandle(const std::string _channel_name, ErrCmdType _err_type, int _err_code, int _fail_handle, uint32_t _src_taskid, bool _callback_runing_task_only = true);
     bool __SingleRespHandle(std::list<TaskProfile>::iterator _it, ErrCmdType _err_type, int _err_code, int _fail_handle, const ConnectProfile& _connect_profile);
     void __BatchErrorRespHandleByUserId(const std::string& _user_id, ErrCmdType _err_type, int _err_code, int _fail_handle, uint32_t _src_taskid, bool _callback_runing_task_only = true);
 
     std::list<TaskProfile>::iterator __Locate(uint32_t  _taskid);
+    void __EraseTask(std::list<TaskProfile>::iterator _it);
 #ifdef __APPLE__
     void __ResetLongLink(const std::string& _name);
 #endif
@@ -119,6 +126,8 @@ class LongLinkTaskManager {
   private:
     MessageQueue::ScopeRegister     asyncreg_;
     std::list<TaskProfile>          lst_cmd_;
+    std::unordered_map<uint32_t, std::list<TaskProfile>::iterator> task_index_;   // taskid -> lst_cmd_
+    TaskDeadlineQueue               deadlines_;
     uint64_t                        lastbatcherrortime_;   // ms
     unsigned long                   retry_interval_;	//ms
     unsigned int                    tasks_continuous_fail_count_;
@@ -0,0 +1,224 @@
+#include "longlink.h"
+#include "gtest/gtest.h"
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "mars/app/app_logic.h"
+#include "mars/baseevent/active_logic.h"
+#include "mars/comm/messagequeue/message_queue.h"
+#include "mars/comm/thread/lock.h"
+#include "mars/comm/thread/thread.h"
+
+#include "net_source.h"
+
+using namespace testing;
+using namespace mars::stn;
+using namespace mars::comm;
+
+namespace {
+
+class AppCallback : public mars::app::Callback {
+  public:
+    virtual std::string GetAppFilePath() { return boost::filesystem::temp_directory_path().string(); }
+    virtual mars::app::AccountInfo GetAccountInfo() { return mars::app::AccountInfo(); }
+    virtual unsigned int GetClientVersion() { return 0; }
+    virtual mars::app::DeviceInfo GetDeviceInfo() { return mars::app::DeviceInfo(); }
+};
+
+struct Response {
+    uint32_t cmdid;
+    uint32_t taskid;
+    std::string body;
+};
+
+// a LongLink connected to a loopback socket the test plays the server on
+class LongLinkTest : public Test {
+  protected:
+    LongLinkTest(): mq_creater_(true, "longlink_ut"), netsource_(NULL), longlink_(NULL), listen_(INVALID_SOCKET), peer_(INVALID_SOCKET) {
+        encoder_.EnableDefaultPackHeader();
+        encoder_.EnableDefaultUnpackView();
+    }
+
+    virtual void SetUp() {
+        mars::app::SetCallback(&app_callback_);
+        netsource_ = new NetSource(active_logic_);
+
+        listen_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ASSERT_EQ(0, bind(listen_, (sockaddr*)&addr, sizeof(addr)));
+        ASSERT_EQ(0, listen(listen_, 1));
+        socklen_t len = sizeof(addr);
+        getsockname(listen_, (sockaddr*)&addr, &len);
+        NetSource::SetLongLink(std::vector<std::string>(1, "longlink.ut"), std::vector<uint16_t>(1, ntohs(addr.sin_port)), "127.0.0.1");
+
+        LonglinkConfig config("longlink_ut");
+        config.host_list.push_back("longlink.ut");
+        longlink_ = new LongLink(mq_creater_.GetMessageQueue(), *netsource_, config, encoder_);
+        longlink_->OnResponse = boost::bind(&LongLinkTest::__OnResponse, this, _4, _5, _6);
+
+        longlink_->MakeSureConnected();
+        ASSERT_TRUE(__Readable(listen_, 5000));
+        peer_ = accept(listen_, NULL, NULL);
+        ASSERT_NE(INVALID_SOCKET, peer_);
+        for (int i = 0; i < 500 && LongLink::kConnected != longlink_->ConnectStatus(); ++i) ThreadUtil::usleep(10 * 1000);
+        ASSERT_EQ(LongLink::kConnected, longlink_->ConnectStatus());
+    }
+
+    virtual void TearDown() {
+        delete longlink_;
+        delete netsource_;
+        if (INVALID_SOCKET != peer_) close(peer_);
+        if (INVALID_SOCKET != listen_) close(listen_);
+        mars::app::SetCallback(NULL);
+    }
+
+    static bool __Readable(SOCKET _fd, int _timeout) {
+        pollfd pfd = {_fd, POLLIN, 0};
+        return 1 == poll(&pfd, 1, _timeout);
+    }
+
+    void __Push(uint32_t _cmdid, const std::string& _body, AutoBuffer& _packed) {
+        AutoBuffer body;
+        body.Write(_body.data(), _body.size());
+        AutoBuffer packed;
+        gDefaultLongLinkEncoder.longlink_pack(_cmdid, 0, body, AutoBuffer(), packed, NULL);   // taskid 0: a push
+        _packed.Write(packed.Ptr(), packed.Length());
+    }
+
+    // what the LongLink sent, noops left out
+    bool __RecvPackages(size_t _count, std::vector<Response>& _packages) {
+        while (_packages.size() < _count) {
+            if (!__Readable(peer_, 5000)) return false;
+            char buf[64 * 1024];
+            ssize_t len = recv(peer_, buf, sizeof(buf), 0);
+            if (0 >= len) return false;
+            server_recv_.Write(buf, len);
+
+            while (0 < server_recv_.Length()) {
+                uint32_t cmdid = 0;
+                uint32_t seq = 0;
+                size_t packlen = 0;
+                AutoBuffer body;
+                AutoBuffer extension;
+                int ret = gDefaultLongLinkEncoder.longlink_unpack(server_recv_, cmdid, seq, packlen, body, extension, NULL);
+                if (LONGLINK_UNPACK_CONTINUE == ret) break;
+                if (LONGLINK_UNPACK_OK != ret) return false;
+
+                if (Task::kNoopTaskID != seq) {
+                    Response package = {cmdid, seq, std::string((const char*)body.Ptr(), body.Length())};
+                    _packages.push_back(package);
+                }
+                server_recv_.Move(-(off_t)packlen);
+            }
+        }
+        return true;
+    }
+
+    bool __WaitResponses(size_t _count) {
+        for (int i = 0; i < 500; ++i) {
+            {
+                ScopedLock lock(mutex_);
+                if (_count <= responses_.size()) return true;
+            }
+            ThreadUtil::usleep(10 * 1000);
+        }
+        return false;
+    }
+
+    void __OnResponse(uint32_t _cmdid, uint32_t _taskid, AutoBuffer& _body) {
+        Response resp = {_cmdid, _taskid, std::string((const char*)_body.Ptr(), _body.Length())};
+        ScopedLock lock(mutex_);
+        responses_.push_back(resp);
+    }
+
+    AppCallback app_callback_;
+    LongLinkEncoder encoder_;       // the default one, with the zero-copy paths turned on
+    MessageQueue::MessageQueueCreater mq_creater_;
+    ActiveLogic active_logic_;
+    NetSource* netsource_;
+    LongLink* longlink_;
+    SOCKET listen_;
+    SOCKET peer_;
+    AutoBuffer server_recv_;
+
+    Mutex mutex_;
+    std::vector<Response> responses_;
+};
+
+}
+
+TEST_F(LongLinkTest, recv_large_body_in_place) {
+    // a body at least 16KB big is received straight into its own buffer once its header arrived
+    std::string large(100 * 1024, 0);
+    for (size_t i = 0; i < large.size(); ++i) large[i] = (char)(i % 251);
+
+    AutoBuffer stream;
+    __Push(3000, "small before", stream);
+    size_t large_begin = stream.Length();
+    __Push(3001, large, stream);
+    __Push(3002, "small after", stream);
+
+    // the first package and the head of the large one, then the rest of it together with the next package
+    size_t split = large_begin + 100;
+    ASSERT_EQ((ssize_t)split, send(peer_, stream.Ptr(), split, 0));
+    ThreadUtil::usleep(50 * 1000);
+    ASSERT_EQ((ssize_t)(stream.Length() - split), send(peer_, stream.Ptr(split), stream.Length() - split, 0));
+
+    ASSERT_TRUE(__WaitResponses(3));
+    ScopedLock lock(mutex_);
+    ASSERT_EQ(3u, responses_.size());
+    EXPECT_EQ(3000u, responses_[0].cmdid);
+    EXPECT_EQ("small before", responses_[0].body);
+    EXPECT_EQ(3001u, responses_[1].cmdid);
+    EXPECT_TRUE(large == responses_[1].body);
+    EXPECT_EQ(3002u, responses_[2].cmdid);
+    EXPECT_EQ("small after", responses_[2].body);
+}
+
+TEST_F(LongLinkTest, send_header_and_body_apart) {
+    // headers and bodies go out as separate iovecs, sent nodes come back from the free list in later rounds
+    const size_t kBodySizes[] = {0, 10, 1000, 20 * 1024};
+    const uint32_t kRounds = 4;
+    const uint32_t kTasksPerRound = 30;
+
+    uint32_t taskid = 1;
+    for (uint32_t round = 0; round < kRounds; ++round) {
+        std::vector<std::string> sent;
+        for (uint32_t i = 0; i < kTasksPerRound; ++i, ++taskid) {
+            std::string content(kBodySizes[taskid % (sizeof(kBodySizes) / sizeof(kBodySizes[0]))], (char)taskid);
+            AutoBuffer body;
+            body.Write(content.data(), content.size());
+
+            Task task(taskid);
+            task.cmdid = 2000 + taskid;
+            if (taskid % 2) {
+                ASSERT_TRUE(longlink_->SendMove(body, AutoBuffer(), task));
+            } else {
+                ASSERT_TRUE(longlink_->Send(body, AutoBuffer(), task));
+            }
+            sent.push_back(content);
+        }
+
+        std::vector<Response> packages;
+        ASSERT_TRUE(__RecvPackages(kTasksPerRound, packages));
+        ASSERT_EQ(kTasksPerRound, packages.size());
+        for (uint32_t i = 0; i < kTasksPerRound; ++i) {
+            uint32_t expect_taskid = taskid - kTasksPerRound + i;
+            EXPECT_EQ(expect_taskid, packages[i].taskid);
+            EXPECT_EQ(2000 + expect_taskid, packages[i].cmdid);
+            EXPECT_TRUE(sent[i] == packages[i].body) << "taskid:" << expect_taskid;
+        }
+    }
+}
+
+EXPORT_GTEST_SYMBOLS(stn_export_longlink_unittest)
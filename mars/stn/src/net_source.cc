@@ -491,6 +491,7 @@ void NetSource::ReportShortIP(bool _is_success, const std::string& _ip, const st
 void NetSource::ClearCache() {
     xinfo_function();
     ipportstrategy_.InitHistory2BannedList(true);
+    DNS::ClearCache();
 }
 
 std::string NetSource::DumpTable(const std::vector<IPPortItem>& _ipport_items) {
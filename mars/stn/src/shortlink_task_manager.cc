@@ -92,7 +92,9 @@ bool ShortLinkTaskManager::StartTask(const Task& _task) {
     task.link_type = Task::kChannelShort;
 
     lst_cmd_.push_back(task);
-    lst_cmd_.sort(__CompareTask);
+    task_index_[_task.taskid] = --lst_cmd_.end();
+    deadlines_.Schedule(_task.taskid, __NextDeadline(lst_cmd_.back()));
+    lst_cmd_.sort(__CompareTask);   // list::sort keeps the iterators of task_index_ valid
 
     __RunLoop();
     return true;
@@ -101,38 +103,19 @@ bool ShortLinkTaskManager::StartTask(const Task& _task) {
 bool ShortLinkTaskManager::StopTask(uint32_t _taskid) {
     xverbose_function();
 
-    std::list<TaskProfile>::iterator first = lst_cmd_.begin();
-    std::list<TaskProfile>::iterator last = lst_cmd_.end();
-
-    while (first != last) {
-        if (_taskid == first->task.taskid) {
-            xinfo2(TSF"find the task, taskid:%0", _taskid);
+    std::list<TaskProfile>::iterator it = __Locate(_taskid);
+    if (lst_cmd_.end() == it) return false;
 
-            __DeleteShortLink(first->running_id);
-            lst_cmd_.erase(first);
-            return true;
-        }
+    xinfo2(TSF"find the task, taskid:%0", _taskid);
 
-        ++first;
-    }
-
-    return false;
+    __DeleteShortLink(it->running_id);
+    __EraseTask(it);
+    return true;
 }
 
 bool ShortLinkTaskManager::HasTask(uint32_t _taskid) const {
     xverbose_function();
-
-    std::list<TaskProfile>::const_iterator first = lst_cmd_.begin();
-    std::list<TaskProfile>::const_iterator last = lst_cmd_.end();
-
-    while (first != last) {
-        if (_taskid == first->task.taskid) {
-            return true;
-        }
-        ++first;
-    }
-
-    return false;
+    return task_index_.end() != task_index_.find(_taskid);
 }
 
 void ShortLinkTaskManager::ClearTasks() {
@@ -145,6 +128,9 @@ void ShortLinkTaskManager::ClearTasks() {
     }
 
     lst_cmd_.clear();
+    task_index_.clear();
+    worker_index_.clear();
+    deadlines_.Clear();
 }
 
 unsigned int ShortLinkTaskManager::GetTasksContinuousFailCount() {
@@ -162,15 +148,21 @@ void ShortLinkTaskManager::__RunLoop() {
     }
 
     __RunOnTimeout();
-    __RunOnStartTask();
+    bool waiting = __RunOnStartTask();
 
     if (!lst_cmd_.empty()) {
+        // tasks waiting for auth or the retry interval are still polled every second,
+        // otherwise sleep until the next timeout is due
+        uint64_t next_deadline = deadlines_.Next();
+        uint64_t cur_time = ::gettickcount();
+        int64_t after = 1000;
+        if (0 != next_deadline && (!waiting || next_deadline < cur_time + after)) {
+            after = next_deadline > cur_time ? (int64_t)(next_deadline - cur_time) : 0;
+        }
 #ifdef ANDROID
-        wakeup_lock_->Lock(60 * 1000);
+        wakeup_lock_->Lock(std::max<int64_t>(60 * 1000, after + 1000));
 #endif
-        MessageQueue::FasterMessage(asyncreg_.Get(),
-                                    MessageQueue::Message((MessageQueue::MessageTitle_t)this, boost::bind(&ShortLinkTaskManager::__RunLoop, this), "ShortLinkTaskManager::__RunLoop"),
-                                    MessageQueue::MessageTiming(1000));
+        __WakeUpRunLoop(after);
     } else {
 #ifdef ANDROID
         /*cancel the last wakeuplock*/
@@ -180,67 +172,106 @@ void ShortLinkTaskManager::__RunLoop() {
 }
 
 void ShortLinkTaskManager::__RunOnTimeout() {
-    xverbose2(TSF"lst_cmd_ size=%0", lst_cmd_.size());
+    xverbose2(TSF"lst_cmd_ size=%0, deadlines:%1", lst_cmd_.size(), deadlines_.Size());
     socket_pool_.CleanTimeout();
 
-    std::list<TaskProfile>::iterator first = lst_cmd_.begin();
-    std::list<TaskProfile>::iterator last = lst_cmd_.end();
-
     uint64_t cur_time = ::gettickcount();
+    std::vector<uint32_t> due_taskids;
 
-    while (first != last) {
-        std::list<TaskProfile>::iterator next = first;
-        ++next;
+    uint32_t taskid = Task::kInvalidTaskID;
+    while (deadlines_.PopDue(cur_time, taskid)) {
+        due_taskids.push_back(taskid);
 
-        ErrCmdType err_type = kEctLocal;
-        int socket_timeout_code = 0;
-	    // xinfo2(TSF"task is long-polling task:%_,%_, cgi:%_,%_, timeout:%_, id %_",first->task.long_polling, first->transfer_profile.task.long_polling, first->transfer_profile.task.cgi,first->task.cgi, first->transfer_profile.task.long_polling_timeout, (void*)first->running_id);
-
-        if (cur_time - first->start_task_time >= first->task_timeout) {
-            err_type = kEctLocal;
-            socket_timeout_code = kEctLocalTaskTimeout;
-        } else if (first->running_id && 0 < first->transfer_profile.start_send_time && cur_time - first->transfer_profile.start_send_time >= first->transfer_profile.read_write_timeout) {
-            xerror2(TSF"task read-write timeout, taskid:%_, wworker:%_, nStartSendTime:%_, nReadWriteTimeOut:%_", first->task.taskid, (void*)first->running_id, first->transfer_profile.start_send_time / 1000, first->transfer_profile.read_write_timeout / 1000);
-            err_type = kEctHttp;
-            socket_timeout_code = kEctHttpReadWriteTimeout;
-        } else if (first->running_id && first->task.long_polling && 0 < first->transfer_profile.start_send_time && 0 == first->transfer_profile.last_receive_pkg_time && cur_time - first->transfer_profile.start_send_time >= (uint64_t)first->task.long_polling_timeout) {
-            xerror2(TSF"task long-polling timeout, taskid:%_, wworker:%_, nStartSendTime:%_, nLongPollingTimeout:%_", first->task.taskid, (void*)first->running_id, first->transfer_profile.start_send_time / 1000, first->task.long_polling_timeout / 1000);
-            err_type = kEctHttp;
-            socket_timeout_code = kEctHttpLongPollingTimeout;
-        } else if (first->running_id && !first->task.long_polling && 0 < first->transfer_profile.start_send_time && 0 == first->transfer_profile.last_receive_pkg_time && cur_time - first->transfer_profile.start_send_time >= first->transfer_profile.first_pkg_timeout) {
-            xerror2(TSF"task first-pkg timeout taskid:%_, wworker:%_, nStartSendTime:%_, nfirstpkgtimeout:%_", first->task.taskid, (void*)first->running_id, first->transfer_profile.start_send_time / 1000, first->transfer_profile.first_pkg_timeout / 1000);
-            err_type = kEctHttp;
-            socket_timeout_code = kEctHttpFirstPkgTimeout;
-        } else if (first->running_id && 0 < first->transfer_profile.start_send_time && 0 < first->transfer_profile.last_receive_pkg_time &&
-                cur_time - first->transfer_profile.last_receive_pkg_time >= ((kMobile != getNetInfo()) ? kWifiPackageInterval : kGPRSPackageInterval)) {
-            xerror2(TSF"task pkg-pkg timeout, taskid:%_, wworker:%_, nLastRecvTime:%_, pkg-pkg timeout:%_",
-                    first->task.taskid, (void*)first->running_id, first->transfer_profile.last_receive_pkg_time / 1000, ((kMobile != getNetInfo()) ? kWifiPackageInterval : kGPRSPackageInterval) / 1000);
-            err_type = kEctHttp;
-            socket_timeout_code = kEctHttpPkgPkgTimeout;
-        } else {
-            // pass
-        }
+        std::list<TaskProfile>::iterator it = __Locate(taskid);
+        if (lst_cmd_.end() != it) __CheckTimeout(it, cur_time);
+    }
 
-        if (0 != socket_timeout_code) {
-            std::string ip = first->running_id ? ((ShortLinkInterface*)first->running_id)->Profile().ip : "";
-            std::string host = first->running_id ? ((ShortLinkInterface*)first->running_id)->Profile().host : "";
-            int port = first->running_id ? ((ShortLinkInterface*)first->running_id)->Profile().port : 0;
-            dynamic_timeout_.CgiTaskStatistic(first->task.cgi, kDynTimeTaskFailedPkgLen, 0);
-            __SetLastFailedStatus(first);
-            __SingleRespHandle(first, err_type, socket_timeout_code, err_type == kEctLocal ? kTaskFailHandleTaskTimeout : kTaskFailHandleDefault, 0, first->running_id ? ((ShortLinkInterface*)first->running_id)->Profile() : ConnectProfile());
-            xassert2(fun_notify_network_err_);
-            fun_notify_network_err_(__LINE__, err_type, socket_timeout_code, ip, host, port);
-        }
+    // survivors are checked again at their next deadline
+    for (std::vector<uint32_t>::iterator id = due_taskids.begin(); id != due_taskids.end(); ++id) {
+        std::list<TaskProfile>::iterator it = __Locate(*id);
+        if (lst_cmd_.end() == it) continue;
 
-        first = next;
+        uint64_t deadline = __NextDeadline(*it);
+        deadlines_.Schedule(*id, deadline > cur_time ? deadline : cur_time + 1000);
+    }
+}
+
+void ShortLinkTaskManager::__CheckTimeout(std::list<TaskProfile>::iterator _it, uint64_t _cur_time) {
+    ErrCmdType err_type = kEctLocal;
+    int socket_timeout_code = 0;
+    // xinfo2(TSF"task is long-polling task:%_,%_, cgi:%_,%_, timeout:%_, id %_",_it->task.long_polling, _it->transfer_profile.task.long_polling, _it->transfer_profile.task.cgi,_it->task.cgi, _it->transfer_profile.task.long_polling_timeout, (void*)_it->running_id);
+
+    if (_cur_time - _it->start_task_time >= _it->task_timeout) {
+        err_type = kEctLocal;
+        socket_timeout_code = kEctLocalTaskTimeout;
+    } else if (_it->running_id && 0 < _it->transfer_profile.start_send_time && _cur_time - _it->transfer_profile.start_send_time >= _it->transfer_profile.read_write_timeout) {
+        xerror2(TSF"task read-write timeout, taskid:%_, wworker:%_, nStartSendTime:%_, nReadWriteTimeOut:%_", _it->task.taskid, (void*)_it->running_id, _it->transfer_profile.start_send_time / 1000, _it->transfer_profile.read_write_timeout / 1000);
+        err_type = kEctHttp;
+        socket_timeout_code = kEctHttpReadWriteTimeout;
+    } else if (_it->running_id && _it->task.long_polling && 0 < _it->transfer_profile.start_send_time && 0 == _it->transfer_profile.last_receive_pkg_time && _cur_time - _it->transfer_profile.start_send_time >= (uint64_t)_it->task.long_polling_timeout) {
+        xerror2(TSF"task long-polling timeout, taskid:%_, wworker:%_, nStartSendTime:%_, nLongPollingTimeout:%_", _it->task.taskid, (void*)_it->running_id, _it->transfer_profile.start_send_time / 1000, _it->task.long_polling_timeout / 1000);
+        err_type = kEctHttp;
+        socket_timeout_code = kEctHttpLongPollingTimeout;
+    } else if (_it->running_id && !_it->task.long_polling && 0 < _it->transfer_profile.start_send_time && 0 == _it->transfer_profile.last_receive_pkg_time && _cur_time - _it->transfer_profile.start_send_time >= _it->transfer_profile.first_pkg_timeout) {
+        xerror2(TSF"task first-pkg timeout taskid:%_, wworker:%_, nStartSendTime:%_, nfirstpkgtimeout:%_", _it->task.taskid, (void*)_it->running_id, _it->transfer_profile.start_send_time / 1000, _it->transfer_profile.first_pkg_timeout / 1000);
+        err_type = kEctHttp;
+        socket_timeout_code = kEctHttpFirstPkgTimeout;
+    } else if (_it->running_id && 0 < _it->transfer_profile.start_send_time && 0 < _it->transfer_profile.last_receive_pkg_time &&
+            _cur_time - _it->transfer_profile.last_receive_pkg_time >= ((kMobile != getNetInfo()) ? kWifiPackageInterval : kGPRSPackageInterval)) {
+        xerror2(TSF"task pkg-pkg timeout, taskid:%_, wworker:%_, nLastRecvTime:%_, pkg-pkg timeout:%_",
+                _it->task.taskid, (void*)_it->running_id, _it->transfer_profile.last_receive_pkg_time / 1000, ((kMobile != getNetInfo()) ? kWifiPackageInterval : kGPRSPackageInterval) / 1000);
+        err_type = kEctHttp;
+        socket_timeout_code = kEctHttpPkgPkgTimeout;
+    } else {
+        // pass
+    }
+
+    if (0 != socket_timeout_code) {
+        std::string ip = _it->running_id ? ((ShortLinkInterface*)_it->running_id)->Profile().ip : "";
+        std::string host = _it->running_id ? ((ShortLinkInterface*)_it->running_id)->Profile().host : "";
+        int port = _it->running_id ? ((ShortLinkInterface*)_it->running_id)->Profile().port : 0;
+        dynamic_timeout_.CgiTaskStatistic(_it->task.cgi, kDynTimeTaskFailedPkgLen, 0);
+        __SetLastFailedStatus(_it);
+        __SingleRespHandle(_it, err_type, socket_timeout_code, err_type == kEctLocal ? kTaskFailHandleTaskTimeout : kTaskFailHandleDefault, 0, _it->running_id ? ((ShortLinkInterface*)_it->running_id)->Profile() : ConnectProfile());
+        xassert2(fun_notify_network_err_);
+        fun_notify_network_err_(__LINE__, err_type, socket_timeout_code, ip, host, port);
+    }
+}
+
+uint64_t ShortLinkTaskManager::__NextDeadline(const TaskProfile& _task) const {
+    uint64_t deadline = _task.start_task_time + _task.task_timeout;
+    if (!_task.running_id || 0 == _task.transfer_profile.start_send_time) return deadline;
+
+    const TransferProfile& profile = _task.transfer_profile;
+    deadline = std::min(deadline, profile.start_send_time + profile.read_write_timeout);
+    if (0 == profile.last_receive_pkg_time) {
+        uint64_t first_pkg_timeout = _task.task.long_polling ? (uint64_t)_task.task.long_polling_timeout : profile.first_pkg_timeout;
+        return std::min(deadline, profile.start_send_time + first_pkg_timeout);
     }
+    return std::min<uint64_t>(deadline, profile.last_receive_pkg_time + ((kMobile != getNetInfo()) ? kWifiPackageInterval : kGPRSPackageInterval));
+}
+
+void ShortLinkTaskManager::__ScheduleTimeout(const TaskProfile& _task) {
+    uint64_t deadline = __NextDeadline(_task);
+    if (!deadlines_.Schedule(_task.task.taskid, deadline)) return;
+
+    // FasterMessage never postpones, a loop due earlier stays as it is
+    uint64_t cur_time = ::gettickcount();
+    __WakeUpRunLoop(deadline > cur_time ? (int64_t)(deadline - cur_time) : 0);
+}
+
+void ShortLinkTaskManager::__WakeUpRunLoop(int64_t _after) {
+    MessageQueue::FasterMessage(asyncreg_.Get(),
+                                MessageQueue::Message((MessageQueue::MessageTitle_t)this, boost::bind(&ShortLinkTaskManager::__RunLoop, this), "ShortLinkTaskManager::__RunLoop"),
+                                MessageQueue::MessageTiming(_after));
 }
 
-void ShortLinkTaskManager::__RunOnStartTask() {
+bool ShortLinkTaskManager::__RunOnStartTask() {
     std::list<TaskProfile>::iterator first = lst_cmd_.begin();
     std::list<TaskProfile>::iterator last = lst_cmd_.end();
 
     uint64_t curtime = ::gettickcount();
+    bool waiting = false;
     int sent_count = 0;
 
     while (first != last) {
@@ -256,6 +287,7 @@ void ShortLinkTaskManager::__RunOnStartTask() {
         //重试间隔
         if (first->retry_time_interval > curtime - first->retry_start_time) {
             xdebug2(TSF"retry interval, taskid:%0, task retry late task, wait:%1", first->task.taskid, (curtime - first->transfer_profile.loop_start_task_time) / 1000);
+            waiting = true;
             first = next;
             continue;
         }
@@ -273,6 +305,7 @@ void ShortLinkTaskManager::__RunOnStartTask() {
 
             if (!ismakesureauthsuccess) {
                 xinfo2_if(curtime % 3 == 1, TSF"makeSureAuth retsult=%0", ismakesureauthsuccess);
+                waiting = true;
                 first = next;
                 continue;
             }
@@ -323,9 +356,11 @@ void ShortLinkTaskManager::__RunOnStartTask() {
         xassert2(worker && first->running_id);
         if (!first->running_id) {
             xwarn2(TSF"task add into shortlink readwrite fail cgi:%_, cmdid:%_, taskid:%_", first->task.cgi, first->task.cmdid, first->task.taskid);
+            waiting = true;
             first = next;
             continue;
         }
+        worker_index_[first->running_id] = first->task.taskid;
 
         worker->func_network_report.set(fun_notify_network_err_);
         if (choose_protocol_) {
@@ -339,15 +374,9 @@ void ShortLinkTaskManager::__RunOnStartTask() {
         ++sent_count;
         first = next;
     }
-}
 
-struct find_seq {
-  public:
-    bool operator()(const TaskProfile& _value) {return p_worker == (ShortLinkInterface*)_value.running_id;}
-
-  public:
-    ShortLinkInterface* p_worker;
-};
+    return waiting;
+}
 
 void ShortLinkTaskManager::__OnResponse(ShortLinkInterface* _worker, ErrCmdType _err_type, int _status, AutoBuffer& _body, AutoBuffer& _extension, bool _cancel_retry, ConnectProfile& _conn_profile) {
 
@@ -362,11 +391,12 @@ void ShortLinkTaskManager::__OnResponse(ShortLinkInterface* _worker, ErrCmdType
         return;
     }
     
+    bool has_ip_item = _conn_profile.ip_index >=0 && _conn_profile.ip_index < (int)_conn_profile.ip_items.size();
     if(_worker->IsKeepAlive() && _conn_profile.socket_fd != INVALID_SOCKET) {
         if(_err_type != kEctOK) {
             socket_close(_conn_profile.socket_fd);
-            socket_pool_.Report(_conn_profile.is_reused_fd, false, false);
-        } else if(_conn_profile.ip_index >=0 && _conn_profile.ip_index < (int)_conn_profile.ip_items.size()) {
+            if (has_ip_item) socket_pool_.Report(_conn_profile.ip_items[_conn_profile.ip_index], _conn_profile.is_reused_fd, false, false);
+        } else if(has_ip_item) {
             IPPortItem item = _conn_profile.ip_items[_conn_profile.ip_index];
             CacheSocketItem cache_item(item, _conn_profile.socket_fd, _conn_profile.keepalive_timeout);
             if(!socket_pool_.AddCache(cache_item)) {
@@ -394,11 +424,12 @@ void ShortLinkTaskManager::__OnResponse(ShortLinkInterface* _worker, ErrCmdType
     it->transfer_profile.received_size = _body.Length();
     it->transfer_profile.receive_data_size = _body.Length();
     it->transfer_profile.last_receive_pkg_time = ::gettickcount();
+    __ScheduleTimeout(*it);
 
     int err_code = 0;
     int handle_type = Buf2Resp(it->task.taskid, it->task.user_context, it->task.user_id, _body, _extension, err_code, Task::kChannelShort);
     xinfo2(TSF"err_code %_ ",err_code);
-    socket_pool_.Report(_conn_profile.is_reused_fd, true, handle_type==kTaskFailHandleNoError);
+    if (has_ip_item) socket_pool_.Report(_conn_profile.ip_items[_conn_profile.ip_index], _conn_profile.is_reused_fd, true, handle_type==kTaskFailHandleNoError);
 
     switch(handle_type){
         case kTaskFailHandleNoError:
@@ -457,6 +488,7 @@ void ShortLinkTaskManager::__OnSend(ShortLinkInterface* _worker) {
             it->transfer_profile.first_start_send_time = ::gettickcount();
         it->transfer_profile.start_send_time = ::gettickcount();
         xdebug2(TSF"taskid:%_, worker:%_, nStartSendTime:%_", it->task.taskid, _worker, it->transfer_profile.start_send_time / 1000);
+        __ScheduleTimeout(*it);
     }
 }
 
@@ -473,6 +505,7 @@ void ShortLinkTaskManager::__OnRecv(ShortLinkInterface* _worker, unsigned int _c
         it->transfer_profile.last_receive_pkg_time = ::gettickcount();
         it->transfer_profile.received_size = _cached_size;
         it->transfer_profile.receive_data_size = _total_size;
+        __ScheduleTimeout(*it);
         xdebug2(TSF"worker:%_, last_recvtime:%_, cachedsize:%_, totalsize:%_", _worker, it->transfer_profile.last_receive_pkg_time / 1000, _cached_size, _total_size);
     } else {
         xwarn2(TSF"not found worker:%_", _worker);
@@ -613,7 +646,7 @@ bool ShortLinkTaskManager::__SingleRespHandle(std::list<TaskProfile>::iterator _
 
         __DeleteShortLink(_it->running_id);
 
-        lst_cmd_.erase(_it);
+        __EraseTask(_it);
 
         return true;
     }
@@ -653,15 +686,30 @@ bool ShortLinkTaskManager::__SingleRespHandle(std::list<TaskProfile>::iterator _
 std::list<TaskProfile>::iterator ShortLinkTaskManager::__LocateBySeq(intptr_t _running_id) {
     if (!_running_id) return lst_cmd_.end();
 
-    find_seq find_functor;
-    find_functor.p_worker = (ShortLinkInterface*)_running_id;
-    std::list<TaskProfile>::iterator it = std::find_if(lst_cmd_.begin(), lst_cmd_.end(), find_functor);
+    std::unordered_map<intptr_t, uint32_t>::iterator worker = worker_index_.find(_running_id);
+    if (worker_index_.end() == worker) return lst_cmd_.end();
+
+    std::list<TaskProfile>::iterator it = __Locate(worker->second);
+    if (lst_cmd_.end() == it || _running_id != it->running_id) return lst_cmd_.end();
 
     return it;
 }
 
+std::list<TaskProfile>::iterator ShortLinkTaskManager::__Locate(uint32_t _taskid) {
+    std::unordered_map<uint32_t, std::list<TaskProfile>::iterator>::iterator it = task_index_.find(_taskid);
+    return task_index_.end() == it ? lst_cmd_.end() : it->second;
+}
+
+void ShortLinkTaskManager::__EraseTask(std::list<TaskProfile>::iterator _it) {
+    if (_it->running_id) worker_index_.erase(_it->running_id);
+    task_index_.erase(_it->task.taskid);
+    deadlines_.Remove(_it->task.taskid);
+    lst_cmd_.erase(_it);
+}
+
 void ShortLinkTaskManager::__DeleteShortLink(intptr_t& _running_id) {
     if (!_running_id) return;
+    worker_index_.erase(_running_id);
     ShortLinkInterface* p_shortlink = (ShortLinkInterface*)_running_id;
     ShortLinkChannelFactory::Destory(p_shortlink);
     MessageQueue::CancelMessage(asyncreg_.Get(), p_shortlink);
@@ -24,6 +24,7 @@
 #include <list>
 #include <stdint.h>
 #include <map>
+#include <unordered_map>
 
 #include "boost/function.hpp"
 
@@ -33,6 +34,7 @@
 
 #include "shortlink.h"
 #include "socket_pool.h"
+#include "task_deadline_queue.h"
 
 class AutoBuffer;
 
@@ -76,7 +78,11 @@ class ShortLinkTaskManager {
   private:
     void __RunLoop();
     void __RunOnTimeout();
-    void __RunOnStartTask();
+    bool __RunOnStartTask();
+    void __CheckTimeout(std::list<TaskProfile>::iterator _it, uint64_t _cur_time);
+    uint64_t __NextDeadline(const TaskProfile& _task) const;
+    void __ScheduleTimeout(const TaskProfile& _task);
+    void __WakeUpRunLoop(int64_t _after);
 
     void __OnResponse(ShortLinkInterface* _worker, ErrCmdType _err_type, int _status, AutoBuffer& _body, AutoBuffer& _extension, bool _cancel_retry, ConnectProfile& _conn_profile);
     void __OnSend(ShortLinkInterface* _worker);
@@ -86,6 +92,8 @@ class ShortLinkTaskManager {
     bool __SingleRespHandle(std::list<TaskProfile>::iterator _it, ErrCmdType _err_type, int _err_code, int _fail_handle, size_t _resp_length, const ConnectProfile& _connect_profile);
 
     std::list<TaskProfile>::iterator __LocateBySeq(intptr_t _running_id);
+    std::list<TaskProfile>::iterator __Locate(uint32_t _taskid);
+    void __EraseTask(std::list<TaskProfile>::iterator _it);
 
     void __DeleteShortLink(intptr_t& _running_id);
     SOCKET __OnGetCacheSocket(const IPPortItem& _address);
@@ -95,6 +103,9 @@ class ShortLinkTaskManager {
     NetSource&                      net_source_;
     
     std::list<TaskProfile>          lst_cmd_;
+    std::unordered_map<uint32_t, std::list<TaskProfile>::iterator> task_index_;   // taskid -> lst_cmd_
+    std::unordered_map<intptr_t, uint32_t> worker_index_;  // running_id -> taskid
+    TaskDeadlineQueue               deadlines_;
     
     bool                            default_use_proxy_;
     unsigned int                    tasks_continuous_fail_count_;
@@ -20,13 +20,14 @@
 
 #include "simple_ipport_sort.h"
 
+#include <string.h>
 #include <unistd.h>
 #include <math.h>
 #include <deque>
 #include <algorithm>
+#include <functional>
 
 #include "boost/filesystem.hpp"
-#include "boost/bind.hpp"
 #include "boost/accumulators/numeric/functional.hpp"
 
 #include "mars/comm/socket/unix_socket.h"
@@ -37,20 +38,7 @@
 
 #include "mars/app/app.h"
 
-#define IPPORT_RECORDS_FILENAME "/ipportrecords2.xml"
-
-static const time_t kRecordTimeout = 60 * 60 * 24;
 static const char* const kFolderName = "host";
-// const static char* const RECORDS = "records";
-static const char* const kRecord = "record";
-static const char* const kItem = "item";
-static const char* const kTime = "time";
-static const char* const kNetInfo = "netinfo";
-static const char* const kIP = "ip";
-static const char* const kPort = "port";
-//static const char* const kSuccess = "succ";
-//static const char* const kTotal = "total";
-static const char* const kHistoryResult = "historyresult";
 
 static const unsigned int kBanTime = 6 * 60 * 1000;  // 6 min
 static const unsigned int kMaxBanTime = 30 * 60 * 1000; // 30 min
@@ -87,21 +75,40 @@ uint32_t CAL_LAST_CONTINUOUS_BIT_COUNT(uint64_t RECORDS) {
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////
-namespace mars { namespace stn {
-    struct BanItem {
-        std::string ip;
-        uint16_t port;
-        uint8_t records;
-        tickcount_t last_fail_time;
-        tickcount_t last_suc_time;
-        BanItem(): port(0), records(0) {}
-    };
-}}
-
 using namespace mars::stn;
 
+IPPortKey::IPPortKey(const std::string& _ip, uint16_t _port)
+: port(_port) {
+    memset(addr, 0, sizeof(addr));
+    if (1 == socket_inet_pton(AF_INET, _ip.c_str(), &addr[12])) {
+        addr[10] = addr[11] = 0xFF;
+    } else if (1 != socket_inet_pton(AF_INET6, _ip.c_str(), addr)) {
+        // not an ip literal, never expected: a hash of the text, away from the v4 mapped range
+        size_t hash = std::hash<std::string>()(_ip);
+        memcpy(addr, &hash, std::min(sizeof(hash), sizeof(addr)));
+        addr[15] = 0xFF;
+    }
+}
+
+bool IPPortKey::operator==(const IPPortKey& _rhs) const {
+    return port == _rhs.port && 0 == memcmp(addr, _rhs.addr, sizeof(addr));
+}
+
+size_t IPPortKeyHash::operator()(const IPPortKey& _key) const {
+    uint64_t high = 0, low = 0;
+    memcpy(&high, _key.addr, sizeof(high));
+    memcpy(&low, _key.addr + sizeof(high), sizeof(low));
+
+    uint64_t hash = (high * 0x9E3779B97F4A7C15ULL) ^ low ^ ((uint64_t)_key.port << 48);
+    hash ^= hash >> 29;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 32;
+    return (size_t)hash;
+}
+
 SimpleIPPortSort::SimpleIPPortSort()
 : hostpath_(mars::app::GetAppFilePath() + "/" + kFolderName)
+, history_(hostpath_)
 , IPv6_ban_flag_(0)
 , IPv4_ban_flag_(0) 
 , ban_v6_(false) {
@@ -110,100 +117,47 @@ SimpleIPPortSort::SimpleIPPortSort()
         boost::filesystem::create_directory(hostpath_);
     }
         
-    ScopedLock lock(mutex_);
-    __LoadXml();
-    lock.unlock();
     InitHistory2BannedList(false);
 }
 
 SimpleIPPortSort::~SimpleIPPortSort() {
-    ScopedLock lock(mutex_);
-    __SaveXml();
-}
-
-void SimpleIPPortSort::__SaveXml() {
-    __RemoveTimeoutXml();
-    recordsxml_.SaveFile((hostpath_ + IPPORT_RECORDS_FILENAME).c_str());
-}
-
-void SimpleIPPortSort::__LoadXml() {
-    tinyxml2::XMLError error = recordsxml_.LoadFile((hostpath_ + IPPORT_RECORDS_FILENAME).c_str());
-    if (tinyxml2::XML_SUCCESS != error) return;
-    __RemoveTimeoutXml();
-}
-
-void SimpleIPPortSort::__RemoveTimeoutXml() {
-    std::vector<tinyxml2::XMLElement*> remove_ele_ptr_list;
-
-    for (tinyxml2::XMLElement* record = recordsxml_.FirstChildElement(kRecord);
-            NULL != record; record = record->NextSiblingElement(kRecord)) {
-        const char* lasttime_chr = record->Attribute(kTime);
-
-        if (lasttime_chr) {
-            struct timeval now = {0};
-            gettimeofday(&now, NULL);
-            time_t lasttime = (time_t)strtoul(lasttime_chr, NULL, 10);
-
-            if (now.tv_sec < lasttime || now.tv_sec - lasttime >= kRecordTimeout) {
-                remove_ele_ptr_list.push_back(record);
-            }
-        } else {
-            remove_ele_ptr_list.push_back(record);
-        }
-    }
-
-    for (std::vector<tinyxml2::XMLElement*>::iterator iter = remove_ele_ptr_list.begin();
-            iter != remove_ele_ptr_list.end(); ++iter) {
-        recordsxml_.DeleteChild(*iter);
-    }
 }
 
 void SimpleIPPortSort::InitHistory2BannedList(bool _savexml) {
+    // written behind, a network switch does not wait for the disk
+    if (_savexml) history_.Flush();
+
     ScopedLock lock(mutex_);
-    if (_savexml) __SaveXml();
-    
     _ban_fail_list_.clear();
     
     std::string curr_netinfo;
     if (kNoNet == getCurrNetLabel(curr_netinfo)) return;
 
-    const tinyxml2::XMLElement* record = NULL;
+    std::vector<IPPortHistory::Item> items;
+    history_.Get(curr_netinfo, items);
+    xinfo2(TSF"curr_netinfo:%_, history items:%_", curr_netinfo, items.size());
 
-    for (record = recordsxml_.FirstChildElement(kRecord);
-            NULL != record; record = record->NextSiblingElement(kRecord)) {
-        const char* netinfoChr = record->Attribute(kNetInfo);
-
-        if (netinfoChr && (0 == strcmp(netinfoChr, curr_netinfo.c_str()))) {
-            xwarn2(TSF"netinfoChr:%_, curr_netinfo.c_str():%_", netinfoChr, curr_netinfo.c_str());
-            break;
-        }
-    }
-
-    if (NULL == record) { return; }
-
-    for (const tinyxml2::XMLElement* item = record->FirstChildElement(kItem); NULL != item; item = item->NextSiblingElement(kItem)) {
-        const char* ip = item->Attribute(kIP);
-        uint32_t    port = item->UnsignedAttribute(kPort);
-        uint64_t    historyresult = (uint64_t)item->Int64Attribute(kHistoryResult);
+    for (std::vector<IPPortHistory::Item>::const_iterator item = items.begin(); item != items.end(); ++item) {
+        uint64_t    historyresult = item->results;
         
         struct BanItem banitem;
-        if(ip) banitem.ip = ip;
-        banitem.port = port;
+        banitem.ip = item->ip;
+        banitem.port = item->port;
         banitem.records = 0;
         //8 in 1
         for (int i = 0; i < 8; ++i) {
             SET_BIT(historyresult & 0xFF, banitem.records);
             historyresult >>= 8;
         }
-        _ban_fail_list_.push_back(banitem);
+        _ban_fail_list_[IPPortKey(banitem.ip, banitem.port)] = banitem;
     }
 }
 
 void SimpleIPPortSort::RemoveBannedList(const std::string& _ip) {
     ScopedLock lock(mutex_);
 
-    for (std::vector<BanItem>::iterator iter = _ban_fail_list_.begin(); iter != _ban_fail_list_.end();) {
-        if (iter->ip == _ip)
+    for (std::unordered_map<IPPortKey, BanItem, IPPortKeyHash>::iterator iter = _ban_fail_list_.begin(); iter != _ban_fail_list_.end();) {
+        if (iter->second.ip == _ip)
             iter = _ban_fail_list_.erase(iter);
         else
             ++iter;
@@ -219,82 +173,31 @@ void SimpleIPPortSort::Update(const std::string& _ip, uint16_t _port, bool _is_s
     if (!__CanUpdate(_ip, _port, _is_success)) return;
     
     __UpdateBanList(_is_success,  _ip,  _port);
-
-    tinyxml2::XMLElement* record = NULL;
-
-    for (record = recordsxml_.FirstChildElement(kRecord);
-            NULL != record; record = record->NextSiblingElement(kRecord)) {
-        const char* netinfo_chr = record->Attribute(kNetInfo);
-        if (netinfo_chr && (0 == strcmp(netinfo_chr, curr_net_info.c_str()))) break;
-    }
-
-    if (NULL == record) {
-        struct timeval timeval = {0};
-        gettimeofday(&timeval, NULL);
-        char timebuf[128] = {0};
-        snprintf(timebuf, sizeof(timebuf), "%ld", timeval.tv_sec);
-        
-        record = recordsxml_.NewElement(kRecord);
-        record->SetAttribute(kNetInfo, curr_net_info.c_str());
-        record->SetAttribute(kTime, timebuf);
-        recordsxml_.InsertEndChild(record);
-    }
-
-    tinyxml2::XMLElement* item = NULL;
-
-    for (item = record->FirstChildElement(kItem);
-            NULL != item; item = item->NextSiblingElement(kItem)) {
-        const char* ip = item->Attribute(kIP);
-        uint32_t port = item->UnsignedAttribute(kPort);
-
-        if (ip && (0 == strcmp(ip, _ip.c_str())) && port == _port) break;
-    }
-
-    if (NULL == item) {
-        item = recordsxml_.NewElement(kItem);
-        item->SetAttribute(kIP, _ip.c_str());
-        item->SetAttribute(kPort, _port);
-        record->InsertEndChild(item);
-    }
-
-    uint64_t history_result = item->Int64Attribute(kHistoryResult);
-    SET_BIT(!_is_success, history_result);
-    item->SetAttribute(kHistoryResult, (int64_t)history_result);
+    history_.Update(curr_net_info, _ip, _port, _is_success);
 }
 
-std::vector<BanItem>::iterator  SimpleIPPortSort::__FindBannedIter(const std::string& _ip, unsigned short _port) const {
-    std::vector<BanItem>::iterator iter;
-
-    for (iter = _ban_fail_list_.begin(); iter != _ban_fail_list_.end(); ++iter) {
-        if (iter->ip == _ip && iter->port == _port) {
-            return iter;
-        }
-    }
-
-    return iter;
-}
-
-bool SimpleIPPortSort::__IsBanned(const std::string& _ip, unsigned short _port) const {
-    return __IsBanned(__FindBannedIter(_ip, _port));
+const BanItem* SimpleIPPortSort::__FindBanned(const IPPortKey& _key) const {
+    std::unordered_map<IPPortKey, BanItem, IPPortKeyHash>::const_iterator iter = _ban_fail_list_.find(_key);
+    return iter == _ban_fail_list_.end() ? NULL : &iter->second;
 }
 
-bool SimpleIPPortSort::__IsBanned(std::vector<BanItem>::iterator _iter) const {
-    if (_iter == _ban_fail_list_.end()) return false;
+bool SimpleIPPortSort::__IsBanned(const BanItem* _item) const {
+    if (NULL == _item) return false;
 
-    bool baned =  CAL_BIT_COUNT(_iter->records) >= kBanFailCount;
+    bool baned =  CAL_BIT_COUNT(_item->records) >= kBanFailCount;
     if (!baned) return false;
     
-    uint32_t last_continuous_cnt = CAL_LAST_CONTINUOUS_BIT_COUNT(_iter->records);
+    uint32_t last_continuous_cnt = CAL_LAST_CONTINUOUS_BIT_COUNT(_item->records);
     int64_t ban_time = kBanTime;
     if (last_continuous_cnt > kBanFailCount) {
         ban_time += (last_continuous_cnt - kBanFailCount) * kBanTime;
         if (ban_time > kMaxBanTime) {
             ban_time = kMaxBanTime;
         }
-        xinfo2(TSF"%_:%_ ban time:%_", _iter->ip, _iter->port, ban_time);
+        xinfo2(TSF"%_:%_ ban time:%_", _item->ip, _item->port, ban_time);
     }
     
-    if (_iter->last_fail_time.gettickspan() < ban_time) {
+    if (_item->last_fail_time.gettickspan() < ban_time) {
         return true;
     }
 
@@ -303,28 +206,19 @@ bool SimpleIPPortSort::__IsBanned(std::vector<BanItem>::iterator _iter) const {
 
 void SimpleIPPortSort::__UpdateBanList(bool _is_success, const std::string& _ip, unsigned short _port) {
     __UpdateBanFlagAndTime(_ip, _is_success);
-    for (std::vector<BanItem>::iterator iter = _ban_fail_list_.begin(); iter != _ban_fail_list_.end(); ++iter) {
-        if (iter->ip == _ip && iter->port == _port) {
-            SET_BIT(!_is_success, iter->records);
-            if (_is_success)
-                iter->last_suc_time.gettickcount();
-            else
-                iter->last_fail_time.gettickcount();
-            return;
-        }
+
+    BanItem& item = _ban_fail_list_[IPPortKey(_ip, _port)];
+    if (item.ip.empty()) {
+        item.ip = _ip;
+        item.port = _port;
     }
 
-    BanItem item;
-    item.ip = _ip;
-    item.port = _port;
     SET_BIT(!_is_success, item.records);
     
     if (_is_success)
         item.last_suc_time.gettickcount();
     else
         item.last_fail_time.gettickcount();
-    
-    _ban_fail_list_.push_back(item);
 }
 
 
@@ -384,22 +278,19 @@ bool SimpleIPPortSort::__IsIPv6(const std::string& _ip) {
 }
 
 bool SimpleIPPortSort::__CanUpdate(const std::string& _ip, uint16_t _port, bool _is_success) const {
-    for (std::vector<BanItem>::iterator iter = _ban_fail_list_.begin(); iter != _ban_fail_list_.end(); ++iter) {
-        if (iter->ip == _ip && iter->port == _port) {
-            if (_is_success) {
-                return kSuccessUpdateInterval < iter->last_suc_time.gettickspan();
-            } else {
-                return kFailUpdateInterval < iter->last_fail_time.gettickspan();
-            }
-        }
+    const BanItem* item = __FindBanned(IPPortKey(_ip, _port));
+    if (NULL == item) return true;
+
+    if (_is_success) {
+        return kSuccessUpdateInterval < item->last_suc_time.gettickspan();
+    } else {
+        return kFailUpdateInterval < item->last_fail_time.gettickspan();
     }
-    
-    return true;
 }
 
 void SimpleIPPortSort::__FilterbyBanned(std::vector<IPPortItem>& _items) const {
     for (std::vector<IPPortItem>::iterator it = _items.begin(); it != _items.end();) {
-        if (__IsBanned(it->str_ip, it->port) || __IsServerBan(it->str_ip)) {
+        if (__IsBanned(__FindBanned(IPPortKey(it->str_ip, it->port))) || __IsServerBan(it->str_ip, IPPortKey(it->str_ip, 0))) {
             xwarn2(TSF"ip:%0, port:%1, is ban!!", it->str_ip, it->port);
             it = _items.erase(it);
         } else {
@@ -408,8 +299,10 @@ void SimpleIPPortSort::__FilterbyBanned(std::vector<IPPortItem>& _items) const {
     }
 }
 
-bool SimpleIPPortSort::__IsServerBan(const std::string& _ip) const {
-    std::map<std::string, uint64_t>::iterator iter = _server_bans_.find(_ip);
+bool SimpleIPPortSort::__IsServerBan(const std::string& _ip, const IPPortKey& _key) const {
+    if (_server_bans_.empty()) return false;
+
+    std::unordered_map<IPPortKey, uint64_t, IPPortKeyHash>::iterator iter = _server_bans_.find(_key);
 
     if (iter == _server_bans_.end()) return false;
     
@@ -424,6 +317,15 @@ bool SimpleIPPortSort::__IsServerBan(const std::string& _ip) const {
     return false;
 }
 
+namespace {
+// a candidate with a history and what it is sorted by
+struct ScoredItem {
+    const IPPortItem* item;
+    const BanItem* banned;
+    uint32_t fail_count;
+};
+}
+
 void SimpleIPPortSort::__SortbyBanned(std::vector<IPPortItem>& _items, bool _use_IPv6) const {
     srand((unsigned int)gettickcount());
     //random_shuffle new and history
@@ -450,50 +352,45 @@ void SimpleIPPortSort::__SortbyBanned(std::vector<IPPortItem>& _items, bool _use
 		}
 	}
 
-    //separate new and history
-    std::deque<IPPortItem> items_history(_items.size());
-    std::deque<IPPortItem> items_new(_items.size());
-    auto find_lambda = [&](const IPPortItem& _v) {
-        for (std::vector<BanItem>::const_iterator it_banned = _ban_fail_list_.begin(); it_banned != _ban_fail_list_.end(); ++it_banned) {
-            if (it_banned->ip == _v.str_ip && it_banned->port == _v.port) {
-                return true;
-            }
+    //separate new and history, each candidate looked up once
+    std::vector<ScoredItem> items_scored;
+    std::deque<IPPortItem> items_new;
+    items_scored.reserve(_items.size());
+    for (std::vector<IPPortItem>::const_iterator it = _items.begin(); it != _items.end(); ++it) {
+        const BanItem* banned = __FindBanned(IPPortKey(it->str_ip, it->port));
+        if (NULL == banned) {
+            items_new.push_back(*it);
+            continue;
         }
-        return false;
-    };
-    
-    items_history.erase(std::remove_copy_if(_items.begin(), _items.end(), items_history.begin(), !boost::bind<bool>(find_lambda, _1)), items_history.end());
-    items_new.erase(std::remove_copy_if(_items.begin(), _items.end(), items_new.begin(), find_lambda), items_new.end());
-    xassert2(_items.size() == items_history.size()+items_new.size(), TSF"_item:%_, history:%_, new:%_", _items.size(), items_history.size(), items_new.size());
+
+        ScoredItem scored;
+        scored.item = &(*it);
+        scored.banned = banned;
+        scored.fail_count = CAL_BIT_COUNT(banned->records);
+        items_scored.push_back(scored);
+    }
     
     //sort history
-    std::sort(items_history.begin(), items_history.end(),
-              [&](const IPPortItem& _l, const IPPortItem& _r){
-                  auto find_lr_lambda  = [](const BanItem& _v, const IPPortItem& _find) {
-                      return _v.ip == _find.str_ip && _v.port == _find.port;
-                  };
-                      
-                  std::vector<BanItem>::const_iterator  l = std::find_if(_ban_fail_list_.begin(), _ban_fail_list_.end(), boost::bind<bool>(find_lr_lambda, _1, _l));
-                  std::vector<BanItem>::const_iterator  r = std::find_if(_ban_fail_list_.begin(), _ban_fail_list_.end(), boost::bind<bool>(find_lr_lambda, _1, _r));
+    std::sort(items_scored.begin(), items_scored.end(),
+              [](const ScoredItem& _l, const ScoredItem& _r){
+                 if (_l.fail_count != _r.fail_count)
+                     return _l.fail_count < _r.fail_count;
                       
-                  xassert2(l != _ban_fail_list_.end());
-                  xassert2(r != _ban_fail_list_.end());
+                 if (_l.banned->last_fail_time != _r.banned->last_fail_time)
+                     return _l.banned->last_fail_time < _r.banned->last_fail_time;
                   
-                 if(l == _ban_fail_list_.end() || r == _ban_fail_list_.end())
-                  return false;
-                 
-                 if (CAL_BIT_COUNT(l->records) != CAL_BIT_COUNT(r->records))
-                     return CAL_BIT_COUNT(l->records) < CAL_BIT_COUNT(r->records);
-                      
-                 if (l->last_fail_time != r->last_fail_time)
-                     return l->last_fail_time < r->last_fail_time;
-                  
-                 if (l->last_suc_time != r->last_suc_time)
-                     return l->last_suc_time > r->last_suc_time;
+                 if (_l.banned->last_suc_time != _r.banned->last_suc_time)
+                     return _l.banned->last_suc_time > _r.banned->last_suc_time;
                   
                   //random by std::random_shuffle(_items.begin(), _items.end());
                   return false;
               });
+
+    std::deque<IPPortItem> items_history;
+    for (std::vector<ScoredItem>::const_iterator it = items_scored.begin(); it != items_scored.end(); ++it) {
+        items_history.push_back(*it->item);
+    }
+    xassert2(_items.size() == items_history.size()+items_new.size(), TSF"_item:%_, history:%_, new:%_", _items.size(), items_history.size(), items_new.size());
     
    //merge
     _items.clear();
@@ -610,6 +507,6 @@ void SimpleIPPortSort::AddServerBan(const std::string& _ip) {
     if (_ip.empty()) return;
 
     ScopedLock lock(mutex_);
-    _server_bans_[_ip] = ::gettickcount();
+    _server_bans_[IPPortKey(_ip, 0)] = ::gettickcount();
 }
 
@@ -23,18 +23,39 @@
 
 #include <string>
 #include <vector>
-#include <map>
 #include <deque>
+#include <unordered_map>
 
 #include "mars/comm/thread/lock.h"
-#include "mars/comm/tinyxml2.h"
 #include "mars/comm/tickcount.h"
 #include "mars/stn/stn.h"
 
+#include "ipport_history.h"
+
 namespace mars {
 namespace stn {
 
-struct BanItem;
+struct BanItem {
+    std::string ip;
+    uint16_t port;
+    uint8_t records;
+    tickcount_t last_fail_time;
+    tickcount_t last_suc_time;
+    BanItem(): port(0), records(0) {}
+};
+
+// the binary address of an ip, v4 mapped into v6, and a port; 0 for the ip alone
+struct IPPortKey {
+    uint8_t addr[16];
+    uint16_t port;
+
+    IPPortKey(const std::string& _ip, uint16_t _port);
+    bool operator==(const IPPortKey& _rhs) const;
+};
+
+struct IPPortKeyHash {
+    size_t operator()(const IPPortKey& _key) const;
+};
     
 class SimpleIPPortSort {
   public:
@@ -51,19 +72,14 @@ class SimpleIPPortSort {
     bool CanUseIPv6();
     
   private:
-    void __LoadXml();
-    void __SaveXml();
-    void __RemoveTimeoutXml();
-
-    std::vector<BanItem>::iterator __FindBannedIter(const std::string& _ip, uint16_t _port) const;
-    bool __IsBanned(std::vector<BanItem>::iterator _iter) const;
-    bool __IsBanned(const std::string& _ip, uint16_t _port) const;
+    const BanItem* __FindBanned(const IPPortKey& _key) const;
+    bool __IsBanned(const BanItem* _item) const;
     void __UpdateBanList(bool _isSuccess, const std::string& _ip, uint16_t _port);
     bool __CanUpdate(const std::string& _ip, uint16_t _port, bool _is_success) const;
 
     void __FilterbyBanned(std::vector<IPPortItem>& _items) const;
     void __SortbyBanned(std::vector<IPPortItem>& _items, bool _use_IPv6) const;
-    bool __IsServerBan(const std::string& _ip) const;
+    bool __IsServerBan(const std::string& _ip, const IPPortKey& _key) const;
     bool __IsV6Ip(const IPPortItem& item) const;
     void __PickIpItemRandom(std::vector<IPPortItem>& _items, std::deque<IPPortItem>& _items_history, std::deque<IPPortItem>& _items_new) const;
     void __UpdateBanFlagAndTime(const std::string& _ip, bool _success);
@@ -76,11 +92,12 @@ class SimpleIPPortSort {
 
   private:
     std::string hostpath_;
-    tinyxml2::XMLDocument recordsxml_;
+    IPPortHistory history_;
 
     mutable Mutex mutex_;
-    mutable std::vector<BanItem> _ban_fail_list_;
-    mutable std::map<std::string, uint64_t> _server_bans_;
+    // every candidate of every connect is looked up, by ip and port
+    mutable std::unordered_map<IPPortKey, BanItem, IPPortKeyHash> _ban_fail_list_;
+    mutable std::unordered_map<IPPortKey, uint64_t, IPPortKeyHash> _server_bans_;
 
     uint8_t IPv6_ban_flag_;
     uint8_t IPv4_ban_flag_;
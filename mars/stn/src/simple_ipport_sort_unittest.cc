@@ -0,0 +1,110 @@
+#include "simple_ipport_sort.h"
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+
+#include "mars/app/app.h"
+#include "mars/comm/platform_comm.h"
+#include "mars/comm/xlogger/xlogger.h"
+
+using namespace testing;
+using namespace mars::stn;
+
+static IPPortItem __Item(const std::string& _ip, uint16_t _port) {
+    IPPortItem item;
+    item.str_ip = _ip;
+    item.port = _port;
+    item.source_type = kIPSourceDNS;
+    return item;
+}
+
+static std::string __IP(int _i) {
+    char ip[32];
+    snprintf(ip, sizeof(ip), "10.0.%d.%d", _i / 256, _i % 256);
+    return ip;
+}
+
+static int __Position(const std::vector<IPPortItem>& _items, const std::string& _ip) {
+    for (size_t i = 0; i < _items.size(); ++i) {
+        if (_items[i].str_ip == _ip) return (int)i;
+    }
+    return -1;
+}
+
+class SimpleIPPortSortTest : public Test {
+  protected:
+    virtual void SetUp() {
+        hostpath_ = mars::app::GetAppFilePath() + "/host";
+        boost::filesystem::remove_all(hostpath_);
+        boost::filesystem::create_directories(hostpath_);
+        getCurrNetLabel(netinfo_);
+        old_level_ = xlogger_Level();
+        xlogger_SetLevel(kLevelWarn);
+    }
+
+    virtual void TearDown() {
+        xlogger_SetLevel(old_level_);
+        boost::filesystem::remove_all(hostpath_);
+    }
+
+    std::string hostpath_;
+    std::string netinfo_;
+    TLogLevel old_level_;
+};
+
+TEST_F(SimpleIPPortSortTest, filters_and_orders) {
+    {
+        IPPortHistory history(hostpath_);
+        // a result a byte: 3 of the last 8 failed, 1 failed, none failed
+        for (int i = 0; i < 24; ++i) history.Update(netinfo_, "10.0.0.1", 443, 0 != i % 8);
+        for (int i = 0; i < 8; ++i) history.Update(netinfo_, "10.0.0.2", 443, 0 != i);
+        history.Update(netinfo_, "10.0.0.3", 443, true);
+        history.Update(netinfo_, "2001:db8::3", 443, true);
+    }
+
+    SimpleIPPortSort sort;
+    sort.AddServerBan("10.0.0.4");
+
+    for (int round = 0; round < 20; ++round) {
+        std::vector<IPPortItem> items;
+        items.push_back(__Item("10.0.0.1", 443));
+        items.push_back(__Item("10.0.0.2", 443));
+        items.push_back(__Item("10.0.0.3", 443));
+        items.push_back(__Item("10.0.0.4", 443));
+        items.push_back(__Item("10.0.0.5", 443));
+        items.push_back(__Item("10.0.0.6", 80));
+        items.push_back(__Item("2001:db8::3", 443));
+        sort.SortandFilter(items, 10, false);
+
+        ASSERT_EQ(6u, items.size());
+        EXPECT_EQ(-1, __Position(items, "10.0.0.4"));
+        // fewer failures first among the known ones
+        EXPECT_LT(__Position(items, "10.0.0.3"), __Position(items, "10.0.0.2"));
+        EXPECT_LT(__Position(items, "2001:db8::3"), __Position(items, "10.0.0.2"));
+        EXPECT_LT(__Position(items, "10.0.0.2"), __Position(items, "10.0.0.1"));
+        EXPECT_NE(-1, __Position(items, "10.0.0.5"));
+        EXPECT_NE(-1, __Position(items, "10.0.0.6"));
+
+        items.resize(3);
+        sort.SortandFilter(items, 2, true);
+        EXPECT_EQ(2u, items.size());
+    }
+
+    // one failure is no ban
+    sort.Update("10.0.0.7", 443, false);
+    std::vector<IPPortItem> items(1, __Item("10.0.0.7", 443));
+    sort.SortandFilter(items, 10, false);
+    EXPECT_EQ(1u, items.size());
+
+    sort.RemoveBannedList("10.0.0.1");
+    items.assign(1, __Item("10.0.0.1", 443));
+    sort.SortandFilter(items, 10, false);
+    EXPECT_EQ(1u, items.size());
+}
+
+EXPORT_GTEST_SYMBOLS(stn_export_simple_ipport_sort_unittest)
@@ -0,0 +1,244 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+/*
+ * socket_pool.cc
+ *
+ *  Created on: 2026-10-18
+ */
+
+#include "socket_pool.h"
+
+#include <string.h>
+#include <algorithm>
+#include <iterator>
+
+#include "boost/bind.hpp"
+
+#include "mars/comm/socket/socketpoll.h"
+#include "mars/comm/xlogger/xlogger.h"
+
+using namespace mars::stn;
+
+const size_t SocketPool::kDefaultMaxSize;
+const size_t SocketPool::kMaxSizePerEndpoint;
+
+SocketPool::SocketPool(size_t _max_size)
+: max_size_(_max_size)
+, stop_(false)
+, thread_(boost::bind(&SocketPool::__RunReaper, this), "socket_pool") {
+}
+
+SocketPool::~SocketPool() {
+    ScopedLock lock(mutex_);
+    stop_ = true;
+    lock.unlock();
+
+    breaker_.Break();
+    thread_.join();
+    Clear();
+}
+
+SOCKET SocketPool::GetSocket(const IPPortItem& _item) {
+    xverbose_function();
+    std::string endpoint = __Endpoint(_item);
+
+    ScopedLock lock(mutex_);
+    if (lru_.empty() || __IsBanned(endpoint)) return INVALID_SOCKET;
+
+    while (true) {
+        std::unordered_map<std::string, std::vector<CacheList::iterator> >::iterator bucket = buckets_.find(endpoint);
+        if (buckets_.end() == bucket) break;
+
+        CacheList::iterator iter = bucket->second.back();
+        if (iter->HasTimeout() || __IsSocketClosed(iter->socket_fd)) {
+            xinfo2(TSF"remove timeout or closed socket, is timeout:%_", iter->HasTimeout());
+            __Remove(iter, true);
+            continue;
+        }
+
+        SOCKET fd = iter->socket_fd;
+        __Remove(iter, false);
+        xinfo2(TSF"get from cache: ip:%_, port:%_, host:%_, fd:%_, size:%_", _item.str_ip, _item.port, _item.str_host, fd, lru_.size());
+        return fd;
+    }
+
+    xinfo2(TSF"can not find socket ip:%_, port:%_, host:%_, size:%_", _item.str_ip, _item.port, _item.str_host, lru_.size());
+    return INVALID_SOCKET;
+}
+
+bool SocketPool::AddCache(CacheSocketItem& item) {
+    std::string endpoint = __Endpoint(item.address_info);
+
+    ScopedLock lock(mutex_);
+    if (0 == max_size_ || __IsBanned(endpoint)) return false;
+
+    std::unordered_map<std::string, std::vector<CacheList::iterator> >::iterator bucket = buckets_.find(endpoint);
+    if (buckets_.end() != bucket && bucket->second.size() >= kMaxSizePerEndpoint) __Remove(bucket->second.front(), true);
+    while (lru_.size() >= max_size_) __Remove(std::prev(lru_.end()), true);
+
+    xinfo2(TSF"add item to socket pool, ip:%_, port:%_, host:%_, fd:%_, size:%_", item.address_info.str_ip, item.address_info.port, item.address_info.str_host, item.socket_fd, lru_.size());
+    lru_.push_front(item);
+    buckets_[endpoint].push_back(lru_.begin());
+
+    // the reaper polls the new socket from now on
+    thread_.start();
+    breaker_.Break();
+    return true;
+}
+
+void SocketPool::CleanTimeout() {
+    ScopedLock lock(mutex_);
+    if (lru_.empty()) return;
+
+    for (CacheList::iterator iter = lru_.begin(); iter != lru_.end();) {
+        if (iter->HasTimeout()) {
+            xinfo2(TSF"remove timeout socket: ip:%_, port:%_, host:%_, fd:%_", iter->address_info.str_ip, iter->address_info.port, iter->address_info.str_host, iter->socket_fd);
+            __Remove(iter++, true);
+            continue;
+        }
+        ++iter;
+    }
+    xinfo2(TSF"after clean, size:%_", lru_.size());
+}
+
+void SocketPool::Clear() {
+    ScopedLock lock(mutex_);
+    xinfo2(TSF"clear cache sockets");
+    for (CacheList::iterator iter = lru_.begin(); iter != lru_.end(); ++iter) {
+        if (iter->socket_fd != INVALID_SOCKET) socket_close(iter->socket_fd);
+    }
+    lru_.clear();
+    buckets_.clear();
+    breaker_.Break();
+}
+
+void SocketPool::Report(const IPPortItem& _item, bool _is_reused, bool _has_received, bool _is_decode_ok) {
+    if (!_is_reused) return;
+
+    std::string endpoint = __Endpoint(_item);
+    ScopedLock lock(mutex_);
+
+    if (!_has_received || !_is_decode_ok) {
+        xwarn2(TSF"reused socket fail, ban cache of %_, has_received:%_", endpoint, _has_received);
+        bans_[endpoint].gettickcount();
+        __CloseEndpoint(endpoint);
+    } else {
+        bans_.erase(endpoint);
+    }
+}
+
+size_t SocketPool::Size() const {
+    ScopedLock lock(mutex_);
+    return lru_.size();
+}
+
+std::string SocketPool::__Endpoint(const IPPortItem& _item) {
+    char port[16];
+    snprintf(port, sizeof(port), ":%u/", (unsigned int)_item.port);
+    return _item.str_ip + port + _item.str_host;
+}
+
+bool SocketPool::__IsBanned(const std::string& _endpoint) {
+    if (bans_.empty()) return false;
+
+    std::unordered_map<std::string, tickcount_t>::iterator ban = bans_.find(_endpoint);
+    if (bans_.end() == ban) return false;
+    if (ban->second.gettickspan() <= BAN_INTERVAL) return true;
+
+    bans_.erase(ban);
+    return false;
+}
+
+void SocketPool::__Remove(CacheList::iterator _iter, bool _close) {
+    std::unordered_map<std::string, std::vector<CacheList::iterator> >::iterator bucket = buckets_.find(__Endpoint(_iter->address_info));
+    if (buckets_.end() != bucket) {
+        std::vector<CacheList::iterator>& items = bucket->second;
+        items.erase(std::find(items.begin(), items.end(), _iter));
+        if (items.empty()) buckets_.erase(bucket);
+    }
+
+    if (_close) socket_close(_iter->socket_fd);
+    lru_.erase(_iter);
+}
+
+void SocketPool::__CloseEndpoint(const std::string& _endpoint) {
+    std::unordered_map<std::string, std::vector<CacheList::iterator> >::iterator bucket = buckets_.find(_endpoint);
+    if (buckets_.end() == bucket) return;
+
+    for (std::vector<CacheList::iterator>::iterator iter = bucket->second.begin(); iter != bucket->second.end(); ++iter) {
+        socket_close((*iter)->socket_fd);
+        lru_.erase(*iter);
+    }
+    buckets_.erase(bucket);
+}
+
+bool SocketPool::__IsSocketClosed(SOCKET fd) {
+    char buff[2];
+#ifndef WIN32
+    ssize_t nrecv = ::recv(fd, buff, 1, MSG_PEEK|MSG_DONTWAIT);
+#else
+    ssize_t nrecv = ::recv(fd, buff, 1, MSG_PEEK);
+#endif
+    if (0 == nrecv) {
+        xerror2(TSF"socket already closed");
+        return true;
+    }
+
+    if (0 > nrecv && !IS_NOBLOCK_READ_ERRNO(socket_errno)) {
+        xerror2(TSF"socket error:(%_, %_)", socket_errno, strerror(socket_errno));
+        return true;
+    }
+
+    return false;
+}
+
+// an idle keep-alive socket has nothing to read: readable means the server closed or reset it
+void SocketPool::__RunReaper() {
+    SocketPoll poll(breaker_, true);
+
+    ScopedLock lock(mutex_);
+    while (!stop_) {
+        int64_t timeout = -1;
+        poll.ClearEvent();
+
+        for (CacheList::iterator iter = lru_.begin(); iter != lru_.end();) {
+            int64_t left = (int64_t)iter->timeout * 1000 - iter->start_tick.gettickspan();
+            if (0 >= left) {
+                xinfo2(TSF"reap timeout socket: ip:%_, port:%_, fd:%_", iter->address_info.str_ip, iter->address_info.port, iter->socket_fd);
+                __Remove(iter++, true);
+                continue;
+            }
+
+            if (-1 == timeout || left < timeout) timeout = left;
+            poll.AddEvent(iter->socket_fd, true, false, NULL);
+            ++iter;
+        }
+        lock.unlock();
+
+        // woken by AddCache and the destructor
+        poll.Poll((int)timeout);
+        lock.lock();
+
+        const std::vector<PollEvent>& events = poll.TriggeredEvents();
+        for (std::vector<PollEvent>::const_iterator event = events.begin(); event != events.end(); ++event) {
+            // taken by GetSocket meanwhile, or closed with the pool
+            CacheList::iterator iter = lru_.begin();
+            while (iter != lru_.end() && iter->socket_fd != event->FD()) ++iter;
+            if (lru_.end() == iter) continue;
+
+            xinfo2(TSF"reap socket closed by server: ip:%_, port:%_, fd:%_", iter->address_info.str_ip, iter->address_info.port, iter->socket_fd);
+            __Remove(iter, true);
+        }
+    }
+}
@@ -21,13 +21,18 @@
 #ifndef SOCKET_POOL_
 #define SOCKET_POOL_
 
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "mars/stn/stn.h"
 #include "mars/comm/tickcount.h"
 #include "mars/comm/socket/unix_socket.h"
-#include "mars/comm/xlogger/xlogger.h"
+#include "mars/comm/socket/socketbreaker.h"
 #include "mars/comm/thread/mutex.h"
 #include "mars/comm/thread/lock.h"
-#include "mars/comm/tickcount.h"
+#include "mars/comm/thread/thread.h"
 
 namespace mars {
 namespace stn {
@@ -54,121 +59,57 @@ namespace stn {
         uint32_t timeout;   //in seconds
     };
 
+    /*
+     * The idle keep-alive sockets of ShortLink, in a bucket for each (ip, port, host).
+     * GetSocket takes the socket added last to the bucket, the one most likely still open on the server.
+     * The pool holds at most _max_size sockets, kMaxSizePerEndpoint of an endpoint; beyond that the
+     * least recently added socket is closed.
+     * A reaper thread polls the idle sockets: a socket that turns readable was closed or reset by the
+     * server and is closed at once, and a socket is closed when its keep-alive timeout expires.
+     * A reused socket which fails bans caching for its endpoint only, for BAN_INTERVAL.
+     */
     class SocketPool {
     public:
-        const int DEFAULT_MAX_KEEPALIVE_TIME = 5*1000;      //same as apache default
+        static const size_t kDefaultMaxSize = 16;
+        static const size_t kMaxSizePerEndpoint = 4;
 
-        SocketPool():use_cache_(true), is_baned_(false) {}
-        ~SocketPool() {
-            Clear();
-        }
+        SocketPool(size_t _max_size = kDefaultMaxSize);
+        ~SocketPool();
 
-        SOCKET GetSocket(const IPPortItem& _item) {
-            xverbose_function();
-            ScopedLock lock(mutex_);
-            if(!use_cache_ || _isBaned() || socket_pool_.empty())
-                return INVALID_SOCKET;
-
-            auto iter = socket_pool_.begin();
-            while(iter != socket_pool_.end()) {
-                if(iter->IsSame(_item)) {
-                    if(iter->HasTimeout() || _IsSocketClosed(iter->socket_fd)) {
-                        xinfo2(TSF"remove timeout or closed socket, is timeout:%_", iter->HasTimeout());
-                        socket_close(iter->socket_fd);
-                        iter = socket_pool_.erase(iter);
-                        continue;
-                    }
-                    SOCKET fd = iter->socket_fd;
-                    socket_pool_.erase(iter);
-                    xinfo2(TSF"get from cache: ip:%_, port:%_, host:%_, fd:%_, size:%_", _item.str_ip, _item.port, _item.str_host, fd, socket_pool_.size());
-                    return fd;
-                }
-                iter++;
-            }
-            xinfo2(TSF"can not find socket ip:%_, port:%_, host:%_, size:%_", _item.str_ip, _item.port, _item.str_host, socket_pool_.size());
-            return INVALID_SOCKET;
-        }
+        SOCKET GetSocket(const IPPortItem& _item);
+        // false when the socket is not taken, the caller closes it
+        bool AddCache(CacheSocketItem& item);
+        void CleanTimeout();
+        void Clear();
+        void Report(const IPPortItem& _item, bool _is_reused, bool _has_received, bool _is_decode_ok);
 
-        bool AddCache(CacheSocketItem& item) {
-            ScopedLock lock(mutex_);
-            xinfo2(TSF"add item to socket pool, ip:%_, port:%_, host:%_, fd:%_, size:%_", item.address_info.str_ip, item.address_info.port, item.address_info.str_host, item.socket_fd, socket_pool_.size());
-            socket_pool_.push_back(item);
-            return true;
-        }
+        size_t Size() const;
 
-        void CleanTimeout() {
-            ScopedLock lock(mutex_);
-            if(socket_pool_.empty())    return;
-            
-            auto iter = socket_pool_.begin();
-            while(iter != socket_pool_.end()) {
-                if(iter->HasTimeout()) {
-                    socket_close(iter->socket_fd);
-                    xinfo2(TSF"remove timeout socket: ip:%_, port:%_, host:%_, fd:%_", iter->address_info.str_ip, iter->address_info.port, iter->address_info.str_host, iter->socket_fd);
-                    iter = socket_pool_.erase(iter);
-                    continue;
-                }
-                iter++;
-            }
-            xinfo2(TSF"after clean, size:%_", socket_pool_.size());
-        }
+    private:
+        typedef std::list<CacheSocketItem> CacheList;
 
-        void Clear() {
-            ScopedLock lock(mutex_);
-            xinfo2(TSF"clear cache sockets");
-            std::for_each(socket_pool_.begin(), socket_pool_.end(), [](CacheSocketItem& value) {
-                if(value.socket_fd != INVALID_SOCKET)
-                    socket_close(value.socket_fd);
-            });
-            socket_pool_.clear();
-        }
+        static std::string __Endpoint(const IPPortItem& _item);
+        bool __IsBanned(const std::string& _endpoint);
+        void __Remove(CacheList::iterator _iter, bool _close);
+        void __CloseEndpoint(const std::string& _endpoint);
+        bool __IsSocketClosed(SOCKET fd);
+        void __RunReaper();
 
-        void Report(bool _is_reused, bool _has_received, bool _is_decode_ok) {
-            if(_is_reused && (!_has_received || !_is_decode_ok)) {
-                ban_start_tick_.gettickcount();
-                is_baned_ = true;
-            } else if(_is_reused && _has_received && _is_decode_ok) {
-                is_baned_ = false;
-            }
-        }
-        
     private:
-        bool _isBaned() {
-            return is_baned_ && ban_start_tick_.isValid() && ban_start_tick_.gettickspan() <= BAN_INTERVAL;
-        }
-
-        bool _IsSocketClosed(SOCKET fd) {
-            char buff[2];
-            int try_count = 0;
-            while(try_count < 2) {
-                try_count++;
-#ifndef WIN32
-                ssize_t nrecv = ::recv(fd, buff, 1, MSG_PEEK|MSG_DONTWAIT);
-#else
-                ssize_t nrecv = ::recv(fd, buff, 1, MSG_PEEK);
-#endif
-                if (0 == nrecv) {
-                    xerror2(TSF"socket already closed");
-                    return true;
-                }
-                
-                if (0 > nrecv && !IS_NOBLOCK_READ_ERRNO(socket_errno)) {
-                    xerror2(TSF"socket error:(%_, %_)", socket_errno, strerror(socket_errno));
-                    return true;
-                } else {
-                    return false;
-                }
-            }
-            
-            return true;
-        }
+        SocketPool(const SocketPool&);
+        SocketPool& operator=(const SocketPool&);
 
     private:
-        Mutex mutex_;
-        bool use_cache_;
-        std::vector<CacheSocketItem> socket_pool_;
-        bool is_baned_;
-        tickcount_t ban_start_tick_;
+        const size_t max_size_;
+
+        mutable Mutex mutex_;
+        CacheList lru_;     // most recently added first
+        std::unordered_map<std::string, std::vector<CacheList::iterator> > buckets_;     // most recently added last
+        std::unordered_map<std::string, tickcount_t> bans_;     // endpoint -> ban start
+
+        SocketBreaker breaker_;
+        bool stop_;
+        Thread thread_;
     };
 
 }
@@ -0,0 +1,166 @@
+#include "socket_pool.h"
+#include "gtest/gtest.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "mars/comm/thread/thread.h"
+
+using namespace testing;
+using namespace mars::stn;
+
+static IPPortItem __Item(const std::string& _ip, uint16_t _port, const std::string& _host) {
+    IPPortItem item;
+    item.str_ip = _ip;
+    item.port = _port;
+    item.source_type = kIPSourceDNS;
+    item.str_host = _host;
+    return item;
+}
+
+// the pool side of a connection, the server side goes to _peer
+static SOCKET __Socket(SOCKET* _peer) {
+    int fds[2];
+    if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) return INVALID_SOCKET;
+    *_peer = fds[1];
+    return fds[0];
+}
+
+// fd numbers come back with the next socketpair, the peer tells whether the pool closed a socket
+static bool __ClosedByPool(SOCKET _peer) {
+    char c;
+    return 0 == recv(_peer, &c, 1, MSG_DONTWAIT);
+}
+
+static bool __Add(SocketPool& _pool, const IPPortItem& _item, SOCKET _fd, uint32_t _timeout = 60) {
+    CacheSocketItem cache(_item, _fd, _timeout);
+    return _pool.AddCache(cache);
+}
+
+static bool __WaitSize(SocketPool& _pool, size_t _size) {
+    for (int i = 0; i < 300 && _pool.Size() != _size; ++i) ThreadUtil::usleep(10 * 1000);
+    return _pool.Size() == _size;
+}
+
+TEST(socket_pool, buckets) {
+    SocketPool pool;
+    IPPortItem a = __Item("10.0.0.1", 80, "a.qq.com");
+    IPPortItem b = __Item("10.0.0.1", 80, "b.qq.com");
+    SOCKET peers[3];
+    SOCKET a1 = __Socket(&peers[0]);
+    SOCKET a2 = __Socket(&peers[1]);
+    SOCKET b1 = __Socket(&peers[2]);
+
+    EXPECT_TRUE(__Add(pool, a, a1));
+    EXPECT_TRUE(__Add(pool, a, a2));
+    EXPECT_TRUE(__Add(pool, b, b1));
+    EXPECT_EQ(3u, pool.Size());
+
+    // the last one added first
+    EXPECT_EQ(a2, pool.GetSocket(a));
+    EXPECT_EQ(a1, pool.GetSocket(a));
+    EXPECT_EQ(INVALID_SOCKET, pool.GetSocket(a));
+    EXPECT_EQ(INVALID_SOCKET, pool.GetSocket(__Item("10.0.0.1", 443, "b.qq.com")));
+    EXPECT_EQ(b1, pool.GetSocket(b));
+    EXPECT_EQ(0u, pool.Size());
+
+    for (int i = 0; i < 3; ++i) close(peers[i]);
+    close(a1);
+    close(a2);
+    close(b1);
+}
+
+TEST(socket_pool, lru_cap) {
+    SocketPool pool(5);
+    std::vector<SOCKET> fds, peers;
+    for (int i = 0; i < 7; ++i) {
+        SOCKET peer = INVALID_SOCKET;
+        fds.push_back(__Socket(&peer));
+        peers.push_back(peer);
+        EXPECT_TRUE(__Add(pool, __Item("10.0.0." + std::to_string(i % 3), 80, "qq.com"), fds.back()));
+    }
+    // the two added first are closed
+    EXPECT_EQ(5u, pool.Size());
+    EXPECT_TRUE(__ClosedByPool(peers[0]));
+    EXPECT_TRUE(__ClosedByPool(peers[1]));
+    EXPECT_FALSE(__ClosedByPool(peers[2]));
+
+    // and at most kMaxSizePerEndpoint of an endpoint
+    IPPortItem item = __Item("10.0.0.9", 80, "qq.com");
+    std::vector<SOCKET> same;
+    for (size_t i = 0; i <= SocketPool::kMaxSizePerEndpoint; ++i) {
+        SOCKET peer = INVALID_SOCKET;
+        same.push_back(__Socket(&peer));
+        peers.push_back(peer);
+        EXPECT_TRUE(__Add(pool, item, same.back()));
+    }
+    EXPECT_TRUE(__ClosedByPool(peers[7]));
+    EXPECT_FALSE(__ClosedByPool(peers[8]));
+    EXPECT_EQ(same.back(), pool.GetSocket(item));
+    close(same.back());
+
+    pool.Clear();
+    EXPECT_EQ(0u, pool.Size());
+    for (size_t i = 0; i < peers.size(); ++i) close(peers[i]);
+}
+
+TEST(socket_pool, ban_per_endpoint) {
+    SocketPool pool;
+    IPPortItem a = __Item("10.0.0.1", 80, "qq.com");
+    IPPortItem b = __Item("10.0.0.2", 80, "qq.com");
+    SOCKET peers[3];
+    SOCKET a1 = __Socket(&peers[0]);
+    SOCKET b1 = __Socket(&peers[1]);
+    EXPECT_TRUE(__Add(pool, a, a1));
+    EXPECT_TRUE(__Add(pool, b, b1));
+
+    // a new socket failing is no reason
+    pool.Report(a, false, false, false);
+    EXPECT_EQ(2u, pool.Size());
+
+    pool.Report(a, true, true, false);
+    EXPECT_TRUE(__ClosedByPool(peers[0]));
+    EXPECT_FALSE(__ClosedByPool(peers[1]));
+    EXPECT_EQ(INVALID_SOCKET, pool.GetSocket(a));
+    SOCKET a2 = __Socket(&peers[2]);
+    EXPECT_FALSE(__Add(pool, a, a2));
+    EXPECT_EQ(b1, pool.GetSocket(b));
+
+    pool.Report(a, true, true, true);
+    EXPECT_TRUE(__Add(pool, a, a2));
+    EXPECT_EQ(a2, pool.GetSocket(a));
+
+    for (int i = 0; i < 3; ++i) close(peers[i]);
+    close(a2);
+    close(b1);
+}
+
+TEST(socket_pool, reaps_in_background) {
+    SocketPool pool;
+    SOCKET peer = INVALID_SOCKET;
+    SOCKET closed_by_server = __Socket(&peer);
+    SOCKET alive_peer = INVALID_SOCKET;
+    SOCKET alive = __Socket(&alive_peer);
+    SOCKET expiring_peer = INVALID_SOCKET;
+    SOCKET expiring = __Socket(&expiring_peer);
+
+    EXPECT_TRUE(__Add(pool, __Item("10.0.0.1", 80, "qq.com"), closed_by_server));
+    EXPECT_TRUE(__Add(pool, __Item("10.0.0.2", 80, "qq.com"), alive));
+    EXPECT_TRUE(__Add(pool, __Item("10.0.0.3", 80, "qq.com"), expiring, 1));
+
+    close(peer);
+    // long before the keep-alive timeout
+    EXPECT_TRUE(__WaitSize(pool, 2));
+    EXPECT_EQ(INVALID_SOCKET, pool.GetSocket(__Item("10.0.0.1", 80, "qq.com")));
+
+    EXPECT_TRUE(__WaitSize(pool, 1));
+    EXPECT_TRUE(__ClosedByPool(expiring_peer));
+    EXPECT_FALSE(__ClosedByPool(alive_peer));
+    EXPECT_EQ(alive, pool.GetSocket(__Item("10.0.0.2", 80, "qq.com")));
+
+    close(alive);
+    close(alive_peer);
+    close(expiring_peer);
+}
+
+EXPORT_GTEST_SYMBOLS(stn_export_socket_pool_unittest)
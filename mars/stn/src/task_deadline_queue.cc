@@ -0,0 +1,64 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+/*
+ * task_deadline_queue.cc
+ *
+ *  Created on: 2026-10-18
+ */
+
+#include "task_deadline_queue.h"
+
+using namespace mars::stn;
+
+bool TaskDeadlineQueue::Schedule(uint32_t _taskid, uint64_t _deadline) {
+    std::unordered_map<uint32_t, uint64_t>::iterator it = scheduled_.find(_taskid);
+    if (scheduled_.end() != it && it->second <= _deadline) return false;
+
+    scheduled_[_taskid] = _deadline;
+    heap_.push(Entry(_deadline, _taskid));
+    return true;
+}
+
+void TaskDeadlineQueue::Remove(uint32_t _taskid) {
+    scheduled_.erase(_taskid);
+    if (scheduled_.empty()) heap_ = std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> >();
+}
+
+void TaskDeadlineQueue::Clear() {
+    scheduled_.clear();
+    heap_ = std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> >();
+}
+
+bool TaskDeadlineQueue::PopDue(uint64_t _now, uint32_t& _taskid) {
+    __DropStale();
+    if (heap_.empty() || heap_.top().first > _now) return false;
+
+    _taskid = heap_.top().second;
+    scheduled_.erase(_taskid);
+    heap_.pop();
+    return true;
+}
+
+uint64_t TaskDeadlineQueue::Next() {
+    __DropStale();
+    return heap_.empty() ? 0 : heap_.top().first;
+}
+
+void TaskDeadlineQueue::__DropStale() {
+    while (!heap_.empty()) {
+        std::unordered_map<uint32_t, uint64_t>::iterator it = scheduled_.find(heap_.top().second);
+        if (scheduled_.end() != it && it->second == heap_.top().first) return;
+        heap_.pop();
+    }
+}
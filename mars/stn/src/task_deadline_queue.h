@@ -0,0 +1,67 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+/*
+ * task_deadline_queue.h
+ *
+ *  Created on: 2026-10-18
+ */
+
+#ifndef STN_SRC_TASK_DEADLINE_QUEUE_H_
+#define STN_SRC_TASK_DEADLINE_QUEUE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mars {
+namespace stn {
+
+/*
+ * Earliest pending timeout check per task, ordered in a min-heap.
+ * A task holds at most one live entry: Schedule() only moves it earlier, entries that got
+ * superseded or removed stay in the heap and are skipped by PopDue() (lazy deletion).
+ * The owner recomputes the next deadline of a task after its entry popped.
+ */
+class TaskDeadlineQueue {
+  public:
+    // true if the task's live entry moved earlier
+    bool Schedule(uint32_t _taskid, uint64_t _deadline);
+    void Remove(uint32_t _taskid);
+    void Clear();
+
+    // pops the next task whose deadline is <= _now, false if none
+    bool PopDue(uint64_t _now, uint32_t& _taskid);
+    // earliest live deadline, 0 if none
+    uint64_t Next();
+
+    bool IsScheduled(uint32_t _taskid) const { return scheduled_.end() != scheduled_.find(_taskid); }
+    size_t Size() const { return scheduled_.size(); }
+
+  private:
+    void __DropStale();
+
+  private:
+    typedef std::pair<uint64_t, uint32_t> Entry;    // (deadline ms, taskid)
+
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > heap_;
+    std::unordered_map<uint32_t, uint64_t> scheduled_;     // taskid -> deadline of its live entry
+};
+
+}}
+
+#endif // STN_SRC_TASK_DEADLINE_QUEUE_H_
@@ -0,0 +1,53 @@
+#include "task_deadline_queue.h"
+#include "gtest/gtest.h"
+
+using namespace testing;
+using namespace mars::stn;
+
+TEST(task_deadline_queue, pops_in_deadline_order) {
+    TaskDeadlineQueue queue;
+    queue.Schedule(1, 300);
+    queue.Schedule(2, 100);
+    queue.Schedule(3, 200);
+    EXPECT_EQ(queue.Next(), 100u);
+
+    uint32_t taskid = 0;
+    EXPECT_FALSE(queue.PopDue(99, taskid));
+    ASSERT_TRUE(queue.PopDue(250, taskid));
+    EXPECT_EQ(taskid, 2u);
+    ASSERT_TRUE(queue.PopDue(250, taskid));
+    EXPECT_EQ(taskid, 3u);
+    EXPECT_FALSE(queue.PopDue(250, taskid));
+    EXPECT_EQ(queue.Next(), 300u);
+}
+
+TEST(task_deadline_queue, schedule_only_moves_earlier) {
+    TaskDeadlineQueue queue;
+    EXPECT_TRUE(queue.Schedule(1, 200));
+    EXPECT_FALSE(queue.Schedule(1, 300));
+    EXPECT_TRUE(queue.Schedule(1, 100));
+    EXPECT_EQ(queue.Size(), 1u);
+
+    uint32_t taskid = 0;
+    ASSERT_TRUE(queue.PopDue(1000, taskid));
+    EXPECT_EQ(taskid, 1u);
+    // the superseded entry at 200 is stale
+    EXPECT_FALSE(queue.PopDue(1000, taskid));
+    EXPECT_EQ(queue.Next(), 0u);
+}
+
+TEST(task_deadline_queue, removed_task_never_pops) {
+    TaskDeadlineQueue queue;
+    queue.Schedule(1, 100);
+    queue.Schedule(2, 200);
+    queue.Remove(1);
+    EXPECT_FALSE(queue.IsScheduled(1));
+    EXPECT_EQ(queue.Next(), 200u);
+
+    uint32_t taskid = 0;
+    ASSERT_TRUE(queue.PopDue(1000, taskid));
+    EXPECT_EQ(taskid, 2u);
+    EXPECT_FALSE(queue.PopDue(1000, taskid));
+}
+
+EXPORT_GTEST_SYMBOLS(stn_export_task_deadline_queue_unittest)
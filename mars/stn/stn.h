@@ -128,6 +128,7 @@ public:
     bool            isMain;
     int             packer_encoder_version = PackerEncoderVersion::kOld;
     std::vector<std::string> (*dns_func)(const std::string& host);
+    bool            shared_reactor = false;     //read/write on the one reactor thread shared by all channels instead of a thread per channel
 };
 
 enum TaskFailHandleType {
@@ -0,0 +1,81 @@
+#include "../src/simple_ipport_sort.h"
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+
+#include "mars/app/app.h"
+#include "mars/comm/platform_comm.h"
+#include "mars/comm/tickcount.h"
+#include "mars/comm/xlogger/xlogger.h"
+
+using namespace testing;
+using namespace mars::stn;
+
+static IPPortItem __Item(const std::string& _ip, uint16_t _port) {
+    IPPortItem item;
+    item.str_ip = _ip;
+    item.port = _port;
+    item.source_type = kIPSourceDNS;
+    return item;
+}
+
+static std::string __IP(int _i) {
+    char ip[32];
+    snprintf(ip, sizeof(ip), "10.0.%d.%d", _i / 256, _i % 256);
+    return ip;
+}
+
+class SimpleIPPortSortTest : public Test {
+  protected:
+    virtual void SetUp() {
+        hostpath_ = mars::app::GetAppFilePath() + "/host";
+        boost::filesystem::remove_all(hostpath_);
+        boost::filesystem::create_directories(hostpath_);
+        getCurrNetLabel(netinfo_);
+        old_level_ = xlogger_Level();
+        xlogger_SetLevel(kLevelWarn);
+    }
+
+    virtual void TearDown() {
+        xlogger_SetLevel(old_level_);
+        boost::filesystem::remove_all(hostpath_);
+    }
+
+    std::string hostpath_;
+    std::string netinfo_;
+    TLogLevel old_level_;
+};
+
+// SortandFilter of a backup ip list of 1k candidates, half of them with a history on the network
+TEST_F(SimpleIPPortSortTest, sort_and_filter_benchmark) {
+    static const int kCandidates = 1000;
+    static const int kRounds = 20;
+
+    SimpleIPPortSort sort;
+    for (int i = 0; i < kCandidates; i += 2) {
+        sort.Update(__IP(i), 443, 0 != i % 3);
+    }
+    for (int i = 0; i < kCandidates; i += 50) {
+        sort.AddServerBan(__IP(i + 1));
+    }
+
+    std::vector<IPPortItem> candidates;
+    for (int i = 0; i < kCandidates; ++i) {
+        candidates.push_back(__Item(__IP(i), 443));
+    }
+
+    uint64_t cost = 0;
+    for (int round = 0; round < kRounds; ++round) {
+        std::vector<IPPortItem> items = candidates;
+        tickcount_t begin(true);
+        sort.SortandFilter(items, kCandidates, false);
+        cost += tickcount_t(true) - begin;
+        EXPECT_EQ((size_t)(kCandidates - kCandidates / 50), items.size());
+    }
+
+    printf("%d candidates: SortandFilter %.2f ms\n", kCandidates, (double)cost / kRounds);
+}